@@ -0,0 +1,95 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "bench_utils.h"
+
+#include <time.h>
+
+double bench_now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+uint32_t bench_rand_u32(uint32_t * state) {
+  *state = (*state * 1664525u) + 1013904223u;
+  return *state >> 8;
+}
+
+bool bench_report_open(BenchReport * report, const char * suite, int argc, char ** argv) {
+  *report = (BenchReport){.suite = suite, .json_path = (argc > 1) ? argv[1] : NULL};
+
+  // with no output file the JSON goes to stdout at the end, so we gather it in a temporary file until then
+  report->json = (report->json_path != NULL) ? fopen(report->json_path, "w") : tmpfile();
+  if(report->json == NULL) {
+    fprintf(stderr, "can't open %s for writing\n", (report->json_path != NULL) ? report->json_path : "temporary file");
+    return false;
+  }
+
+  fprintf(report->json, "{\n  \"suite\": \"%s\",\n  \"results\": [", suite);
+  printf("%s:\n", suite);
+
+  return true;
+}
+
+static double per_second(size_t n, double seconds) { return (seconds > 0.0) ? ((double)n / seconds) : 0.0; }
+
+void bench_report_add(BenchReport * report, BenchResult result) {
+  const double bytes_per_s = per_second(result.bytes, result.seconds);
+  const double msgs_per_s  = per_second(result.msgs, result.seconds);
+  const double ns_per_op   = (result.ops > 0) ? ((result.seconds * 1e9) / (double)result.ops) : 0.0;
+
+  printf("  %-36s", result.name);
+  if(result.bytes > 0) printf(" %10.2f MB/s", bytes_per_s * 1e-6);
+  if(result.msgs > 0) printf(" %10.2f Mmsgs/s", msgs_per_s * 1e-6);
+  if(result.ops > 0) printf(" %10.2f ns/op", ns_per_op);
+  printf("\n");
+
+  fprintf(report->json,
+          "%s\n    {\"name\": \"%s\", \"seconds\": %.9f, \"bytes\": %zu, \"msgs\": %zu, \"ops\": %zu, "
+          "\"bytes_per_sec\": %.1f, \"msgs_per_sec\": %.1f, \"ns_per_op\": %.3f, \"checksum\": %llu}",
+          (report->num_results > 0) ? "," : "",
+          result.name,
+          result.seconds,
+          result.bytes,
+          result.msgs,
+          result.ops,
+          bytes_per_s,
+          msgs_per_s,
+          ns_per_op,
+          (unsigned long long)result.checksum);
+
+  report->num_results++;
+}
+
+bool bench_report_close(BenchReport * report) {
+  fprintf(report->json, "\n  ]\n}\n");
+
+  if(report->json_path == NULL) {
+    rewind(report->json);
+
+    char   buf[4096];
+    size_t n = 0;
+    while((n = fread(buf, 1, sizeof(buf), report->json)) > 0) fwrite(buf, 1, n, stdout);
+  } else {
+    printf("  results written to %s\n", report->json_path);
+  }
+
+  return fclose(report->json) == 0;
+}
@@ -0,0 +1,55 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_BENCH_UTILS_H
+#define C_MIDI_BENCH_UTILS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Shared plumbing for the benchmarks: timing, reproducible random data, and reporting. Each result is printed in a
+// human readable form and collected in a JSON document, which goes to the path given as the first command line
+// argument (or to stdout after the human readable output if there is none), so runs can be compared by tools.
+
+typedef struct BenchResult {
+  const char * name;
+  double       seconds; // best of all repetitions
+  size_t       bytes;   // bytes processed per repetition, 0 if not applicable
+  size_t       msgs;    // messages processed per repetition, 0 if not applicable
+  size_t       ops;     // operations per repetition, for ns/op
+  uint64_t     checksum;
+} BenchResult;
+
+typedef struct BenchReport {
+  const char * suite;
+  const char * json_path; // NULL for stdout
+  FILE *       json;
+  size_t       num_results;
+} BenchReport;
+
+double   bench_now_seconds(void);
+uint32_t bench_rand_u32(uint32_t * state);
+
+bool bench_report_open(BenchReport * report, const char * suite, int argc, char ** argv);
+void bench_report_add(BenchReport * report, BenchResult result);
+bool bench_report_close(BenchReport * report);
+
+#endif
@@ -0,0 +1,159 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "msg_queue.h"
+#include "parser.h"
+
+#define OK STAT_OK
+
+#define NUM_OPS     (1 << 22)
+#define REPETITIONS 10
+#define BATCH_SIZE  16
+#define CAPACITY    256
+
+static MIDI_Message make_msg(size_t i) {
+  return (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+                        .channel             = 1,
+                        .data.control_change = {.control = i & 0x7f, .value = (i >> 7) & 0x7f}};
+}
+
+// push then pop one message at a time through the parser's output buffer
+static BenchResult run_parser_buffer(void) {
+  BenchResult res = {.name = "parser_buffer/push_pop", .seconds = 1e9, .msgs = NUM_OPS, .ops = NUM_OPS};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Parser parser;
+    if(MIDI_parser_init(&parser, 1) != OK) exit(1);
+
+    uint64_t checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < NUM_OPS; i++) {
+      MIDI_INT_buff_push(&(parser.msg_buffer), make_msg(i));
+      checksum += MIDI_parser_pop_msg(&parser).data.control_change.value;
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+// fill with a batch, drain with MIDI_parser_pop_msgs
+static BenchResult run_parser_buffer_batch(void) {
+  BenchResult res = {.name = "parser_buffer/push_pop_msgs", .seconds = 1e9, .msgs = NUM_OPS, .ops = NUM_OPS};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Parser parser;
+    if(MIDI_parser_init(&parser, 1) != OK) exit(1);
+
+    MIDI_Message out[BATCH_SIZE];
+    uint64_t     checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < NUM_OPS; i += BATCH_SIZE) {
+      for(size_t j = 0; j < BATCH_SIZE; j++) MIDI_INT_buff_push(&(parser.msg_buffer), make_msg(i + j));
+
+      const size_t n = MIDI_parser_pop_msgs(&parser, out, BATCH_SIZE);
+      for(size_t j = 0; j < n; j++) checksum += out[j].data.control_change.value;
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+// single threaded, so this measures the cost of the queue operations themselves rather than of cache line transfers
+static BenchResult run_msg_queue(void) {
+  BenchResult res = {.name = "msg_queue/push_pop", .seconds = 1e9, .msgs = NUM_OPS, .ops = NUM_OPS};
+
+  static MIDI_Message storage[CAPACITY];
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_MsgQueue queue;
+    if(MIDI_msg_queue_init(&queue, storage, CAPACITY) != OK) exit(1);
+
+    uint64_t checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < NUM_OPS; i++) {
+      MIDI_Message msg;
+      MIDI_msg_queue_push(&queue, make_msg(i));
+      if(MIDI_msg_queue_pop(&queue, &msg)) checksum += msg.data.control_change.value;
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+static BenchResult run_msg_queue_batch(void) {
+  BenchResult res = {.name = "msg_queue/push_pop_n", .seconds = 1e9, .msgs = NUM_OPS, .ops = NUM_OPS};
+
+  static MIDI_Message storage[CAPACITY];
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_MsgQueue queue;
+    if(MIDI_msg_queue_init(&queue, storage, CAPACITY) != OK) exit(1);
+
+    MIDI_Message in[BATCH_SIZE];
+    MIDI_Message out[BATCH_SIZE];
+    uint64_t     checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < NUM_OPS; i += BATCH_SIZE) {
+      for(size_t j = 0; j < BATCH_SIZE; j++) in[j] = make_msg(i + j);
+      MIDI_msg_queue_push_n(&queue, in, BATCH_SIZE);
+
+      const size_t n = MIDI_msg_queue_pop_n(&queue, out, BATCH_SIZE);
+      for(size_t j = 0; j < n; j++) checksum += out[j].data.control_change.value;
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+int main(int argc, char ** argv) {
+  BenchReport report;
+  if(!bench_report_open(&report, "buffer", argc, argv)) return 1;
+
+  bench_report_add(&report, run_parser_buffer());
+  bench_report_add(&report, run_parser_buffer_batch());
+  bench_report_add(&report, run_msg_queue());
+  bench_report_add(&report, run_msg_queue_batch());
+
+  return bench_report_close(&report) ? 0 : 1;
+}
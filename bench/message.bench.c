@@ -0,0 +1,113 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "message.h"
+
+#define NUM_MSGS    (1 << 16)
+#define REPETITIONS 10
+#define BATCH_SIZE  64
+#define STR_SIZE    (128 * BATCH_SIZE)
+
+typedef int (*ToStrFn)(char * str, int max_len, MIDI_Message msg);
+typedef int (*BatchToStrFn)(char * str, int max_len, const MIDI_Message * msgs, size_t n);
+
+static void fill_msgs(MIDI_Message * msgs, size_t n) {
+  uint32_t seed = 12345;
+  for(size_t i = 0; i < n; i++) {
+    const uint32_t r = bench_rand_u32(&seed);
+    const uint8_t  a = r & 0x7f;
+    const uint8_t  b = (r >> 7) & 0x7f;
+
+    switch((r >> 14) % 4) {
+    case 0: msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {a, b}}; break;
+    case 1: msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {a, b}}; break;
+    case 2: msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {a, b}}; break;
+    default:
+      msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend = {(int16_t)((a << 7 | b) - 8192)}};
+      break;
+    }
+  }
+}
+
+static BenchResult run_single(const char * name, ToStrFn fn, const MIDI_Message * msgs, size_t n) {
+  BenchResult res = {.name = name, .seconds = 1e9, .msgs = n, .ops = n};
+  static char str[STR_SIZE];
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    uint64_t checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < n; i++) checksum += (uint64_t)fn(str, STR_SIZE, msgs[i]) + (uint8_t)str[0];
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+static BenchResult run_batch(const char * name, BatchToStrFn fn, const MIDI_Message * msgs, size_t n) {
+  BenchResult res = {.name = name, .seconds = 1e9, .msgs = n, .ops = n};
+  static char str[STR_SIZE];
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    uint64_t checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i + BATCH_SIZE <= n; i += BATCH_SIZE) {
+      checksum += (uint64_t)fn(str, STR_SIZE, &msgs[i], BATCH_SIZE) + (uint8_t)str[0];
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+int main(int argc, char ** argv) {
+  MIDI_Message * msgs = malloc(NUM_MSGS * sizeof(MIDI_Message));
+  if(msgs == NULL) return 1;
+
+  fill_msgs(msgs, NUM_MSGS);
+
+  BenchReport report;
+  if(!bench_report_open(&report, "message", argc, argv)) {
+    free(msgs);
+    return 1;
+  }
+
+  bench_report_add(&report, run_single("message_to_str_buffer", MIDI_message_to_str_buffer, msgs, NUM_MSGS));
+  bench_report_add(&report,
+                   run_single("message_to_str_buffer_short", MIDI_message_to_str_buffer_short, msgs, NUM_MSGS));
+  bench_report_add(&report, run_batch("messages_to_str_buffer", MIDI_messages_to_str_buffer, msgs, NUM_MSGS));
+  bench_report_add(&report,
+                   run_batch("messages_to_str_buffer_short", MIDI_messages_to_str_buffer_short, msgs, NUM_MSGS));
+
+  free(msgs);
+
+  return bench_report_close(&report) ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "parser.h"
+
+#define OK STAT_OK
+
+#define STREAM_SIZE (1 << 22)
+#define REPETITIONS 10
+#define CHANNEL     1
+#define DRAIN_SIZE  64
+
+#define STATUS_BIT (1 << 7) // 0b1000'0000
+
+typedef void (*FillFn)(uint8_t * bytes, size_t n, uint32_t * seed);
+
+typedef struct Stream {
+  const char * name;
+  FillFn       fill;
+  bool         omni; // parse with an omni parser rather than one on CHANNEL
+} Stream;
+
+static uint8_t status_byte(MIDI_MessageType type, uint8_t channel) {
+  return STATUS_BIT | (MIDI_type_to_byte(type) << 4) | (channel - 1);
+}
+static uint8_t rand_data(uint32_t * seed) { return bench_rand_u32(seed) & 0x7f; }
+
+// note ons with a status byte each, like a keyboard that doesn't use running status
+static void fill_dense_note_on(uint8_t * bytes, size_t n, uint32_t * seed) {
+  size_t i = 0;
+  for(; i + 3 <= n; i += 3) {
+    bytes[i]     = status_byte(MIDI_MSG_TYPE_NOTE_ON, CHANNEL);
+    bytes[i + 1] = rand_data(seed);
+    bytes[i + 2] = 1 + (rand_data(seed) % 127);
+  }
+  for(; i < n; i++) bytes[i] = 0xfe;
+}
+
+// a single status byte followed by nothing but CCs, like a fader sweep
+static void fill_cc_flood(uint8_t * bytes, size_t n, uint32_t * seed) {
+  bytes[0] = status_byte(MIDI_MSG_TYPE_CONTROL_CHANGE, CHANNEL);
+  size_t i = 1;
+  for(; i + 2 <= n; i += 2) {
+    bytes[i]     = MIDI_CTRL_VOLUME;
+    bytes[i + 1] = rand_data(seed);
+  }
+  for(; i < n; i++) bytes[i] = MIDI_CTRL_VOLUME;
+}
+
+// channel pressure from an MPE-style controller, a single status byte followed by one data byte per message
+static void fill_aftertouch_flood(uint8_t * bytes, size_t n, uint32_t * seed) {
+  bytes[0] = status_byte(MIDI_MSG_TYPE_AFTERTOUCH_MONO, CHANNEL);
+  for(size_t i = 1; i < n; i++) bytes[i] = rand_data(seed);
+}
+
+// pitch bend going up and down its whole range, with running status
+static void fill_pitch_bend_sweep(uint8_t * bytes, size_t n, uint32_t * seed) {
+  (void)seed;
+
+  bytes[0]  = status_byte(MIDI_MSG_TYPE_PITCH_BEND, CHANNEL);
+  int value = 0;
+  int step  = 37;
+  size_t i  = 1;
+  for(; i + 2 <= n; i += 2) {
+    bytes[i]     = value & 0x7f;
+    bytes[i + 1] = (value >> 7) & 0x7f;
+
+    if(value + step < 0 || value + step > 0x3fff) step = -step;
+    value += step;
+  }
+  for(; i < n; i++) bytes[i] = 0;
+}
+
+// notes and CCs spread evenly over all channels
+static void fill_multi_channel(uint8_t * bytes, size_t n, uint32_t * seed) {
+  size_t i = 0;
+  for(; i + 3 <= n; i += 3) {
+    const uint8_t channel = 1 + (bench_rand_u32(seed) % 16);
+    bytes[i] = status_byte((bench_rand_u32(seed) % 2) ? MIDI_MSG_TYPE_NOTE_ON : MIDI_MSG_TYPE_CONTROL_CHANGE, channel);
+    bytes[i + 1] = rand_data(seed);
+    bytes[i + 2] = 1 + (rand_data(seed) % 127);
+  }
+  for(; i < n; i++) bytes[i] = 0xfe;
+}
+
+// random bytes, mostly things the parser has to skip
+static void fill_garbage(uint8_t * bytes, size_t n, uint32_t * seed) {
+  for(size_t i = 0; i < n; i++) bytes[i] = bench_rand_u32(seed) & 0xff;
+}
+
+static const Stream streams[] = {
+    {"dense_note_on", fill_dense_note_on, false},
+    {"cc_flood_running_status", fill_cc_flood, false},
+    {"aftertouch_flood_running_status", fill_aftertouch_flood, false},
+    {"pitch_bend_sweep", fill_pitch_bend_sweep, false},
+    {"multi_channel", fill_multi_channel, false},
+    {"multi_channel_omni", fill_multi_channel, true},
+    {"garbage", fill_garbage, false},
+};
+
+static void init_parser(MIDI_Parser * parser, const Stream * stream) {
+  const STAT_Val st =
+      stream->omni ? MIDI_parser_init_omni(parser, MIDI_CHANNEL_MASK_ALL) : MIDI_parser_init(parser, CHANNEL);
+  if(st != OK) exit(1);
+}
+
+static uint64_t drain(MIDI_Parser * parser, size_t * num_msgs) {
+  MIDI_Message msgs[DRAIN_SIZE];
+  uint64_t     checksum = 0;
+
+  size_t n = 0;
+  while((n = MIDI_parser_pop_msgs(parser, msgs, DRAIN_SIZE)) > 0) {
+    for(size_t i = 0; i < n; i++) checksum += msgs[i].type + msgs[i].channel + (uint16_t)msgs[i].data.pitch_bend.value;
+    *num_msgs += n;
+  }
+
+  return checksum;
+}
+
+static BenchResult run_parse_byte(const char * name, const Stream * stream, const uint8_t * bytes, size_t n) {
+  BenchResult res = {.name = name, .seconds = 1e9, .bytes = n, .ops = n};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Parser parser;
+    init_parser(&parser, stream);
+
+    size_t   num_msgs = 0;
+    uint64_t checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < n; i++) {
+      if(MIDI_parse_byte(&parser, bytes[i]) != OK) exit(1);
+      if(!MIDI_parser_is_ready(&parser)) checksum += drain(&parser, &num_msgs);
+    }
+    checksum += drain(&parser, &num_msgs);
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.msgs     = num_msgs;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+static BenchResult run_parse_bytes(const char * name, const Stream * stream, const uint8_t * bytes, size_t n) {
+  BenchResult res = {.name = name, .seconds = 1e9, .bytes = n, .ops = n};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Parser parser;
+    init_parser(&parser, stream);
+
+    size_t   num_msgs = 0;
+    uint64_t checksum = 0;
+
+    const double start  = bench_now_seconds();
+    size_t       offset = 0;
+    while(offset < n) {
+      size_t consumed = 0;
+      if(MIDI_parse_bytes(&parser, &bytes[offset], n - offset, &consumed) != OK) exit(1);
+      offset += consumed;
+      checksum += drain(&parser, &num_msgs);
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.msgs     = num_msgs;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+static uint64_t drain_timed(MIDI_Parser * parser, size_t * num_msgs, MIDI_Timestamp * last) {
+  MIDI_TimedMessage msgs[DRAIN_SIZE];
+  uint64_t          checksum = 0;
+
+  size_t n = 0;
+  while((n = MIDI_parser_pop_timed_msgs(parser, msgs, DRAIN_SIZE)) > 0) {
+    for(size_t i = 0; i < n; i++) {
+      checksum += msgs[i].msg.type + msgs[i].msg.channel + (uint16_t)msgs[i].msg.data.pitch_bend.value;
+    }
+    *last = msgs[n - 1].timestamp;
+    *num_msgs += n;
+  }
+
+  return checksum;
+}
+
+// the whole stream as one chunk, one time unit per byte
+static BenchResult run_parse_chunk_timed(const char * name, const Stream * stream, const uint8_t * bytes, size_t n) {
+  BenchResult res = {.name = name, .seconds = 1e9, .bytes = n, .ops = n};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Parser    parser;
+    MIDI_Timestamp timestamps[MIDI_OUT_BUFFER_SIZE];
+    init_parser(&parser, stream);
+    if(MIDI_parser_set_timestamp_buffer(&parser, timestamps, MIDI_OUT_BUFFER_SIZE) != OK) exit(1);
+
+    size_t         num_msgs = 0;
+    uint64_t       checksum = 0;
+    MIDI_Timestamp last     = 0;
+
+    const double start  = bench_now_seconds();
+    size_t       offset = 0;
+    while(offset < n) {
+      size_t consumed = 0;
+      if(MIDI_parse_chunk_timed(&parser, &bytes[offset], n - offset, offset, n - 1, &consumed) != OK) exit(1);
+      offset += consumed;
+      checksum += drain_timed(&parser, &num_msgs, &last);
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.msgs     = num_msgs;
+    res.checksum = checksum;
+    if(last >= n) exit(1);
+  }
+
+  return res;
+}
+
+int main(int argc, char ** argv) {
+  uint8_t * bytes = malloc(STREAM_SIZE);
+  if(bytes == NULL) return 1;
+
+  BenchReport report;
+  if(!bench_report_open(&report, "parser", argc, argv)) {
+    free(bytes);
+    return 1;
+  }
+
+  for(size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); i++) {
+    uint32_t seed = 12345;
+    streams[i].fill(bytes, STREAM_SIZE, &seed);
+
+    char name_byte[64];
+    char name_bytes[64];
+    char name_timed[64];
+    snprintf(name_byte, sizeof(name_byte), "parse_byte/%s", streams[i].name);
+    snprintf(name_bytes, sizeof(name_bytes), "parse_bytes/%s", streams[i].name);
+    snprintf(name_timed, sizeof(name_timed), "parse_chunk_timed/%s", streams[i].name);
+
+    const BenchResult byte_res  = run_parse_byte(name_byte, &streams[i], bytes, STREAM_SIZE);
+    const BenchResult bytes_res = run_parse_bytes(name_bytes, &streams[i], bytes, STREAM_SIZE);
+    const BenchResult timed_res = run_parse_chunk_timed(name_timed, &streams[i], bytes, STREAM_SIZE);
+
+    bench_report_add(&report, byte_res);
+    bench_report_add(&report, bytes_res);
+    bench_report_add(&report, timed_res);
+
+    if(byte_res.checksum != bytes_res.checksum || byte_res.checksum != timed_res.checksum) {
+      printf("parse_byte, parse_bytes and parse_chunk_timed disagree on %s!\n", streams[i].name);
+      bench_report_close(&report);
+      free(bytes);
+      return 1;
+    }
+  }
+
+  free(bytes);
+
+  return bench_report_close(&report) ? 0 : 1;
+}
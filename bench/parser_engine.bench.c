@@ -0,0 +1,141 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "parser.h"
+
+#define OK STAT_OK
+
+#define STREAM_SIZE (1 << 22)
+#define REPETITIONS 10
+#define CHANNEL     1
+
+#define STATUS_BIT (1 << 7) // 0b1000'0000
+
+typedef STAT_Val (*ParseBytesFn)(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed);
+
+static uint32_t lcg_state = 12345;
+static uint32_t rand_u32(void) { return bench_rand_u32(&lcg_state); }
+static uint8_t rand_data(void) { return rand_u32() & 0x7f; }
+
+static uint8_t status_byte(MIDI_MessageType type, uint8_t channel) {
+  return STATUS_BIT | (MIDI_type_to_byte(type) << 4) | (channel - 1);
+}
+
+// a mix of the traffic we typically see: mostly notes and CCs on our channel, some of it using running status, with
+// other channels and unsupported bytes mixed in
+static void fill_stream(uint8_t * bytes, size_t n) {
+  size_t i = 0;
+  while(i + 8 < n) {
+    const uint32_t kind    = rand_u32() % 100;
+    const uint8_t  channel = ((rand_u32() % 8) == 0) ? (1 + (rand_u32() % 16)) : CHANNEL;
+
+    if(kind < 35) {
+      bytes[i++] = status_byte(MIDI_MSG_TYPE_NOTE_ON, channel);
+      bytes[i++] = rand_data();
+      bytes[i++] = rand_data();
+    } else if(kind < 55) {
+      bytes[i++] = status_byte(MIDI_MSG_TYPE_NOTE_OFF, channel);
+      bytes[i++] = rand_data();
+      bytes[i++] = rand_data();
+    } else if(kind < 80) {
+      bytes[i++] = status_byte(MIDI_MSG_TYPE_CONTROL_CHANGE, channel);
+      bytes[i++] = rand_data();
+      bytes[i++] = rand_data();
+      bytes[i++] = rand_data(); // running status
+      bytes[i++] = rand_data();
+    } else if(kind < 92) {
+      bytes[i++] = status_byte(MIDI_MSG_TYPE_PITCH_BEND, channel);
+      bytes[i++] = rand_data();
+      bytes[i++] = rand_data();
+    } else {
+      bytes[i++] = status_byte(MIDI_MSG_TYPE_PROGRAM_CHANGE, channel);
+      bytes[i++] = rand_data();
+      bytes[i++] = 0xf8; // clock
+    }
+  }
+  while(i < n) bytes[i++] = 0xfe; // active sensing
+}
+
+static BenchResult run(const char * name, ParseBytesFn parse_bytes, const uint8_t * bytes, size_t n) {
+  BenchResult res = {.name = name, .seconds = 1e9, .bytes = n, .ops = n};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Parser parser;
+    if(MIDI_parser_init(&parser, CHANNEL) != OK) exit(1);
+
+    size_t   num_msgs = 0;
+    uint64_t checksum = 0;
+
+    const double start  = bench_now_seconds();
+    size_t       offset = 0;
+    while(offset < n) {
+      size_t consumed = 0;
+      if(parse_bytes(&parser, &bytes[offset], n - offset, &consumed) != OK) exit(1);
+      offset += consumed;
+
+      while(MIDI_parser_has_output(&parser)) {
+        const MIDI_Message msg = MIDI_parser_pop_msg(&parser);
+        checksum += msg.type + (uint16_t)msg.data.pitch_bend.value;
+        num_msgs++;
+      }
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.msgs     = num_msgs;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+int main(int argc, char ** argv) {
+  uint8_t * bytes = malloc(STREAM_SIZE);
+  if(bytes == NULL) return 1;
+
+  fill_stream(bytes, STREAM_SIZE);
+
+  BenchReport report;
+  if(!bench_report_open(&report, "parser_engine", argc, argv)) {
+    free(bytes);
+    return 1;
+  }
+
+  const BenchResult switch_res = run("switch", MIDI_INT_parse_bytes_switch, bytes, STREAM_SIZE);
+  const BenchResult table_res  = run("table", MIDI_INT_parse_bytes_table, bytes, STREAM_SIZE);
+
+  bench_report_add(&report, switch_res);
+  bench_report_add(&report, table_res);
+
+  free(bytes);
+
+  const bool closed = bench_report_close(&report);
+
+  if(switch_res.msgs != table_res.msgs || switch_res.checksum != table_res.checksum) {
+    printf("engines disagree on output!\n");
+    return 1;
+  }
+
+  return closed ? 0 : 1;
+}
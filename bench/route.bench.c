@@ -0,0 +1,147 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "route.h"
+
+#define OK STAT_OK
+
+#define NUM_MSGS    (1 << 20)
+#define BATCH_SIZE  256
+#define REPETITIONS 10
+#define MAX_RULES   500
+
+static MIDI_Router    router;
+static MIDI_RouteRule rules[MAX_RULES];
+static uint8_t        curves[MAX_RULES][MIDI_ROUTE_NUM_KEYS];
+static MIDI_Message   out[BATCH_SIZE * MIDI_ROUTE_MAX_OUTPUTS];
+
+// notes, controllers and pitch bend spread over all channels
+static void fill_msgs(MIDI_Message * msgs, size_t n, uint32_t * seed) {
+  static const uint8_t types[] = {MIDI_MSG_TYPE_NOTE_ON,
+                                  MIDI_MSG_TYPE_NOTE_OFF,
+                                  MIDI_MSG_TYPE_CONTROL_CHANGE,
+                                  MIDI_MSG_TYPE_PITCH_BEND};
+
+  for(size_t i = 0; i < n; i++) {
+    const uint32_t r = bench_rand_u32(seed);
+    msgs[i]          = (MIDI_Message){
+        .type                = types[r % sizeof(types)],
+        .channel             = 1 + ((r >> 2) % 16),
+        .data.control_change = {.control = (r >> 8) & 0x7f, .value = 1 + (r >> 16) % 127},
+    };
+  }
+}
+
+// rules that each pick out a small part of the messages, so a message goes through a handful of them
+static void fill_rules(size_t n, uint32_t * seed) {
+  for(size_t i = 0; i < n; i++) {
+    const uint32_t r   = bench_rand_u32(seed);
+    const uint8_t  key = (r >> 8) & 0x7f;
+
+    rules[i]              = MIDI_ROUTE_RULE_ALL;
+    rules[i].types        = (r & 1) ? MIDI_ROUTE_NOTE_TYPES : MIDI_ROUTE_TYPE(MIDI_MSG_TYPE_CONTROL_CHANGE);
+    rules[i].channel_mask = (uint16_t)(1u << ((r >> 1) % 16));
+    rules[i].key_min      = key;
+    rules[i].key_max      = (key < 112) ? key + 16 : 127;
+    rules[i].action       = ((r >> 5) % 16 == 0) ? MIDI_ROUTE_DROP : MIDI_ROUTE_MODIFY;
+    rules[i].channel      = (r >> 15) % 17;
+    rules[i].transpose    = (int8_t)((int)((r >> 20) % 5) - 2);
+
+    // a few of them with one of a handful of curves
+    if((r >> 24) % 8 == 0) {
+      MIDI_route_linear_values(curves[i], (uint16_t)(96 + (r >> 28) % 4 * 16), 0, 1, 127);
+      rules[i].values = curves[i];
+    }
+  }
+}
+
+static BenchResult run_apply(const char * name, const MIDI_Message * msgs, size_t num_rules) {
+  BenchResult res = {.name = name, .seconds = 1e9, .msgs = NUM_MSGS, .ops = NUM_MSGS};
+
+  uint32_t seed = 777;
+  fill_rules(num_rules, &seed);
+  if(MIDI_route_compile(&router, rules, num_rules) != OK) exit(1);
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    uint64_t checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < NUM_MSGS; i += BATCH_SIZE) {
+      size_t       consumed = 0;
+      const size_t max      = sizeof(out) / sizeof(out[0]);
+      const size_t n        = MIDI_route_apply(&router, &(msgs[i]), BATCH_SIZE, out, max, &consumed);
+      if(consumed != BATCH_SIZE) exit(1);
+      for(size_t j = 0; j < n; j++) checksum += out[j].channel + (uint16_t)out[j].data.pitch_bend.value;
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+static BenchResult run_compile(size_t num_rules) {
+  BenchResult res = {.name = "route/compile_500_rules", .seconds = 1e9, .ops = 1};
+
+  uint32_t seed = 777;
+  fill_rules(num_rules, &seed);
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    const double start = bench_now_seconds();
+    if(MIDI_route_compile(&router, rules, num_rules) != OK) exit(1);
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = router.num_extra + router.num_tables;
+  }
+
+  return res;
+}
+
+int main(int argc, char ** argv) {
+  MIDI_Message * msgs = malloc(NUM_MSGS * sizeof(MIDI_Message));
+  if(msgs == NULL) return 1;
+
+  uint32_t seed = 12345;
+  fill_msgs(msgs, NUM_MSGS, &seed);
+
+  BenchReport report;
+  if(!bench_report_open(&report, "route", argc, argv)) {
+    free(msgs);
+    return 1;
+  }
+
+  // the time per message should be the same for all of these
+  bench_report_add(&report, run_apply("route/apply_0_rules", msgs, 0));
+  bench_report_add(&report, run_apply("route/apply_10_rules", msgs, 10));
+  bench_report_add(&report, run_apply("route/apply_100_rules", msgs, 100));
+  bench_report_add(&report, run_apply("route/apply_500_rules", msgs, MAX_RULES));
+  bench_report_add(&report, run_compile(MAX_RULES));
+
+  free(msgs);
+
+  return bench_report_close(&report) ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <unistd.h>
+
+#include "bench_utils.h"
+#include "smf.h"
+#include "smf_timeline.h"
+#include "smf_writer.h"
+
+#define OK STAT_OK
+
+#define NUM_TRACKS       32
+#define EVENTS_PER_TRACK (1 << 16)
+#define MAX_EVENT_SIZE   (MIDI_SMF_VLQ_MAX_SIZE + 3)
+#define REPETITIONS      10
+#define WRITE_EVENTS     (1 << 20)
+#define WRITE_BUFFER     (1 << 16)
+
+static uint8_t * put_u32(uint8_t * p, uint32_t v) {
+  p[0] = (v >> 24) & 0xff;
+  p[1] = (v >> 16) & 0xff;
+  p[2] = (v >> 8) & 0xff;
+  p[3] = v & 0xff;
+  return p + 4;
+}
+
+static uint8_t * put_vlq(uint8_t * p, uint32_t v) {
+  uint8_t bytes[MIDI_SMF_VLQ_MAX_SIZE];
+  size_t  n = 0;
+  do {
+    bytes[n++] = v & 0x7f;
+    v >>= 7;
+  } while(v > 0);
+  while(n > 1) *(p++) = bytes[--n] | 0x80;
+  *(p++) = bytes[0];
+  return p;
+}
+
+// a format 1 file, each track playing notes on its own channel with running status and the odd controller in between
+static size_t fill_file(uint8_t * data, uint32_t * seed) {
+  uint8_t * p = data;
+
+  // clang-format off
+  const uint8_t header[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, NUM_TRACKS, 0x01, 0xe0};
+  // clang-format on
+  for(size_t i = 0; i < sizeof(header); i++) *(p++) = header[i];
+
+  for(int t = 0; t < NUM_TRACKS; t++) {
+    p                   = put_u32(p, 0x4d54726b); // "MTrk"
+    uint8_t * len_field = p;
+    uint8_t * track     = p + 4;
+    p                   = track;
+
+    uint8_t running_status = 0;
+    for(size_t i = 0; i < EVENTS_PER_TRACK; i++) {
+      const uint32_t r = bench_rand_u32(seed);
+      p                = put_vlq(p, (r >> 16) & 0x3ff);
+
+      const uint8_t status = ((r & 0xf) == 0) ? (0xb0 | t) : (0x90 | t);
+      if(status != running_status) *(p++) = status;
+      running_status = status;
+      *(p++)         = (r >> 4) & 0x7f;
+      *(p++)         = (r >> 11) & 0x1f;
+    }
+    *(p++) = 0x00;
+    *(p++) = MIDI_SMF_META;
+    *(p++) = MIDI_SMF_META_END_OF_TRACK;
+    *(p++) = 0x00;
+
+    put_u32(len_field, (uint32_t)(p - track));
+  }
+
+  return (size_t)(p - data);
+}
+
+// opening only looks at the header, so this should not depend on the size of the file
+static BenchResult run_open(const uint8_t * data, size_t size) {
+  BenchResult res = {.name = "smf/open_get_tracks", .seconds = 1e9, .ops = 1};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Smf      smf;
+    MIDI_SmfTrack tracks[NUM_TRACKS];
+    size_t        num_tracks = 0;
+
+    const double start = bench_now_seconds();
+    if(MIDI_smf_open_buffer(&smf, data, size) != OK) exit(1);
+    if(MIDI_smf_get_tracks(&smf, tracks, NUM_TRACKS, &num_tracks) != OK) exit(1);
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = num_tracks;
+  }
+
+  return res;
+}
+
+static BenchResult run_iterate(const uint8_t * data, size_t size) {
+  BenchResult res = {.name    = "smf/iterate_tracks",
+                     .seconds = 1e9,
+                     .bytes   = size,
+                     .msgs    = (size_t)NUM_TRACKS * EVENTS_PER_TRACK,
+                     .ops     = (size_t)NUM_TRACKS * EVENTS_PER_TRACK};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Smf      smf;
+    MIDI_SmfTrack tracks[NUM_TRACKS];
+    size_t        num_tracks = 0;
+    uint64_t      checksum   = 0;
+
+    const double start = bench_now_seconds();
+    if(MIDI_smf_open_buffer(&smf, data, size) != OK) exit(1);
+    if(MIDI_smf_get_tracks(&smf, tracks, NUM_TRACKS, &num_tracks) != OK) exit(1);
+
+    for(size_t t = 0; t < num_tracks; t++) {
+      MIDI_SmfTrackIter iter;
+      MIDI_SmfEvent     event;
+      if(MIDI_smf_track_iter_init(&iter, tracks[t]) != OK) exit(1);
+
+      STAT_Val st;
+      while((st = MIDI_smf_track_iter_next(&iter, &event)) == OK) checksum += event.tick + event.msg.data.note_on.note;
+      if(st != STAT_OK_FINISHED) exit(1);
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+static MIDI_SmfEvent       track_events[NUM_TRACKS][EVENTS_PER_TRACK];
+static MIDI_SmfTrackEvents decoded[NUM_TRACKS];
+
+static BenchResult run_decode_tracks(const char * name, const uint8_t * data, size_t size, size_t num_threads) {
+  BenchResult res = {.name    = name,
+                     .seconds = 1e9,
+                     .bytes   = size,
+                     .msgs    = (size_t)NUM_TRACKS * EVENTS_PER_TRACK,
+                     .ops     = (size_t)NUM_TRACKS * EVENTS_PER_TRACK};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_Smf      smf;
+    MIDI_SmfTrack tracks[NUM_TRACKS];
+    size_t        num_tracks = 0;
+    if(MIDI_smf_open_buffer(&smf, data, size) != OK) exit(1);
+    if(MIDI_smf_get_tracks(&smf, tracks, NUM_TRACKS, &num_tracks) != OK) exit(1);
+    for(size_t t = 0; t < num_tracks; t++) {
+      decoded[t] = (MIDI_SmfTrackEvents){.events = track_events[t], .capacity = EVENTS_PER_TRACK};
+    }
+
+    const double start = bench_now_seconds();
+    if(MIDI_smf_decode_tracks(tracks, decoded, num_tracks, num_threads) != OK) exit(1);
+    const double duration = bench_now_seconds() - start;
+
+    uint64_t checksum = 0;
+    for(size_t t = 0; t < num_tracks; t++) checksum += decoded[t].events[decoded[t].num_events - 1].tick;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+// merges what the last run_decode_tracks() left behind
+static BenchResult run_merge(void) {
+  BenchResult res = {.name    = "smf/merge_tracks",
+                     .seconds = 1e9,
+                     .msgs    = (size_t)NUM_TRACKS * EVENTS_PER_TRACK,
+                     .ops     = (size_t)NUM_TRACKS * EVENTS_PER_TRACK};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_SmfMergeCursor heap[NUM_TRACKS];
+    MIDI_SmfMerge       merge;
+    MIDI_SmfEvent       event;
+    size_t              track    = 0;
+    uint64_t            checksum = 0;
+
+    const double start = bench_now_seconds();
+    if(MIDI_smf_merge_init(&merge, decoded, NUM_TRACKS, heap) != OK) exit(1);
+    while(MIDI_smf_merge_next(&merge, &event, &track) == OK) checksum += event.tick ^ track;
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+// records the merged timeline to a file, which mostly measures encoding as the buffer keeps system calls rare
+static BenchResult run_write(void) {
+  BenchResult res = {.name = "smf/write", .seconds = 1e9, .msgs = WRITE_EVENTS, .ops = WRITE_EVENTS};
+
+  static uint8_t       buffer[WRITE_BUFFER];
+  static MIDI_SmfEvent events[WRITE_EVENTS];
+
+  MIDI_SmfMergeCursor heap[NUM_TRACKS];
+  MIDI_SmfMerge       merge;
+  if(MIDI_smf_merge_init(&merge, decoded, NUM_TRACKS, heap) != OK) exit(1);
+  for(size_t i = 0; i < WRITE_EVENTS; i++) {
+    if(MIDI_smf_merge_next(&merge, &events[i], NULL) != OK) exit(1);
+  }
+
+  char path[] = "/tmp/c_midi_smf_bench_XXXXXX";
+  int  fd     = mkstemp(path);
+  if(fd < 0) exit(1);
+  close(fd);
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    MIDI_SmfWriter writer;
+    size_t         consumed = 0;
+
+    const double start = bench_now_seconds();
+    if(MIDI_smf_writer_open(&writer, path, 480, buffer, WRITE_BUFFER) != OK) exit(1);
+    if(MIDI_smf_writer_write_events(&writer, events, WRITE_EVENTS, &consumed) != OK) exit(1);
+    if(MIDI_smf_writer_close(&writer) != OK) exit(1);
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.bytes    = (size_t)writer.track_len;
+    res.checksum = writer.track_len + writer.num_writes;
+  }
+
+  unlink(path);
+
+  return res;
+}
+
+int main(int argc, char ** argv) {
+  uint8_t * data = malloc(14 + (size_t)NUM_TRACKS * (12 + (size_t)EVENTS_PER_TRACK * MAX_EVENT_SIZE));
+  if(data == NULL) return 1;
+
+  uint32_t     seed = 12345;
+  const size_t size = fill_file(data, &seed);
+
+  BenchReport report;
+  if(!bench_report_open(&report, "smf", argc, argv)) {
+    free(data);
+    return 1;
+  }
+
+  bench_report_add(&report, run_open(data, size));
+  bench_report_add(&report, run_iterate(data, size));
+
+  const BenchResult single = run_decode_tracks("smf/decode_tracks_1_thread", data, size, 1);
+  bench_report_add(&report, single);
+
+  // compare against single threaded to see how decoding scales with the number of cores
+  const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if(num_cpus > 1) {
+    char name_all[64];
+    snprintf(name_all, sizeof(name_all), "smf/decode_tracks_%ld_threads", num_cpus);
+
+    const BenchResult all = run_decode_tracks(name_all, data, size, (size_t)num_cpus);
+    bench_report_add(&report, all);
+
+    if(single.checksum != all.checksum) {
+      printf("single and multi-threaded decoding disagree!\n");
+      bench_report_close(&report);
+      free(data);
+      return 1;
+    }
+  }
+
+  bench_report_add(&report, run_merge());
+  bench_report_add(&report, run_write());
+
+  free(data);
+
+  return bench_report_close(&report) ? 0 : 1;
+}
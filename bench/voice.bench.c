@@ -0,0 +1,105 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_utils.h"
+#include "voice.h"
+
+#define OK STAT_OK
+
+#define NUM_MSGS    (1 << 20)
+#define NUM_VOICES  16
+#define REPETITIONS 10
+
+static MIDI_VoiceAllocator allocator;
+
+// a player holding down about twice as many notes as there are voices, with the pedal going up and down
+static void fill_msgs(MIDI_Message * msgs, size_t n, uint32_t * seed) {
+  bool down[128] = {0};
+
+  for(size_t i = 0; i < n; i++) {
+    const uint32_t r    = bench_rand_u32(seed);
+    const uint8_t  note = (uint8_t)(36 + (r >> 8) % (2 * NUM_VOICES));
+
+    if((r >> 20) % 64 == 0) {
+      const uint8_t pedal = (r & 1) ? 127 : 0;
+      msgs[i]             = (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+                                           .channel             = 1,
+                                           .data.control_change = {MIDI_CTRL_DAMPER_PEDAL_ON_OFF, pedal}};
+    } else if(down[note]) {
+      msgs[i]    = (MIDI_Message){.type = MIDI_MSG_TYPE_NOTE_OFF, .channel = 1, .data.note_off = {.note = note}};
+      down[note] = false;
+    } else {
+      msgs[i]    = (MIDI_Message){.type         = MIDI_MSG_TYPE_NOTE_ON,
+                                  .channel      = 1,
+                                  .data.note_on = {.note = note, .velocity = 1 + (r >> 12) % 127}};
+      down[note] = true;
+    }
+  }
+}
+
+static BenchResult run_process(const char * name, const MIDI_Message * msgs, MIDI_StealPolicy policy) {
+  BenchResult res = {.name = name, .seconds = 1e9, .msgs = NUM_MSGS, .ops = NUM_MSGS};
+
+  for(int rep = 0; rep < REPETITIONS; rep++) {
+    if(MIDI_voice_init(&allocator, 1, NUM_VOICES, policy) != OK) exit(1);
+
+    MIDI_VoiceEvent events[NUM_VOICES + 1];
+    uint64_t        checksum = 0;
+
+    const double start = bench_now_seconds();
+    for(size_t i = 0; i < NUM_MSGS; i++) {
+      size_t n = 0;
+      if(MIDI_voice_process(&allocator, msgs[i], events, NUM_VOICES + 1, &n) != OK) exit(1);
+      for(size_t j = 0; j < n; j++) checksum += events[j].type + events[j].voice;
+    }
+    const double duration = bench_now_seconds() - start;
+
+    if(duration < res.seconds) res.seconds = duration;
+    res.checksum = checksum;
+  }
+
+  return res;
+}
+
+int main(int argc, char ** argv) {
+  MIDI_Message * msgs = malloc(NUM_MSGS * sizeof(MIDI_Message));
+  if(msgs == NULL) return 1;
+
+  uint32_t seed = 12345;
+  fill_msgs(msgs, NUM_MSGS, &seed);
+
+  BenchReport report;
+  if(!bench_report_open(&report, "voice", argc, argv)) {
+    free(msgs);
+    return 1;
+  }
+
+  bench_report_add(&report, run_process("voice/steal_oldest", msgs, MIDI_STEAL_OLDEST));
+  bench_report_add(&report, run_process("voice/steal_quietest", msgs, MIDI_STEAL_QUIETEST));
+  bench_report_add(&report, run_process("voice/steal_lowest", msgs, MIDI_STEAL_LOWEST));
+  bench_report_add(&report, run_process("voice/steal_highest", msgs, MIDI_STEAL_HIGHEST));
+
+  free(msgs);
+
+  return bench_report_close(&report) ? 0 : 1;
+}
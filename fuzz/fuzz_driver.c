@@ -0,0 +1,196 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Stand-in for libFuzzer's main, so fuzz targets build and run with any compiler. It runs every file given (or every
+// file in a directory given) through the target once, and then random input for as long as asked, which makes it a
+// smoke test for ctest and a quick local check. Flags take the same form as libFuzzer's:
+//   -runs=N           run N random inputs, default 0 when files are given and 10000 otherwise
+//   -max_total_time=S stop the random inputs after S seconds
+//   -max_len=N        longest random input, default 4096
+//   -seed=N           seed for the random inputs, default 1
+// The target aborts on a failed check, AFL can use this driver as is with "-- ./parser_fuzz @@".
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+typedef struct Options {
+  long     runs; // -1 if not given
+  double   max_total_time;
+  size_t   max_len;
+  uint32_t seed;
+} Options;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+static uint32_t rand_u32(uint32_t * state) {
+  *state = (*state * 1664525u) + 1013904223u;
+  return *state >> 8;
+}
+
+static bool parse_flag(const char * arg, const char * name, long * value) {
+  const size_t len = strlen(name);
+  if(strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+
+  *value = strtol(&(arg[len + 1]), NULL, 10);
+  return true;
+}
+
+static bool parse_option(const char * arg, Options * options) {
+  long value = 0;
+  if(parse_flag(arg, "-runs", &value)) {
+    options->runs = value;
+  } else if(parse_flag(arg, "-max_total_time", &value)) {
+    options->max_total_time = (double)value;
+  } else if(parse_flag(arg, "-max_len", &value)) {
+    options->max_len = (size_t)value;
+  } else if(parse_flag(arg, "-seed", &value)) {
+    options->seed = (uint32_t)value;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool run_file(const char * path) {
+  FILE * file = fopen(path, "rb");
+  if(file == NULL) {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+
+  uint8_t * data = NULL;
+  size_t    size = 0;
+  uint8_t   chunk[4096];
+  size_t    len = 0;
+  while((len = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    uint8_t * grown = realloc(data, size + len);
+    if(grown == NULL) {
+      fprintf(stderr, "out of memory reading %s\n", path);
+      free(data);
+      fclose(file);
+      return false;
+    }
+    data = grown;
+    memcpy(&(data[size]), chunk, len);
+    size += len;
+  }
+  fclose(file);
+
+  LLVMFuzzerTestOneInput(data, size);
+  free(data);
+
+  return true;
+}
+
+static bool run_path(const char * path, size_t * num_files) {
+  struct stat info;
+  if(stat(path, &info) != 0) {
+    fprintf(stderr, "can't find %s\n", path);
+    return false;
+  }
+
+  if(!S_ISDIR(info.st_mode)) {
+    (*num_files)++;
+    return run_file(path);
+  }
+
+  DIR * dir = opendir(path);
+  if(dir == NULL) {
+    fprintf(stderr, "can't open directory %s\n", path);
+    return false;
+  }
+
+  bool            ok    = true;
+  struct dirent * entry = NULL;
+  while(ok && (entry = readdir(dir)) != NULL) {
+    if(entry->d_name[0] == '.') continue;
+
+    char entry_path[4096];
+    snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name);
+    ok = run_path(entry_path, num_files);
+  }
+  closedir(dir);
+
+  return ok;
+}
+
+// mostly data bytes and status bytes on a few channels, uniformly random bytes hardly ever complete a message
+static size_t make_random_input(uint8_t * data, size_t max_len, uint32_t * state) {
+  const size_t len = (size_t)(rand_u32(state) % (max_len + 1));
+
+  for(size_t i = 0; i < len; i++) {
+    const uint32_t r    = rand_u32(state);
+    uint8_t        byte = (uint8_t)r;
+    if((r & 0x300) != 0) byte &= 0x7f;
+    else if((r & 0x400) != 0) byte = (uint8_t)((byte & 0xf0) | ((r >> 12) & 0x3));
+    data[i] = byte;
+  }
+
+  return len;
+}
+
+int main(int argc, char ** argv) {
+  Options options   = {.runs = -1, .max_total_time = 0.0, .max_len = 4096, .seed = 1};
+  size_t  num_files = 0;
+
+  for(int i = 1; i < argc; i++) {
+    if(argv[i][0] == '-') {
+      if(!parse_option(argv[i], &options)) fprintf(stderr, "ignoring unknown option %s\n", argv[i]);
+    } else if(!run_path(argv[i], &num_files)) {
+      return 1;
+    }
+  }
+
+  // like libFuzzer, a time limit alone means run until it's up
+  long runs = options.runs;
+  if(runs < 0) runs = (num_files > 0) ? 0 : ((options.max_total_time > 0.0) ? -1 : 10000);
+
+  uint8_t * data = malloc(options.max_len + 1);
+  if(data == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  const double start = now_seconds();
+  uint32_t     state = options.seed;
+  long         done  = 0;
+  for(; runs < 0 || done < runs; done++) {
+    if(options.max_total_time > 0.0 && (now_seconds() - start) >= options.max_total_time) break;
+
+    LLVMFuzzerTestOneInput(data, make_random_input(data, options.max_len, &state));
+  }
+  free(data);
+
+  printf("ran %zu files and %ld random inputs in %.2f s\n", num_files, done, now_seconds() - start);
+
+  return 0;
+}
@@ -0,0 +1,381 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Differential fuzz target for the parser. Every input goes through each way into the parser (byte by byte, in bulk
+// chunks, timed, and both engines directly) and all of them have to give exactly what a deliberately simple reference
+// decoder gives. What comes out is then encoded and parsed again, which has to give the same messages back.
+//
+// The first byte of the input picks the parser configuration, the rest is the byte stream:
+//   bits 0-3  channel the parser listens to
+//   bit  4    omni, listening to that channel and the one 5 up from it
+//   bits 5-7  chunk size for MIDI_parse_bytes, 1 << bits
+//
+// Builds for libFuzzer with MIDI_FUZZ, or with fuzz_driver.c everywhere else, see CMakeLists.txt.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "encoder.h"
+#include "parser.h"
+
+#define OK STAT_OK
+
+#define FUZZ_CHECK(cond)                                                                                               \
+  do {                                                                                                                 \
+    if(!(cond)) {                                                                                                      \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                         \
+      abort();                                                                                                         \
+    }                                                                                                                  \
+  } while(0)
+
+typedef struct Config {
+  MIDI_Channel channel;
+  bool         omni;
+  uint16_t     channel_mask;
+  size_t       chunk_size;
+} Config;
+
+typedef struct SysExRecord {
+  MIDI_SysExEvent event; // START, END or ABORT, chunks are only added up
+  size_t          len;
+} SysExRecord;
+
+typedef struct Output {
+  MIDI_Message * msgs;
+  size_t         num_msgs;
+  SysExRecord *  sysex;
+  size_t         num_sysex;
+  size_t         capacity;    // of both msgs and sysex
+  size_t         chunk_total; // payload handed over in chunks for the dump in progress
+} Output;
+
+typedef STAT_Val (*ParseBytesFn)(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed);
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+static Config config_from_byte(uint8_t byte) {
+  const MIDI_Channel channel = (MIDI_Channel)((byte & 0xf) + 1);
+  const bool         omni    = (byte & 0x10) != 0;
+  const uint16_t     other   = omni ? MIDI_channel_to_mask((MIDI_Channel)(((channel + 4) % 16) + 1)) : 0;
+
+  return (Config){
+      .channel      = channel,
+      .omni         = omni,
+      .channel_mask = (uint16_t)(MIDI_channel_to_mask(channel) | other),
+      .chunk_size   = (size_t)1 << (byte >> 5),
+  };
+}
+
+static void output_init(Output * out, size_t n) {
+  // every message takes at least a byte, and so does every SysEx event except for the END or ABORT after a START
+  *out = (Output){.capacity = (2 * n) + 1};
+
+  out->msgs  = malloc(out->capacity * sizeof(MIDI_Message));
+  out->sysex = malloc(out->capacity * sizeof(SysExRecord));
+  FUZZ_CHECK(out->msgs != NULL && out->sysex != NULL);
+}
+
+static void output_free(Output * out) {
+  free(out->msgs);
+  free(out->sysex);
+  *out = (Output){0};
+}
+
+static void push_msg(Output * out, MIDI_Message msg) {
+  FUZZ_CHECK(out->num_msgs < out->capacity);
+  out->msgs[out->num_msgs++] = msg;
+}
+
+static void push_sysex(Output * out, MIDI_SysExEvent event, size_t len) {
+  FUZZ_CHECK(out->num_sysex < out->capacity);
+  out->sysex[out->num_sysex++] = (SysExRecord){.event = event, .len = len};
+}
+
+static void record_sysex(void * context, MIDI_SysExEvent event, const uint8_t * data, size_t len) {
+  Output * out = (Output *)context;
+
+  switch(event) {
+  case MIDI_SYSEX_START:
+    out->chunk_total = 0;
+    push_sysex(out, event, len);
+    break;
+  case MIDI_SYSEX_CHUNK:
+    FUZZ_CHECK(data != NULL && len > 0);
+    out->chunk_total += len;
+    break;
+  case MIDI_SYSEX_END:
+  case MIDI_SYSEX_ABORT:
+    FUZZ_CHECK(len == out->chunk_total);
+    push_sysex(out, event, len);
+    break;
+  }
+}
+
+// --- reference decoder ---
+
+// Written straight from the spec, one byte at a time with nothing but a running status and the data bytes so far.
+
+static size_t ref_data_length(uint8_t status) { return ((status & 0xf0) == 0xc0 || (status & 0xf0) == 0xd0) ? 1 : 2; }
+
+static MIDI_Message ref_make_msg(uint8_t status, const uint8_t * data) {
+  const MIDI_Channel channel = (MIDI_Channel)((status & 0xf) + 1);
+
+  switch(status & 0xf0) {
+  case 0x80:
+    return (MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
+                          .channel       = channel,
+                          .data.note_off = {.note = data[0], .velocity = data[1]}};
+  case 0x90:
+    if(data[1] == 0) {
+      return (MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
+                            .channel       = channel,
+                            .data.note_off = {.note = data[0], .velocity = MIDI_NOTE_OFF_DEFAULT_VELOCITY}};
+    }
+    return (MIDI_Message){
+        .type = MIDI_MSG_TYPE_NOTE_ON, .channel = channel, .data.note_on = {.note = data[0], .velocity = data[1]}};
+  case 0xa0:
+    return (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+                          .channel              = channel,
+                          .data.aftertouch_poly = {.note = data[0], .value = data[1]}};
+  case 0xb0:
+    return (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+                          .channel             = channel,
+                          .data.control_change = {.control = data[0], .value = data[1]}};
+  case 0xc0:
+    return (MIDI_Message){
+        .type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = channel, .data.program_change = {.program = data[0]}};
+  case 0xd0:
+    return (MIDI_Message){
+        .type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = channel, .data.aftertouch_mono = {.value = data[0]}};
+  default:
+    return (MIDI_Message){.type            = MIDI_MSG_TYPE_PITCH_BEND,
+                          .channel         = channel,
+                          .data.pitch_bend = {.value = (int16_t)(((data[1] << 7) | data[0]) - 0x2000)}};
+  }
+}
+
+static void ref_decode(const Config * cfg, const uint8_t * bytes, size_t n, Output * out) {
+  uint8_t running   = 0; // status of the channel message we're in, 0 if none
+  uint8_t data[2]   = {0};
+  size_t  num_data  = 0;
+  bool    in_sysex  = false;
+  size_t  sysex_len = 0;
+
+  for(size_t i = 0; i < n; i++) {
+    const uint8_t byte = bytes[i];
+
+    if(byte >= 0xf8) {
+      if(MIDI_is_real_time(byte)) push_msg(out, (MIDI_Message){.type = MIDI_MSG_TYPE_MISC, .data.misc = {byte}});
+      continue;
+    }
+
+    if(in_sysex) {
+      if(byte < 0x80) {
+        sysex_len++;
+        continue;
+      }
+      in_sysex = false;
+      if(byte == 0xf7) {
+        push_sysex(out, MIDI_SYSEX_END, sysex_len);
+        continue;
+      }
+      push_sysex(out, MIDI_SYSEX_ABORT, sysex_len);
+    }
+
+    if(byte < 0x80) {
+      if(running == 0) continue;
+      data[num_data++] = byte;
+      if(num_data == ref_data_length(running)) {
+        push_msg(out, ref_make_msg(running, data));
+        num_data = 0;
+      }
+      continue;
+    }
+
+    // any status byte ends the message we're in, only channel messages for us start a new one
+    running  = 0;
+    num_data = 0;
+    if(byte == 0xf0) {
+      in_sysex  = true;
+      sysex_len = 0;
+      push_sysex(out, MIDI_SYSEX_START, 0);
+    } else if(byte < 0xf0 && ((cfg->channel_mask >> (byte & 0xf)) & 1) != 0) {
+      running = byte;
+    }
+  }
+}
+
+// --- parser under test ---
+
+static void init_parser(MIDI_Parser * parser, const Config * cfg, Output * out) {
+  if(cfg->omni) {
+    FUZZ_CHECK(MIDI_parser_init_omni(parser, cfg->channel_mask) == OK);
+  } else {
+    FUZZ_CHECK(MIDI_parser_init(parser, cfg->channel) == OK);
+  }
+  FUZZ_CHECK(MIDI_parser_set_sysex_callback(parser, record_sysex, out) == OK);
+}
+
+static void drain(MIDI_Parser * parser, Output * out) {
+  out->num_msgs += MIDI_parser_pop_msgs(parser, &(out->msgs[out->num_msgs]), out->capacity - out->num_msgs);
+  FUZZ_CHECK(!MIDI_parser_has_output(parser));
+}
+
+static void parse_byte_by_byte(MIDI_Parser * parser, const uint8_t * bytes, size_t n, Output * out) {
+  for(size_t i = 0; i < n; i++) {
+    FUZZ_CHECK(MIDI_parse_byte(parser, bytes[i]) == OK);
+    drain(parser, out);
+  }
+}
+
+// the buffer rejects messages when full, so this also covers stopping early and resuming
+static void parse_in_chunks(
+    MIDI_Parser * parser, ParseBytesFn parse_fn, const uint8_t * bytes, size_t n, size_t chunk_size, Output * out) {
+  size_t i = 0;
+  while(i < n) {
+    const size_t len      = (n - i < chunk_size) ? n - i : chunk_size;
+    size_t       consumed = 0;
+    FUZZ_CHECK(parse_fn(parser, &(bytes[i]), len, &consumed) == OK);
+    FUZZ_CHECK(consumed <= len);
+    i += consumed;
+    drain(parser, out);
+  }
+}
+
+static STAT_Val parse_chunk_timed(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed) {
+  return MIDI_parse_chunk_timed(parser, bytes, n, 0, n, consumed);
+}
+
+static bool msg_equals(MIDI_Message a, MIDI_Message b) {
+  // pitch bend is the widest of the data, it covers the bytes of all others
+  return a.type == b.type && a.channel == b.channel && a.data.pitch_bend.value == b.data.pitch_bend.value;
+}
+
+static void check_msgs(const MIDI_Message * expected, size_t num_expected, const MIDI_Message * actual, size_t num) {
+  FUZZ_CHECK(num_expected == num);
+  for(size_t i = 0; i < num; i++) FUZZ_CHECK(msg_equals(expected[i], actual[i]));
+}
+
+static void check_output(const Output * expected, const Output * actual) {
+  check_msgs(expected->msgs, expected->num_msgs, actual->msgs, actual->num_msgs);
+
+  FUZZ_CHECK(expected->num_sysex == actual->num_sysex);
+  for(size_t i = 0; i < actual->num_sysex; i++) {
+    FUZZ_CHECK(expected->sysex[i].event == actual->sysex[i].event);
+    FUZZ_CHECK(expected->sysex[i].len == actual->sysex[i].len);
+  }
+}
+
+#ifdef MIDI_PARSER_STATS
+static void check_stats(MIDI_Parser * parser, size_t n, MIDI_ParserStats * first) {
+  MIDI_ParserStats stats;
+  FUZZ_CHECK(MIDI_parser_get_stats(parser, &stats, false) == OK);
+  FUZZ_CHECK(stats.bytes == n);
+
+  // all engines see the same bytes, so they have to skip and retry the same, the buffer side depends on draining
+  if(first->bytes == 0) *first = stats;
+  FUZZ_CHECK(stats.skipped_bytes == first->skipped_bytes);
+  FUZZ_CHECK(stats.retries == first->retries);
+  FUZZ_CHECK(stats.other_channel_resets == first->other_channel_resets);
+}
+#endif
+
+// encodes msgs and parses them back with a parser that takes every channel, which has to give msgs again
+static void check_round_trip(const MIDI_Message * msgs, size_t n, MIDI_Channel channel, bool use_running_status) {
+  uint8_t *      encoded = malloc((n * MIDI_ENCODER_MAX_MSG_SIZE) + 1);
+  MIDI_Message * decoded = malloc((n + 1) * sizeof(MIDI_Message));
+  FUZZ_CHECK(encoded != NULL && decoded != NULL);
+
+  MIDI_Encoder encoder;
+  size_t       consumed = 0;
+  size_t       written  = 0;
+  FUZZ_CHECK(MIDI_encoder_init(&encoder, channel, use_running_status) == OK);
+  FUZZ_CHECK(MIDI_encode_msgs(&encoder, msgs, n, encoded, n * MIDI_ENCODER_MAX_MSG_SIZE, &consumed, &written) == OK);
+  FUZZ_CHECK(consumed == n);
+
+  MIDI_Parser parser;
+  size_t      num_decoded = 0;
+  size_t      i           = 0;
+  FUZZ_CHECK(MIDI_parser_init_omni(&parser, MIDI_CHANNEL_MASK_ALL) == OK);
+  while(i < written) {
+    FUZZ_CHECK(MIDI_parse_bytes(&parser, &(encoded[i]), written - i, &consumed) == OK);
+    i += consumed;
+    num_decoded += MIDI_parser_pop_msgs(&parser, &(decoded[num_decoded]), n + 1 - num_decoded);
+  }
+
+  check_msgs(msgs, n, decoded, num_decoded);
+
+  free(encoded);
+  free(decoded);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+  if(size == 0) return 0;
+
+  const Config    cfg   = config_from_byte(data[0]);
+  const uint8_t * bytes = &(data[1]);
+  const size_t    n     = size - 1;
+
+  Output expected;
+  output_init(&expected, n);
+  ref_decode(&cfg, bytes, n, &expected);
+
+  const struct {
+    ParseBytesFn parse_fn; // NULL for MIDI_parse_byte
+    size_t       chunk_size;
+  } variants[] = {
+      {NULL, 1},
+      {MIDI_parse_bytes, cfg.chunk_size},
+      {MIDI_INT_parse_bytes_switch, n},
+      {MIDI_INT_parse_bytes_table, n},
+      {parse_chunk_timed, cfg.chunk_size},
+  };
+
+#ifdef MIDI_PARSER_STATS
+  MIDI_ParserStats first_stats = {0};
+#endif
+
+  for(size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+    MIDI_Parser parser;
+    Output      actual;
+    output_init(&actual, n);
+    init_parser(&parser, &cfg, &actual);
+
+    if(variants[v].parse_fn == NULL) {
+      parse_byte_by_byte(&parser, bytes, n, &actual);
+    } else {
+      parse_in_chunks(&parser, variants[v].parse_fn, bytes, n, variants[v].chunk_size, &actual);
+    }
+
+    check_output(&expected, &actual);
+#ifdef MIDI_PARSER_STATS
+    check_stats(&parser, n, &first_stats);
+#endif
+    output_free(&actual);
+  }
+
+  check_round_trip(expected.msgs, expected.num_msgs, cfg.channel, false);
+  check_round_trip(expected.msgs, expected.num_msgs, cfg.channel, true);
+
+  output_free(&expected);
+  return 0;
+}
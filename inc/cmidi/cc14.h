@@ -0,0 +1,96 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_CC14_H
+#define C_MIDI_CC14_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "control.h"
+#include "message.h"
+
+#include <cfac/stat.h>
+
+#define MIDI_CC14_NUM_CONTROLS 32 // controllers 0-31 are MSBs, their LSB is 32 higher
+#define MIDI_CC14_LSB_OFFSET   32
+#define MIDI_CC14_NUM_SLOTS    (16 * MIDI_CC14_NUM_CONTROLS)
+
+// the controllers that have an LSB defined in control.h, pass as controls to MIDI_cc14_init. Data entry is left out,
+// it belongs to the parameter selected with RPN/NRPN: with both, the pairer goes first and passes data entry on to
+// MIDI_rpn_process. Paired here, the decoder would never see it.
+#define MIDI_CC14_DEFINED_CONTROLS                                                                                     \
+  ((1u << MIDI_CTRL_BANK_SELECT) | (1u << MIDI_CTRL_MOD_WHEEL) | (1u << MIDI_CTRL_BREATH_CONTROL) |                    \
+   (1u << MIDI_CTRL_FOOT_PEDAL) | (1u << MIDI_CTRL_PORTAMENTO) | (1u << MIDI_CTRL_VOLUME) |                            \
+   (1u << MIDI_CTRL_BALANCE) | (1u << MIDI_CTRL_PAN) | (1u << MIDI_CTRL_EXPRESSION) |                                  \
+   (1u << MIDI_CTRL_EFFECT1) | (1u << MIDI_CTRL_EFFECT2) | (1u << MIDI_CTRL_GENERAL_A) |                               \
+   (1u << MIDI_CTRL_GENERAL_B) | (1u << MIDI_CTRL_GENERAL_C) | (1u << MIDI_CTRL_GENERAL_D))
+
+typedef enum MIDI_Cc14Result {
+  MIDI_CC14_PASS, // not a paired controller, use the message as it is
+  MIDI_CC14_HELD, // an MSB, held until its LSB comes in
+  MIDI_CC14_EMIT, // out holds a 14-bit value
+} MIDI_Cc14Result;
+
+typedef enum MIDI_Cc14Mode {
+  MIDI_CC14_WAIT_FOR_LSB = 0, // hold an MSB until its LSB arrives, or the timeout passes
+  MIDI_CC14_MSB_IMMEDIATE,    // emit an MSB right away (with LSB 0, as the spec resets it), the LSB refines it later
+} MIDI_Cc14Mode;
+
+typedef struct MIDI_ControlChange14 {
+  uint8_t  channel; // MIDI_Channel
+  uint8_t  control; // MIDI_Control of the MSB, 0-31
+  uint16_t value;   // (MSB << 7) | LSB
+} MIDI_ControlChange14;
+
+// Pairs MSB and LSB control changes into one 14-bit value, to be put after a parser. State is kept per channel and
+// controller in flat tables indexed by (channel - 1) * 32 + controller.
+typedef struct MIDI_Cc14Pairer {
+  uint32_t       controls; // bit n set pairs controller n with controller n + 32
+  uint8_t        mode;     // MIDI_Cc14Mode
+  MIDI_Timestamp timeout;  // how long an MSB is held, 0 holds it until the LSB arrives
+
+  uint32_t       held[16]; // per channel, bit n set while the MSB of controller n waits for its LSB
+  uint8_t        msb[MIDI_CC14_NUM_SLOTS];
+  MIDI_Timestamp held_since[MIDI_CC14_NUM_SLOTS];
+} MIDI_Cc14Pairer;
+
+STAT_Val MIDI_cc14_init(MIDI_Cc14Pairer * restrict pairer,
+                        uint32_t                   controls,
+                        MIDI_Cc14Mode              mode,
+                        MIDI_Timestamp             timeout);
+
+// Feeds a message arriving at now. Another MSB for a controller that's still held is emitted without waiting for
+// its LSB, so EMIT can mean the previous value while the new MSB is held. An LSB without an MSB before it goes with
+// the last MSB of that controller, or 0 if there wasn't one.
+MIDI_Cc14Result MIDI_cc14_process(MIDI_Cc14Pairer * restrict      pairer,
+                                  MIDI_Message                    msg,
+                                  MIDI_Timestamp                  now,
+                                  MIDI_ControlChange14 * restrict out);
+
+// Emits every MSB that has been held for timeout or longer as it is, with LSB 0. Writes up to max into out and returns
+// how many, call again while it returns max. Only this enforces the timeout: an LSB that comes in before the next poll
+// is still paired with its MSB, however long that was held, so call it at least as often as the timeout.
+size_t MIDI_cc14_poll(MIDI_Cc14Pairer * restrict pairer, MIDI_Timestamp now, MIDI_ControlChange14 * out, size_t max);
+
+// Emits all held MSBs, e.g. at the end of a stream.
+size_t MIDI_cc14_flush(MIDI_Cc14Pairer * restrict pairer, MIDI_ControlChange14 * out, size_t max);
+
+#endif
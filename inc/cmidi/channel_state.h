@@ -0,0 +1,148 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_CHANNEL_STATE_H
+#define C_MIDI_CHANNEL_STATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "control.h"
+#include "message.h"
+#include "note.h"
+
+#include <cfac/stat.h>
+
+#define MIDI_NUM_NOTES    128
+#define MIDI_NUM_CONTROLS 128
+
+// One bit per note, bit n of bits[n / 64] for note n.
+typedef struct MIDI_NoteSet {
+  uint64_t bits[2];
+} MIDI_NoteSet;
+
+static inline bool   MIDI_note_set_contains(const MIDI_NoteSet * restrict set, uint8_t note);
+static inline bool   MIDI_note_set_is_empty(const MIDI_NoteSet * restrict set);
+static inline size_t MIDI_note_set_count(const MIDI_NoteSet * restrict set);
+// Lowest and highest note in a set that isn't empty.
+static inline uint8_t MIDI_note_set_lowest(const MIDI_NoteSet * restrict set);
+static inline uint8_t MIDI_note_set_highest(const MIDI_NoteSet * restrict set);
+// Removes and returns the lowest note in a set that isn't empty. Pop from a copy to go over the notes in a set:
+//   MIDI_NoteSet held = state.held;
+//   while(!MIDI_note_set_is_empty(&held)) { const uint8_t note = MIDI_note_set_pop_lowest(&held); ... }
+static inline uint8_t MIDI_note_set_pop_lowest(MIDI_NoteSet * restrict set);
+// Writes the notes in the set to notes (room for MIDI_NUM_NOTES) from low to high, returns how many.
+static inline size_t MIDI_note_set_to_array(const MIDI_NoteSet * restrict set, uint8_t * restrict notes);
+
+// What's going on on one channel, as far as the messages fed to it tell. Everything is a plain array or bitmap, so
+// queries are a lookup and a snapshot is a struct copy.
+typedef struct MIDI_ChannelState {
+  MIDI_Channel channel;    // messages on other channels are ignored, 0 takes messages from any channel
+  uint8_t      pressure;   // channel aftertouch
+  int16_t      pitch_bend; // 0 is center
+  MIDI_NoteSet held;       // keys that are down
+
+  uint8_t velocity[MIDI_NUM_NOTES];      // note on velocity of held notes, 0 for the others
+  uint8_t poly_pressure[MIDI_NUM_NOTES]; // poly aftertouch of held notes
+  uint8_t control[MIDI_NUM_CONTROLS];    // last value of every controller, channel mode messages (120-127) aren't kept
+} MIDI_ChannelState;
+
+// Which parts differ between two states.
+typedef struct MIDI_ChannelStateDiff {
+  MIDI_NoteSet pressed;     // held in the new state only
+  MIDI_NoteSet released;    // held in the old state only
+  uint64_t     controls[2]; // bit n of controls[n / 64] set if controller n changed
+  bool         pitch_bend;  // pitch bend changed
+  bool         pressure;    // channel aftertouch changed
+} MIDI_ChannelStateDiff;
+
+// Starts out with no notes held and the controllers as they are after RESET_ALL_CONTROLLERS, all others at 0.
+STAT_Val MIDI_channel_state_init(MIDI_ChannelState * restrict state, MIDI_Channel channel);
+
+// Returns false for messages that don't go to this channel or don't change state (e.g. program change).
+// ALL_NOTES_OFF, ALL_SOUND_OFF and the mode changes that imply all notes off release every note. RESET_ALL_CONTROLLERS
+// resets what RP-015 says it does: modulation, expression (to 127), the pedals (64-67), the RPN/NRPN numbers (to 127,
+// null), pitch bend and both aftertouches. Volume, pan, bank select, sound and effect controllers are left alone.
+bool MIDI_channel_state_process(MIDI_ChannelState * restrict state, MIDI_Message msg);
+
+// Returns whether anything in the diff is set.
+bool MIDI_channel_state_diff(const MIDI_ChannelState * restrict old_state,
+                             const MIDI_ChannelState * restrict new_state,
+                             MIDI_ChannelStateDiff * restrict   diff);
+
+static inline void MIDI_channel_state_snapshot(const MIDI_ChannelState * restrict state,
+                                               MIDI_ChannelState * restrict       snapshot) {
+  *snapshot = *state;
+}
+
+static inline bool MIDI_channel_state_is_held(const MIDI_ChannelState * restrict state, uint8_t note) {
+  return MIDI_note_set_contains(&(state->held), note);
+}
+static inline size_t MIDI_channel_state_num_held(const MIDI_ChannelState * restrict state) {
+  return MIDI_note_set_count(&(state->held));
+}
+static inline uint8_t MIDI_channel_state_velocity(const MIDI_ChannelState * restrict state, uint8_t note) {
+  return state->velocity[note & 0x7f];
+}
+static inline uint8_t MIDI_channel_state_control(const MIDI_ChannelState * restrict state, uint8_t control) {
+  return state->control[control & 0x7f];
+}
+
+static inline bool MIDI_note_set_contains(const MIDI_NoteSet * restrict set, uint8_t note) {
+  note &= 0x7f;
+  return (set->bits[note >> 6] >> (note & 63)) & 1;
+}
+
+static inline bool MIDI_note_set_is_empty(const MIDI_NoteSet * restrict set) {
+  return (set->bits[0] | set->bits[1]) == 0;
+}
+
+static inline size_t MIDI_note_set_count(const MIDI_NoteSet * restrict set) {
+  return (size_t)(__builtin_popcountll(set->bits[0]) + __builtin_popcountll(set->bits[1]));
+}
+
+static inline uint8_t MIDI_note_set_lowest(const MIDI_NoteSet * restrict set) {
+  const size_t word = (set->bits[0] == 0) ? 1 : 0;
+  return (uint8_t)((word << 6) | (size_t)__builtin_ctzll(set->bits[word]));
+}
+
+static inline uint8_t MIDI_note_set_highest(const MIDI_NoteSet * restrict set) {
+  const size_t word = (set->bits[1] != 0) ? 1 : 0;
+  return (uint8_t)((word << 6) | (size_t)(63 - __builtin_clzll(set->bits[word])));
+}
+
+static inline uint8_t MIDI_note_set_pop_lowest(MIDI_NoteSet * restrict set) {
+  const size_t word = (set->bits[0] == 0) ? 1 : 0;
+  const int    bit  = __builtin_ctzll(set->bits[word]);
+  set->bits[word] &= set->bits[word] - 1;
+  return (uint8_t)((word << 6) | (size_t)bit);
+}
+
+static inline size_t MIDI_note_set_to_array(const MIDI_NoteSet * restrict set, uint8_t * restrict notes) {
+  size_t n = 0;
+  for(size_t word = 0; word < 2; word++) {
+    for(uint64_t bits = set->bits[word]; bits != 0; bits &= bits - 1) {
+      notes[n++] = (uint8_t)((word << 6) | (size_t)__builtin_ctzll(bits));
+    }
+  }
+  return n;
+}
+
+#endif
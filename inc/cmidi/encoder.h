@@ -0,0 +1,69 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_ENCODER_H
+#define C_MIDI_ENCODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "message.h"
+
+#include <cfac/stat.h>
+
+#define MIDI_ENCODER_MAX_MSG_SIZE 3 // largest number of bytes a single message encodes to
+
+typedef struct MIDI_Encoder {
+  MIDI_Channel channel;            // channel for messages that have no channel set (MIDI_Message.channel == 0)
+  bool         use_running_status; // leave out status bytes that repeat the previous one
+  uint8_t      running_status;     // last status byte written, 0 if none
+} MIDI_Encoder;
+
+STAT_Val MIDI_encoder_init(MIDI_Encoder * restrict encoder, MIDI_Channel channel, bool use_running_status);
+
+// Forgets the running status, so the next message is written with its status byte. Call this whenever something else
+// (e.g. a system exclusive message) was written to the same stream.
+STAT_Val MIDI_encoder_reset(MIDI_Encoder * restrict encoder);
+
+// Messages that can't be encoded, as they would not parse back to themselves: a note on with velocity 0 (send a note
+// off), data bytes over 0x7f, a pitch bend outside -8192-8191, a channel outside 1-16 (after the encoder's channel is
+// filled in) and MISC messages other than real-time ones (SysEx is written by the caller, see MIDI_encoder_reset).
+
+// Encodes a single message into out, the number of bytes written goes into written. Fails with STAT_ERR_RANGE if the
+// message doesn't fit in max_len bytes and with STAT_ERR_ARGS if it can't be encoded, nothing is written in both cases.
+STAT_Val MIDI_encode_msg(MIDI_Encoder * restrict encoder,
+                         MIDI_Message            msg,
+                         uint8_t *               out,
+                         size_t                  max_len,
+                         size_t *                written);
+
+// Encodes up to n messages into out, stopping early at the first message that doesn't fit in max_len. The number of
+// messages encoded goes into consumed and the number of bytes written into written, so the caller can flush out and
+// resume from msgs[*consumed]. Fails with STAT_ERR_ARGS at a message that can't be encoded, consumed and written then
+// cover the messages before it, which were written.
+STAT_Val MIDI_encode_msgs(MIDI_Encoder * restrict encoder,
+                          const MIDI_Message *    msgs,
+                          size_t                  n,
+                          uint8_t *               out,
+                          size_t                  max_len,
+                          size_t *                consumed,
+                          size_t *                written);
+
+#endif
@@ -0,0 +1,63 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_HELD_MSB_H
+#define C_MIDI_HELD_MSB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "message.h"
+
+// Internal to the cc14 pairer and the RPN decoder, which both hold an MSB until its LSB arrives or a timeout passes.
+// Each keeps a mask with a bit per value that can be held, and the arrival of each held MSB in held_since, indexed by
+// bit number.
+
+// Whether an MSB that came in at since has been held for timeout at now. A clock that went back doesn't let it go.
+static inline bool MIDI_INT_held_msb_is_due(MIDI_Timestamp since, MIDI_Timestamp now, MIDI_Timestamp timeout) {
+  return now >= since && now - since >= timeout;
+}
+
+// Lets go of up to max held MSBs, lowest bit first: clears them in held and writes their bit numbers to taken. With
+// check_time only those that are due at now, otherwise all of them. Returns how many.
+static inline size_t MIDI_INT_held_msb_take(uint32_t * restrict    held,
+                                            const MIDI_Timestamp * held_since,
+                                            bool                   check_time,
+                                            MIDI_Timestamp         now,
+                                            MIDI_Timestamp         timeout,
+                                            uint8_t * restrict     taken,
+                                            size_t                 max) {
+  size_t   n    = 0;
+  uint32_t left = *held;
+
+  while(left != 0 && n < max) {
+    const uint8_t bit = (uint8_t)__builtin_ctz(left);
+    left &= left - 1;
+
+    if(check_time && !MIDI_INT_held_msb_is_due(held_since[bit], now, timeout)) continue;
+
+    taken[n++] = bit;
+    *held &= ~(1u << bit);
+  }
+
+  return n;
+}
+
+#endif
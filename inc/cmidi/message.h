@@ -20,6 +20,8 @@
 #ifndef C_MIDI_MESSAGE_H
 #define C_MIDI_MESSAGE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "control.h"
@@ -38,6 +40,11 @@ typedef enum MIDI_MessageType {
 
 static inline uint8_t MIDI_type_to_byte(MIDI_MessageType type) { return (uint8_t)type; }
 
+typedef uint8_t MIDI_Channel; // 1-16
+
+// velocity of the note off that a note on with velocity 0 stands for
+#define MIDI_NOTE_OFF_DEFAULT_VELOCITY 63
+
 typedef struct MIDI_NoteOff {
   uint8_t note; // MIDI_Note
   uint8_t velocity;
@@ -48,25 +55,157 @@ typedef struct MIDI_NoteOn {
   uint8_t velocity;
 } MIDI_NoteOn;
 
+typedef struct MIDI_AftertouchPoly {
+  uint8_t note; // MIDI_Note
+  uint8_t value;
+} MIDI_AftertouchPoly;
+
 typedef struct MIDI_ControlChange {
   uint8_t control; // MIDI_ControlType
   uint8_t value;
 } MIDI_ControlChange;
 
+typedef struct MIDI_ProgramChange {
+  uint8_t program;
+} MIDI_ProgramChange;
+
+typedef struct MIDI_AftertouchMono {
+  uint8_t value;
+} MIDI_AftertouchMono;
+
 typedef struct MIDI_PitchBend {
   int16_t value;
 } MIDI_PitchBend;
 
+// System real-time messages are a single status byte, they may show up anywhere in the stream (even in the middle of
+// another message) and don't belong to a channel. 0xf9 and 0xfd are undefined.
+typedef enum MIDI_RealTime {
+  MIDI_RT_CLOCK          = 0xf8,
+  MIDI_RT_START          = 0xfa,
+  MIDI_RT_CONTINUE       = 0xfb,
+  MIDI_RT_STOP           = 0xfc,
+  MIDI_RT_ACTIVE_SENSING = 0xfe,
+  MIDI_RT_RESET          = 0xff,
+} MIDI_RealTime;
+
+static inline bool MIDI_is_real_time(uint8_t byte) { return (byte >= 0xf8) && (byte != 0xf9) && (byte != 0xfd); }
+
+static inline const char * MIDI_real_time_to_str(MIDI_RealTime rt) {
+  switch(rt) {
+  case MIDI_RT_CLOCK: return "CLOCK";
+  case MIDI_RT_START: return "START";
+  case MIDI_RT_CONTINUE: return "CONTINUE";
+  case MIDI_RT_STOP: return "STOP";
+  case MIDI_RT_ACTIVE_SENSING: return "ACTIVE_SENSING";
+  case MIDI_RT_RESET: return "RESET";
+  }
+  return "OTHER";
+}
+
+typedef struct MIDI_Misc {
+  uint8_t status; // system status byte, MIDI_RealTime for real-time messages
+} MIDI_Misc;
+
 typedef struct MIDI_Message {
-  uint8_t type; // MIDI_MessageType
+  uint8_t type;    // MIDI_MessageType
+  uint8_t channel; // MIDI_Channel the message came in on, 0 if unknown or not channel specific
   union {
-    MIDI_NoteOff       note_off;
-    MIDI_NoteOn        note_on;
-    MIDI_ControlChange control_change;
-    MIDI_PitchBend     pitch_bend;
+    MIDI_NoteOff        note_off;
+    MIDI_NoteOn         note_on;
+    MIDI_AftertouchPoly aftertouch_poly;
+    MIDI_ControlChange  control_change;
+    MIDI_ProgramChange  program_change;
+    MIDI_AftertouchMono aftertouch_mono;
+    MIDI_PitchBend      pitch_bend;
+    MIDI_Misc           misc;
   } data;
 } MIDI_Message;
 
+// Arrival time of a message, in whatever unit the caller feeds the parser (nanoseconds, samples, ...).
+typedef uint64_t MIDI_Timestamp;
+
+typedef struct MIDI_TimedMessage {
+  MIDI_Timestamp timestamp; // arrival of the message's last byte
+  MIDI_Message   msg;
+} MIDI_TimedMessage;
+
+// Packed form of a message, laid out like a MIDI 2.0 UMP MIDI 1.0 channel voice word:
+//   [31:28] UMP message type (MIDI_PACKED_MT_CHANNEL_VOICE)
+//   [27:24] group (always 0)
+//   [23:16] status byte, type in the high nibble and channel - 1 in the low nibble
+//   [15:8]  first data byte
+//   [7:0]   second data byte (0 for messages with a single data byte)
+// System messages (MIDI_MSG_TYPE_MISC) are UMP system words (MIDI_PACKED_MT_SYSTEM), with the status byte in [23:16].
+// Conversion from MIDI_Message is lossless for channels 1-16, which is every message that comes out of a parser.
+typedef uint32_t MIDI_PackedMessage;
+
+#define MIDI_PACKED_MT_UTILITY       0x0
+#define MIDI_PACKED_MT_SYSTEM        0x1
+#define MIDI_PACKED_MT_CHANNEL_VOICE 0x2
+
+static inline MIDI_PackedMessage MIDI_packed_make(uint8_t status, uint8_t data1, uint8_t data2) {
+  return ((uint32_t)MIDI_PACKED_MT_CHANNEL_VOICE << 28) | ((uint32_t)status << 16) | ((uint32_t)data1 << 8) | data2;
+}
+
+static inline uint8_t MIDI_packed_mt(MIDI_PackedMessage p) { return (uint8_t)(p >> 28); }
+static inline uint8_t MIDI_packed_status(MIDI_PackedMessage p) { return (uint8_t)(p >> 16); }
+static inline uint8_t MIDI_packed_data1(MIDI_PackedMessage p) { return (uint8_t)(p >> 8) & 0x7f; }
+static inline uint8_t MIDI_packed_data2(MIDI_PackedMessage p) { return (uint8_t)p & 0x7f; }
+static inline MIDI_MessageType MIDI_packed_type(MIDI_PackedMessage p) {
+  return (MIDI_MessageType)((MIDI_packed_status(p) >> 4) & 0x7);
+}
+static inline MIDI_Channel MIDI_packed_channel(MIDI_PackedMessage p) { return (MIDI_packed_status(p) & 0xf) + 1; }
+
+static inline MIDI_PackedMessage MIDI_message_to_packed(MIDI_Message msg) {
+  const uint8_t status = (uint8_t)(0x80 | (msg.type << 4) | ((msg.channel - 1) & 0xf));
+
+  switch((MIDI_MessageType)msg.type) {
+  case MIDI_MSG_TYPE_NOTE_OFF: return MIDI_packed_make(status, msg.data.note_off.note, msg.data.note_off.velocity);
+  case MIDI_MSG_TYPE_NOTE_ON: return MIDI_packed_make(status, msg.data.note_on.note, msg.data.note_on.velocity);
+  case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+    return MIDI_packed_make(status, msg.data.aftertouch_poly.note, msg.data.aftertouch_poly.value);
+  case MIDI_MSG_TYPE_CONTROL_CHANGE:
+    return MIDI_packed_make(status, msg.data.control_change.control, msg.data.control_change.value);
+  case MIDI_MSG_TYPE_PROGRAM_CHANGE: return MIDI_packed_make(status, msg.data.program_change.program, 0);
+  case MIDI_MSG_TYPE_AFTERTOUCH_MONO: return MIDI_packed_make(status, msg.data.aftertouch_mono.value, 0);
+  case MIDI_MSG_TYPE_PITCH_BEND: {
+    const uint16_t value = (uint16_t)(msg.data.pitch_bend.value + 0x2000); // 14 bit, center at 0x2000
+    return MIDI_packed_make(status, value & 0x7f, (value >> 7) & 0x7f);
+  }
+  case MIDI_MSG_TYPE_MISC: return ((uint32_t)MIDI_PACKED_MT_SYSTEM << 28) | ((uint32_t)msg.data.misc.status << 16);
+  }
+
+  return 0; // a UMP utility NOOP
+}
+
+static inline MIDI_Message MIDI_packed_to_message(MIDI_PackedMessage p) {
+  if(MIDI_packed_mt(p) == MIDI_PACKED_MT_SYSTEM) {
+    return (MIDI_Message){.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = MIDI_packed_status(p)}};
+  }
+  if(MIDI_packed_mt(p) != MIDI_PACKED_MT_CHANNEL_VOICE) return (MIDI_Message){.type = MIDI_MSG_TYPE_MISC};
+
+  MIDI_Message msg = {.type = MIDI_packed_type(p), .channel = MIDI_packed_channel(p)};
+
+  switch((MIDI_MessageType)msg.type) {
+  case MIDI_MSG_TYPE_NOTE_OFF: msg.data.note_off = (MIDI_NoteOff){MIDI_packed_data1(p), MIDI_packed_data2(p)}; break;
+  case MIDI_MSG_TYPE_NOTE_ON: msg.data.note_on = (MIDI_NoteOn){MIDI_packed_data1(p), MIDI_packed_data2(p)}; break;
+  case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+    msg.data.aftertouch_poly = (MIDI_AftertouchPoly){MIDI_packed_data1(p), MIDI_packed_data2(p)};
+    break;
+  case MIDI_MSG_TYPE_CONTROL_CHANGE:
+    msg.data.control_change = (MIDI_ControlChange){MIDI_packed_data1(p), MIDI_packed_data2(p)};
+    break;
+  case MIDI_MSG_TYPE_PROGRAM_CHANGE: msg.data.program_change.program = MIDI_packed_data1(p); break;
+  case MIDI_MSG_TYPE_AFTERTOUCH_MONO: msg.data.aftertouch_mono.value = MIDI_packed_data1(p); break;
+  case MIDI_MSG_TYPE_PITCH_BEND:
+    msg.data.pitch_bend.value = (int16_t)((MIDI_packed_data1(p) | (MIDI_packed_data2(p) << 7)) - 0x2000);
+    break;
+  case MIDI_MSG_TYPE_MISC: break;
+  }
+
+  return msg;
+}
+
 static inline const char * MIDI_message_type_to_str(MIDI_MessageType t) {
   switch(t) {
   case MIDI_MSG_TYPE_NOTE_OFF: return "NOTE_OFF";
@@ -83,15 +222,28 @@ static inline const char * MIDI_message_type_to_str(MIDI_MessageType t) {
 
 int MIDI_note_off_msg_to_str_buffer(char * str, int max_len, MIDI_NoteOff msg);
 int MIDI_note_on_msg_to_str_buffer(char * str, int max_len, MIDI_NoteOn msg);
+int MIDI_aftertouch_poly_msg_to_str_buffer(char * str, int max_len, MIDI_AftertouchPoly msg);
 int MIDI_control_change_msg_to_str_buffer(char * str, int max_len, MIDI_ControlChange msg);
+int MIDI_program_change_msg_to_str_buffer(char * str, int max_len, MIDI_ProgramChange msg);
+int MIDI_aftertouch_mono_msg_to_str_buffer(char * str, int max_len, MIDI_AftertouchMono msg);
 int MIDI_pitch_bend_msg_to_str_buffer(char * str, int max_len, MIDI_PitchBend msg);
+int MIDI_misc_msg_to_str_buffer(char * str, int max_len, MIDI_Misc msg);
 
 int MIDI_note_off_msg_to_str_buffer_short(char * str, int max_len, MIDI_NoteOff msg);
 int MIDI_note_on_msg_to_str_buffer_short(char * str, int max_len, MIDI_NoteOn msg);
+int MIDI_aftertouch_poly_msg_to_str_buffer_short(char * str, int max_len, MIDI_AftertouchPoly msg);
 int MIDI_control_change_msg_to_str_buffer_short(char * str, int max_len, MIDI_ControlChange msg);
+int MIDI_program_change_msg_to_str_buffer_short(char * str, int max_len, MIDI_ProgramChange msg);
+int MIDI_aftertouch_mono_msg_to_str_buffer_short(char * str, int max_len, MIDI_AftertouchMono msg);
 int MIDI_pitch_bend_msg_to_str_buffer_short(char * str, int max_len, MIDI_PitchBend msg);
+int MIDI_misc_msg_to_str_buffer_short(char * str, int max_len, MIDI_Misc msg);
 
 int MIDI_message_to_str_buffer(char * str, int max_len, MIDI_Message msg);
 int MIDI_message_to_str_buffer_short(char * str, int max_len, MIDI_Message msg);
 
+// Formats n messages into str, one per line (each followed by a newline). Like the functions above, this returns the
+// length the output would have had if it fit (as far as it got), the string is truncated to max_len.
+int MIDI_messages_to_str_buffer(char * str, int max_len, const MIDI_Message * msgs, size_t n);
+int MIDI_messages_to_str_buffer_short(char * str, int max_len, const MIDI_Message * msgs, size_t n);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_MSG_QUEUE_H
+#define C_MIDI_MSG_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "message.h"
+
+#include <cfac/stat.h>
+
+#define MIDI_CACHE_LINE_SIZE 64
+
+// Single-producer/single-consumer queue of messages, for handing parser output from one thread to another. Exactly one
+// thread may push and exactly one (other) thread may pop. Neither side ever blocks or retries, push and pop are
+// wait-free. Indices run freely and are wrapped with a mask, so the capacity must be a power of two.
+typedef struct MIDI_MsgQueue {
+  // written by the producer only
+  _Alignas(MIDI_CACHE_LINE_SIZE) atomic_size_t end_idx;
+  size_t cached_begin_idx; // producer's last look at begin_idx, saves touching the consumer's cache line
+
+  // written by the consumer only
+  _Alignas(MIDI_CACHE_LINE_SIZE) atomic_size_t begin_idx;
+  size_t cached_end_idx; // consumer's last look at end_idx, saves touching the producer's cache line
+
+  // constant after init
+  _Alignas(MIDI_CACHE_LINE_SIZE) MIDI_Message * data;
+  size_t mask;
+} MIDI_MsgQueue;
+
+STAT_Val MIDI_msg_queue_init(MIDI_MsgQueue * restrict queue, MIDI_Message * storage, size_t capacity);
+
+// producer side
+static inline bool   MIDI_msg_queue_push(MIDI_MsgQueue * restrict queue, MIDI_Message msg);
+static inline size_t MIDI_msg_queue_push_n(MIDI_MsgQueue * restrict queue, const MIDI_Message * msgs, size_t n);
+
+// consumer side
+static inline bool   MIDI_msg_queue_pop(MIDI_MsgQueue * restrict queue, MIDI_Message * msg);
+static inline size_t MIDI_msg_queue_pop_n(MIDI_MsgQueue * restrict queue, MIDI_Message * msgs, size_t max_n);
+
+static inline size_t MIDI_msg_queue_capacity(const MIDI_MsgQueue * restrict queue) { return queue->mask + 1; }
+
+static inline size_t MIDI_INT_msg_queue_free_space(MIDI_MsgQueue * restrict queue, size_t end, size_t wanted) {
+  size_t free_space = MIDI_msg_queue_capacity(queue) - (end - queue->cached_begin_idx);
+  if(free_space < wanted) {
+    // not enough room as far as we last saw, look again
+    queue->cached_begin_idx = atomic_load_explicit(&(queue->begin_idx), memory_order_acquire);
+    free_space              = MIDI_msg_queue_capacity(queue) - (end - queue->cached_begin_idx);
+  }
+  return free_space;
+}
+
+static inline size_t MIDI_INT_msg_queue_available(MIDI_MsgQueue * restrict queue, size_t begin, size_t wanted) {
+  size_t available = queue->cached_end_idx - begin;
+  if(available < wanted) {
+    // not enough messages as far as we last saw, look again
+    queue->cached_end_idx = atomic_load_explicit(&(queue->end_idx), memory_order_acquire);
+    available             = queue->cached_end_idx - begin;
+  }
+  return available;
+}
+
+static inline size_t MIDI_INT_msg_queue_first_span(const MIDI_MsgQueue * restrict queue, size_t idx, size_t n) {
+  const size_t until_wrap = MIDI_msg_queue_capacity(queue) - (idx & queue->mask);
+  return (n < until_wrap) ? n : until_wrap;
+}
+
+static inline bool MIDI_msg_queue_push(MIDI_MsgQueue * restrict queue, MIDI_Message msg) {
+  const size_t end = atomic_load_explicit(&(queue->end_idx), memory_order_relaxed);
+  if(MIDI_INT_msg_queue_free_space(queue, end, 1) == 0) return false;
+
+  queue->data[end & queue->mask] = msg;
+  atomic_store_explicit(&(queue->end_idx), end + 1, memory_order_release);
+
+  return true;
+}
+
+static inline size_t MIDI_msg_queue_push_n(MIDI_MsgQueue * restrict queue, const MIDI_Message * msgs, size_t n) {
+  const size_t end        = atomic_load_explicit(&(queue->end_idx), memory_order_relaxed);
+  const size_t free_space = MIDI_INT_msg_queue_free_space(queue, end, n);
+  if(n > free_space) n = free_space;
+
+  // at most two contiguous spans, one up to the end of the storage and one from the start
+  const size_t first_n = MIDI_INT_msg_queue_first_span(queue, end, n);
+  memcpy(&(queue->data[end & queue->mask]), msgs, first_n * sizeof(MIDI_Message));
+  memcpy(queue->data, &(msgs[first_n]), (n - first_n) * sizeof(MIDI_Message));
+
+  atomic_store_explicit(&(queue->end_idx), end + n, memory_order_release);
+
+  return n;
+}
+
+static inline bool MIDI_msg_queue_pop(MIDI_MsgQueue * restrict queue, MIDI_Message * msg) {
+  const size_t begin = atomic_load_explicit(&(queue->begin_idx), memory_order_relaxed);
+  if(MIDI_INT_msg_queue_available(queue, begin, 1) == 0) return false;
+
+  *msg = queue->data[begin & queue->mask];
+  atomic_store_explicit(&(queue->begin_idx), begin + 1, memory_order_release);
+
+  return true;
+}
+
+static inline size_t MIDI_msg_queue_pop_n(MIDI_MsgQueue * restrict queue, MIDI_Message * msgs, size_t max_n) {
+  const size_t begin     = atomic_load_explicit(&(queue->begin_idx), memory_order_relaxed);
+  const size_t available = MIDI_INT_msg_queue_available(queue, begin, max_n);
+  const size_t n         = (max_n < available) ? max_n : available;
+
+  const size_t first_n = MIDI_INT_msg_queue_first_span(queue, begin, n);
+  memcpy(msgs, &(queue->data[begin & queue->mask]), first_n * sizeof(MIDI_Message));
+  memcpy(&(msgs[first_n]), queue->data, (n - first_n) * sizeof(MIDI_Message));
+
+  atomic_store_explicit(&(queue->begin_idx), begin + n, memory_order_release);
+
+  return n;
+}
+
+#endif
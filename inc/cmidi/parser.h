@@ -20,26 +20,94 @@
 #ifndef C_MIDI_PARSER_H
 #define C_MIDI_PARSER_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "message.h"
 #include "note.h"
 
 #include <cfac/stat.h>
 
-#define MIDI_OUT_BUFFER_SIZE 32
+#ifndef MIDI_OUT_BUFFER_SIZE
+#define MIDI_OUT_BUFFER_SIZE 32 // capacity of the buffer built into every parser, must be a power of two
+#endif
 
+_Static_assert((MIDI_OUT_BUFFER_SIZE & (MIDI_OUT_BUFFER_SIZE - 1)) == 0, "MIDI_OUT_BUFFER_SIZE must be a power of two");
+
+// What to do with a new message when the buffer is full. Every message that is lost is counted in dropped_count.
+typedef enum MIDI_OverflowPolicy {
+  MIDI_OVERFLOW_REJECT = 0,  // parser is not ready while the buffer is full, the caller has to drain it first
+  MIDI_OVERFLOW_DROP_OLDEST, // make room by dropping the oldest message
+  MIDI_OVERFLOW_DROP_NEWEST, // drop the new message
+  MIDI_OVERFLOW_COALESCE,    // overwrite the last message on the channel if the new one supersedes it, else drop oldest
+} MIDI_OverflowPolicy;
+
+#define MIDI_INT_BUFF_CHANNELS 32 // last_idx entries, covers channel 0 (not channel specific) and 1-16
+
+// Timestamps are optional and live in a ring of their own next to the messages, at the same index, so a message stays
+// as small as it is and parsers that don't use them only pay for a pointer check when a message is pushed.
+// Messages come out in the order of their timestamps. To keep it that way, with timestamps COALESCE only overwrites
+// the newest message in the buffer, anything else makes it drop the oldest.
 typedef struct MIDI_MsgBuffer {
-  MIDI_Message data[MIDI_OUT_BUFFER_SIZE];
-  uint16_t     begin_idx;
-  uint16_t     end_idx;
-  bool         is_full;
+  MIDI_Message *   data;            // external storage, or NULL to use internal_data
+  uint32_t         mask;            // capacity - 1
+  uint32_t         begin_idx;       // begin_idx and end_idx run freely, they are only wrapped (with mask) on access
+  uint32_t         end_idx;
+  uint8_t          overflow_policy; // MIDI_OverflowPolicy
+  uint32_t         dropped_count;
+  MIDI_Timestamp * timestamps;      // parallel to the messages, NULL if they aren't timestamped
+  MIDI_Timestamp   now;             // arrival of the byte being parsed, pushed messages are stamped with it
+  uint32_t         last_idx[MIDI_INT_BUFF_CHANNELS]; // index (running freely) of the last message on each channel
+#ifdef MIDI_PARSER_STATS
+  uint32_t overwritten_count; // buffered messages overwritten by COALESCE or DROP_OLDEST
+  uint32_t high_water;        // most messages in the buffer at once
+#endif
+  MIDI_Message internal_data[MIDI_OUT_BUFFER_SIZE];
 } MIDI_MsgBuffer;
 
-typedef uint8_t MIDI_Channel;
+// Zero-copy view of the buffered messages, the ring wraps around at most once so they are in at most two spans.
+typedef struct MIDI_MsgSpans {
+  const MIDI_Message * first;
+  size_t               first_len;
+  const MIDI_Message * second; // NULL if second_len is 0
+  size_t               second_len;
+} MIDI_MsgSpans;
+
+// SysEx dumps are never buffered, their payload is handed to a callback as it comes in. A dump is reported as START,
+// any number of CHUNKs and then END, or ABORT when another status byte cuts it short. F0 and F7 are not part of the
+// payload. Real-time bytes in the middle of a dump are parsed as usual, they just split it into more chunks.
+typedef enum MIDI_SysExEvent {
+  MIDI_SYSEX_START,
+  MIDI_SYSEX_CHUNK,
+  MIDI_SYSEX_END,
+  MIDI_SYSEX_ABORT,
+} MIDI_SysExEvent;
+
+// For CHUNK, data points straight into the bytes being parsed, so it is only valid during the call. For END and ABORT,
+// data is NULL and len is the total payload length.
+typedef void (*MIDI_SysExCallback)(void * context, MIDI_SysExEvent event, const uint8_t * data, size_t len);
+
+// Counters for finding out what a misbehaving device is sending us. They are only kept when the library is built with
+// MIDI_PARSER_STATS (see CMakeLists.txt), without it the parser doesn't have them and they cost nothing.
+typedef struct MIDI_ParserStats {
+  uint64_t bytes;                // bytes parsed
+  uint64_t skipped_bytes;        // system common and undefined bytes, and data bytes without a status to go with
+  uint32_t retries;              // status bytes that cut running status or a message short and were parsed again
+  uint32_t other_channel_resets; // status bytes for channels outside channel_mask, each sends us back to init
+  uint32_t overwritten;          // buffered messages overwritten on overflow, also in MIDI_parser_get_dropped_count()
+  uint32_t buffer_high_water;    // most messages in the buffer at once
+} MIDI_ParserStats;
+
+#define MIDI_CHANNEL_OMNI     0 // MIDI_Parser.channel for parsers listening to multiple channels
+#define MIDI_CHANNEL_MASK_ALL 0xffff
+
+static inline uint16_t MIDI_channel_to_mask(MIDI_Channel channel) { return (uint16_t)(1u << (channel - 1)); }
 
 typedef struct MIDI_Parser {
   MIDI_Channel channel;
+  uint16_t     channel_mask;    // bit (n - 1) set means we parse messages on channel n
+  MIDI_Channel current_channel; // channel of the message in progress
 
   uint8_t        state;
   MIDI_MsgBuffer msg_buffer;
@@ -47,22 +115,107 @@ typedef struct MIDI_Parser {
   MIDI_Note    current_note;
   MIDI_Control current_control;
   uint8_t      pitch_bend_lsb;
+  uint8_t      data_byte; // first data byte of the message in progress, only used by the table-driven engine
+
+  MIDI_SysExCallback sysex_callback; // NULL to skip SysEx dumps
+  void *             sysex_context;
+  size_t             sysex_len; // payload length of the dump in progress
+
+#ifdef MIDI_PARSER_STATS
+  MIDI_ParserStats stats; // the byte counters only, the buffer keeps its own, see MIDI_parser_get_stats()
+#endif
 } MIDI_Parser;
 
 STAT_Val MIDI_parser_init(MIDI_Parser * restrict parser, MIDI_Channel channel);
 
+// Omni parsers parse all channels in channel_mask in a single pass, the channel of each message is in
+// MIDI_Message.channel. Messages on other channels are dropped.
+STAT_Val MIDI_parser_init_omni(MIDI_Parser * restrict parser, uint16_t channel_mask);
+STAT_Val MIDI_parser_set_channel_mask(MIDI_Parser * restrict parser, uint16_t channel_mask);
+
+// Replaces the built-in buffer with storage for capacity messages, capacity must be a power of two. Call this right
+// after init, or at least while the buffer is empty. The storage has to outlive the parser. Timestamp storage set
+// before is let go, as it may no longer match.
+STAT_Val MIDI_parser_set_buffer(MIDI_Parser * restrict parser, MIDI_Message * storage, size_t capacity);
+// Turns on timestamps, storage has to hold one for every message in the buffer, so capacity must be the buffer's
+// capacity (MIDI_OUT_BUFFER_SIZE unless MIDI_parser_set_buffer() was used). Pass NULL to turn them off again. Like
+// MIDI_parser_set_buffer(), only while the buffer is empty.
+STAT_Val MIDI_parser_set_timestamp_buffer(MIDI_Parser * restrict parser, MIDI_Timestamp * storage, size_t capacity);
+STAT_Val MIDI_parser_set_overflow_policy(MIDI_Parser * restrict parser, MIDI_OverflowPolicy policy);
+// The callback is called from within MIDI_parse_byte(s), pass NULL to go back to skipping SysEx dumps.
+STAT_Val MIDI_parser_set_sysex_callback(MIDI_Parser * restrict parser, MIDI_SysExCallback callback, void * context);
+
+// Copies the counters into stats, and when reset is set, starts them over (the high-water mark from the messages in
+// the buffer right now). Fails with STAT_ERR_PRECONDITION, and zeroes stats, if built without MIDI_PARSER_STATS.
+STAT_Val MIDI_parser_get_stats(MIDI_Parser * restrict parser, MIDI_ParserStats * stats, bool reset);
+
 STAT_Val MIDI_parse_byte(MIDI_Parser * restrict parser, uint8_t byte);
 
+// Parses up to n bytes, stopping early when the message buffer fills up (with MIDI_OVERFLOW_REJECT). The number of
+// bytes actually parsed is written to consumed, so the caller can drain the output and resume from bytes[*consumed].
+STAT_Val MIDI_parse_bytes(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed);
+
+// Timed versions of the above, every message is stamped with the arrival time of the byte that completes it. Without
+// timestamp storage these parse just the same and the times go nowhere.
+STAT_Val MIDI_parse_byte_timed(MIDI_Parser * restrict parser, uint8_t byte, MIDI_Timestamp timestamp);
+// timestamps holds the arrival time of every byte.
+STAT_Val MIDI_parse_bytes_timed(MIDI_Parser * restrict parser,
+                                const uint8_t *        bytes,
+                                const MIDI_Timestamp * timestamps,
+                                size_t                 n,
+                                size_t *               consumed);
+// For a chunk that only comes with the arrival times of its first and last byte, e.g. a driver buffer, the bytes in
+// between are spread evenly over [first, last]. When stopping early, bytes[*consumed] is at
+// first + (last - first) * *consumed / (n - 1), which is where to resume from.
+STAT_Val MIDI_parse_chunk_timed(MIDI_Parser * restrict parser,
+                                const uint8_t *        bytes,
+                                size_t                 n,
+                                MIDI_Timestamp         first,
+                                MIDI_Timestamp         last,
+                                size_t *               consumed);
+
+// Which engine MIDI_parse_byte(s) uses is decided at build time (see MIDI_PARSER_ENGINE in CMakeLists.txt), these
+// bypass that choice so both engines can be tested and benchmarked side by side. Don't mix engines on one parser.
+STAT_Val MIDI_INT_parse_bytes_switch(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed);
+STAT_Val MIDI_INT_parse_bytes_table(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed);
+
 static inline bool         MIDI_parser_has_output(const MIDI_Parser * restrict parser);
 static inline MIDI_Message MIDI_parser_peek_msg(const MIDI_Parser * restrict parser);
 static inline MIDI_Message MIDI_parser_pop_msg(MIDI_Parser * restrict parser);
 static inline bool         MIDI_parser_is_ready(const MIDI_Parser * restrict parser);
+static inline uint32_t     MIDI_parser_get_dropped_count(const MIDI_Parser * restrict parser);
+
+// Pops up to max messages into out, returns the number of messages popped.
+static inline size_t MIDI_parser_pop_msgs(MIDI_Parser * restrict parser, MIDI_Message * restrict out, size_t max);
+// Same as MIDI_parser_pop_msgs, with the timestamp of each message (0 if timestamps are off). Timestamps never go
+// backwards, also with MIDI_OVERFLOW_COALESCE.
+static inline size_t MIDI_parser_pop_timed_msgs(MIDI_Parser * restrict parser, MIDI_TimedMessage * restrict out,
+                                                size_t max);
+static inline MIDI_TimedMessage MIDI_parser_pop_timed_msg(MIDI_Parser * restrict parser);
+// Timestamp of the message MIDI_parser_peek_msg would return.
+static inline MIDI_Timestamp MIDI_parser_peek_timestamp(const MIDI_Parser * restrict parser);
+// Same as MIDI_parser_pop_msgs, but converts to the packed 32-bit form on the way out.
+static inline size_t MIDI_parser_pop_packed_msgs(MIDI_Parser * restrict parser, MIDI_PackedMessage * restrict out,
+                                                 size_t max);
+
+// Points spans at the buffered messages without copying or removing them, returns the total number of messages. The
+// spans stay valid until the messages are committed or the parser is fed more bytes.
+static inline size_t MIDI_parser_peek_msgs(const MIDI_Parser * restrict parser, MIDI_MsgSpans * restrict spans);
+// Removes the first n messages (as returned by MIDI_parser_peek_msgs) from the buffer, returns the number removed.
+static inline size_t MIDI_parser_commit_msgs(MIDI_Parser * restrict parser, size_t n);
+
+static inline MIDI_Message *       MIDI_INT_buff_data(MIDI_MsgBuffer * restrict buffer);
+static inline const MIDI_Message * MIDI_INT_buff_const_data(const MIDI_MsgBuffer * restrict buffer);
+static inline bool                 MIDI_INT_buff_is_empty(const MIDI_MsgBuffer * restrict buffer);
+static inline bool                 MIDI_INT_buff_is_full(const MIDI_MsgBuffer * restrict buffer);
+static inline size_t               MIDI_INT_buff_capacity(const MIDI_MsgBuffer * restrict buffer);
+static inline size_t               MIDI_INT_buff_count(const MIDI_MsgBuffer * restrict buffer);
+static inline MIDI_Message         MIDI_INT_buff_pop(MIDI_MsgBuffer * restrict buffer);
+static inline bool                 MIDI_INT_buff_push(MIDI_MsgBuffer * restrict buffer, MIDI_Message msg);
+static inline MIDI_Message         MIDI_INT_buff_peek(const MIDI_MsgBuffer * restrict buffer);
 
-static inline bool         MIDI_INT_buff_is_empty(const MIDI_MsgBuffer * restrict buffer);
-static inline bool         MIDI_INT_buff_is_full(const MIDI_MsgBuffer * restrict buffer);
-static inline MIDI_Message MIDI_INT_buff_pop(MIDI_MsgBuffer * restrict buffer);
-static inline void         MIDI_INT_buff_push(MIDI_MsgBuffer * restrict buffer, MIDI_Message msg);
-static inline MIDI_Message MIDI_INT_buff_peek(const MIDI_MsgBuffer * restrict buffer);
+// slow path of MIDI_INT_buff_push, applies the overflow policy
+bool MIDI_INT_buff_push_overflow(MIDI_MsgBuffer * restrict buffer, MIDI_Message msg);
 
 static inline bool MIDI_parser_has_output(const MIDI_Parser * restrict parser) {
   return (parser != NULL) && !MIDI_INT_buff_is_empty(&(parser->msg_buffer));
@@ -79,34 +232,145 @@ static inline MIDI_Message MIDI_parser_pop_msg(MIDI_Parser * restrict parser) {
 }
 
 static inline bool MIDI_parser_is_ready(const MIDI_Parser * restrict parser) {
-  return (parser != NULL) && (!MIDI_INT_buff_is_full(&(parser->msg_buffer)));
+  // with any policy other than reject the buffer makes room by itself
+  return (parser != NULL) && ((parser->msg_buffer.overflow_policy != MIDI_OVERFLOW_REJECT) ||
+                              !MIDI_INT_buff_is_full(&(parser->msg_buffer)));
 }
 
-static inline bool MIDI_INT_buff_is_empty(const MIDI_MsgBuffer * restrict buffer) {
-  return (buffer->begin_idx == buffer->end_idx) && !buffer->is_full;
+static inline uint32_t MIDI_parser_get_dropped_count(const MIDI_Parser * restrict parser) {
+  return (parser != NULL) ? parser->msg_buffer.dropped_count : 0;
 }
-static inline bool         MIDI_INT_buff_is_full(const MIDI_MsgBuffer * restrict buffer) { return buffer->is_full; }
-static inline MIDI_Message MIDI_INT_buff_pop(MIDI_MsgBuffer * restrict buffer) {
-  if(!MIDI_INT_buff_is_empty(buffer)) {
-    const MIDI_Message m = buffer->data[buffer->begin_idx++];
 
-    if(buffer->begin_idx == MIDI_OUT_BUFFER_SIZE) buffer->begin_idx = 0;
-    buffer->is_full = false;
+static inline size_t MIDI_parser_pop_msgs(MIDI_Parser * restrict parser, MIDI_Message * restrict out, size_t max) {
+  if(parser == NULL || out == NULL) return 0;
+
+  MIDI_MsgSpans spans;
+  const size_t  available = MIDI_parser_peek_msgs(parser, &spans);
+  const size_t  n         = (available < max) ? available : max;
+  const size_t  first_n   = (spans.first_len < n) ? spans.first_len : n;
 
-    return m;
+  memcpy(out, spans.first, first_n * sizeof(MIDI_Message));
+  if(n > first_n) memcpy(out + first_n, spans.second, (n - first_n) * sizeof(MIDI_Message));
+
+  parser->msg_buffer.begin_idx += (uint32_t)n;
+  return n;
+}
+
+static inline size_t MIDI_parser_pop_timed_msgs(MIDI_Parser * restrict parser, MIDI_TimedMessage * restrict out,
+                                                size_t max) {
+  if(parser == NULL || out == NULL) return 0;
+
+  MIDI_MsgBuffer *       buffer     = &(parser->msg_buffer);
+  const MIDI_Message *   data       = MIDI_INT_buff_const_data(buffer);
+  const MIDI_Timestamp * timestamps = buffer->timestamps;
+  const size_t           count      = MIDI_INT_buff_count(buffer);
+  const size_t           n          = (count < max) ? count : max;
+
+  for(size_t i = 0; i < n; i++) {
+    const uint32_t idx = (buffer->begin_idx + (uint32_t)i) & buffer->mask;
+    out[i]             = (MIDI_TimedMessage){.timestamp = (timestamps != NULL) ? timestamps[idx] : 0, .msg = data[idx]};
   }
+
+  buffer->begin_idx += (uint32_t)n;
+  return n;
+}
+
+static inline MIDI_TimedMessage MIDI_parser_pop_timed_msg(MIDI_Parser * restrict parser) {
+  MIDI_TimedMessage msg = {0};
+  MIDI_parser_pop_timed_msgs(parser, &msg, 1);
+  return msg;
+}
+
+static inline MIDI_Timestamp MIDI_parser_peek_timestamp(const MIDI_Parser * restrict parser) {
+  if(parser == NULL || parser->msg_buffer.timestamps == NULL) return 0;
+  return parser->msg_buffer.timestamps[parser->msg_buffer.begin_idx & parser->msg_buffer.mask];
+}
+
+static inline size_t MIDI_parser_pop_packed_msgs(MIDI_Parser * restrict parser, MIDI_PackedMessage * restrict out,
+                                                 size_t max) {
+  if(parser == NULL || out == NULL) return 0;
+
+  MIDI_MsgSpans spans;
+  const size_t  available = MIDI_parser_peek_msgs(parser, &spans);
+  const size_t  n         = (available < max) ? available : max;
+  const size_t  first_n   = (spans.first_len < n) ? spans.first_len : n;
+
+  for(size_t i = 0; i < first_n; i++) out[i] = MIDI_message_to_packed(spans.first[i]);
+  for(size_t i = first_n; i < n; i++) out[i] = MIDI_message_to_packed(spans.second[i - first_n]);
+
+  parser->msg_buffer.begin_idx += (uint32_t)n;
+  return n;
+}
+
+static inline size_t MIDI_parser_peek_msgs(const MIDI_Parser * restrict parser, MIDI_MsgSpans * restrict spans) {
+  if(spans == NULL) return 0;
+  *spans = (MIDI_MsgSpans){0};
+  if(parser == NULL) return 0;
+
+  const MIDI_MsgBuffer * buffer = &(parser->msg_buffer);
+  const MIDI_Message *   data   = MIDI_INT_buff_const_data(buffer);
+  const size_t           count  = MIDI_INT_buff_count(buffer);
+  const size_t           begin  = buffer->begin_idx & buffer->mask;
+  const size_t           to_end = MIDI_INT_buff_capacity(buffer) - begin;
+
+  spans->first     = &(data[begin]);
+  spans->first_len = (count < to_end) ? count : to_end;
+  if(count > spans->first_len) {
+    spans->second     = data;
+    spans->second_len = count - spans->first_len;
+  }
+
+  return count;
+}
+
+static inline size_t MIDI_parser_commit_msgs(MIDI_Parser * restrict parser, size_t n) {
+  if(parser == NULL) return 0;
+
+  const size_t count = MIDI_INT_buff_count(&(parser->msg_buffer));
+  if(n > count) n = count;
+
+  parser->msg_buffer.begin_idx += (uint32_t)n;
+  return n;
+}
+
+static inline MIDI_Message * MIDI_INT_buff_data(MIDI_MsgBuffer * restrict buffer) {
+  return (buffer->data != NULL) ? buffer->data : buffer->internal_data;
+}
+static inline const MIDI_Message * MIDI_INT_buff_const_data(const MIDI_MsgBuffer * restrict buffer) {
+  return (buffer->data != NULL) ? buffer->data : buffer->internal_data;
+}
+
+static inline bool MIDI_INT_buff_is_empty(const MIDI_MsgBuffer * restrict buffer) {
+  return buffer->begin_idx == buffer->end_idx;
+}
+static inline bool MIDI_INT_buff_is_full(const MIDI_MsgBuffer * restrict buffer) {
+  return (buffer->end_idx - buffer->begin_idx) > buffer->mask;
+}
+static inline size_t MIDI_INT_buff_capacity(const MIDI_MsgBuffer * restrict buffer) { return (size_t)buffer->mask + 1; }
+static inline size_t MIDI_INT_buff_count(const MIDI_MsgBuffer * restrict buffer) {
+  return buffer->end_idx - buffer->begin_idx;
+}
+static inline MIDI_Message MIDI_INT_buff_pop(MIDI_MsgBuffer * restrict buffer) {
+  if(!MIDI_INT_buff_is_empty(buffer)) return MIDI_INT_buff_data(buffer)[buffer->begin_idx++ & buffer->mask];
   return (MIDI_Message){0};
 }
-static inline void MIDI_INT_buff_push(MIDI_MsgBuffer * restrict buffer, MIDI_Message msg) {
-  if(buffer->is_full) MIDI_INT_buff_pop(buffer);
+static inline bool MIDI_INT_buff_push(MIDI_MsgBuffer * restrict buffer, MIDI_Message msg) {
+  if(MIDI_INT_buff_is_full(buffer)) return MIDI_INT_buff_push_overflow(buffer, msg);
 
-  buffer->data[buffer->end_idx++] = msg;
+  const uint32_t end = buffer->end_idx++;
+  const uint32_t idx = end & buffer->mask;
 
-  if(buffer->end_idx == MIDI_OUT_BUFFER_SIZE) buffer->end_idx = 0;
-  if(buffer->end_idx == buffer->begin_idx) buffer->is_full = true;
+  MIDI_INT_buff_data(buffer)[idx]                              = msg;
+  buffer->last_idx[msg.channel & (MIDI_INT_BUFF_CHANNELS - 1)] = end;
+  if(buffer->timestamps != NULL) buffer->timestamps[idx] = buffer->now;
+#ifdef MIDI_PARSER_STATS
+  const uint32_t count = buffer->end_idx - buffer->begin_idx;
+  if(count > buffer->high_water) buffer->high_water = count;
+#endif
+  return true;
 }
 static inline MIDI_Message MIDI_INT_buff_peek(const MIDI_MsgBuffer * restrict buffer) {
-  return buffer->data[buffer->begin_idx];
+  return MIDI_INT_buff_const_data(buffer)[buffer->begin_idx & buffer->mask];
 }
 
-#endif
\ No newline at end of file
+#endif
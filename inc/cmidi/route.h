@@ -0,0 +1,118 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_ROUTE_H
+#define C_MIDI_ROUTE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "message.h"
+
+#include <cfac/stat.h>
+
+#ifndef MIDI_ROUTER_MAX_EXTRA
+#define MIDI_ROUTER_MAX_EXTRA 8192 // outputs beyond the first one of every message, over all compiled routes
+#endif
+#ifndef MIDI_ROUTER_MAX_TABLES
+#define MIDI_ROUTER_MAX_TABLES 64 // distinct value tables after composing the rules, the identity included
+#endif
+
+#define MIDI_ROUTE_MAX_OUTPUTS 16 // messages a single message may turn into
+#define MIDI_ROUTE_NUM_TYPES   7  // the channel voice types, MIDI_MSG_TYPE_MISC is passed on as it is
+#define MIDI_ROUTE_NUM_KEYS    128
+#define MIDI_ROUTE_KEEP        (-1)
+
+#define MIDI_ROUTE_TYPE(type)  (1u << (type))
+#define MIDI_ROUTE_ALL_TYPES   ((1u << MIDI_ROUTE_NUM_TYPES) - 1)
+#define MIDI_ROUTE_NOTE_TYPES                                                                                          \
+  (MIDI_ROUTE_TYPE(MIDI_MSG_TYPE_NOTE_OFF) | MIDI_ROUTE_TYPE(MIDI_MSG_TYPE_NOTE_ON) |                                  \
+   MIDI_ROUTE_TYPE(MIDI_MSG_TYPE_AFTERTOUCH_POLY))
+
+typedef enum MIDI_RouteAction {
+  MIDI_ROUTE_MODIFY = 0, // change the message, the rules after this one see it changed
+  MIDI_ROUTE_DROP,
+  MIDI_ROUTE_DUPLICATE, // emit a changed copy as well, both go on to the rules after this one
+} MIDI_RouteAction;
+
+// A message matches when its type, channel and key are all in the rule. The key is the note, controller or program.
+// Channel aftertouch and pitch bend have none, so the key range doesn't apply to them. Only the key, channel and type
+// are matched on, never the value, which is what lets the rules be compiled into tables.
+typedef struct MIDI_RouteRule {
+  uint8_t  types;        // MIDI_ROUTE_TYPE() of each type to match
+  uint16_t channel_mask; // bit (n - 1) set matches channel n
+  uint8_t  key_min;      // inclusive
+  uint8_t  key_max;      // inclusive
+
+  uint8_t         action;    // MIDI_RouteAction
+  MIDI_Channel    channel;   // new channel, 0 keeps it
+  int16_t         key;       // new key, or MIDI_ROUTE_KEEP
+  int8_t          transpose; // added to the key after that, messages whose key ends up outside 0-127 are dropped
+  const uint8_t * values;    // 128 entries mapping velocity, controller value or aftertouch, NULL keeps them
+} MIDI_RouteRule;
+
+// matches everything and changes nothing, a starting point for rules
+#define MIDI_ROUTE_RULE_ALL                                                                                            \
+  ((MIDI_RouteRule){.types        = MIDI_ROUTE_ALL_TYPES,                                                              \
+                    .channel_mask = 0xffff,                                                                            \
+                    .key_min      = 0,                                                                                 \
+                    .key_max      = 127,                                                                               \
+                    .key          = MIDI_ROUTE_KEEP})
+
+// Where one message goes after all rules.
+typedef struct MIDI_Route {
+  uint8_t  channel;     // 0 if nothing is left of the message itself
+  uint8_t  key;
+  uint8_t  table;       // index into MIDI_Router.values
+  uint8_t  num_extra;   // outputs that follow, they are in MIDI_Router.extra from first_extra on
+  uint16_t first_extra;
+} MIDI_Route;
+
+// Rules compiled into a route for every type, channel and key, so applying them costs the same no matter how many
+// rules there are. Value mappings are composed into one table per route and tables are shared between routes.
+// This is about 150 KB, keep it off small stacks.
+typedef struct MIDI_Router {
+  MIDI_Route routes[MIDI_ROUTE_NUM_TYPES][16][MIDI_ROUTE_NUM_KEYS];
+  MIDI_Route extra[MIDI_ROUTER_MAX_EXTRA];
+  uint8_t    values[MIDI_ROUTER_MAX_TABLES][MIDI_ROUTE_NUM_KEYS];
+  size_t     num_extra;
+  size_t     num_tables;
+} MIDI_Router;
+
+// Compiles the rules, applied in order, into router. Returns STAT_ERR_RANGE when a message would turn into more than
+// MIDI_ROUTE_MAX_OUTPUTS, or the routes don't fit in MIDI_ROUTER_MAX_EXTRA or MIDI_ROUTER_MAX_TABLES. The rules (and
+// their value tables) aren't needed after this.
+STAT_Val MIDI_route_compile(MIDI_Router * restrict router, const MIDI_RouteRule * rules, size_t num_rules);
+
+// Routes up to n messages into out, which has room for max, and returns the number of messages written. A message
+// comes out as itself first (unless that was dropped) and then its copies. Stops before a message whose outputs don't
+// all fit, or before a message that is dropped while out is full. The number of messages taken from in is written to
+// consumed.
+size_t MIDI_route_apply(const MIDI_Router * restrict router,
+                        const MIDI_Message *         in,
+                        size_t                       n,
+                        MIDI_Message * restrict      out,
+                        size_t                       max,
+                        size_t *                     consumed);
+
+// Fills values with a linear mapping, value * scale / 128 + offset clamped to min-max, e.g. for a velocity curve.
+void MIDI_route_linear_values(uint8_t * values, uint16_t scale, int16_t offset, uint8_t min, uint8_t max);
+
+#endif
@@ -0,0 +1,113 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_RPN_H
+#define C_MIDI_RPN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "control.h"
+#include "message.h"
+
+#include <cfac/stat.h>
+
+// registered parameter numbers, (MSB << 7) | LSB
+#define MIDI_RPN_PITCH_BEND_SENSITIVITY 0x0000
+#define MIDI_RPN_FINE_TUNING            0x0001
+#define MIDI_RPN_COARSE_TUNING          0x0002
+#define MIDI_RPN_TUNING_PROGRAM         0x0003
+#define MIDI_RPN_TUNING_BANK            0x0004
+#define MIDI_RPN_NULL                   0x3fff // deselects the parameter, data entry is ignored until the next one
+
+#define MIDI_RPN_VALUE_MAX 0x3fff
+
+typedef enum MIDI_RpnResult {
+  MIDI_RPN_PASS,     // not part of an RPN/NRPN sequence, use the message as it is
+  MIDI_RPN_CONSUMED, // part of a sequence, nothing to emit yet
+  MIDI_RPN_EMIT,     // out holds a parameter change
+} MIDI_RpnResult;
+
+typedef enum MIDI_RpnMode {
+  MIDI_RPN_WAIT_FOR_LSB = 0, // a write is one change, once its data entry LSB is in (or without it after the timeout)
+  MIDI_RPN_MSB_IMMEDIATE,    // a data entry MSB is a change of its own, for devices that only send the MSB
+} MIDI_RpnMode;
+
+typedef enum MIDI_ParamKind {
+  MIDI_PARAM_NONE = 0,
+  MIDI_PARAM_RPN,
+  MIDI_PARAM_NRPN,
+} MIDI_ParamKind;
+
+typedef enum MIDI_ParamOp {
+  MIDI_PARAM_SET = 0,    // value is the new 14-bit value
+  MIDI_PARAM_INCREMENT,  // by one, for a parameter whose value isn't known yet (value is 0)
+  MIDI_PARAM_DECREMENT,
+} MIDI_ParamOp;
+
+typedef struct MIDI_ParamChange {
+  uint8_t  channel; // MIDI_Channel
+  uint8_t  kind;    // MIDI_ParamKind
+  uint8_t  op;      // MIDI_ParamOp
+  uint16_t param;   // (MSB << 7) | LSB
+  uint16_t value;   // (MSB << 7) | LSB
+} MIDI_ParamChange;
+
+typedef struct MIDI_RpnChannel {
+  uint16_t param;
+  uint8_t  kind;        // MIDI_ParamKind of the selected parameter
+  uint8_t  data_msb;
+  uint8_t  data_lsb;
+  bool     value_known; // data entry was seen since the parameter was selected
+} MIDI_RpnChannel;
+
+// Turns the CC sequences of RPN/NRPN writes (parameter number MSB and LSB, data entry MSB and LSB, or data
+// increment/decrement) into one parameter change per write, to be put after a parser. Behind a MIDI_Cc14Pairer, the
+// pairer must not take data entry (MIDI_CC14_DEFINED_CONTROLS doesn't).
+typedef struct MIDI_RpnDecoder {
+  uint8_t        mode;    // MIDI_RpnMode
+  MIDI_Timestamp timeout; // how long a data entry MSB is held, 0 holds it until the LSB arrives
+  uint32_t       held;    // bit (n - 1) set while the data entry MSB of channel n waits for its LSB
+
+  MIDI_RpnChannel channels[16];
+  MIDI_Timestamp  held_since[16]; // arrival of the held data entry MSB, per channel
+} MIDI_RpnDecoder;
+
+STAT_Val MIDI_rpn_init(MIDI_RpnDecoder * restrict decoder, MIDI_RpnMode mode, MIDI_Timestamp timeout);
+
+// Feeds a message arriving at now. Data entry without a parameter selected, or with the null RPN, is consumed and
+// dropped. A held data entry MSB is emitted on its own when another data entry MSB or parameter number comes in, so
+// EMIT can mean the held value while the new message is taken in as well. Increment and decrement change a known
+// value by one (clamped to 0-MIDI_RPN_VALUE_MAX) and emit it as SET, otherwise they're emitted as they are.
+MIDI_RpnResult MIDI_rpn_process(MIDI_RpnDecoder * restrict  decoder,
+                                MIDI_Message                msg,
+                                MIDI_Timestamp              now,
+                                MIDI_ParamChange * restrict out);
+
+// For every channel whose data entry MSB has waited timeout or longer for its LSB, emits a SET of the selected
+// parameter to that MSB with LSB 0. Writes up to max into out and returns how many, call again while it returns max.
+// As with MIDI_cc14_poll(), only this enforces the timeout, a data entry LSB before the next poll still pairs.
+size_t MIDI_rpn_poll(MIDI_RpnDecoder * restrict decoder, MIDI_Timestamp now, MIDI_ParamChange * out, size_t max);
+
+// Emits the SET of every channel that is still waiting for a data entry LSB, whatever the timeout, e.g. at the end of
+// a stream.
+size_t MIDI_rpn_flush(MIDI_RpnDecoder * restrict decoder, MIDI_ParamChange * out, size_t max);
+
+#endif
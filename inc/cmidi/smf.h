@@ -0,0 +1,126 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_SMF_H
+#define C_MIDI_SMF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "message.h"
+#include "parser.h"
+
+#include <cfac/stat.h>
+
+#define MIDI_SMF_CHUNK_HEADER_SIZE 8 // 4 byte type, 4 byte big-endian length
+#define MIDI_SMF_HEADER_LENGTH     6 // length of the MThd chunk data
+
+#define MIDI_SMF_META              0xff
+#define MIDI_SMF_META_END_OF_TRACK 0x2f
+#define MIDI_SMF_SYSEX             0xf0
+#define MIDI_SMF_SYSEX_ESCAPE      0xf7
+
+#define MIDI_SMF_VLQ_MAX_SIZE 4
+#define MIDI_SMF_VLQ_MAX      0x0fffffff
+
+// A Standard MIDI File. The file is mapped rather than read, so opening it costs next to nothing, pages are only
+// touched once events are iterated. Everything that points into the file stays valid until MIDI_smf_close().
+typedef struct MIDI_Smf {
+  const uint8_t * data; // the whole file, starting at MThd
+  size_t          size;
+  bool            is_mapped; // data was mapped by MIDI_smf_open() and is unmapped by MIDI_smf_close()
+
+  uint16_t format;     // 0, 1 or 2
+  uint16_t num_tracks; // as declared in the header, MIDI_smf_get_tracks() returns what's actually there
+  uint16_t division;   // ticks per quarter note, or SMPTE timing if the top bit is set
+} MIDI_Smf;
+
+// the data of an MTrk chunk, pointing into the file
+typedef struct MIDI_SmfTrack {
+  const uint8_t * data;
+  size_t          len;
+} MIDI_SmfTrack;
+
+typedef struct MIDI_SmfEvent {
+  uint64_t     tick; // absolute, from the start of the track
+  MIDI_Message msg;
+} MIDI_SmfEvent;
+
+// Walks the events in a track. Channel messages are decoded by a MIDI_Parser, so running status and note ons with
+// velocity 0 work the same as for live input. Meta and SysEx events are skipped, like most readers running status
+// survives them.
+typedef struct MIDI_SmfTrackIter {
+  const uint8_t * pos;
+  const uint8_t * end;
+  uint64_t        tick;
+  uint8_t         running_status; // only used to know how long a channel message is, 0 if there is none yet
+  MIDI_Parser     parser;
+} MIDI_SmfTrackIter;
+
+STAT_Val MIDI_smf_open(MIDI_Smf * restrict smf, const char * path);
+// Same as MIDI_smf_open(), but for a file that's already in memory. data has to outlive smf.
+STAT_Val MIDI_smf_open_buffer(MIDI_Smf * restrict smf, const uint8_t * data, size_t size);
+STAT_Val MIDI_smf_close(MIDI_Smf * restrict smf);
+
+// Finds up to max_tracks MTrk chunks, other chunk types are skipped. Sizing tracks for smf->num_tracks is enough for
+// any well-formed file. A track cut short by the end of the file is returned as far as it goes.
+STAT_Val MIDI_smf_get_tracks(const MIDI_Smf * restrict smf,
+                             MIDI_SmfTrack *           tracks,
+                             size_t                    max_tracks,
+                             size_t *                  num_tracks);
+
+STAT_Val MIDI_smf_track_iter_init(MIDI_SmfTrackIter * restrict iter, MIDI_SmfTrack track);
+// Returns OK with the next event in event, or STAT_OK_FINISHED at the end of the track.
+STAT_Val MIDI_smf_track_iter_next(MIDI_SmfTrackIter * restrict iter, MIDI_SmfEvent * restrict event);
+
+// Decodes the variable-length quantity at *pos and moves *pos past it. Returns false if it runs past end or is longer
+// than MIDI_SMF_VLQ_MAX_SIZE bytes.
+static inline bool MIDI_smf_decode_vlq(const uint8_t ** pos, const uint8_t * end, uint32_t * value) {
+  const uint8_t * p = *pos;
+  uint32_t        v = 0;
+
+  for(int i = 0; i < MIDI_SMF_VLQ_MAX_SIZE && p < end; i++) {
+    const uint8_t byte = *(p++);
+    v                  = (v << 7) | (byte & 0x7f);
+    if((byte & 0x80) == 0) {
+      *value = v;
+      *pos   = p;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Writes value, which must not be over MIDI_SMF_VLQ_MAX, as a variable-length quantity to out, which must have room
+// for MIDI_SMF_VLQ_MAX_SIZE bytes. Returns the number of bytes written.
+static inline size_t MIDI_smf_encode_vlq(uint32_t value, uint8_t * out) {
+  size_t len = 1;
+  while(len < MIDI_SMF_VLQ_MAX_SIZE && (value >> (7 * len)) != 0) len++;
+
+  for(size_t i = 0; i < len; i++) {
+    const uint8_t more = (i + 1 < len) ? 0x80 : 0x00;
+    out[i]             = more | ((value >> (7 * (len - 1 - i))) & 0x7f);
+  }
+
+  return len;
+}
+
+#endif
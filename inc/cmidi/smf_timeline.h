@@ -0,0 +1,81 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_SMF_TIMELINE_H
+#define C_MIDI_SMF_TIMELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "smf.h"
+
+#include <cfac/stat.h>
+
+// The smallest channel event is a one byte delta time and a single data byte under running status, meta and SysEx
+// events are longer, so a track never holds more events than half its length.
+#define MIDI_SMF_MIN_EVENT_SIZE 2
+
+// The decoded events of one track, in caller provided storage.
+typedef struct MIDI_SmfTrackEvents {
+  MIDI_SmfEvent * events;
+  size_t          capacity;
+  size_t          num_events;
+  STAT_Val        stat; // result of decoding this track
+} MIDI_SmfTrackEvents;
+
+// Position in one track during a merge, kept in the heap so comparisons don't have to chase the event arrays.
+typedef struct MIDI_SmfMergeCursor {
+  uint64_t tick;  // tick of the event at pos
+  size_t   track; // index into the tracks, also breaks ties between equal ticks
+  size_t   pos;
+} MIDI_SmfMergeCursor;
+
+// Merges decoded tracks into a single stream ordered by tick. Events with the same tick come out in track order, and
+// in their original order within a track, so the result is the same on every run no matter how the tracks were
+// decoded.
+typedef struct MIDI_SmfMerge {
+  const MIDI_SmfTrackEvents * tracks;
+  MIDI_SmfMergeCursor *       heap; // min-heap on (tick, track), one cursor for every track that has events left
+  size_t                      heap_len;
+} MIDI_SmfMerge;
+
+// Enough capacity to decode any track, see MIDI_SMF_MIN_EVENT_SIZE.
+static inline size_t MIDI_smf_track_max_events(MIDI_SmfTrack track) { return track.len / MIDI_SMF_MIN_EVENT_SIZE; }
+
+// Decodes all channel events of a track into out->events. Fails with STAT_ERR_RANGE if they don't fit.
+STAT_Val MIDI_smf_decode_track(MIDI_SmfTrack track, MIDI_SmfTrackEvents * restrict out);
+
+// Decodes num_tracks tracks on up to num_threads threads, the calling thread included. Each track goes into its own
+// out[i], so threads share nothing but the index of the next track to take. Returns the stat of the first track that
+// failed, or OK. The stat of every track is in out[i].stat.
+STAT_Val MIDI_smf_decode_tracks(const MIDI_SmfTrack * tracks,
+                                MIDI_SmfTrackEvents * out,
+                                size_t                num_tracks,
+                                size_t                num_threads);
+
+// heap has to hold num_tracks cursors and, like tracks, outlive the merge.
+STAT_Val MIDI_smf_merge_init(MIDI_SmfMerge * restrict     merge,
+                             const MIDI_SmfTrackEvents * tracks,
+                             size_t                      num_tracks,
+                             MIDI_SmfMergeCursor *       heap);
+// Returns OK with the next event, and the index of the track it came from if track isn't NULL, or STAT_OK_FINISHED
+// once all tracks are done.
+STAT_Val MIDI_smf_merge_next(MIDI_SmfMerge * restrict merge, MIDI_SmfEvent * restrict event, size_t * track);
+
+#endif
@@ -0,0 +1,80 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_SMF_WRITER_H
+#define C_MIDI_SMF_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "encoder.h"
+#include "smf.h"
+
+#include <cfac/stat.h>
+
+// Room for the MThd chunk and the MTrk chunk header that are written on open, and for one event after that.
+#define MIDI_SMF_WRITER_MIN_BUFFER_SIZE                                                                                \
+  (2 * MIDI_SMF_CHUNK_HEADER_SIZE + MIDI_SMF_HEADER_LENGTH + MIDI_SMF_VLQ_MAX_SIZE + MIDI_ENCODER_MAX_MSG_SIZE)
+
+// Records timestamped messages to a format 0 Standard MIDI File as they come in. Events are collected in a buffer
+// supplied by the caller, which is only written out when full, so a bigger buffer means fewer system calls. The
+// length of the track is filled in by MIDI_smf_writer_close(), nothing else is kept around, so recording takes the
+// same memory no matter how long it goes on.
+typedef struct MIDI_SmfWriter {
+  int fd; // -1 once closed
+
+  uint8_t * buffer;
+  size_t    capacity;
+  size_t    len; // bytes in buffer that haven't been written yet
+
+  uint64_t     last_tick;
+  uint64_t     track_len; // bytes of track data so far, flushed or not
+  MIDI_Encoder encoder;   // running status
+
+  size_t num_writes; // write() calls so far, to see if the buffer is big enough
+} MIDI_SmfWriter;
+
+// Creates the file at path, or truncates it if it exists. division is the number of ticks per quarter note, or SMPTE
+// timing if the top bit is set. buffer has to hold at least MIDI_SMF_WRITER_MIN_BUFFER_SIZE bytes and outlive
+// writer.
+STAT_Val MIDI_smf_writer_open(MIDI_SmfWriter * restrict writer,
+                              const char *              path,
+                              uint16_t                  division,
+                              uint8_t *                 buffer,
+                              size_t                    capacity);
+
+// Adds a channel message at an absolute tick, ticks can't go back in time. Messages without a channel go to channel
+// 1. Real-time messages have no place in a file and are refused with STAT_ERR_ARGS, as are messages the encoder
+// can't encode. Nothing is written when an event is refused.
+STAT_Val MIDI_smf_writer_write(MIDI_SmfWriter * restrict writer, MIDI_SmfEvent event);
+// Same as MIDI_smf_writer_write() for n events, stops at the first one that's refused. The number of events written
+// goes into consumed.
+STAT_Val MIDI_smf_writer_write_events(MIDI_SmfWriter * restrict writer,
+                                      const MIDI_SmfEvent *     events,
+                                      size_t                    n,
+                                      size_t *                  consumed);
+
+// Writes what's left in the buffer, without finishing the file. The file can't be read until it's closed.
+STAT_Val MIDI_smf_writer_flush(MIDI_SmfWriter * restrict writer);
+
+// Ends the track, writes what's left, fills in the length of the track and closes the file. The file is closed even
+// when that fails.
+STAT_Val MIDI_smf_writer_close(MIDI_SmfWriter * restrict writer);
+
+#endif
@@ -0,0 +1,124 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_VOICE_H
+#define C_MIDI_VOICE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "channel_state.h"
+#include "message.h"
+
+#include <cfac/stat.h>
+
+#ifndef MIDI_VOICES_MAX
+#define MIDI_VOICES_MAX 64 // size of the voice pool built into every allocator, at most 254
+#endif
+
+_Static_assert(MIDI_VOICES_MAX > 0 && MIDI_VOICES_MAX < 0xff, "MIDI_VOICES_MAX must be 1-254");
+
+#define MIDI_VOICE_NONE 0xff
+
+// Which voice goes when a note comes in and none is free.
+typedef enum MIDI_StealPolicy {
+  MIDI_STEAL_OLDEST = 0, // the one started longest ago
+  MIDI_STEAL_QUIETEST,   // the one with the lowest velocity, the oldest of those
+  MIDI_STEAL_LOWEST,     // the one playing the lowest note
+  MIDI_STEAL_HIGHEST,    // the one playing the highest note
+} MIDI_StealPolicy;
+
+typedef enum MIDI_VoiceState {
+  MIDI_VOICE_FREE = 0,
+  MIDI_VOICE_ON,        // key down
+  MIDI_VOICE_SUSTAINED, // key up, held by the damper pedal
+} MIDI_VoiceState;
+
+typedef enum MIDI_VoiceEventType {
+  MIDI_VOICE_START,   // start playing note, on a voice that's still playing the same note this is a retrigger
+  MIDI_VOICE_RELEASE, // note was let go, the voice is free again once its release is over
+  MIDI_VOICE_KILL,    // stop playing note right away, the voice is stolen or all sound is off
+} MIDI_VoiceEventType;
+
+typedef struct MIDI_VoiceEvent {
+  uint8_t type; // MIDI_VoiceEventType
+  uint8_t voice;
+  uint8_t note;
+  uint8_t velocity; // for START
+} MIDI_VoiceEvent;
+
+typedef struct MIDI_VoiceList {
+  uint8_t head; // MIDI_VOICE_NONE if empty
+  uint8_t tail;
+} MIDI_VoiceList;
+
+// Voices are linked into lists through their own fields, so starting, releasing and stealing never search.
+typedef struct MIDI_Voice {
+  uint8_t note;
+  uint8_t velocity;
+  uint8_t state;    // MIDI_VoiceState
+  uint8_t prev;     // in the free list or the active list
+  uint8_t next;
+  uint8_t prev_vel; // in the list for its velocity, while active
+  uint8_t next_vel;
+} MIDI_Voice;
+
+// Maps the notes of one channel onto a fixed pool of voices. Released voices are reused in the order they were
+// released, so a voice gets as much time as possible for its release before it plays something else.
+typedef struct MIDI_VoiceAllocator {
+  MIDI_Channel channel; // messages on other channels are ignored, 0 takes messages from any channel
+  uint8_t      policy;  // MIDI_StealPolicy
+  uint8_t      num_voices;
+  bool         sustain; // damper pedal down
+
+  uint8_t        note_to_voice[MIDI_NUM_NOTES]; // MIDI_VOICE_NONE for notes without a voice
+  MIDI_NoteSet   notes;                         // notes with a voice
+  MIDI_NoteSet   velocities;                    // velocities that have a voice in by_velocity
+  MIDI_VoiceList free;                          // released longest ago first
+  MIDI_VoiceList active;                        // started longest ago first
+  MIDI_VoiceList by_velocity[128];              // started longest ago first
+  MIDI_Voice     voices[MIDI_VOICES_MAX];
+} MIDI_VoiceAllocator;
+
+STAT_Val MIDI_voice_init(MIDI_VoiceAllocator * restrict allocator,
+                         MIDI_Channel                   channel,
+                         size_t                         num_voices,
+                         MIDI_StealPolicy               policy);
+
+// Feeds a message and writes what the voices have to do to events, which needs room for num_voices + 1 of them, the
+// most a single message can cause. A note that is played again while it still has a voice goes to that same voice.
+// With the damper pedal (MIDI_CTRL_DAMPER_PEDAL_ON_OFF) down, note offs are held back until the pedal comes up.
+// ALL_NOTES_OFF (and the mode changes that imply it) counts as a note off for every note, ALL_SOUND_OFF kills every
+// voice, RESET_ALL_CONTROLLERS lifts the pedal.
+STAT_Val MIDI_voice_process(MIDI_VoiceAllocator * restrict allocator,
+                            MIDI_Message                   msg,
+                            MIDI_VoiceEvent * restrict     events,
+                            size_t                         max,
+                            size_t * restrict              num_events);
+
+static inline uint8_t MIDI_voice_of_note(const MIDI_VoiceAllocator * restrict allocator, uint8_t note) {
+  return allocator->note_to_voice[note & 0x7f];
+}
+
+static inline size_t MIDI_voice_num_active(const MIDI_VoiceAllocator * restrict allocator) {
+  return MIDI_note_set_count(&(allocator->notes));
+}
+
+#endif
@@ -0,0 +1,123 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "cc14.h"
+#include "held_msb.h"
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define NUM_CHANNELS 16
+
+static size_t slot_of(size_t channel_idx, uint8_t control) { return (channel_idx * MIDI_CC14_NUM_CONTROLS) + control; }
+
+static MIDI_ControlChange14 make_cc14(size_t channel_idx, uint8_t control, uint8_t msb, uint8_t lsb) {
+  return (MIDI_ControlChange14){
+      .channel = (uint8_t)(channel_idx + 1), .control = control, .value = (uint16_t)((msb << 7) | lsb)};
+}
+
+// emits held MSBs of any controller as they are, channel by channel
+static size_t emit_held(MIDI_Cc14Pairer * restrict pairer,
+                        MIDI_Timestamp             now,
+                        bool                       check_time,
+                        MIDI_ControlChange14 *     out,
+                        size_t                     max) {
+  size_t n = 0;
+
+  for(size_t ch = 0; ch < NUM_CHANNELS && n < max; ch++) {
+    uint8_t      controls[MIDI_CC14_NUM_CONTROLS];
+    const size_t room  = (max - n < MIDI_CC14_NUM_CONTROLS) ? max - n : MIDI_CC14_NUM_CONTROLS;
+    const size_t taken = MIDI_INT_held_msb_take(&(pairer->held[ch]), &(pairer->held_since[slot_of(ch, 0)]), check_time,
+                                                now, pairer->timeout, controls, room);
+
+    for(size_t i = 0; i < taken; i++) out[n++] = make_cc14(ch, controls[i], pairer->msb[slot_of(ch, controls[i])], 0);
+  }
+
+  return n;
+}
+
+STAT_Val MIDI_cc14_init(MIDI_Cc14Pairer * restrict pairer,
+                        uint32_t                   controls,
+                        MIDI_Cc14Mode              mode,
+                        MIDI_Timestamp             timeout) {
+  if(pairer == NULL) return LOG_STAT(STAT_ERR_ARGS, "pairer pointer is NULL");
+  if(mode != MIDI_CC14_WAIT_FOR_LSB && mode != MIDI_CC14_MSB_IMMEDIATE) {
+    return LOG_STAT(STAT_ERR_ARGS, "invalid mode %d", mode);
+  }
+
+  *pairer = (MIDI_Cc14Pairer){.controls = controls, .mode = mode, .timeout = timeout};
+
+  return OK;
+}
+
+MIDI_Cc14Result MIDI_cc14_process(MIDI_Cc14Pairer * restrict      pairer,
+                                  MIDI_Message                    msg,
+                                  MIDI_Timestamp                  now,
+                                  MIDI_ControlChange14 * restrict out) {
+  if(pairer == NULL || out == NULL) return MIDI_CC14_PASS;
+  if(msg.type != MIDI_MSG_TYPE_CONTROL_CHANGE || msg.channel < 1 || msg.channel > NUM_CHANNELS) return MIDI_CC14_PASS;
+
+  const size_t  ch      = msg.channel - 1;
+  const uint8_t value   = msg.data.control_change.value;
+  uint8_t       control = msg.data.control_change.control;
+
+  const bool is_msb = control < MIDI_CC14_NUM_CONTROLS;
+  if(!is_msb) {
+    if(control >= MIDI_CC14_LSB_OFFSET + MIDI_CC14_NUM_CONTROLS) return MIDI_CC14_PASS;
+    control -= MIDI_CC14_LSB_OFFSET;
+  }
+
+  const uint32_t bit = 1u << control;
+  if((pairer->controls & bit) == 0) return MIDI_CC14_PASS;
+
+  const size_t slot = slot_of(ch, control);
+
+  if(!is_msb) {
+    pairer->held[ch] &= ~bit;
+    *out = make_cc14(ch, control, pairer->msb[slot], value);
+    return MIDI_CC14_EMIT;
+  }
+
+  if(pairer->mode == MIDI_CC14_MSB_IMMEDIATE) {
+    pairer->msb[slot] = value;
+    *out              = make_cc14(ch, control, value, 0);
+    return MIDI_CC14_EMIT;
+  }
+
+  // the previous MSB never got its LSB, let it go as it is
+  const bool was_held = (pairer->held[ch] & bit) != 0;
+  if(was_held) *out = make_cc14(ch, control, pairer->msb[slot], 0);
+
+  pairer->msb[slot]        = value;
+  pairer->held_since[slot] = now;
+  pairer->held[ch] |= bit;
+
+  return was_held ? MIDI_CC14_EMIT : MIDI_CC14_HELD;
+}
+
+size_t MIDI_cc14_poll(MIDI_Cc14Pairer * restrict pairer, MIDI_Timestamp now, MIDI_ControlChange14 * out, size_t max) {
+  if(pairer == NULL || out == NULL || pairer->timeout == 0) return 0;
+  return emit_held(pairer, now, true, out, max);
+}
+
+size_t MIDI_cc14_flush(MIDI_Cc14Pairer * restrict pairer, MIDI_ControlChange14 * out, size_t max) {
+  if(pairer == NULL || out == NULL) return 0;
+  return emit_held(pairer, 0, false, out, max);
+}
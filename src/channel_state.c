@@ -0,0 +1,151 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "channel_state.h"
+
+#include <string.h>
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define RPN_NULL_VALUE 0x7f
+
+static void release_all(MIDI_ChannelState * restrict state) {
+  state->held = (MIDI_NoteSet){0};
+  memset(state->velocity, 0, sizeof(state->velocity));
+  memset(state->poly_pressure, 0, sizeof(state->poly_pressure));
+}
+
+static void reset_controllers(MIDI_ChannelState * restrict state) {
+  state->control[MIDI_CTRL_MOD_WHEEL]                       = 0;
+  state->control[MIDI_CTRL_MOD_WHEEL_LSB]                   = 0;
+  state->control[MIDI_CTRL_EXPRESSION]                      = 0x7f;
+  state->control[MIDI_CTRL_EXPRESSION_LSB]                  = 0;
+  state->control[MIDI_CTRL_DAMPER_PEDAL_ON_OFF]             = 0;
+  state->control[MIDI_CTRL_PORTAMENTO_ON_OFF]               = 0;
+  state->control[MIDI_CTRL_SOSTENUTO_PEDAL_ON_OFF]          = 0;
+  state->control[MIDI_CTRL_SOFT_PEDAL_ON_OFF]               = 0;
+  state->control[MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_LSB] = RPN_NULL_VALUE;
+  state->control[MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_MSB] = RPN_NULL_VALUE;
+  state->control[MIDI_CTRL_REGISTERED_PARAM_NUMBER_LSB]     = RPN_NULL_VALUE;
+  state->control[MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB]     = RPN_NULL_VALUE;
+
+  state->pitch_bend = 0;
+  state->pressure   = 0;
+  memset(state->poly_pressure, 0, sizeof(state->poly_pressure));
+}
+
+static void set_bit(uint64_t bits[2], size_t n) { bits[n >> 6] |= 1ull << (n & 63); }
+
+STAT_Val MIDI_channel_state_init(MIDI_ChannelState * restrict state, MIDI_Channel channel) {
+  if(state == NULL) return LOG_STAT(STAT_ERR_ARGS, "state pointer is NULL");
+  if(channel > 16) return LOG_STAT(STAT_ERR_ARGS, "invalid channel %d", channel);
+
+  *state = (MIDI_ChannelState){.channel = channel};
+  reset_controllers(state);
+
+  return OK;
+}
+
+bool MIDI_channel_state_process(MIDI_ChannelState * restrict state, MIDI_Message msg) {
+  if(state == NULL) return false;
+  if(state->channel != 0 && msg.channel != state->channel) return false;
+
+  switch(msg.type) {
+  case MIDI_MSG_TYPE_NOTE_ON:
+    if(msg.data.note_on.velocity > 0) {
+      const uint8_t note = msg.data.note_on.note & 0x7f;
+      set_bit(state->held.bits, note);
+      state->velocity[note] = msg.data.note_on.velocity;
+      return true;
+    }
+    // velocity 0 is a note off, when not fed by our own parser
+    msg.data.note_off = (MIDI_NoteOff){.note = msg.data.note_on.note};
+    // fall through
+  case MIDI_MSG_TYPE_NOTE_OFF: {
+    const uint8_t note = msg.data.note_off.note & 0x7f;
+    state->held.bits[note >> 6] &= ~(1ull << (note & 63));
+    state->velocity[note]      = 0;
+    state->poly_pressure[note] = 0;
+    return true;
+  }
+
+  case MIDI_MSG_TYPE_AFTERTOUCH_POLY: {
+    const uint8_t note = msg.data.aftertouch_poly.note & 0x7f;
+    if(!MIDI_note_set_contains(&(state->held), note)) return false;
+    state->poly_pressure[note] = msg.data.aftertouch_poly.value;
+    return true;
+  }
+
+  case MIDI_MSG_TYPE_AFTERTOUCH_MONO: state->pressure = msg.data.aftertouch_mono.value; return true;
+  case MIDI_MSG_TYPE_PITCH_BEND: state->pitch_bend = msg.data.pitch_bend.value; return true;
+
+  case MIDI_MSG_TYPE_CONTROL_CHANGE: {
+    const uint8_t control = msg.data.control_change.control & 0x7f;
+    switch(control) {
+    case MIDI_CTRL_RESET_ALL_CONTROLLERS: reset_controllers(state); return true;
+    case MIDI_CTRL_ALL_SOUND_OFF:
+    case MIDI_CTRL_ALL_NOTES_OFF:
+    case MIDI_CTRL_OMNI_MODE_ON:
+    case MIDI_CTRL_OMNI_MODE_OFF:
+    case MIDI_CTRL_MONO_MODE:
+    case MIDI_CTRL_POLY_MODE: release_all(state); return true;
+    case MIDI_CTRL_LOCAL_ON_OFF: return false;
+    default: state->control[control] = msg.data.control_change.value; return true;
+    }
+  }
+
+  default: return false;
+  }
+}
+
+bool MIDI_channel_state_diff(const MIDI_ChannelState * restrict old_state,
+                             const MIDI_ChannelState * restrict new_state,
+                             MIDI_ChannelStateDiff * restrict   diff) {
+  if(old_state == NULL || new_state == NULL || diff == NULL) return false;
+
+  *diff = (MIDI_ChannelStateDiff){
+      .pitch_bend = old_state->pitch_bend != new_state->pitch_bend,
+      .pressure   = old_state->pressure != new_state->pressure,
+  };
+
+  uint64_t any = diff->pitch_bend | diff->pressure;
+  for(size_t word = 0; word < 2; word++) {
+    diff->pressed.bits[word]  = new_state->held.bits[word] & ~old_state->held.bits[word];
+    diff->released.bits[word] = old_state->held.bits[word] & ~new_state->held.bits[word];
+    any |= diff->pressed.bits[word] | diff->released.bits[word];
+  }
+
+  // eight controllers at a time, most of them won't have changed
+  for(size_t i = 0; i < MIDI_NUM_CONTROLS; i += sizeof(uint64_t)) {
+    uint64_t old_word;
+    uint64_t new_word;
+    memcpy(&old_word, &(old_state->control[i]), sizeof(old_word));
+    memcpy(&new_word, &(new_state->control[i]), sizeof(new_word));
+    if(old_word == new_word) continue;
+
+    for(size_t j = i; j < i + sizeof(uint64_t); j++) {
+      if(old_state->control[j] != new_state->control[j]) set_bit(diff->controls, j);
+    }
+  }
+  any |= diff->controls[0] | diff->controls[1];
+
+  return any != 0;
+}
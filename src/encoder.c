@@ -0,0 +1,183 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "encoder.h"
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define STATUS_BIT 0x80 // 0b1000'0000
+
+static bool    is_valid_channel(MIDI_Channel channel) { return (channel >= 1) && (channel <= 16); }
+static bool    is_data(uint8_t value) { return (value & STATUS_BIT) == 0; }
+static uint8_t make_status(MIDI_MessageType type, MIDI_Channel channel) {
+  return (uint8_t)(STATUS_BIT | (MIDI_type_to_byte(type) << 4) | (channel - 1));
+}
+
+// Writes msg into out (which must have room for MIDI_ENCODER_MAX_MSG_SIZE bytes), returns the number of bytes written,
+// or 0 if the message can't be encoded.
+static size_t encode(MIDI_Encoder * restrict encoder, MIDI_Message msg, uint8_t * out) {
+  if(msg.type == MIDI_MSG_TYPE_MISC) {
+    // real-time messages are a single byte and leave running status alone, for the receiver as well as for us
+    if(!MIDI_is_real_time(msg.data.misc.status)) return 0;
+    out[0] = msg.data.misc.status;
+    return 1;
+  }
+
+  const MIDI_Channel channel = (msg.channel != 0) ? msg.channel : encoder->channel;
+  if(!is_valid_channel(channel)) return 0;
+
+  uint8_t type     = msg.type;
+  uint8_t data1    = 0;
+  uint8_t data2    = 0;
+  size_t  num_data = 2;
+
+  switch(msg.type) {
+  case MIDI_MSG_TYPE_NOTE_OFF:
+    data1 = msg.data.note_off.note;
+    data2 = msg.data.note_off.velocity;
+
+    // a note on with velocity 0 parses back to exactly this note off, and with running status it saves a byte
+    if(encoder->use_running_status && data2 == MIDI_NOTE_OFF_DEFAULT_VELOCITY &&
+       encoder->running_status == make_status(MIDI_MSG_TYPE_NOTE_ON, channel)) {
+      type  = MIDI_MSG_TYPE_NOTE_ON;
+      data2 = 0;
+    }
+    break;
+  case MIDI_MSG_TYPE_NOTE_ON:
+    data1 = msg.data.note_on.note;
+    data2 = msg.data.note_on.velocity;
+    if(data2 == 0) return 0; // would parse back as a note off
+    break;
+  case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+    data1 = msg.data.aftertouch_poly.note;
+    data2 = msg.data.aftertouch_poly.value;
+    break;
+  case MIDI_MSG_TYPE_CONTROL_CHANGE:
+    data1 = msg.data.control_change.control;
+    data2 = msg.data.control_change.value;
+    break;
+  case MIDI_MSG_TYPE_PROGRAM_CHANGE:
+    data1    = msg.data.program_change.program;
+    num_data = 1;
+    break;
+  case MIDI_MSG_TYPE_AFTERTOUCH_MONO:
+    data1    = msg.data.aftertouch_mono.value;
+    num_data = 1;
+    break;
+  case MIDI_MSG_TYPE_PITCH_BEND: {
+    if(msg.data.pitch_bend.value < -8192 || msg.data.pitch_bend.value > 8191) return 0;
+    const uint16_t value = (uint16_t)(msg.data.pitch_bend.value + 8192); // 14 bits, center at 8192
+    data1                = value & 0x7f;
+    data2                = (value >> 7) & 0x7f;
+    break;
+  }
+  default: return 0; // not a message we know how to encode
+  }
+
+  if(!is_data(data1) || !is_data(data2)) return 0;
+
+  const uint8_t status = make_status(type, channel);
+  size_t        len    = 0;
+
+  if(!encoder->use_running_status || status != encoder->running_status) out[len++] = status;
+  out[len++] = data1;
+  if(num_data == 2) out[len++] = data2;
+
+  encoder->running_status = encoder->use_running_status ? status : 0;
+
+  return len;
+}
+
+STAT_Val MIDI_encoder_init(MIDI_Encoder * restrict encoder, MIDI_Channel channel, bool use_running_status) {
+  if(encoder == NULL) return LOG_STAT(STAT_ERR_ARGS, "encoder pointer is NULL");
+  if(!is_valid_channel(channel)) return LOG_STAT(STAT_ERR_ARGS, "invalid channel %u", channel);
+
+  *encoder = (MIDI_Encoder){.channel = channel, .use_running_status = use_running_status, .running_status = 0};
+
+  return OK;
+}
+
+STAT_Val MIDI_encoder_reset(MIDI_Encoder * restrict encoder) {
+  if(encoder == NULL) return LOG_STAT(STAT_ERR_ARGS, "encoder pointer is NULL");
+
+  encoder->running_status = 0;
+
+  return OK;
+}
+
+STAT_Val MIDI_encode_msg(MIDI_Encoder * restrict encoder,
+                         MIDI_Message            msg,
+                         uint8_t *               out,
+                         size_t                  max_len,
+                         size_t *                written) {
+  size_t         consumed = 0;
+  const STAT_Val st       = MIDI_encode_msgs(encoder, &msg, 1, out, max_len, &consumed, written);
+  if(st != OK) return st;
+  if(consumed == 0) return LOG_STAT(STAT_ERR_RANGE, "no room for message in %zu bytes", max_len);
+
+  return OK;
+}
+
+STAT_Val MIDI_encode_msgs(MIDI_Encoder * restrict encoder,
+                          const MIDI_Message *    msgs,
+                          size_t                  n,
+                          uint8_t *               out,
+                          size_t                  max_len,
+                          size_t *                consumed,
+                          size_t *                written) {
+  if(encoder == NULL) return LOG_STAT(STAT_ERR_ARGS, "encoder pointer is NULL");
+  if(msgs == NULL && n > 0) return LOG_STAT(STAT_ERR_ARGS, "msgs pointer is NULL");
+  if(out == NULL && max_len > 0) return LOG_STAT(STAT_ERR_ARGS, "out pointer is NULL");
+  if(consumed == NULL) return LOG_STAT(STAT_ERR_ARGS, "consumed pointer is NULL");
+  if(written == NULL) return LOG_STAT(STAT_ERR_ARGS, "written pointer is NULL");
+
+  size_t msg_idx = 0;
+  size_t len     = 0;
+
+  for(; msg_idx < n; msg_idx++) {
+    // encode into scratch space when we're close to the end, so we never write partial messages
+    uint8_t            scratch[MIDI_ENCODER_MAX_MSG_SIZE];
+    const bool         use_scratch   = (max_len - len) < MIDI_ENCODER_MAX_MSG_SIZE;
+    const MIDI_Encoder encoder_saved = *encoder;
+
+    const size_t msg_len = encode(encoder, msgs[msg_idx], use_scratch ? scratch : &out[len]);
+    if(msg_len == 0) {
+      *consumed = msg_idx;
+      *written  = len;
+      return LOG_STAT(STAT_ERR_ARGS, "message %zu can't be encoded (type %u)", msg_idx, msgs[msg_idx].type);
+    }
+
+    if(use_scratch) {
+      if(msg_len > (max_len - len)) {
+        *encoder = encoder_saved; // didn't write it, so the running status didn't change either
+        break;
+      }
+      for(size_t i = 0; i < msg_len; i++) out[len + i] = scratch[i];
+    }
+
+    len += msg_len;
+  }
+
+  *consumed = msg_idx;
+  *written  = len;
+
+  return OK;
+}
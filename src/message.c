@@ -19,115 +19,512 @@
 
 #include "message.h"
 
-#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Formatting writes straight into the caller's buffer instead of going through snprintf. A "segment" stands in for
+// one snprintf call in a chain of `if(len < max_len) len += snprintf(&str[len], max_len - len, ...)`: it writes what
+// fits, NUL-terminates and counts its full length, so the output and return values are the same as with snprintf.
+typedef struct Writer {
+  char * str;
+  int    max_len;
+  int    len;
+} Writer;
+
+typedef struct Name {
+  const char * str;
+  uint8_t      len;
+} Name;
+
+#define CTRL_NAME(ctrl) [MIDI_CTRL_##ctrl] = {#ctrl, sizeof(#ctrl) - 1}
+
+// same names as MIDI_ctrl_to_str()
+static const Name ctrl_names[128] = {
+    CTRL_NAME(BANK_SELECT),
+    CTRL_NAME(MOD_WHEEL),
+    CTRL_NAME(BREATH_CONTROL),
+    CTRL_NAME(UNDEFINED3),
+    CTRL_NAME(FOOT_PEDAL),
+    CTRL_NAME(PORTAMENTO),
+    CTRL_NAME(DATA_ENTRY),
+    CTRL_NAME(VOLUME),
+    CTRL_NAME(BALANCE),
+    CTRL_NAME(UNDEFINED9),
+    CTRL_NAME(PAN),
+    CTRL_NAME(EXPRESSION),
+    CTRL_NAME(EFFECT1),
+    CTRL_NAME(EFFECT2),
+    CTRL_NAME(UNDEFINED14),
+    CTRL_NAME(UNDEFINED15),
+    CTRL_NAME(GENERAL_A),
+    CTRL_NAME(GENERAL_B),
+    CTRL_NAME(GENERAL_C),
+    CTRL_NAME(GENERAL_D),
+    CTRL_NAME(UNDEFINED20),
+    CTRL_NAME(UNDEFINED21),
+    CTRL_NAME(UNDEFINED22),
+    CTRL_NAME(UNDEFINED23),
+    CTRL_NAME(UNDEFINED24),
+    CTRL_NAME(UNDEFINED25),
+    CTRL_NAME(UNDEFINED26),
+    CTRL_NAME(UNDEFINED27),
+    CTRL_NAME(UNDEFINED28),
+    CTRL_NAME(UNDEFINED29),
+    CTRL_NAME(UNDEFINED30),
+    CTRL_NAME(UNDEFINED31),
+    CTRL_NAME(BANK_SELECT_LSB),
+    CTRL_NAME(MOD_WHEEL_LSB),
+    CTRL_NAME(BREATH_CONTROL_LSB),
+    CTRL_NAME(UNDEFINED35),
+    CTRL_NAME(FOOT_PEDAL_LSB),
+    CTRL_NAME(PORTAMENTO_LSB),
+    CTRL_NAME(DATA_ENTRY_LSB),
+    CTRL_NAME(VOLUME_LSB),
+    CTRL_NAME(BALANCE_LSB),
+    CTRL_NAME(UNDEFINED41),
+    CTRL_NAME(PAN_LSB),
+    CTRL_NAME(EXPRESSION_LSB),
+    CTRL_NAME(EFFECT1_LSB),
+    CTRL_NAME(EFFECT2_LSB),
+    CTRL_NAME(UNDEFINED46),
+    CTRL_NAME(UNDEFINED47),
+    CTRL_NAME(GENERAL_A_LSB),
+    CTRL_NAME(GENERAL_B_LSB),
+    CTRL_NAME(GENERAL_C_LSB),
+    CTRL_NAME(GENERAL_D_LSB),
+    CTRL_NAME(UNDEFINED52),
+    CTRL_NAME(UNDEFINED53),
+    CTRL_NAME(UNDEFINED54),
+    CTRL_NAME(UNDEFINED55),
+    CTRL_NAME(UNDEFINED56),
+    CTRL_NAME(UNDEFINED57),
+    CTRL_NAME(UNDEFINED58),
+    CTRL_NAME(UNDEFINED59),
+    CTRL_NAME(UNDEFINED60),
+    CTRL_NAME(UNDEFINED61),
+    CTRL_NAME(UNDEFINED62),
+    CTRL_NAME(UNDEFINED63),
+    CTRL_NAME(DAMPER_PEDAL_ON_OFF),
+    CTRL_NAME(PORTAMENTO_ON_OFF),
+    CTRL_NAME(SOSTENUTO_PEDAL_ON_OFF),
+    CTRL_NAME(SOFT_PEDAL_ON_OFF),
+    CTRL_NAME(LEGATO_ON_OFF),
+    CTRL_NAME(HOLD_ON_OFF),
+    CTRL_NAME(SOUND_VARIATION),
+    CTRL_NAME(RESONANCE),
+    CTRL_NAME(RELEASE_TIME),
+    CTRL_NAME(ATTACK_TIME),
+    CTRL_NAME(CUTOFF_FREQUENCY),
+    CTRL_NAME(SOUND_CONTROLLER6),
+    CTRL_NAME(SOUND_CONTROLLER7),
+    CTRL_NAME(SOUND_CONTROLLER8),
+    CTRL_NAME(SOUND_CONTROLLER9),
+    CTRL_NAME(SOUND_CONTROLLER10),
+    CTRL_NAME(GENERAL_E),
+    CTRL_NAME(GENERAL_F),
+    CTRL_NAME(GENERAL_G),
+    CTRL_NAME(GENERAL_H),
+    CTRL_NAME(PORTAMENTO_ALT),
+    CTRL_NAME(UNDEFINED85),
+    CTRL_NAME(UNDEFINED86),
+    CTRL_NAME(UNDEFINED87),
+    CTRL_NAME(VELOCITY_PREFIX),
+    CTRL_NAME(UNDEFINED89),
+    CTRL_NAME(UNDEFINED90),
+    CTRL_NAME(EFFECT3),
+    CTRL_NAME(EFFECT4),
+    CTRL_NAME(EFFECT5),
+    CTRL_NAME(EFFECT6),
+    CTRL_NAME(EFFECT7),
+    CTRL_NAME(DATA_INCREMENT),
+    CTRL_NAME(DATA_DECREMENT),
+    CTRL_NAME(NON_REGISTERED_PARAM_NUMBER_LSB),
+    CTRL_NAME(NON_REGISTERED_PARAM_NUMBER_MSB),
+    CTRL_NAME(REGISTERED_PARAM_NUMBER_LSB),
+    CTRL_NAME(REGISTERED_PARAM_NUMBER_MSB),
+    CTRL_NAME(UNDEFINED102),
+    CTRL_NAME(UNDEFINED103),
+    CTRL_NAME(UNDEFINED104),
+    CTRL_NAME(UNDEFINED105),
+    CTRL_NAME(UNDEFINED106),
+    CTRL_NAME(UNDEFINED107),
+    CTRL_NAME(UNDEFINED108),
+    CTRL_NAME(UNDEFINED109),
+    CTRL_NAME(UNDEFINED110),
+    CTRL_NAME(UNDEFINED111),
+    CTRL_NAME(UNDEFINED112),
+    CTRL_NAME(UNDEFINED113),
+    CTRL_NAME(UNDEFINED114),
+    CTRL_NAME(UNDEFINED115),
+    CTRL_NAME(UNDEFINED116),
+    CTRL_NAME(UNDEFINED117),
+    CTRL_NAME(UNDEFINED118),
+    CTRL_NAME(UNDEFINED119),
+    CTRL_NAME(ALL_SOUND_OFF),
+    CTRL_NAME(RESET_ALL_CONTROLLERS),
+    CTRL_NAME(LOCAL_ON_OFF),
+    CTRL_NAME(ALL_NOTES_OFF),
+    CTRL_NAME(OMNI_MODE_ON),
+    CTRL_NAME(OMNI_MODE_OFF),
+    CTRL_NAME(MONO_MODE),
+    CTRL_NAME(POLY_MODE),
+};
+
+static const Name ctrl_other_name = {"OTHER", sizeof("OTHER") - 1};
+
+#define PUT_LITERAL(w, literal) put_str((w), (literal), sizeof(literal) - 1)
+
+static Writer make_writer(char * str, int max_len) { return (Writer){.str = str, .max_len = max_len, .len = 0}; }
+static bool   has_room(const Writer * w) { return w->len < w->max_len; }
+
+static void put_str(Writer * w, const char * s, int n) {
+  const int room = w->max_len - 1 - w->len;
+  if(room > 0) memcpy(&(w->str[w->len]), s, (size_t)((n < room) ? n : room));
+  w->len += n;
+}
+
+static void put_uint(Writer * w, unsigned value) {
+  char digits[10];
+  int  n = sizeof(digits);
+  do {
+    digits[--n] = (char)('0' + (value % 10));
+    value /= 10;
+  } while(value > 0);
+  put_str(w, &digits[n], (int)sizeof(digits) - n);
+}
+
+static void put_int(Writer * w, int value) {
+  if(value < 0) {
+    PUT_LITERAL(w, "-");
+    put_uint(w, 0u - (unsigned)value);
+  } else {
+    put_uint(w, (unsigned)value);
+  }
+}
+
+static void put_ctrl(Writer * w, uint8_t ctrl) {
+  const Name name = ((ctrl < 128) && (ctrl_names[ctrl].str != NULL)) ? ctrl_names[ctrl] : ctrl_other_name;
+  put_str(w, name.str, name.len);
+}
+
+// closes a segment by terminating the string, like snprintf does
+static void end_segment(Writer * w) {
+  if(w->max_len > 0) w->str[(w->len < w->max_len) ? w->len : (w->max_len - 1)] = '\0';
+}
+
+static void put_note(Writer * w, uint8_t note) {
+  w->len += MIDI_note_to_str_buffer(&(w->str[w->len]), (size_t)(w->max_len - w->len), note);
+}
 
 int MIDI_note_off_msg_to_str_buffer(char * str, int max_len, MIDI_NoteOff msg) {
   if(str == NULL) return 0;
 
-  int len = 0;
-  if(len < max_len) len += snprintf(str, max_len, "MIDI_NoteOff{.note=");
+  Writer w = make_writer(str, max_len);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, "MIDI_NoteOff{.note=");
+    end_segment(&w);
+  }
 
-  if(len < max_len) len += MIDI_note_to_str_buffer(&str[len], (max_len - len), msg.note);
+  if(has_room(&w)) put_note(&w, msg.note);
 
-  if(len < max_len) len += snprintf(&str[len], (max_len - len), ", .velocity=%u}", msg.velocity);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, ", .velocity=");
+    put_uint(&w, msg.velocity);
+    PUT_LITERAL(&w, "}");
+    end_segment(&w);
+  }
 
-  return len;
+  return w.len;
 }
 
 int MIDI_note_on_msg_to_str_buffer(char * str, int max_len, MIDI_NoteOn msg) {
   if(str == NULL) return 0;
 
-  int len = 0;
-  if(len < max_len) len += snprintf(str, max_len, "MIDI_NoteOn{.note=");
+  Writer w = make_writer(str, max_len);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, "MIDI_NoteOn{.note=");
+    end_segment(&w);
+  }
 
-  if(len < max_len) len += MIDI_note_to_str_buffer(&str[len], (max_len - len), msg.note);
+  if(has_room(&w)) put_note(&w, msg.note);
 
-  if(len < max_len) len += snprintf(&str[len], (max_len - len), ", .velocity=%u}", msg.velocity);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, ", .velocity=");
+    put_uint(&w, msg.velocity);
+    PUT_LITERAL(&w, "}");
+    end_segment(&w);
+  }
 
-  return len;
+  return w.len;
+}
+
+int MIDI_aftertouch_poly_msg_to_str_buffer(char * str, int max_len, MIDI_AftertouchPoly msg) {
+  if(str == NULL) return 0;
+
+  Writer w = make_writer(str, max_len);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, "MIDI_AftertouchPoly{.note=");
+    end_segment(&w);
+  }
+
+  if(has_room(&w)) put_note(&w, msg.note);
+
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, ", .value=");
+    put_uint(&w, msg.value);
+    PUT_LITERAL(&w, "}");
+    end_segment(&w);
+  }
+
+  return w.len;
 }
 
 int MIDI_control_change_msg_to_str_buffer(char * str, int max_len, MIDI_ControlChange msg) {
   if(str == NULL) return 0;
 
-  return snprintf(str, max_len, "MIDI_ControlChange{.control=%s, .value=%u}", MIDI_ctrl_to_str(msg.control), msg.value);
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "MIDI_ControlChange{.control=");
+  put_ctrl(&w, msg.control);
+  PUT_LITERAL(&w, ", .value=");
+  put_uint(&w, msg.value);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
+}
+
+int MIDI_program_change_msg_to_str_buffer(char * str, int max_len, MIDI_ProgramChange msg) {
+  if(str == NULL) return 0;
+
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "MIDI_ProgramChange{.program=");
+  put_uint(&w, msg.program);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
+}
+
+int MIDI_aftertouch_mono_msg_to_str_buffer(char * str, int max_len, MIDI_AftertouchMono msg) {
+  if(str == NULL) return 0;
+
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "MIDI_AftertouchMono{.value=");
+  put_uint(&w, msg.value);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
 }
 
 int MIDI_pitch_bend_msg_to_str_buffer(char * str, int max_len, MIDI_PitchBend msg) {
   if(str == NULL) return 0;
 
-  return snprintf(str, max_len, "MIDI_PitchBend{.value=%d}", msg.value);
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "MIDI_PitchBend{.value=");
+  put_int(&w, msg.value);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
+}
+
+int MIDI_misc_msg_to_str_buffer(char * str, int max_len, MIDI_Misc msg) {
+  if(str == NULL) return 0;
+
+  const char * status_str = MIDI_real_time_to_str(msg.status);
+
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "MIDI_Misc{.status=");
+  put_str(&w, status_str, (int)strlen(status_str));
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
 }
 
 int MIDI_note_off_msg_to_str_buffer_short(char * str, int max_len, MIDI_NoteOff msg) {
   if(str == NULL) return 0;
 
-  int len = 0;
-  if(len < max_len) len += snprintf(str, max_len, "OFF{");
+  Writer w = make_writer(str, max_len);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, "OFF{");
+    end_segment(&w);
+  }
 
-  if(len < max_len) len += MIDI_note_to_str_buffer(&str[len], (max_len - len), msg.note);
+  if(has_room(&w)) put_note(&w, msg.note);
 
-  if(len < max_len) len += snprintf(&str[len], (max_len - len), ",%u}", msg.velocity);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, ",");
+    put_uint(&w, msg.velocity);
+    PUT_LITERAL(&w, "}");
+    end_segment(&w);
+  }
 
-  return len;
+  return w.len;
 }
 
 int MIDI_note_on_msg_to_str_buffer_short(char * str, int max_len, MIDI_NoteOn msg) {
   if(str == NULL) return 0;
 
-  int len = 0;
-  if(len < max_len) len += snprintf(str, max_len, "ON{");
+  Writer w = make_writer(str, max_len);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, "ON{");
+    end_segment(&w);
+  }
 
-  if(len < max_len) len += MIDI_note_to_str_buffer(&str[len], (max_len - len), msg.note);
+  if(has_room(&w)) put_note(&w, msg.note);
 
-  if(len < max_len) len += snprintf(&str[len], (max_len - len), ",%u}", msg.velocity);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, ",");
+    put_uint(&w, msg.velocity);
+    PUT_LITERAL(&w, "}");
+    end_segment(&w);
+  }
 
-  return len;
+  return w.len;
+}
+
+int MIDI_aftertouch_poly_msg_to_str_buffer_short(char * str, int max_len, MIDI_AftertouchPoly msg) {
+  if(str == NULL) return 0;
+
+  Writer w = make_writer(str, max_len);
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, "PAT{");
+    end_segment(&w);
+  }
+
+  if(has_room(&w)) put_note(&w, msg.note);
+
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, ",");
+    put_uint(&w, msg.value);
+    PUT_LITERAL(&w, "}");
+    end_segment(&w);
+  }
+
+  return w.len;
 }
 
 int MIDI_control_change_msg_to_str_buffer_short(char * str, int max_len, MIDI_ControlChange msg) {
   if(str == NULL) return 0;
 
-  return snprintf(str, max_len, "CC{%s,%u}", MIDI_ctrl_to_str(msg.control), msg.value);
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "CC{");
+  put_ctrl(&w, msg.control);
+  PUT_LITERAL(&w, ",");
+  put_uint(&w, msg.value);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
+}
+
+int MIDI_program_change_msg_to_str_buffer_short(char * str, int max_len, MIDI_ProgramChange msg) {
+  if(str == NULL) return 0;
+
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "PC{");
+  put_uint(&w, msg.program);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
+}
+
+int MIDI_aftertouch_mono_msg_to_str_buffer_short(char * str, int max_len, MIDI_AftertouchMono msg) {
+  if(str == NULL) return 0;
+
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "AT{");
+  put_uint(&w, msg.value);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
 }
 
 int MIDI_pitch_bend_msg_to_str_buffer_short(char * str, int max_len, MIDI_PitchBend msg) {
   if(str == NULL) return 0;
 
-  return snprintf(str, max_len, "PB{%d}", msg.value);
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "PB{");
+  put_int(&w, msg.value);
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
+}
+
+int MIDI_misc_msg_to_str_buffer_short(char * str, int max_len, MIDI_Misc msg) {
+  if(str == NULL) return 0;
+
+  const char * status_str = MIDI_real_time_to_str(msg.status);
+
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "MISC{");
+  put_str(&w, status_str, (int)strlen(status_str));
+  PUT_LITERAL(&w, "}");
+  end_segment(&w);
+
+  return w.len;
+}
+
+// "??" for message types we can't format
+static int unknown_msg_to_str_buffer(char * str, int max_len) {
+  Writer w = make_writer(str, max_len);
+  PUT_LITERAL(&w, "??");
+  end_segment(&w);
+
+  return w.len;
 }
 
 int MIDI_message_to_str_buffer(char * str, int max_len, MIDI_Message msg) {
   if(str == NULL) return 0;
 
-  int len = 0;
+  Writer w = make_writer(str, max_len);
+
+  if(has_room(&w)) {
+    const char * type_str = MIDI_message_type_to_str(msg.type);
+    PUT_LITERAL(&w, "MIDI_Message{.type=");
+    put_str(&w, type_str, (int)strlen(type_str));
+    PUT_LITERAL(&w, ", .data=");
+    end_segment(&w);
+  }
 
-  if(len < max_len) len += snprintf(str, max_len, "MIDI_Message{.type=%s, .data=", MIDI_message_type_to_str(msg.type));
+  if(has_room(&w)) {
+    char *    rest     = &str[w.len];
+    const int rest_len = max_len - w.len;
 
-  if(len < max_len) {
     switch(msg.type) {
-    case MIDI_MSG_TYPE_NOTE_OFF:
-      len += MIDI_note_off_msg_to_str_buffer(&str[len], (max_len - len), msg.data.note_off);
-      break;
-    case MIDI_MSG_TYPE_NOTE_ON:
-      len += MIDI_note_on_msg_to_str_buffer(&str[len], (max_len - len), msg.data.note_on);
+    case MIDI_MSG_TYPE_NOTE_OFF: w.len += MIDI_note_off_msg_to_str_buffer(rest, rest_len, msg.data.note_off); break;
+    case MIDI_MSG_TYPE_NOTE_ON: w.len += MIDI_note_on_msg_to_str_buffer(rest, rest_len, msg.data.note_on); break;
+    case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+      w.len += MIDI_aftertouch_poly_msg_to_str_buffer(rest, rest_len, msg.data.aftertouch_poly);
       break;
-    case MIDI_MSG_TYPE_AFTERTOUCH_POLY: len += snprintf(&str[len], (max_len - len), "??"); break;
     case MIDI_MSG_TYPE_CONTROL_CHANGE:
-      len += MIDI_control_change_msg_to_str_buffer(&str[len], (max_len - len), msg.data.control_change);
+      w.len += MIDI_control_change_msg_to_str_buffer(rest, rest_len, msg.data.control_change);
+      break;
+    case MIDI_MSG_TYPE_PROGRAM_CHANGE:
+      w.len += MIDI_program_change_msg_to_str_buffer(rest, rest_len, msg.data.program_change);
+      break;
+    case MIDI_MSG_TYPE_AFTERTOUCH_MONO:
+      w.len += MIDI_aftertouch_mono_msg_to_str_buffer(rest, rest_len, msg.data.aftertouch_mono);
       break;
-    case MIDI_MSG_TYPE_PROGRAM_CHANGE: len += snprintf(&str[len], (max_len - len), "??"); break;
-    case MIDI_MSG_TYPE_AFTERTOUCH_MONO: len += snprintf(&str[len], (max_len - len), "??"); break;
     case MIDI_MSG_TYPE_PITCH_BEND:
-      len += MIDI_pitch_bend_msg_to_str_buffer(&str[len], (max_len - len), msg.data.pitch_bend);
+      w.len += MIDI_pitch_bend_msg_to_str_buffer(rest, rest_len, msg.data.pitch_bend);
       break;
-    case MIDI_MSG_TYPE_MISC: len += snprintf(&str[len], (max_len - len), "??"); break;
+    case MIDI_MSG_TYPE_MISC: w.len += MIDI_misc_msg_to_str_buffer(rest, rest_len, msg.data.misc); break;
+    default: w.len += unknown_msg_to_str_buffer(rest, rest_len); break;
     }
   }
 
-  if(len < max_len) len += snprintf(&str[len], (max_len - len), "}");
+  if(has_room(&w)) {
+    PUT_LITERAL(&w, "}");
+    end_segment(&w);
+  }
 
-  return len;
+  return w.len;
 }
 
 int MIDI_message_to_str_buffer_short(char * str, int max_len, MIDI_Message msg) {
@@ -143,18 +540,53 @@ int MIDI_message_to_str_buffer_short(char * str, int max_len, MIDI_Message msg)
     case MIDI_MSG_TYPE_NOTE_ON:
       len += MIDI_note_on_msg_to_str_buffer_short(&str[len], (max_len - len), msg.data.note_on);
       break;
-    case MIDI_MSG_TYPE_AFTERTOUCH_POLY: len += snprintf(&str[len], (max_len - len), "??"); break;
+    case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+      len += MIDI_aftertouch_poly_msg_to_str_buffer_short(&str[len], (max_len - len), msg.data.aftertouch_poly);
+      break;
     case MIDI_MSG_TYPE_CONTROL_CHANGE:
       len += MIDI_control_change_msg_to_str_buffer_short(&str[len], (max_len - len), msg.data.control_change);
       break;
-    case MIDI_MSG_TYPE_PROGRAM_CHANGE: len += snprintf(&str[len], (max_len - len), "??"); break;
-    case MIDI_MSG_TYPE_AFTERTOUCH_MONO: len += snprintf(&str[len], (max_len - len), "??"); break;
+    case MIDI_MSG_TYPE_PROGRAM_CHANGE:
+      len += MIDI_program_change_msg_to_str_buffer_short(&str[len], (max_len - len), msg.data.program_change);
+      break;
+    case MIDI_MSG_TYPE_AFTERTOUCH_MONO:
+      len += MIDI_aftertouch_mono_msg_to_str_buffer_short(&str[len], (max_len - len), msg.data.aftertouch_mono);
+      break;
     case MIDI_MSG_TYPE_PITCH_BEND:
       len += MIDI_pitch_bend_msg_to_str_buffer_short(&str[len], (max_len - len), msg.data.pitch_bend);
       break;
-    case MIDI_MSG_TYPE_MISC: len += snprintf(&str[len], (max_len - len), "??"); break;
+    case MIDI_MSG_TYPE_MISC: len += MIDI_misc_msg_to_str_buffer_short(&str[len], (max_len - len), msg.data.misc); break;
+    default: len += unknown_msg_to_str_buffer(&str[len], (max_len - len)); break;
     }
   }
 
   return len;
 }
+
+typedef int (*MessageToStrFn)(char * str, int max_len, MIDI_Message msg);
+
+static int messages_to_str_buffer(char * str, int max_len, const MIDI_Message * msgs, size_t n, MessageToStrFn fn) {
+  if(str == NULL) return 0;
+  if(msgs == NULL) return 0;
+
+  Writer w = make_writer(str, max_len);
+
+  for(size_t i = 0; i < n && has_room(&w); i++) {
+    w.len += fn(&str[w.len], max_len - w.len, msgs[i]);
+
+    if(has_room(&w)) {
+      PUT_LITERAL(&w, "\n");
+      end_segment(&w);
+    }
+  }
+
+  return w.len;
+}
+
+int MIDI_messages_to_str_buffer(char * str, int max_len, const MIDI_Message * msgs, size_t n) {
+  return messages_to_str_buffer(str, max_len, msgs, n, MIDI_message_to_str_buffer);
+}
+
+int MIDI_messages_to_str_buffer_short(char * str, int max_len, const MIDI_Message * msgs, size_t n) {
+  return messages_to_str_buffer(str, max_len, msgs, n, MIDI_message_to_str_buffer_short);
+}
@@ -0,0 +1,42 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "msg_queue.h"
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+static bool is_power_of_two(size_t n) { return (n != 0) && ((n & (n - 1)) == 0); }
+
+STAT_Val MIDI_msg_queue_init(MIDI_MsgQueue * restrict queue, MIDI_Message * storage, size_t capacity) {
+  if(queue == NULL) return LOG_STAT(STAT_ERR_ARGS, "queue pointer is NULL");
+  if(storage == NULL) return LOG_STAT(STAT_ERR_ARGS, "storage pointer is NULL");
+  if(!is_power_of_two(capacity)) return LOG_STAT(STAT_ERR_ARGS, "capacity %zu is not a power of two", capacity);
+
+  atomic_init(&(queue->end_idx), 0);
+  atomic_init(&(queue->begin_idx), 0);
+  queue->cached_begin_idx = 0;
+  queue->cached_end_idx   = 0;
+
+  queue->data = storage;
+  queue->mask = capacity - 1;
+
+  return OK;
+}
@@ -19,10 +19,49 @@
 
 #include "note.h"
 #include <stdio.h>
+#include <string.h>
+
+typedef struct NoteName {
+  const char * str;
+  uint8_t      len;
+} NoteName;
+
+#define NOTE_NAME(name, octave) {name #octave, sizeof(name #octave) - 1}
+#define OCTAVE_NAMES_TO_G(octave)                                                                                      \
+  NOTE_NAME("C", octave), NOTE_NAME("Db", octave), NOTE_NAME("D", octave), NOTE_NAME("Eb", octave),                    \
+      NOTE_NAME("E", octave), NOTE_NAME("F", octave), NOTE_NAME("Gb", octave), NOTE_NAME("G", octave)
+#define OCTAVE_NAMES(octave)                                                                                           \
+  OCTAVE_NAMES_TO_G(octave), NOTE_NAME("Ab", octave), NOTE_NAME("A", octave), NOTE_NAME("Bb", octave),                 \
+      NOTE_NAME("B", octave)
+
+// names of all notes, same as "%s%d" with MIDI_note_get_note_only_str() and MIDI_note_get_octave()
+static const NoteName note_names[MIDI_NOTE_END] = {
+    OCTAVE_NAMES(-1),
+    OCTAVE_NAMES(0),
+    OCTAVE_NAMES(1),
+    OCTAVE_NAMES(2),
+    OCTAVE_NAMES(3),
+    OCTAVE_NAMES(4),
+    OCTAVE_NAMES(5),
+    OCTAVE_NAMES(6),
+    OCTAVE_NAMES(7),
+    OCTAVE_NAMES(8),
+    OCTAVE_NAMES_TO_G(9),
+};
 
 int MIDI_note_to_str_buffer(char * str, size_t max_len, MIDI_Note n) {
   if(str == NULL) return 0;
   if(max_len == 0) return 0;
 
-  return snprintf(str, max_len, "%s%d", MIDI_note_get_note_only_str(n), MIDI_note_get_octave(n));
+  if((unsigned)n >= MIDI_NOTE_END) {
+    return snprintf(str, max_len, "%s%d", MIDI_note_get_note_only_str(n), MIDI_note_get_octave(n));
+  }
+
+  // copy what fits and terminate, just like snprintf would
+  const NoteName name     = note_names[n];
+  const size_t   copy_len = (name.len < max_len) ? name.len : (max_len - 1);
+  memcpy(str, name.str, copy_len);
+  str[copy_len] = '\0';
+
+  return name.len;
 }
\ No newline at end of file
@@ -23,7 +23,11 @@
 
 #define OK STAT_OK
 
-#define NOTE_OFF_DEFAULT_VELOCITY 63
+#ifdef MIDI_PARSER_STATS
+#define STATS_ADD(parser, counter, n) ((parser)->stats.counter += (n))
+#else
+#define STATS_ADD(parser, counter, n) ((void)0)
+#endif
 
 typedef enum State {
   ST_INIT,
@@ -31,14 +35,72 @@ typedef enum State {
   ST_NOTE_ON_WITH_VALID_NOTE,
   ST_RUNNING_NOTE_OFF,
   ST_NOTE_OFF_WITH_VALID_NOTE,
+  ST_RUNNING_AFTERTOUCH_POLY,
+  ST_AFTERTOUCH_POLY_WITH_VALID_NOTE,
   ST_RUNNING_CONTROL_CHANGE,
   ST_CONTROL_CHANGE_WITH_VALID_CONTROL,
+  ST_RUNNING_PROGRAM_CHANGE, // single data byte messages don't need a second state
+  ST_RUNNING_AFTERTOUCH_MONO,
   ST_RUNNING_PITCH_BEND,
-  ST_PITCH_BEND_WITH_VALID_LSB
+  ST_PITCH_BEND_WITH_VALID_LSB,
+  ST_SYSEX, // in the middle of a SysEx dump, data bytes are payload
+  ST_COUNT
 } State;
 
-static bool    is_supported(uint8_t byte);
-static uint8_t channel_to_byte(MIDI_Channel channel);
+// byte classes and actions for the table-driven engine, see parse_table()
+typedef enum ByteClass {
+  // classes of status bytes that are subject to the channel check come first, see is_channel_status_class()
+  BC_NOTE_OFF,
+  BC_NOTE_ON,
+  BC_AFTERTOUCH_POLY,
+  BC_CONTROL_CHANGE,
+  BC_PROGRAM_CHANGE,
+  BC_AFTERTOUCH_MONO,
+  BC_PITCH_BEND,
+
+  BC_DATA,
+  BC_REAL_TIME,
+  BC_IGNORED, // undefined bytes in the real-time range
+  BC_SYSEX_START,
+  BC_SYSEX_END,
+  BC_SYSTEM_COMMON,
+  BC_OTHER_CHANNEL,
+  BC_COUNT
+} ByteClass;
+
+typedef enum Action {
+  AC_NONE,
+  AC_SET_CHANNEL,
+  AC_STORE_DATA_BYTE,
+  AC_EMIT_NOTE_OFF,
+  AC_EMIT_NOTE_ON,
+  AC_EMIT_AFTERTOUCH_POLY,
+  AC_EMIT_CONTROL_CHANGE,
+  AC_EMIT_PROGRAM_CHANGE,
+  AC_EMIT_AFTERTOUCH_MONO,
+  AC_EMIT_PITCH_BEND,
+  AC_EMIT_REAL_TIME,
+  AC_SYSEX_START,
+  AC_SYSEX_RESTART, // abort the dump in progress and start a new one
+  AC_SYSEX_DATA,
+  AC_SYSEX_END,
+  AC_SYSEX_ABORT,
+  AC_SYSEX_ABORT_SET_CHANNEL,
+} Action;
+
+enum {
+  STATUS_SYSEX_START = 0xf0,
+  STATUS_SYSEX_END   = 0xf7,
+};
+
+typedef struct Transition {
+  uint8_t next_state; // State
+  uint8_t action;     // Action
+} Transition;
+
+typedef State (*ParseFn)(MIDI_Parser * restrict parser, State state, uint8_t byte);
+
+static uint8_t byte_to_channel(uint8_t byte);
 static uint8_t get_status_bit(uint8_t byte);
 static uint8_t get_type_bits(uint8_t byte);
 static uint8_t get_channel_bits(uint8_t byte);
@@ -46,14 +108,51 @@ static bool    is_status(uint8_t byte);
 static bool    is_of_type(uint8_t byte, MIDI_MessageType type);
 static bool    is_note_on(uint8_t byte);
 static bool    is_note_off(uint8_t byte);
+static bool    is_aftertouch_poly(uint8_t byte);
 static bool    is_control_change(uint8_t byte);
+static bool    is_program_change(uint8_t byte);
+static bool    is_aftertouch_mono(uint8_t byte);
 static bool    is_pitch_bend(uint8_t byte);
-static bool    is_on_channel(uint8_t byte, MIDI_Channel channel);
+static bool    is_in_channel_mask(uint8_t byte, uint16_t channel_mask);
 static bool    is_data_byte(uint8_t byte);
+static bool    is_system_common(uint8_t byte);
+static size_t  data_run_length(const uint8_t * bytes, size_t n);
 
 static int16_t make_pitch_bend_value(uint8_t lsb, uint8_t high_byte);
 
-static void buff_init(MIDI_MsgBuffer * restrict buffer) { *buffer = (MIDI_MsgBuffer){0}; }
+static void emit(MIDI_Parser * restrict parser, MIDI_Message msg);
+static void emit_real_time(MIDI_Parser * restrict parser, uint8_t byte);
+
+static void sysex_start(MIDI_Parser * restrict parser);
+static void sysex_data(MIDI_Parser * restrict parser, const uint8_t * data, size_t len);
+static void sysex_finish(MIDI_Parser * restrict parser, MIDI_SysExEvent event);
+
+static State parse(MIDI_Parser * restrict parser, State state, uint8_t byte);
+static State parse_switch(MIDI_Parser * restrict parser, State state, uint8_t byte);
+static State parse_table(MIDI_Parser * restrict parser, State state, uint8_t byte);
+#ifdef MIDI_PARSER_STATS
+static void count_byte(MIDI_Parser * restrict parser, State state, ByteClass byte_class);
+#endif
+
+static STAT_Val parse_bytes_with(MIDI_Parser * restrict parser,
+                                 const uint8_t * bytes,
+                                 size_t          n,
+                                 size_t *        consumed,
+                                 ParseFn         parse_fn);
+static STAT_Val parse_bytes_timed(MIDI_Parser * restrict   parser,
+                                  const uint8_t *        bytes,
+                                  const MIDI_Timestamp * timestamps,
+                                  size_t                 n,
+                                  MIDI_Timestamp         first,
+                                  MIDI_Timestamp         last,
+                                  size_t *               consumed);
+
+static void buff_init(MIDI_MsgBuffer * restrict buffer) {
+  *buffer = (MIDI_MsgBuffer){.data = NULL, .mask = MIDI_OUT_BUFFER_SIZE - 1, .overflow_policy = MIDI_OVERFLOW_REJECT};
+}
+
+static bool is_power_of_two(size_t n) { return (n != 0) && ((n & (n - 1)) == 0); }
+static bool is_coalescable(MIDI_Message buffered, MIDI_Message msg);
 
 STAT_Val MIDI_parser_init(MIDI_Parser * restrict parser, MIDI_Channel channel) {
   if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
@@ -62,41 +161,393 @@ STAT_Val MIDI_parser_init(MIDI_Parser * restrict parser, MIDI_Channel channel) {
   *parser = (MIDI_Parser){0};
   buff_init(&(parser->msg_buffer));
 
-  parser->channel = channel;
-  parser->state   = ST_INIT;
+  parser->channel         = channel;
+  parser->channel_mask    = MIDI_channel_to_mask(channel);
+  parser->current_channel = channel;
+  parser->state           = ST_INIT;
+
+  return OK;
+}
+
+STAT_Val MIDI_parser_init_omni(MIDI_Parser * restrict parser, uint16_t channel_mask) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+
+  *parser = (MIDI_Parser){0};
+  buff_init(&(parser->msg_buffer));
+
+  parser->channel      = MIDI_CHANNEL_OMNI;
+  parser->channel_mask = channel_mask;
+  parser->state        = ST_INIT;
+
+  return OK;
+}
+
+STAT_Val MIDI_parser_set_channel_mask(MIDI_Parser * restrict parser, uint16_t channel_mask) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+  if(parser->channel != MIDI_CHANNEL_OMNI) return LOG_STAT(STAT_ERR_PRECONDITION, "parser is not in omni mode");
+
+  parser->channel_mask = channel_mask;
+
+  // whatever we were in the middle of may now be on a channel we should ignore, wait for the next status byte
+  if(parser->state == ST_SYSEX) sysex_finish(parser, MIDI_SYSEX_ABORT);
+  parser->state = ST_INIT;
+
+  return OK;
+}
+
+STAT_Val MIDI_parser_set_buffer(MIDI_Parser * restrict parser, MIDI_Message * storage, size_t capacity) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+  if(storage == NULL) return LOG_STAT(STAT_ERR_ARGS, "storage pointer is NULL");
+  if(!is_power_of_two(capacity) || capacity > ((size_t)1 << 31)) {
+    return LOG_STAT(STAT_ERR_ARGS, "invalid capacity %zu, should be a power of two", capacity);
+  }
+  if(!MIDI_INT_buff_is_empty(&(parser->msg_buffer))) return LOG_STAT(STAT_ERR_PRECONDITION, "buffer not empty");
+
+  parser->msg_buffer.data       = storage;
+  parser->msg_buffer.mask       = (uint32_t)(capacity - 1);
+  parser->msg_buffer.begin_idx  = 0;
+  parser->msg_buffer.end_idx    = 0;
+  parser->msg_buffer.timestamps = NULL;
+
+  return OK;
+}
+
+STAT_Val MIDI_parser_set_timestamp_buffer(MIDI_Parser * restrict parser, MIDI_Timestamp * storage, size_t capacity) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+  if(storage != NULL && capacity != MIDI_INT_buff_capacity(&(parser->msg_buffer))) {
+    return LOG_STAT(STAT_ERR_ARGS,
+                    "capacity %zu doesn't match the message buffer's %zu",
+                    capacity,
+                    MIDI_INT_buff_capacity(&(parser->msg_buffer)));
+  }
+  if(!MIDI_INT_buff_is_empty(&(parser->msg_buffer))) return LOG_STAT(STAT_ERR_PRECONDITION, "buffer not empty");
+
+  parser->msg_buffer.timestamps = storage;
+
+  return OK;
+}
+
+STAT_Val MIDI_parser_set_overflow_policy(MIDI_Parser * restrict parser, MIDI_OverflowPolicy policy) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+  switch(policy) {
+  case MIDI_OVERFLOW_REJECT:
+  case MIDI_OVERFLOW_DROP_OLDEST:
+  case MIDI_OVERFLOW_DROP_NEWEST:
+  case MIDI_OVERFLOW_COALESCE: break;
+  default: return LOG_STAT(STAT_ERR_ARGS, "invalid overflow policy %d", policy);
+  }
+
+  parser->msg_buffer.overflow_policy = policy;
+
+  return OK;
+}
+
+STAT_Val MIDI_parser_get_stats(MIDI_Parser * restrict parser, MIDI_ParserStats * stats, bool reset) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+  if(stats == NULL) return LOG_STAT(STAT_ERR_ARGS, "stats pointer is NULL");
+
+#ifdef MIDI_PARSER_STATS
+  MIDI_MsgBuffer * buffer = &(parser->msg_buffer);
+
+  *stats                   = parser->stats;
+  stats->overwritten       = buffer->overwritten_count;
+  stats->buffer_high_water = buffer->high_water;
+
+  if(reset) {
+    parser->stats             = (MIDI_ParserStats){0};
+    buffer->overwritten_count = 0;
+    buffer->high_water        = (uint32_t)MIDI_INT_buff_count(buffer);
+  }
+
+  return OK;
+#else
+  (void)reset;
+  *stats = (MIDI_ParserStats){0};
+  return LOG_STAT(STAT_ERR_PRECONDITION, "built without MIDI_PARSER_STATS");
+#endif
+}
+
+STAT_Val MIDI_parser_set_sysex_callback(MIDI_Parser * restrict parser, MIDI_SysExCallback callback, void * context) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+
+  parser->sysex_callback = callback;
+  parser->sysex_context  = context;
 
   return OK;
 }
 
+bool MIDI_INT_buff_push_overflow(MIDI_MsgBuffer * restrict buffer, MIDI_Message msg) {
+  MIDI_Message * data = MIDI_INT_buff_data(buffer);
+
+  buffer->dropped_count++;
+
+  switch((MIDI_OverflowPolicy)buffer->overflow_policy) {
+  case MIDI_OVERFLOW_COALESCE: {
+    // Only the last message on the channel may be overwritten. Were there a later one on the same channel, the new
+    // value would end up ahead of it, e.g. a note would start with a bend that only came after it. Messages on other
+    // channels don't depend on it. That makes the last message on the channel the only candidate, nothing to search.
+    // With timestamps it also takes the new time, which is only in order if nothing at all was buffered after it.
+    const uint32_t last        = buffer->last_idx[msg.channel & (MIDI_INT_BUFF_CHANNELS - 1)];
+    const bool     is_buffered = (last - buffer->begin_idx) < (buffer->end_idx - buffer->begin_idx);
+    const bool     is_in_order = (buffer->timestamps == NULL) || (last == buffer->end_idx - 1);
+    if(is_buffered && is_in_order && is_coalescable(data[last & buffer->mask], msg)) {
+#ifdef MIDI_PARSER_STATS
+      buffer->overwritten_count++;
+#endif
+      data[last & buffer->mask] = msg;
+      if(buffer->timestamps != NULL) buffer->timestamps[last & buffer->mask] = buffer->now;
+      return true;
+    }
+    // nothing to coalesce with, fall back to dropping the oldest
+  }
+  // fall through
+  case MIDI_OVERFLOW_DROP_OLDEST: {
+#ifdef MIDI_PARSER_STATS
+    buffer->overwritten_count++;
+#endif
+    buffer->begin_idx++;
+    const uint32_t end = buffer->end_idx++;
+    const uint32_t idx = end & buffer->mask;
+
+    data[idx]                                                    = msg;
+    buffer->last_idx[msg.channel & (MIDI_INT_BUFF_CHANNELS - 1)] = end;
+    if(buffer->timestamps != NULL) buffer->timestamps[idx] = buffer->now;
+    return true;
+  }
+  case MIDI_OVERFLOW_REJECT:
+  case MIDI_OVERFLOW_DROP_NEWEST: return false;
+  }
+
+  return false;
+}
+
 STAT_Val MIDI_parse_byte(MIDI_Parser * restrict parser, uint8_t byte) {
   if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
   if(!MIDI_parser_is_ready(parser)) return LOG_STAT(STAT_ERR_PRECONDITION, "parser not ready");
-  if(!is_supported(byte)) return OK; // silently skip unsupported bytes
 
-  if(is_status(byte) && !is_on_channel(byte, parser->channel)) {
-    // regardless of what state we're in, if we get a message for another channel, we reset to init, as a new status
-    // message must come in to indicate we're back on the correct channel
-    parser->state = ST_INIT;
-    return OK;
+  parser->state = parse(parser, parser->state, byte);
+  STATS_ADD(parser, bytes, 1);
+
+  return OK;
+}
+
+STAT_Val MIDI_parse_bytes(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed) {
+  return parse_bytes_with(parser, bytes, n, consumed, parse);
+}
+
+STAT_Val MIDI_parse_byte_timed(MIDI_Parser * restrict parser, uint8_t byte, MIDI_Timestamp timestamp) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+
+  parser->msg_buffer.now = timestamp;
+
+  return MIDI_parse_byte(parser, byte);
+}
+
+STAT_Val MIDI_parse_bytes_timed(MIDI_Parser * restrict parser,
+                                const uint8_t *        bytes,
+                                const MIDI_Timestamp * timestamps,
+                                size_t                 n,
+                                size_t *               consumed) {
+  if(timestamps == NULL && n > 0) return LOG_STAT(STAT_ERR_ARGS, "timestamps pointer is NULL");
+  return parse_bytes_timed(parser, bytes, timestamps, n, 0, 0, consumed);
+}
+
+STAT_Val MIDI_parse_chunk_timed(MIDI_Parser * restrict parser,
+                                const uint8_t *        bytes,
+                                size_t                 n,
+                                MIDI_Timestamp         first,
+                                MIDI_Timestamp         last,
+                                size_t *               consumed) {
+  if(last < first) return LOG_STAT(STAT_ERR_ARGS, "chunk ends before it starts");
+  return parse_bytes_timed(parser, bytes, NULL, n, first, last, consumed);
+}
+
+STAT_Val MIDI_INT_parse_bytes_switch(MIDI_Parser * restrict parser,
+                                     const uint8_t *        bytes,
+                                     size_t                 n,
+                                     size_t *               consumed) {
+  return parse_bytes_with(parser, bytes, n, consumed, parse_switch);
+}
+
+STAT_Val MIDI_INT_parse_bytes_table(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed) {
+  return parse_bytes_with(parser, bytes, n, consumed, parse_table);
+}
+
+static STAT_Val parse_bytes_with(MIDI_Parser * restrict parser,
+                                 const uint8_t * bytes,
+                                 size_t          n,
+                                 size_t *        consumed,
+                                 ParseFn         parse_fn) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+  if(bytes == NULL && n > 0) return LOG_STAT(STAT_ERR_ARGS, "bytes pointer is NULL");
+  if(consumed == NULL) return LOG_STAT(STAT_ERR_ARGS, "consumed pointer is NULL");
+
+  *consumed = 0;
+  if(!MIDI_parser_is_ready(parser)) return LOG_STAT(STAT_ERR_PRECONDITION, "parser not ready");
+
+  // keep the state in a local for the whole span, it only needs to go back into the parser once we're done
+  State  state = parser->state;
+  size_t i     = 0;
+  while(i < n) {
+    if(state == ST_SYSEX) {
+      // hand the payload over a whole run at a time, pointing into the caller's bytes instead of copying it
+      const size_t run = data_run_length(&(bytes[i]), n - i);
+      if(run > 0) {
+        sysex_data(parser, &(bytes[i]), run);
+        i += run;
+        continue;
+      }
+    }
+
+    state = parse_fn(parser, state, bytes[i++]);
+
+    // stop as soon as the buffer fills up, the caller can drain it and resume from bytes[*consumed]
+    if(!MIDI_parser_is_ready(parser)) break;
+  }
+
+  parser->state = state;
+  *consumed     = i;
+  STATS_ADD(parser, bytes, i);
+
+  return OK;
+}
+
+// Same loop as parse_bytes_with, but it sets the time of every byte before parsing it. That's kept out of the untimed
+// loop so it costs nothing there. The time comes from timestamps, or if that's NULL, from spreading [first, last]
+// evenly over the bytes: byte i is at first + step * i + (rest * i) / (n - 1), with the fraction kept as a running
+// remainder so there's no division per byte.
+static STAT_Val parse_bytes_timed(MIDI_Parser * restrict   parser,
+                                  const uint8_t *        bytes,
+                                  const MIDI_Timestamp * timestamps,
+                                  size_t                 n,
+                                  MIDI_Timestamp         first,
+                                  MIDI_Timestamp         last,
+                                  size_t *               consumed) {
+  if(parser == NULL) return LOG_STAT(STAT_ERR_ARGS, "parser pointer is NULL");
+  if(bytes == NULL && n > 0) return LOG_STAT(STAT_ERR_ARGS, "bytes pointer is NULL");
+  if(consumed == NULL) return LOG_STAT(STAT_ERR_ARGS, "consumed pointer is NULL");
+
+  *consumed = 0;
+  if(!MIDI_parser_is_ready(parser)) return LOG_STAT(STAT_ERR_PRECONDITION, "parser not ready");
+
+  const uint64_t intervals = (n > 1) ? n - 1 : 1;
+  const uint64_t step      = (last - first) / intervals;
+  const uint64_t rest      = (last - first) % intervals;
+
+  MIDI_Timestamp now       = first;
+  uint64_t       remainder = 0;
+
+  State  state = parser->state;
+  size_t i     = 0;
+  while(i < n) {
+    if(state == ST_SYSEX) {
+      // SysEx payload doesn't complete any messages, so it doesn't need times either
+      const size_t run = data_run_length(&(bytes[i]), n - i);
+      if(run > 0) {
+        sysex_data(parser, &(bytes[i]), run);
+        i += run;
+        now       = first + step * i + (rest * i) / intervals;
+        remainder = (rest * i) % intervals;
+        continue;
+      }
+    }
+
+    parser->msg_buffer.now = (timestamps != NULL) ? timestamps[i] : now;
+    state                  = parse(parser, state, bytes[i++]);
+
+    now += step;
+    remainder += rest;
+    if(remainder >= intervals) {
+      remainder -= intervals;
+      now++;
+    }
+
+    if(!MIDI_parser_is_ready(parser)) break;
+  }
+
+  parser->state = state;
+  *consumed     = i;
+  STATS_ADD(parser, bytes, i);
+
+  return OK;
+}
+
+static State parse(MIDI_Parser * restrict parser, State state, uint8_t byte) {
+#ifdef MIDI_PARSER_ENGINE_TABLE
+  return parse_table(parser, state, byte);
+#else
+  return parse_switch(parser, state, byte);
+#endif
+}
+
+static State parse_switch(MIDI_Parser * restrict parser, State state, uint8_t byte) {
+  if(byte >= 0xf8) {
+    // real-time messages can come in between any two bytes, they don't affect the message we're in the middle of
+    if(MIDI_is_real_time(byte)) {
+      emit_real_time(parser, byte);
+    } else {
+      STATS_ADD(parser, skipped_bytes, 1);
+    }
+    return state;
+  }
+
+  if(state == ST_SYSEX) {
+    if(is_data_byte(byte)) {
+      sysex_data(parser, &byte, 1);
+      return ST_SYSEX;
+    }
+    if(byte == STATUS_SYSEX_END) {
+      sysex_finish(parser, MIDI_SYSEX_END);
+      return ST_INIT;
+    }
+    // any other status byte cuts the dump short, and is then parsed like it would be outside of it
+    sysex_finish(parser, MIDI_SYSEX_ABORT);
+    state = ST_INIT;
+  }
+
+  if(byte == STATUS_SYSEX_START) {
+    sysex_start(parser);
+    return ST_SYSEX;
+  }
+
+  // system common messages cancel running status, going back to init also skips their data bytes
+  if(is_system_common(byte)) {
+    STATS_ADD(parser, skipped_bytes, 1);
+    return ST_INIT;
+  }
+
+  if(is_status(byte) && !is_in_channel_mask(byte, parser->channel_mask)) {
+    // regardless of what state we're in, if we get a message for a channel we don't listen to, we reset to init, as a
+    // new status message must come in to indicate we're back on a channel we do listen to
+    STATS_ADD(parser, other_channel_resets, 1);
+    return ST_INIT;
   }
 
   bool try_byte_again = false;
 
   do {
-    switch(parser->state) {
+    switch(state) {
     case ST_INIT: {
       if(is_note_on(byte)) {
-        parser->state = ST_RUNNING_NOTE_ON;
+        state = ST_RUNNING_NOTE_ON;
       } else if(is_note_off(byte)) {
-        parser->state = ST_RUNNING_NOTE_OFF;
+        state = ST_RUNNING_NOTE_OFF;
+      } else if(is_aftertouch_poly(byte)) {
+        state = ST_RUNNING_AFTERTOUCH_POLY;
       } else if(is_control_change(byte)) {
-        parser->state = ST_RUNNING_CONTROL_CHANGE;
+        state = ST_RUNNING_CONTROL_CHANGE;
+      } else if(is_program_change(byte)) {
+        state = ST_RUNNING_PROGRAM_CHANGE;
+      } else if(is_aftertouch_mono(byte)) {
+        state = ST_RUNNING_AFTERTOUCH_MONO;
       } else if(is_pitch_bend(byte)) {
-        parser->state = ST_RUNNING_PITCH_BEND;
+        state = ST_RUNNING_PITCH_BEND;
       } else {
         // do nothing, maintain the init state and move to next byte, as this is an unparseable byte
         // probably it belongs to message for another channel
+        STATS_ADD(parser, skipped_bytes, 1);
       }
+      if(is_status(byte)) parser->current_channel = byte_to_channel(byte); // running status is per channel
       try_byte_again = false; // we never try again after going through the init state, as there would be no improvement
       break;
     }
@@ -106,11 +557,11 @@ STAT_Val MIDI_parse_byte(MIDI_Parser * restrict parser, uint8_t byte) {
       if(is_data_byte(byte)) {
         parser->current_note = MIDI_byte_to_note(byte);
 
-        parser->state = ST_NOTE_ON_WITH_VALID_NOTE;
+        state = ST_NOTE_ON_WITH_VALID_NOTE;
       } else {
         // expected data byte, try again from init state
         try_byte_again = true;
-        parser->state  = ST_INIT;
+        state          = ST_INIT;
       }
       break;
     }
@@ -122,13 +573,13 @@ STAT_Val MIDI_parse_byte(MIDI_Parser * restrict parser, uint8_t byte) {
                                               .data.note_on = {.note = parser->current_note, .velocity = velocity}})
                             : ((MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
                                               .data.note_off = {.note     = parser->current_note,
-                                                                .velocity = NOTE_OFF_DEFAULT_VELOCITY}}));
-        MIDI_INT_buff_push(&(parser->msg_buffer), msg);
+                                                                .velocity = MIDI_NOTE_OFF_DEFAULT_VELOCITY}}));
+        emit(parser, msg);
 
-        parser->state = ST_RUNNING_NOTE_ON; // succesfully parsed note, we may get another
+        state = ST_RUNNING_NOTE_ON; // succesfully parsed note, we may get another
       } else {
         try_byte_again = true;
-        parser->state  = ST_INIT; // byte not parseable, try again from init state
+        state          = ST_INIT; // byte not parseable, try again from init state
       }
       break;
     }
@@ -138,23 +589,49 @@ STAT_Val MIDI_parse_byte(MIDI_Parser * restrict parser, uint8_t byte) {
       if(is_data_byte(byte)) {
         parser->current_note = MIDI_byte_to_note(byte);
 
-        parser->state = ST_NOTE_OFF_WITH_VALID_NOTE;
+        state = ST_NOTE_OFF_WITH_VALID_NOTE;
       } else {
         try_byte_again = true;
-        parser->state  = ST_INIT; // byte not parseable, try again from init state
+        state          = ST_INIT; // byte not parseable, try again from init state
       }
       break;
     }
     case ST_NOTE_OFF_WITH_VALID_NOTE: {
       if(is_data_byte(byte)) {
-        MIDI_INT_buff_push(&(parser->msg_buffer),
-                           (MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
-                                          .data.note_off = {.note = parser->current_note, .velocity = byte}});
+        emit(parser,
+             (MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
+                            .data.note_off = {.note = parser->current_note, .velocity = byte}});
 
-        parser->state = ST_RUNNING_NOTE_OFF; // succesfully parsed note, we may get another
+        state = ST_RUNNING_NOTE_OFF; // succesfully parsed note, we may get another
       } else {
         try_byte_again = true;
-        parser->state  = ST_INIT; // byte not parseable, try again from init state
+        state          = ST_INIT; // byte not parseable, try again from init state
+      }
+      break;
+    }
+
+    // states specific to AFTERTOUCH_POLY
+    case ST_RUNNING_AFTERTOUCH_POLY: {
+      if(is_data_byte(byte)) {
+        parser->current_note = MIDI_byte_to_note(byte);
+
+        state = ST_AFTERTOUCH_POLY_WITH_VALID_NOTE;
+      } else {
+        try_byte_again = true;
+        state          = ST_INIT; // byte not parseable, try again from init state
+      }
+      break;
+    }
+    case ST_AFTERTOUCH_POLY_WITH_VALID_NOTE: {
+      if(is_data_byte(byte)) {
+        emit(parser,
+             (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+                            .data.aftertouch_poly = {.note = parser->current_note, .value = byte}});
+
+        state = ST_RUNNING_AFTERTOUCH_POLY;
+      } else {
+        try_byte_again = true;
+        state          = ST_INIT; // byte not parseable, try again from init state
       }
       break;
     }
@@ -164,23 +641,47 @@ STAT_Val MIDI_parse_byte(MIDI_Parser * restrict parser, uint8_t byte) {
       if(is_data_byte(byte)) {
         parser->current_control = byte;
 
-        parser->state = ST_CONTROL_CHANGE_WITH_VALID_CONTROL;
+        state = ST_CONTROL_CHANGE_WITH_VALID_CONTROL;
       } else {
         try_byte_again = true;
-        parser->state  = ST_INIT; // byte not parseable, try again from init state
+        state          = ST_INIT; // byte not parseable, try again from init state
       }
       break;
     }
     case ST_CONTROL_CHANGE_WITH_VALID_CONTROL: {
       if(is_data_byte(byte)) {
-        MIDI_INT_buff_push(&(parser->msg_buffer),
-                           (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
-                                          .data.control_change = {.control = parser->current_control, .value = byte}});
+        emit(parser,
+             (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+                            .data.control_change = {.control = parser->current_control, .value = byte}});
 
-        parser->state = ST_RUNNING_CONTROL_CHANGE;
+        state = ST_RUNNING_CONTROL_CHANGE;
       } else {
         try_byte_again = true;
-        parser->state  = ST_INIT; // byte not parseable, try again from init state
+        state          = ST_INIT; // byte not parseable, try again from init state
+      }
+      break;
+    }
+
+    // states specific to PROGRAM_CHANGE
+    case ST_RUNNING_PROGRAM_CHANGE: {
+      if(is_data_byte(byte)) {
+        emit(parser,
+             (MIDI_Message){.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .data.program_change = {.program = byte}});
+      } else {
+        try_byte_again = true;
+        state          = ST_INIT; // byte not parseable, try again from init state
+      }
+      break;
+    }
+
+    // states specific to AFTERTOUCH_MONO
+    case ST_RUNNING_AFTERTOUCH_MONO: {
+      if(is_data_byte(byte)) {
+        emit(parser,
+             (MIDI_Message){.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .data.aftertouch_mono = {.value = byte}});
+      } else {
+        try_byte_again = true;
+        state          = ST_INIT; // byte not parseable, try again from init state
       }
       break;
     }
@@ -190,42 +691,283 @@ STAT_Val MIDI_parse_byte(MIDI_Parser * restrict parser, uint8_t byte) {
       if(is_data_byte(byte)) {
         parser->pitch_bend_lsb = byte;
 
-        parser->state = ST_PITCH_BEND_WITH_VALID_LSB;
+        state = ST_PITCH_BEND_WITH_VALID_LSB;
       } else {
         try_byte_again = true;
-        parser->state  = ST_INIT; // byte not parseable, try again from init state
+        state          = ST_INIT; // byte not parseable, try again from init state
       }
       break;
     }
     case ST_PITCH_BEND_WITH_VALID_LSB: {
       if(is_data_byte(byte)) {
-        MIDI_INT_buff_push(&(parser->msg_buffer),
-                           (MIDI_Message){.type            = MIDI_MSG_TYPE_PITCH_BEND,
-                                          .data.pitch_bend = {
-                                              .value = make_pitch_bend_value(parser->pitch_bend_lsb, byte)}});
+        emit(parser,
+             (MIDI_Message){.type            = MIDI_MSG_TYPE_PITCH_BEND,
+                            .data.pitch_bend = {.value = make_pitch_bend_value(parser->pitch_bend_lsb, byte)}});
 
-        parser->state = ST_RUNNING_PITCH_BEND; // pitch bend parsed OK, maybe we get another
+        state = ST_RUNNING_PITCH_BEND; // pitch bend parsed OK, maybe we get another
       } else {
         try_byte_again = true;
-        parser->state  = ST_INIT; // byte not parseable, try again from init state
+        state          = ST_INIT; // byte not parseable, try again from init state
       }
       break;
     }
-    default: parser->state = ST_INIT; // should never get here, best effort fix is to go back to init
+    default: state = ST_INIT; // should never get here, best effort fix is to go back to init
     }
+    if(try_byte_again) STATS_ADD(parser, retries, 1);
 
   } while(try_byte_again);
 
-  return OK;
+  return state;
 }
 
-static bool is_supported(uint8_t byte) {
-  return !is_status(byte) ||
-         (is_of_type(byte, MIDI_MSG_TYPE_NOTE_ON) || is_of_type(byte, MIDI_MSG_TYPE_NOTE_OFF) ||
-          is_of_type(byte, MIDI_MSG_TYPE_CONTROL_CHANGE) || is_of_type(byte, MIDI_MSG_TYPE_PITCH_BEND));
+// Table-driven engine. Every byte is mapped to a ByteClass through a 256 entry lookup, and the (state, class) pair then
+// gives the next state and an action to perform. It produces exactly the same output as parse_switch(), but does so
+// without the retry loop and the chains of type checks.
+
+#define BC_ROW16(c) c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c
+
+static const uint8_t byte_classes[256] = {
+    BC_ROW16(BC_DATA),            // 0x00
+    BC_ROW16(BC_DATA),            // 0x10
+    BC_ROW16(BC_DATA),            // 0x20
+    BC_ROW16(BC_DATA),            // 0x30
+    BC_ROW16(BC_DATA),            // 0x40
+    BC_ROW16(BC_DATA),            // 0x50
+    BC_ROW16(BC_DATA),            // 0x60
+    BC_ROW16(BC_DATA),            // 0x70
+    BC_ROW16(BC_NOTE_OFF),        // 0x80
+    BC_ROW16(BC_NOTE_ON),         // 0x90
+    BC_ROW16(BC_AFTERTOUCH_POLY), // 0xa0
+    BC_ROW16(BC_CONTROL_CHANGE),  // 0xb0
+    BC_ROW16(BC_PROGRAM_CHANGE),  // 0xc0
+    BC_ROW16(BC_AFTERTOUCH_MONO), // 0xd0
+    BC_ROW16(BC_PITCH_BEND),      // 0xe0
+    // 0xf0, system exclusive, system common and system real-time
+    // clang-format off
+    BC_SYSEX_START,   BC_SYSTEM_COMMON, BC_SYSTEM_COMMON, BC_SYSTEM_COMMON, BC_SYSTEM_COMMON, BC_SYSTEM_COMMON,
+    BC_SYSTEM_COMMON, BC_SYSEX_END,     BC_REAL_TIME,     BC_IGNORED,       BC_REAL_TIME,     BC_REAL_TIME,
+    BC_REAL_TIME,     BC_IGNORED,       BC_REAL_TIME,     BC_REAL_TIME,
+    // clang-format on
+};
+
+// any status byte we understand moves us to the corresponding running state, regardless of the state we're in (except
+// for ST_SYSEX, which has to end the dump first)
+#define STATUS_TRANSITIONS                                             \
+  [BC_NOTE_OFF]        = {ST_RUNNING_NOTE_OFF, AC_SET_CHANNEL},        \
+  [BC_NOTE_ON]         = {ST_RUNNING_NOTE_ON, AC_SET_CHANNEL},         \
+  [BC_AFTERTOUCH_POLY] = {ST_RUNNING_AFTERTOUCH_POLY, AC_SET_CHANNEL}, \
+  [BC_CONTROL_CHANGE]  = {ST_RUNNING_CONTROL_CHANGE, AC_SET_CHANNEL},  \
+  [BC_PROGRAM_CHANGE]  = {ST_RUNNING_PROGRAM_CHANGE, AC_SET_CHANNEL},  \
+  [BC_AFTERTOUCH_MONO] = {ST_RUNNING_AFTERTOUCH_MONO, AC_SET_CHANNEL}, \
+  [BC_PITCH_BEND]      = {ST_RUNNING_PITCH_BEND, AC_SET_CHANNEL},      \
+  [BC_SYSEX_START]     = {ST_SYSEX, AC_SYSEX_START},                   \
+  [BC_SYSEX_END]       = {ST_INIT, AC_NONE},                           \
+  [BC_SYSTEM_COMMON]   = {ST_INIT, AC_NONE},                           \
+  [BC_OTHER_CHANNEL]   = {ST_INIT, AC_NONE}
+
+static const Transition transitions[ST_COUNT][BC_COUNT] = {
+    [ST_INIT] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_INIT, AC_NONE},
+            [BC_REAL_TIME] = {ST_INIT, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_INIT, AC_NONE},
+        },
+    [ST_RUNNING_NOTE_ON] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_NOTE_ON_WITH_VALID_NOTE, AC_STORE_DATA_BYTE},
+            [BC_REAL_TIME] = {ST_RUNNING_NOTE_ON, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_RUNNING_NOTE_ON, AC_NONE},
+        },
+    [ST_NOTE_ON_WITH_VALID_NOTE] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_RUNNING_NOTE_ON, AC_EMIT_NOTE_ON},
+            [BC_REAL_TIME] = {ST_NOTE_ON_WITH_VALID_NOTE, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_NOTE_ON_WITH_VALID_NOTE, AC_NONE},
+        },
+    [ST_RUNNING_NOTE_OFF] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_NOTE_OFF_WITH_VALID_NOTE, AC_STORE_DATA_BYTE},
+            [BC_REAL_TIME] = {ST_RUNNING_NOTE_OFF, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_RUNNING_NOTE_OFF, AC_NONE},
+        },
+    [ST_NOTE_OFF_WITH_VALID_NOTE] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_RUNNING_NOTE_OFF, AC_EMIT_NOTE_OFF},
+            [BC_REAL_TIME] = {ST_NOTE_OFF_WITH_VALID_NOTE, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_NOTE_OFF_WITH_VALID_NOTE, AC_NONE},
+        },
+    [ST_RUNNING_AFTERTOUCH_POLY] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_AFTERTOUCH_POLY_WITH_VALID_NOTE, AC_STORE_DATA_BYTE},
+            [BC_REAL_TIME] = {ST_RUNNING_AFTERTOUCH_POLY, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_RUNNING_AFTERTOUCH_POLY, AC_NONE},
+        },
+    [ST_AFTERTOUCH_POLY_WITH_VALID_NOTE] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_RUNNING_AFTERTOUCH_POLY, AC_EMIT_AFTERTOUCH_POLY},
+            [BC_REAL_TIME] = {ST_AFTERTOUCH_POLY_WITH_VALID_NOTE, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_AFTERTOUCH_POLY_WITH_VALID_NOTE, AC_NONE},
+        },
+    [ST_RUNNING_CONTROL_CHANGE] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_CONTROL_CHANGE_WITH_VALID_CONTROL, AC_STORE_DATA_BYTE},
+            [BC_REAL_TIME] = {ST_RUNNING_CONTROL_CHANGE, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_RUNNING_CONTROL_CHANGE, AC_NONE},
+        },
+    [ST_CONTROL_CHANGE_WITH_VALID_CONTROL] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_RUNNING_CONTROL_CHANGE, AC_EMIT_CONTROL_CHANGE},
+            [BC_REAL_TIME] = {ST_CONTROL_CHANGE_WITH_VALID_CONTROL, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_CONTROL_CHANGE_WITH_VALID_CONTROL, AC_NONE},
+        },
+    [ST_RUNNING_PROGRAM_CHANGE] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_RUNNING_PROGRAM_CHANGE, AC_EMIT_PROGRAM_CHANGE},
+            [BC_REAL_TIME] = {ST_RUNNING_PROGRAM_CHANGE, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_RUNNING_PROGRAM_CHANGE, AC_NONE},
+        },
+    [ST_RUNNING_AFTERTOUCH_MONO] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_RUNNING_AFTERTOUCH_MONO, AC_EMIT_AFTERTOUCH_MONO},
+            [BC_REAL_TIME] = {ST_RUNNING_AFTERTOUCH_MONO, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_RUNNING_AFTERTOUCH_MONO, AC_NONE},
+        },
+    [ST_RUNNING_PITCH_BEND] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_PITCH_BEND_WITH_VALID_LSB, AC_STORE_DATA_BYTE},
+            [BC_REAL_TIME] = {ST_RUNNING_PITCH_BEND, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_RUNNING_PITCH_BEND, AC_NONE},
+        },
+    [ST_PITCH_BEND_WITH_VALID_LSB] =
+        {
+            STATUS_TRANSITIONS,
+            [BC_DATA]      = {ST_RUNNING_PITCH_BEND, AC_EMIT_PITCH_BEND},
+            [BC_REAL_TIME] = {ST_PITCH_BEND_WITH_VALID_LSB, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]   = {ST_PITCH_BEND_WITH_VALID_LSB, AC_NONE},
+        },
+    [ST_SYSEX] =
+        {
+            [BC_NOTE_OFF]        = {ST_RUNNING_NOTE_OFF, AC_SYSEX_ABORT_SET_CHANNEL},
+            [BC_NOTE_ON]         = {ST_RUNNING_NOTE_ON, AC_SYSEX_ABORT_SET_CHANNEL},
+            [BC_AFTERTOUCH_POLY] = {ST_RUNNING_AFTERTOUCH_POLY, AC_SYSEX_ABORT_SET_CHANNEL},
+            [BC_CONTROL_CHANGE]  = {ST_RUNNING_CONTROL_CHANGE, AC_SYSEX_ABORT_SET_CHANNEL},
+            [BC_PROGRAM_CHANGE]  = {ST_RUNNING_PROGRAM_CHANGE, AC_SYSEX_ABORT_SET_CHANNEL},
+            [BC_AFTERTOUCH_MONO] = {ST_RUNNING_AFTERTOUCH_MONO, AC_SYSEX_ABORT_SET_CHANNEL},
+            [BC_PITCH_BEND]      = {ST_RUNNING_PITCH_BEND, AC_SYSEX_ABORT_SET_CHANNEL},
+            [BC_DATA]            = {ST_SYSEX, AC_SYSEX_DATA},
+            [BC_REAL_TIME]       = {ST_SYSEX, AC_EMIT_REAL_TIME},
+            [BC_IGNORED]         = {ST_SYSEX, AC_NONE},
+            [BC_SYSEX_START]     = {ST_SYSEX, AC_SYSEX_RESTART},
+            [BC_SYSEX_END]       = {ST_INIT, AC_SYSEX_END},
+            [BC_SYSTEM_COMMON]   = {ST_INIT, AC_SYSEX_ABORT},
+            [BC_OTHER_CHANNEL]   = {ST_INIT, AC_SYSEX_ABORT},
+        },
+};
+
+static bool is_channel_status_class(ByteClass c) { return c < BC_DATA; }
+
+static State parse_table(MIDI_Parser * restrict parser, State state, uint8_t byte) {
+  ByteClass byte_class = (ByteClass)byte_classes[byte];
+  if(is_channel_status_class(byte_class) && !is_in_channel_mask(byte, parser->channel_mask)) {
+    byte_class = BC_OTHER_CHANNEL;
+  }
+#ifdef MIDI_PARSER_STATS
+  count_byte(parser, state, byte_class);
+#endif
+
+  const Transition t = transitions[state][byte_class];
+
+  switch((Action)t.action) {
+  case AC_NONE: break;
+  case AC_SET_CHANNEL: parser->current_channel = byte_to_channel(byte); break;
+  case AC_STORE_DATA_BYTE: parser->data_byte = byte; break;
+  case AC_EMIT_NOTE_OFF:
+    emit(parser,
+         (MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
+                        .data.note_off = {.note = parser->data_byte, .velocity = byte}});
+    break;
+  case AC_EMIT_NOTE_ON:
+    emit(parser,
+         ((byte > 0) ? ((MIDI_Message){.type         = MIDI_MSG_TYPE_NOTE_ON,
+                                       .data.note_on = {.note = parser->data_byte, .velocity = byte}})
+                     : ((MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
+                                       .data.note_off = {.note     = parser->data_byte,
+                                                         .velocity = MIDI_NOTE_OFF_DEFAULT_VELOCITY}})));
+    break;
+  case AC_EMIT_AFTERTOUCH_POLY:
+    emit(parser,
+         (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+                        .data.aftertouch_poly = {.note = parser->data_byte, .value = byte}});
+    break;
+  case AC_EMIT_CONTROL_CHANGE:
+    emit(parser,
+         (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+                        .data.control_change = {.control = parser->data_byte, .value = byte}});
+    break;
+  case AC_EMIT_PROGRAM_CHANGE:
+    emit(parser, (MIDI_Message){.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .data.program_change = {.program = byte}});
+    break;
+  case AC_EMIT_AFTERTOUCH_MONO:
+    emit(parser, (MIDI_Message){.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .data.aftertouch_mono = {.value = byte}});
+    break;
+  case AC_EMIT_PITCH_BEND:
+    emit(parser,
+         (MIDI_Message){.type            = MIDI_MSG_TYPE_PITCH_BEND,
+                        .data.pitch_bend = {.value = make_pitch_bend_value(parser->data_byte, byte)}});
+    break;
+  case AC_EMIT_REAL_TIME: emit_real_time(parser, byte); break;
+  case AC_SYSEX_START: sysex_start(parser); break;
+  case AC_SYSEX_RESTART:
+    sysex_finish(parser, MIDI_SYSEX_ABORT);
+    sysex_start(parser);
+    break;
+  case AC_SYSEX_DATA: sysex_data(parser, &byte, 1); break;
+  case AC_SYSEX_END: sysex_finish(parser, MIDI_SYSEX_END); break;
+  case AC_SYSEX_ABORT: sysex_finish(parser, MIDI_SYSEX_ABORT); break;
+  case AC_SYSEX_ABORT_SET_CHANNEL:
+    sysex_finish(parser, MIDI_SYSEX_ABORT);
+    parser->current_channel = byte_to_channel(byte);
+    break;
+  }
+
+  return (State)t.next_state;
 }
 
-static uint8_t channel_to_byte(MIDI_Channel channel) { return ((uint8_t)(channel)-1); }
+#ifdef MIDI_PARSER_STATS
+// the table has no retry loop, so work out from the state and class of the byte what parse_switch() would have counted
+static void count_byte(MIDI_Parser * restrict parser, State state, ByteClass byte_class) {
+  switch(byte_class) {
+  case BC_OTHER_CHANNEL: parser->stats.other_channel_resets++; break;
+  case BC_DATA:
+    if(state == ST_INIT) parser->stats.skipped_bytes++;
+    break;
+  case BC_SYSEX_END:
+    if(state != ST_SYSEX) parser->stats.skipped_bytes++;
+    break;
+  case BC_IGNORED:
+  case BC_SYSTEM_COMMON: parser->stats.skipped_bytes++; break;
+  case BC_REAL_TIME:
+  case BC_SYSEX_START:
+  case BC_COUNT: break;
+  default:
+    // a status byte on one of our channels, it ends whatever message we were running (a SysEx dump isn't a retry)
+    if(state != ST_INIT && state != ST_SYSEX) parser->stats.retries++;
+    break;
+  }
+}
+#endif
 
 static uint8_t get_status_bit(uint8_t byte) { return byte & (1 << 7) /* 0b1000'0000 */; }
 static uint8_t get_type_bits(uint8_t byte) { return byte & (0x7 << 4) /* 0b0111'0000 */; }
@@ -238,15 +980,72 @@ static bool is_of_type(uint8_t byte, MIDI_MessageType type) {
 
 static bool is_note_on(uint8_t byte) { return is_of_type(byte, MIDI_MSG_TYPE_NOTE_ON); }
 static bool is_note_off(uint8_t byte) { return is_of_type(byte, MIDI_MSG_TYPE_NOTE_OFF); }
+static bool is_aftertouch_poly(uint8_t byte) { return is_of_type(byte, MIDI_MSG_TYPE_AFTERTOUCH_POLY); }
 static bool is_control_change(uint8_t byte) { return is_of_type(byte, MIDI_MSG_TYPE_CONTROL_CHANGE); }
+static bool is_program_change(uint8_t byte) { return is_of_type(byte, MIDI_MSG_TYPE_PROGRAM_CHANGE); }
+static bool is_aftertouch_mono(uint8_t byte) { return is_of_type(byte, MIDI_MSG_TYPE_AFTERTOUCH_MONO); }
 static bool is_pitch_bend(uint8_t byte) { return is_of_type(byte, MIDI_MSG_TYPE_PITCH_BEND); }
 
-static bool is_on_channel(uint8_t byte, MIDI_Channel channel) {
-  return get_channel_bits(byte) == channel_to_byte(channel);
+static uint8_t byte_to_channel(uint8_t byte) { return get_channel_bits(byte) + 1; }
+
+static bool is_in_channel_mask(uint8_t byte, uint16_t channel_mask) {
+  return ((channel_mask >> get_channel_bits(byte)) & 1) != 0;
 }
 
 static bool is_data_byte(uint8_t byte) { return !is_status(byte); }
 
+// F1 to F6, and F7 when it isn't ending a SysEx dump
+static bool is_system_common(uint8_t byte) { return byte > STATUS_SYSEX_START && byte <= STATUS_SYSEX_END; }
+
+static size_t data_run_length(const uint8_t * bytes, size_t n) {
+  size_t i = 0;
+
+  // SysEx dumps can be long, so check eight bytes at a time for a status bit
+  for(; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, &(bytes[i]), sizeof(word));
+    if((word & 0x8080808080808080ull) != 0) break;
+  }
+  while(i < n && is_data_byte(bytes[i])) i++;
+
+  return i;
+}
+
+static void emit(MIDI_Parser * restrict parser, MIDI_Message msg) {
+  msg.channel = parser->current_channel;
+  MIDI_INT_buff_push(&(parser->msg_buffer), msg);
+}
+
+static void emit_real_time(MIDI_Parser * restrict parser, uint8_t byte) {
+  MIDI_INT_buff_push(&(parser->msg_buffer), (MIDI_Message){.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = byte}});
+}
+
+static void sysex_start(MIDI_Parser * restrict parser) {
+  parser->sysex_len = 0;
+  if(parser->sysex_callback != NULL) parser->sysex_callback(parser->sysex_context, MIDI_SYSEX_START, NULL, 0);
+}
+
+static void sysex_data(MIDI_Parser * restrict parser, const uint8_t * data, size_t len) {
+  parser->sysex_len += len;
+  if(parser->sysex_callback != NULL) parser->sysex_callback(parser->sysex_context, MIDI_SYSEX_CHUNK, data, len);
+}
+
+static void sysex_finish(MIDI_Parser * restrict parser, MIDI_SysExEvent event) {
+  if(parser->sysex_callback != NULL) parser->sysex_callback(parser->sysex_context, event, NULL, parser->sysex_len);
+}
+
+static bool is_coalescable(MIDI_Message buffered, MIDI_Message msg) {
+  if(buffered.type != msg.type || buffered.channel != msg.channel) return false;
+
+  switch(msg.type) {
+  case MIDI_MSG_TYPE_CONTROL_CHANGE: return buffered.data.control_change.control == msg.data.control_change.control;
+  case MIDI_MSG_TYPE_AFTERTOUCH_POLY: return buffered.data.aftertouch_poly.note == msg.data.aftertouch_poly.note;
+  case MIDI_MSG_TYPE_AFTERTOUCH_MONO:
+  case MIDI_MSG_TYPE_PITCH_BEND: return true;
+  default: return false; // anything else is an event of its own, not a new value for something
+  }
+}
+
 static int16_t make_pitch_bend_value(uint8_t lsb, uint8_t msb) {
   const int16_t mid = 0x40 << 7;
   return (((int16_t)(msb) << 7) | (int16_t)lsb) - mid;
@@ -0,0 +1,268 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "route.h"
+
+#include <string.h>
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define NUM_CHANNELS 16
+
+// a message on its way through the rules, at compile time
+typedef struct Pending {
+  uint8_t channel;
+  uint8_t key;
+  bool    has_values;
+  size_t  next_rule;
+  uint8_t values[MIDI_ROUTE_NUM_KEYS];
+} Pending;
+
+static bool has_key(uint8_t type) { return type != MIDI_MSG_TYPE_AFTERTOUCH_MONO && type != MIDI_MSG_TYPE_PITCH_BEND; }
+static bool has_value(uint8_t type) { return type != MIDI_MSG_TYPE_PROGRAM_CHANGE && type != MIDI_MSG_TYPE_PITCH_BEND; }
+
+static bool matches(const MIDI_RouteRule * rule, uint8_t type, const Pending * msg) {
+  return (rule->types & MIDI_ROUTE_TYPE(type)) && (rule->channel_mask & (1u << (msg->channel - 1))) &&
+         (!has_key(type) || (msg->key >= rule->key_min && msg->key <= rule->key_max));
+}
+
+// returns false if the key ended up out of range
+static bool modify(const MIDI_RouteRule * rule, uint8_t type, Pending * msg) {
+  if(rule->channel != 0) msg->channel = rule->channel;
+
+  if(has_key(type)) {
+    const int key = ((rule->key == MIDI_ROUTE_KEEP) ? msg->key : rule->key) + rule->transpose;
+    if(key < 0 || key >= MIDI_ROUTE_NUM_KEYS) return false;
+    msg->key = (uint8_t)key;
+  }
+
+  if(rule->values != NULL && has_value(type)) {
+    for(size_t v = 0; v < MIDI_ROUTE_NUM_KEYS; v++) {
+      msg->values[v] = rule->values[msg->has_values ? msg->values[v] : v] & 0x7f;
+    }
+    msg->has_values = true;
+  }
+
+  return true;
+}
+
+// index of values in the router's tables, adding them if they aren't there yet
+static STAT_Val intern_values(MIDI_Router * restrict router, uint8_t type, Pending * msg, uint8_t * table) {
+  *table = 0;
+  if(!msg->has_values) return OK;
+
+  // a note on with velocity 0 would be a note off
+  if(type == MIDI_MSG_TYPE_NOTE_ON) {
+    for(size_t v = 1; v < MIDI_ROUTE_NUM_KEYS; v++) {
+      if(msg->values[v] == 0) msg->values[v] = 1;
+    }
+  }
+
+  for(size_t i = 0; i < router->num_tables; i++) {
+    if(memcmp(router->values[i], msg->values, MIDI_ROUTE_NUM_KEYS) == 0) {
+      *table = (uint8_t)i;
+      return OK;
+    }
+  }
+
+  if(router->num_tables == MIDI_ROUTER_MAX_TABLES) {
+    return LOG_STAT(STAT_ERR_RANGE, "more than %d value tables", MIDI_ROUTER_MAX_TABLES);
+  }
+  memcpy(router->values[router->num_tables], msg->values, MIDI_ROUTE_NUM_KEYS);
+  *table = (uint8_t)router->num_tables++;
+
+  return OK;
+}
+
+// runs one message through the rules, a stack holds the copies that still have to go
+static STAT_Val compile_route(MIDI_Router * restrict router,
+                              const MIDI_RouteRule * rules,
+                              size_t                 num_rules,
+                              uint8_t                type,
+                              uint8_t                channel,
+                              uint8_t                key,
+                              MIDI_Route * restrict  route) {
+  Pending    stack[MIDI_ROUTE_MAX_OUTPUTS];
+  size_t     stack_len = 1;
+  MIDI_Route outputs[MIDI_ROUTE_MAX_OUTPUTS];
+  size_t     num_outputs = 0;
+  bool       first_kept  = false; // whether the message itself made it, it's the first one off the stack
+
+  stack[0] = (Pending){.channel = channel, .key = key};
+
+  for(bool first = true; stack_len > 0; first = false) {
+    Pending msg  = stack[--stack_len];
+    bool    kept = true;
+
+    for(size_t i = msg.next_rule; i < num_rules && kept; i++) {
+      const MIDI_RouteRule * rule = &(rules[i]);
+      if(!matches(rule, type, &msg)) continue;
+
+      switch(rule->action) {
+      case MIDI_ROUTE_DROP: kept = false; break;
+      case MIDI_ROUTE_MODIFY: kept = modify(rule, type, &msg); break;
+      case MIDI_ROUTE_DUPLICATE:
+        // outputs so far, copies still to go, this message and the new copy
+        if(num_outputs + stack_len + 2 > MIDI_ROUTE_MAX_OUTPUTS) {
+          return LOG_STAT(STAT_ERR_RANGE, "a message turns into more than %d", MIDI_ROUTE_MAX_OUTPUTS);
+        }
+        stack[stack_len] = msg;
+        if(modify(rule, type, &(stack[stack_len]))) {
+          stack[stack_len].next_rule = i + 1;
+          stack_len++;
+        }
+        break;
+      }
+    }
+
+    if(first) first_kept = kept;
+    if(!kept) continue;
+
+    MIDI_Route * out  = &(outputs[num_outputs++]);
+    *out              = (MIDI_Route){.channel = msg.channel, .key = msg.key};
+    const STAT_Val st = intern_values(router, type, &msg, &(out->table));
+    if(st != OK) return st;
+  }
+
+  *route = (MIDI_Route){0};
+  if(num_outputs == 0) return OK;
+
+  const size_t num_extra = first_kept ? num_outputs - 1 : num_outputs;
+  if(router->num_extra + num_extra > MIDI_ROUTER_MAX_EXTRA) {
+    return LOG_STAT(STAT_ERR_RANGE, "more than %d extra outputs", MIDI_ROUTER_MAX_EXTRA);
+  }
+
+  if(first_kept) *route = outputs[0];
+  route->num_extra   = (uint8_t)num_extra;
+  route->first_extra = (uint16_t)router->num_extra;
+  memcpy(&(router->extra[router->num_extra]), &(outputs[num_outputs - num_extra]), num_extra * sizeof(MIDI_Route));
+  router->num_extra += num_extra;
+
+  return OK;
+}
+
+STAT_Val MIDI_route_compile(MIDI_Router * restrict router, const MIDI_RouteRule * rules, size_t num_rules) {
+  if(router == NULL) return LOG_STAT(STAT_ERR_ARGS, "router pointer is NULL");
+  if(rules == NULL && num_rules > 0) return LOG_STAT(STAT_ERR_ARGS, "rules pointer is NULL");
+
+  for(size_t i = 0; i < num_rules; i++) {
+    const MIDI_RouteRule * rule = &(rules[i]);
+    if(rule->action > MIDI_ROUTE_DUPLICATE) return LOG_STAT(STAT_ERR_ARGS, "rule %zu: invalid action", i);
+    if(rule->channel > NUM_CHANNELS) return LOG_STAT(STAT_ERR_ARGS, "rule %zu: invalid channel", i);
+    if(rule->key < MIDI_ROUTE_KEEP || rule->key >= MIDI_ROUTE_NUM_KEYS) {
+      return LOG_STAT(STAT_ERR_ARGS, "rule %zu: invalid key", i);
+    }
+  }
+
+  router->num_extra  = 0;
+  router->num_tables = 1;
+  for(size_t v = 0; v < MIDI_ROUTE_NUM_KEYS; v++) router->values[0][v] = (uint8_t)v;
+
+  for(uint8_t type = 0; type < MIDI_ROUTE_NUM_TYPES; type++) {
+    const size_t num_keys = has_key(type) ? MIDI_ROUTE_NUM_KEYS : 1;
+    for(uint8_t channel = 1; channel <= NUM_CHANNELS; channel++) {
+      MIDI_Route * routes = router->routes[type][channel - 1];
+      memset(routes, 0, sizeof(router->routes[type][channel - 1]));
+
+      for(size_t key = 0; key < num_keys; key++) {
+        const STAT_Val st = compile_route(router, rules, num_rules, type, channel, (uint8_t)key, &(routes[key]));
+        if(st != OK) return st;
+      }
+    }
+  }
+
+  return OK;
+}
+
+static MIDI_Message route_msg(const MIDI_Router * restrict router, MIDI_Message msg, const MIDI_Route * route) {
+  const uint8_t * values = router->values[route->table];
+
+  msg.channel = route->channel;
+  switch(msg.type) {
+  case MIDI_MSG_TYPE_NOTE_OFF:
+  case MIDI_MSG_TYPE_NOTE_ON:
+  case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+  case MIDI_MSG_TYPE_CONTROL_CHANGE:
+    // all of these are a key and a value
+    msg.data.control_change.control = route->key;
+    msg.data.control_change.value   = values[msg.data.control_change.value & 0x7f];
+    break;
+  case MIDI_MSG_TYPE_PROGRAM_CHANGE: msg.data.program_change.program = route->key; break;
+  case MIDI_MSG_TYPE_AFTERTOUCH_MONO:
+    msg.data.aftertouch_mono.value = values[msg.data.aftertouch_mono.value & 0x7f];
+    break;
+  default: break;
+  }
+
+  return msg;
+}
+
+size_t MIDI_route_apply(const MIDI_Router * restrict router,
+                        const MIDI_Message *         in,
+                        size_t                       n,
+                        MIDI_Message * restrict      out,
+                        size_t                       max,
+                        size_t *                     consumed) {
+  size_t num_out = 0;
+  size_t i       = 0;
+
+  if(router != NULL && in != NULL && out != NULL) {
+    for(; i < n; i++) {
+      const MIDI_Message msg = in[i];
+
+      if(msg.type >= MIDI_ROUTE_NUM_TYPES || msg.channel < 1 || msg.channel > NUM_CHANNELS) {
+        if(num_out == max) break;
+        out[num_out++] = msg;
+        continue;
+      }
+
+      // the key is the first data byte for the types that have one
+      const uint8_t      key   = has_key(msg.type) ? (msg.data.control_change.control & 0x7f) : 0;
+      const MIDI_Route * route = &(router->routes[msg.type][msg.channel - 1][key]);
+      const size_t       kept  = (route->channel != 0);
+      const size_t       need  = kept + route->num_extra;
+      if(num_out + need + (need == 0) > max) break; // a dropped message is still written, see below
+
+      // whether the rules dropped it or not depends on the message, so write it either way and only count it if kept
+      out[num_out] = route_msg(router, msg, route);
+      num_out += kept;
+      if(route->num_extra != 0) { // copies are the exception, only they take the loop
+        for(size_t j = 0; j < route->num_extra; j++) {
+          out[num_out++] = route_msg(router, msg, &(router->extra[route->first_extra + j]));
+        }
+      }
+    }
+  }
+
+  if(consumed != NULL) *consumed = i;
+  return num_out;
+}
+
+void MIDI_route_linear_values(uint8_t * values, uint16_t scale, int16_t offset, uint8_t min, uint8_t max) {
+  if(values == NULL) return;
+
+  for(int v = 0; v < MIDI_ROUTE_NUM_KEYS; v++) {
+    int mapped = ((v * scale) >> 7) + offset;
+    if(mapped < min) mapped = min;
+    if(mapped > max) mapped = max;
+    values[v] = (uint8_t)((mapped > 0x7f) ? 0x7f : mapped);
+  }
+}
@@ -0,0 +1,172 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "rpn.h"
+#include "held_msb.h"
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define NUM_CHANNELS 16
+
+static MIDI_ParamChange make_change(size_t channel_idx, const MIDI_RpnChannel * state, MIDI_ParamOp op) {
+  const uint16_t value = (op == MIDI_PARAM_SET) ? (uint16_t)((state->data_msb << 7) | state->data_lsb) : 0;
+  return (MIDI_ParamChange){.channel = (uint8_t)(channel_idx + 1),
+                            .kind    = state->kind,
+                            .op      = (uint8_t)op,
+                            .param   = state->param,
+                            .value   = value};
+}
+
+static bool is_selected(const MIDI_RpnChannel * state) {
+  return state->kind != MIDI_PARAM_NONE && state->param != MIDI_RPN_NULL;
+}
+
+// a channel whose data entry MSB is let go writes the selected parameter with that MSB and LSB 0
+static size_t emit_held(MIDI_RpnDecoder * restrict decoder,
+                        MIDI_Timestamp             now,
+                        bool                       check_time,
+                        MIDI_ParamChange *         out,
+                        size_t                     max) {
+  uint8_t      channels[NUM_CHANNELS];
+  const size_t room  = (max < NUM_CHANNELS) ? max : NUM_CHANNELS;
+  const size_t taken = MIDI_INT_held_msb_take(&(decoder->held), decoder->held_since, check_time, now, decoder->timeout,
+                                              channels, room);
+
+  for(size_t i = 0; i < taken; i++) {
+    out[i] = make_change(channels[i], &(decoder->channels[channels[i]]), MIDI_PARAM_SET);
+  }
+
+  return taken;
+}
+
+STAT_Val MIDI_rpn_init(MIDI_RpnDecoder * restrict decoder, MIDI_RpnMode mode, MIDI_Timestamp timeout) {
+  if(decoder == NULL) return LOG_STAT(STAT_ERR_ARGS, "decoder pointer is NULL");
+  if(mode != MIDI_RPN_WAIT_FOR_LSB && mode != MIDI_RPN_MSB_IMMEDIATE) {
+    return LOG_STAT(STAT_ERR_ARGS, "invalid mode %d", mode);
+  }
+
+  *decoder = (MIDI_RpnDecoder){.mode = mode, .timeout = timeout};
+
+  return OK;
+}
+
+MIDI_RpnResult MIDI_rpn_process(MIDI_RpnDecoder * restrict  decoder,
+                                MIDI_Message                msg,
+                                MIDI_Timestamp              now,
+                                MIDI_ParamChange * restrict out) {
+  if(decoder == NULL || out == NULL) return MIDI_RPN_PASS;
+  if(msg.type != MIDI_MSG_TYPE_CONTROL_CHANGE || msg.channel < 1 || msg.channel > NUM_CHANNELS) return MIDI_RPN_PASS;
+
+  const uint8_t control = msg.data.control_change.control;
+  switch(control) {
+  case MIDI_CTRL_DATA_ENTRY:
+  case MIDI_CTRL_DATA_ENTRY_LSB:
+  case MIDI_CTRL_DATA_INCREMENT:
+  case MIDI_CTRL_DATA_DECREMENT:
+  case MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_LSB:
+  case MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_MSB:
+  case MIDI_CTRL_REGISTERED_PARAM_NUMBER_LSB:
+  case MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB: break;
+  default: return MIDI_RPN_PASS;
+  }
+
+  const size_t      ch    = msg.channel - 1;
+  const uint32_t    bit   = 1u << ch;
+  const uint8_t     value = msg.data.control_change.value;
+  MIDI_RpnChannel * state = &(decoder->channels[ch]);
+
+  if(control == MIDI_CTRL_DATA_ENTRY_LSB) {
+    if(!is_selected(state)) return MIDI_RPN_CONSUMED;
+
+    decoder->held &= ~bit;
+    state->data_lsb    = value;
+    state->value_known = true;
+    *out               = make_change(ch, state, MIDI_PARAM_SET);
+    return MIDI_RPN_EMIT;
+  }
+
+  if(control == MIDI_CTRL_DATA_INCREMENT || control == MIDI_CTRL_DATA_DECREMENT) {
+    if(!is_selected(state)) return MIDI_RPN_CONSUMED;
+
+    // a held MSB is folded into the change rather than emitted on its own
+    decoder->held &= ~bit;
+
+    const bool is_increment = control == MIDI_CTRL_DATA_INCREMENT;
+    if(!state->value_known) {
+      *out = make_change(ch, state, is_increment ? MIDI_PARAM_INCREMENT : MIDI_PARAM_DECREMENT);
+      return MIDI_RPN_EMIT;
+    }
+
+    uint16_t current = (uint16_t)((state->data_msb << 7) | state->data_lsb);
+    if(is_increment && current < MIDI_RPN_VALUE_MAX) current++;
+    if(!is_increment && current > 0) current--;
+    state->data_msb = (uint8_t)(current >> 7);
+    state->data_lsb = (uint8_t)(current & 0x7f);
+    *out            = make_change(ch, state, MIDI_PARAM_SET);
+    return MIDI_RPN_EMIT;
+  }
+
+  // anything else ends the wait for the LSB of a held MSB, which goes out as it is
+  const bool was_held = (decoder->held & bit) != 0;
+  if(was_held) {
+    decoder->held &= ~bit;
+    *out = make_change(ch, state, MIDI_PARAM_SET);
+  }
+  const MIDI_RpnResult done = was_held ? MIDI_RPN_EMIT : MIDI_RPN_CONSUMED;
+
+  if(control == MIDI_CTRL_DATA_ENTRY) {
+    if(!is_selected(state)) return done;
+
+    state->data_msb    = value;
+    state->data_lsb    = 0;
+    state->value_known = true;
+    if(decoder->mode == MIDI_RPN_MSB_IMMEDIATE) {
+      *out = make_change(ch, state, MIDI_PARAM_SET);
+      return MIDI_RPN_EMIT;
+    }
+    decoder->held_since[ch] = now;
+    decoder->held |= bit;
+    return done;
+  }
+
+  // one of the parameter numbers, selecting a parameter forgets the value of the previous one
+  const bool is_msb =
+      control == MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_MSB || control == MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB;
+
+  state->param       = is_msb ? (uint16_t)((value << 7) | (state->param & 0x7f))
+                              : (uint16_t)((state->param & (0x7f << 7)) | value);
+  state->kind        = (control >= MIDI_CTRL_REGISTERED_PARAM_NUMBER_LSB) ? MIDI_PARAM_RPN : MIDI_PARAM_NRPN;
+  state->data_msb    = 0;
+  state->data_lsb    = 0;
+  state->value_known = false;
+
+  return done;
+}
+
+size_t MIDI_rpn_poll(MIDI_RpnDecoder * restrict decoder, MIDI_Timestamp now, MIDI_ParamChange * out, size_t max) {
+  if(decoder == NULL || out == NULL || decoder->timeout == 0) return 0;
+  return emit_held(decoder, now, true, out, max);
+}
+
+size_t MIDI_rpn_flush(MIDI_RpnDecoder * restrict decoder, MIDI_ParamChange * out, size_t max) {
+  if(decoder == NULL || out == NULL) return 0;
+  return emit_held(decoder, 0, false, out, max);
+}
@@ -0,0 +1,227 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "smf.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define STATUS_BIT 0x80 // 0b1000'0000
+
+static uint16_t read_u16(const uint8_t * p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static uint32_t read_u32(const uint8_t * p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static bool is_chunk(const uint8_t * chunk, const char * type) { return memcmp(chunk, type, 4) == 0; }
+static bool is_status(uint8_t byte) { return (byte & STATUS_BIT) != 0; }
+
+// program change and channel aftertouch have a single data byte, all other channel messages have two
+static size_t num_data_bytes(uint8_t status) {
+  const uint8_t type = status & 0xf0;
+  return (type == 0xc0 || type == 0xd0) ? 1 : 2;
+}
+
+static size_t header_end(const MIDI_Smf * restrict smf) { return MIDI_SMF_CHUNK_HEADER_SIZE + read_u32(&smf->data[4]); }
+
+static STAT_Val parse_header(MIDI_Smf * restrict smf) {
+  if(smf->size < MIDI_SMF_CHUNK_HEADER_SIZE + MIDI_SMF_HEADER_LENGTH || !is_chunk(smf->data, "MThd")) {
+    return LOG_STAT(STAT_ERR_RANGE, "not a standard MIDI file");
+  }
+
+  const uint32_t len = read_u32(&smf->data[4]);
+  if(len < MIDI_SMF_HEADER_LENGTH || len > smf->size - MIDI_SMF_CHUNK_HEADER_SIZE) {
+    return LOG_STAT(STAT_ERR_RANGE, "invalid header length %u", len);
+  }
+
+  const uint8_t * header = &smf->data[MIDI_SMF_CHUNK_HEADER_SIZE];
+  smf->format            = read_u16(&header[0]);
+  smf->num_tracks        = read_u16(&header[2]);
+  smf->division          = read_u16(&header[4]);
+
+  if(smf->format > 2) return LOG_STAT(STAT_ERR_RANGE, "unsupported format %u", smf->format);
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_open(MIDI_Smf * restrict smf, const char * path) {
+  if(smf == NULL) return LOG_STAT(STAT_ERR_ARGS, "smf pointer is NULL");
+  if(path == NULL) return LOG_STAT(STAT_ERR_ARGS, "path is NULL");
+
+  const int fd = open(path, O_RDONLY);
+  if(fd < 0) return LOG_STAT(STAT_ERR_IO, "can't open %s", path);
+
+  struct stat file_stat;
+  if(fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return LOG_STAT(STAT_ERR_IO, "can't stat %s", path);
+  }
+  if(file_stat.st_size < MIDI_SMF_CHUNK_HEADER_SIZE + MIDI_SMF_HEADER_LENGTH) {
+    close(fd);
+    return LOG_STAT(STAT_ERR_RANGE, "%s is too small to be a standard MIDI file", path);
+  }
+
+  const size_t size = (size_t)file_stat.st_size;
+  void *       data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps its own reference to the file
+  if(data == MAP_FAILED) return LOG_STAT(STAT_ERR_IO, "can't map %s", path);
+
+  *smf = (MIDI_Smf){.data = data, .size = size, .is_mapped = true};
+
+  const STAT_Val st = parse_header(smf);
+  if(st != OK) {
+    munmap(data, size);
+    *smf = (MIDI_Smf){0};
+    return st;
+  }
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_open_buffer(MIDI_Smf * restrict smf, const uint8_t * data, size_t size) {
+  if(smf == NULL) return LOG_STAT(STAT_ERR_ARGS, "smf pointer is NULL");
+  if(data == NULL) return LOG_STAT(STAT_ERR_ARGS, "data pointer is NULL");
+
+  *smf = (MIDI_Smf){.data = data, .size = size, .is_mapped = false};
+
+  return parse_header(smf);
+}
+
+STAT_Val MIDI_smf_close(MIDI_Smf * restrict smf) {
+  if(smf == NULL) return LOG_STAT(STAT_ERR_ARGS, "smf pointer is NULL");
+
+  if(smf->is_mapped && munmap((void *)smf->data, smf->size) != 0) return LOG_STAT(STAT_ERR_IO, "can't unmap file");
+  *smf = (MIDI_Smf){0};
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_get_tracks(const MIDI_Smf * restrict smf,
+                             MIDI_SmfTrack *           tracks,
+                             size_t                    max_tracks,
+                             size_t *                  num_tracks) {
+  if(smf == NULL) return LOG_STAT(STAT_ERR_ARGS, "smf pointer is NULL");
+  if(smf->data == NULL) return LOG_STAT(STAT_ERR_PRECONDITION, "smf is not open");
+  if(tracks == NULL && max_tracks > 0) return LOG_STAT(STAT_ERR_ARGS, "tracks pointer is NULL");
+  if(num_tracks == NULL) return LOG_STAT(STAT_ERR_ARGS, "num_tracks pointer is NULL");
+
+  size_t offset = header_end(smf);
+  size_t n      = 0;
+
+  while(n < max_tracks && (smf->size - offset) >= MIDI_SMF_CHUNK_HEADER_SIZE) {
+    const uint8_t * chunk     = &(smf->data[offset]);
+    const size_t    available = smf->size - offset - MIDI_SMF_CHUNK_HEADER_SIZE;
+    size_t          len       = read_u32(&chunk[4]);
+    if(len > available) len = available; // truncated file, keep what's there
+
+    if(is_chunk(chunk, "MTrk")) tracks[n++] = (MIDI_SmfTrack){.data = &chunk[MIDI_SMF_CHUNK_HEADER_SIZE], .len = len};
+
+    offset += MIDI_SMF_CHUNK_HEADER_SIZE + len;
+  }
+
+  *num_tracks = n;
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_track_iter_init(MIDI_SmfTrackIter * restrict iter, MIDI_SmfTrack track) {
+  if(iter == NULL) return LOG_STAT(STAT_ERR_ARGS, "iter pointer is NULL");
+  if(track.data == NULL && track.len > 0) return LOG_STAT(STAT_ERR_ARGS, "track data pointer is NULL");
+
+  *iter = (MIDI_SmfTrackIter){.pos = track.data, .end = track.data + track.len, .tick = 0, .running_status = 0};
+
+  return MIDI_parser_init_omni(&(iter->parser), MIDI_CHANNEL_MASK_ALL);
+}
+
+// skips the length and data of a meta or SysEx event, pos points just past the type
+static bool skip_sized_event(MIDI_SmfTrackIter * restrict iter) {
+  uint32_t len = 0;
+  if(!MIDI_smf_decode_vlq(&(iter->pos), iter->end, &len)) return false;
+  if(len > (size_t)(iter->end - iter->pos)) return false;
+
+  iter->pos += len;
+
+  return true;
+}
+
+STAT_Val MIDI_smf_track_iter_next(MIDI_SmfTrackIter * restrict iter, MIDI_SmfEvent * restrict event) {
+  if(iter == NULL) return LOG_STAT(STAT_ERR_ARGS, "iter pointer is NULL");
+  if(event == NULL) return LOG_STAT(STAT_ERR_ARGS, "event pointer is NULL");
+
+  while(iter->pos < iter->end) {
+    uint32_t delta = 0;
+    if(!MIDI_smf_decode_vlq(&(iter->pos), iter->end, &delta)) return LOG_STAT(STAT_ERR_RANGE, "invalid delta time");
+    iter->tick += delta;
+
+    if(iter->pos >= iter->end) return LOG_STAT(STAT_ERR_RANGE, "track ends after delta time");
+
+    const uint8_t first = iter->pos[0];
+
+    if(first == MIDI_SMF_META) {
+      if(iter->end - iter->pos < 2) return LOG_STAT(STAT_ERR_RANGE, "truncated meta event");
+      const uint8_t type = iter->pos[1];
+      iter->pos += 2;
+      if(!skip_sized_event(iter)) return LOG_STAT(STAT_ERR_RANGE, "truncated meta event");
+
+      if(type == MIDI_SMF_META_END_OF_TRACK) {
+        iter->pos = iter->end;
+        return STAT_OK_FINISHED;
+      }
+      continue;
+    }
+
+    if(first == MIDI_SMF_SYSEX || first == MIDI_SMF_SYSEX_ESCAPE) {
+      iter->pos++;
+      if(!skip_sized_event(iter)) return LOG_STAT(STAT_ERR_RANGE, "truncated SysEx event");
+      continue;
+    }
+
+    if(first >= 0xf0) return LOG_STAT(STAT_ERR_RANGE, "unexpected status 0x%02x in track", first);
+
+    // frame the channel message here, the parser does the actual decoding
+    if(is_status(first)) iter->running_status = first;
+    if(iter->running_status == 0) return LOG_STAT(STAT_ERR_RANGE, "data byte without running status");
+
+    const size_t num_status = is_status(first) ? 1 : 0;
+    const size_t len        = num_status + num_data_bytes(iter->running_status);
+    if(len > (size_t)(iter->end - iter->pos)) return LOG_STAT(STAT_ERR_RANGE, "truncated channel message");
+    for(size_t i = num_status; i < len; i++) {
+      if(is_status(iter->pos[i])) return LOG_STAT(STAT_ERR_RANGE, "status byte in channel message data");
+    }
+
+    size_t         consumed = 0;
+    const STAT_Val st       = MIDI_parse_bytes(&(iter->parser), iter->pos, len, &consumed);
+    if(st != OK) return st;
+    iter->pos += len;
+
+    if(MIDI_parser_has_output(&(iter->parser))) {
+      *event = (MIDI_SmfEvent){.tick = iter->tick, .msg = MIDI_parser_pop_msg(&(iter->parser))};
+      return OK;
+    }
+  }
+
+  return STAT_OK_FINISHED; // track without an end of track event
+}
@@ -0,0 +1,172 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "smf_timeline.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define MAX_THREADS 64
+
+STAT_Val MIDI_smf_decode_track(MIDI_SmfTrack track, MIDI_SmfTrackEvents * restrict out) {
+  if(out == NULL) return LOG_STAT(STAT_ERR_ARGS, "out pointer is NULL");
+  if(out->events == NULL && out->capacity > 0) return LOG_STAT(STAT_ERR_ARGS, "events pointer is NULL");
+
+  out->num_events = 0;
+
+  MIDI_SmfTrackIter iter;
+  STAT_Val          st = MIDI_smf_track_iter_init(&iter, track);
+
+  while(st == OK) {
+    MIDI_SmfEvent event;
+    st = MIDI_smf_track_iter_next(&iter, &event);
+    if(st != OK) break;
+
+    if(out->num_events == out->capacity) {
+      st = LOG_STAT(STAT_ERR_RANGE, "more than %zu events in track", out->capacity);
+      break;
+    }
+    out->events[out->num_events++] = event;
+  }
+
+  out->stat = (st == STAT_OK_FINISHED) ? OK : st;
+
+  return out->stat;
+}
+
+typedef struct DecodeJob {
+  const MIDI_SmfTrack * tracks;
+  MIDI_SmfTrackEvents * out;
+  size_t                num_tracks;
+  atomic_size_t         next_track;
+} DecodeJob;
+
+// takes tracks until there are none left, so a few long tracks don't leave the other threads idle
+static void * decode_worker(void * arg) {
+  DecodeJob * job = arg;
+
+  for(;;) {
+    const size_t i = atomic_fetch_add_explicit(&(job->next_track), 1, memory_order_relaxed);
+    if(i >= job->num_tracks) break;
+    MIDI_smf_decode_track(job->tracks[i], &(job->out[i]));
+  }
+
+  return NULL;
+}
+
+STAT_Val MIDI_smf_decode_tracks(const MIDI_SmfTrack * tracks,
+                                MIDI_SmfTrackEvents * out,
+                                size_t                num_tracks,
+                                size_t                num_threads) {
+  if(tracks == NULL && num_tracks > 0) return LOG_STAT(STAT_ERR_ARGS, "tracks pointer is NULL");
+  if(out == NULL && num_tracks > 0) return LOG_STAT(STAT_ERR_ARGS, "out pointer is NULL");
+  if(num_threads == 0) return LOG_STAT(STAT_ERR_ARGS, "need at least one thread");
+
+  if(num_threads > num_tracks) num_threads = num_tracks;
+  if(num_threads > MAX_THREADS) num_threads = MAX_THREADS;
+
+  DecodeJob job = {.tracks = tracks, .out = out, .num_tracks = num_tracks};
+  atomic_init(&(job.next_track), 0);
+
+  // the calling thread is one of the workers, if a thread can't be started the others just take more tracks
+  pthread_t threads[MAX_THREADS];
+  size_t    num_started = 0;
+  for(size_t i = 1; i < num_threads; i++) {
+    if(pthread_create(&threads[num_started], NULL, decode_worker, &job) != 0) break;
+    num_started++;
+  }
+
+  decode_worker(&job);
+
+  for(size_t i = 0; i < num_started; i++) pthread_join(threads[i], NULL);
+
+  for(size_t i = 0; i < num_tracks; i++) {
+    if(out[i].stat != OK) return out[i].stat;
+  }
+
+  return OK;
+}
+
+static bool cursor_before(const MIDI_SmfMergeCursor * a, const MIDI_SmfMergeCursor * b) {
+  return (a->tick < b->tick) || (a->tick == b->tick && a->track < b->track);
+}
+
+static void sift_down(MIDI_SmfMergeCursor * heap, size_t len, size_t i) {
+  const MIDI_SmfMergeCursor cursor = heap[i];
+
+  for(;;) {
+    size_t child = 2 * i + 1;
+    if(child >= len) break;
+    if(child + 1 < len && cursor_before(&heap[child + 1], &heap[child])) child++;
+    if(!cursor_before(&heap[child], &cursor)) break;
+
+    heap[i] = heap[child];
+    i       = child;
+  }
+
+  heap[i] = cursor;
+}
+
+STAT_Val MIDI_smf_merge_init(MIDI_SmfMerge * restrict     merge,
+                             const MIDI_SmfTrackEvents * tracks,
+                             size_t                      num_tracks,
+                             MIDI_SmfMergeCursor *       heap) {
+  if(merge == NULL) return LOG_STAT(STAT_ERR_ARGS, "merge pointer is NULL");
+  if(tracks == NULL && num_tracks > 0) return LOG_STAT(STAT_ERR_ARGS, "tracks pointer is NULL");
+  if(heap == NULL && num_tracks > 0) return LOG_STAT(STAT_ERR_ARGS, "heap pointer is NULL");
+
+  *merge = (MIDI_SmfMerge){.tracks = tracks, .heap = heap, .heap_len = 0};
+
+  for(size_t i = 0; i < num_tracks; i++) {
+    if(tracks[i].num_events == 0) continue;
+    heap[merge->heap_len++] = (MIDI_SmfMergeCursor){.tick = tracks[i].events[0].tick, .track = i, .pos = 0};
+  }
+
+  for(size_t i = merge->heap_len / 2; i-- > 0;) sift_down(merge->heap, merge->heap_len, i);
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_merge_next(MIDI_SmfMerge * restrict merge, MIDI_SmfEvent * restrict event, size_t * track) {
+  if(merge == NULL) return LOG_STAT(STAT_ERR_ARGS, "merge pointer is NULL");
+  if(event == NULL) return LOG_STAT(STAT_ERR_ARGS, "event pointer is NULL");
+
+  if(merge->heap_len == 0) return STAT_OK_FINISHED;
+
+  MIDI_SmfMergeCursor *       top = &(merge->heap[0]);
+  const MIDI_SmfTrackEvents * src = &(merge->tracks[top->track]);
+
+  *event = src->events[top->pos];
+  if(track != NULL) *track = top->track;
+
+  // move on in the same track, or drop it once it runs out
+  if(++(top->pos) < src->num_events) {
+    top->tick = src->events[top->pos].tick;
+  } else {
+    *top = merge->heap[--(merge->heap_len)];
+  }
+  sift_down(merge->heap, merge->heap_len, 0);
+
+  return OK;
+}
@@ -0,0 +1,209 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "smf_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define TRACK_LEN_OFFSET  (MIDI_SMF_CHUNK_HEADER_SIZE + MIDI_SMF_HEADER_LENGTH + 4) // length field of the MTrk chunk
+#define MAX_EVENT_SIZE    (MIDI_SMF_VLQ_MAX_SIZE + MIDI_ENCODER_MAX_MSG_SIZE)
+#define MAX_TRACK_LEN     UINT32_MAX
+#define END_OF_TRACK_SIZE 4
+#define DEFAULT_CHANNEL   1
+
+static uint8_t * put_u16(uint8_t * p, uint16_t v) {
+  p[0] = (v >> 8) & 0xff;
+  p[1] = v & 0xff;
+  return p + 2;
+}
+
+static uint8_t * put_u32(uint8_t * p, uint32_t v) {
+  p[0] = (v >> 24) & 0xff;
+  p[1] = (v >> 16) & 0xff;
+  p[2] = (v >> 8) & 0xff;
+  p[3] = v & 0xff;
+  return p + 4;
+}
+
+static uint8_t * put_type(uint8_t * p, const char * type) {
+  for(int i = 0; i < 4; i++) p[i] = (uint8_t)type[i];
+  return p + 4;
+}
+
+// write() until everything is out, it may take less than it's given
+static STAT_Val write_all(MIDI_SmfWriter * restrict writer, const uint8_t * data, size_t len) {
+  while(len > 0) {
+    const ssize_t n = write(writer->fd, data, len);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      return LOG_STAT(STAT_ERR_IO, "can't write to file (errno %d)", errno);
+    }
+    writer->num_writes++;
+    data += n;
+    len -= (size_t)n;
+  }
+
+  return OK;
+}
+
+static STAT_Val flush(MIDI_SmfWriter * restrict writer) {
+  const STAT_Val st = write_all(writer, writer->buffer, writer->len);
+  if(st != OK) return st;
+
+  writer->len = 0;
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_writer_open(MIDI_SmfWriter * restrict writer,
+                              const char *              path,
+                              uint16_t                  division,
+                              uint8_t *                 buffer,
+                              size_t                    capacity) {
+  if(writer == NULL) return LOG_STAT(STAT_ERR_ARGS, "writer pointer is NULL");
+  if(path == NULL) return LOG_STAT(STAT_ERR_ARGS, "path is NULL");
+  if(buffer == NULL) return LOG_STAT(STAT_ERR_ARGS, "buffer pointer is NULL");
+  if(capacity < MIDI_SMF_WRITER_MIN_BUFFER_SIZE) {
+    return LOG_STAT(STAT_ERR_ARGS, "buffer of %zu bytes is smaller than %d", capacity, MIDI_SMF_WRITER_MIN_BUFFER_SIZE);
+  }
+  if(division == 0) return LOG_STAT(STAT_ERR_ARGS, "division can't be 0");
+
+  *writer = (MIDI_SmfWriter){.fd = -1, .buffer = buffer, .capacity = capacity};
+
+  const STAT_Val st = MIDI_encoder_init(&(writer->encoder), DEFAULT_CHANNEL, true);
+  if(st != OK) return st;
+
+  writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(writer->fd < 0) return LOG_STAT(STAT_ERR_IO, "can't create %s", path);
+
+  // the track length is a placeholder until the file is closed
+  uint8_t * p = buffer;
+  p           = put_type(p, "MThd");
+  p           = put_u32(p, MIDI_SMF_HEADER_LENGTH);
+  p           = put_u16(p, 0); // format
+  p           = put_u16(p, 1); // number of tracks
+  p           = put_u16(p, division);
+  p           = put_type(p, "MTrk");
+  p           = put_u32(p, 0);
+  writer->len = (size_t)(p - buffer);
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_writer_write(MIDI_SmfWriter * restrict writer, MIDI_SmfEvent event) {
+  size_t consumed = 0;
+  return MIDI_smf_writer_write_events(writer, &event, 1, &consumed);
+}
+
+STAT_Val MIDI_smf_writer_write_events(MIDI_SmfWriter * restrict writer,
+                                      const MIDI_SmfEvent *     events,
+                                      size_t                    n,
+                                      size_t *                  consumed) {
+  if(writer == NULL) return LOG_STAT(STAT_ERR_ARGS, "writer pointer is NULL");
+  if(events == NULL && n > 0) return LOG_STAT(STAT_ERR_ARGS, "events pointer is NULL");
+  if(consumed == NULL) return LOG_STAT(STAT_ERR_ARGS, "consumed pointer is NULL");
+  if(writer->fd < 0) return LOG_STAT(STAT_ERR_PRECONDITION, "writer is not open");
+
+  *consumed = 0;
+
+  for(size_t i = 0; i < n; i++) {
+    const MIDI_SmfEvent * event = &events[i];
+
+    if(event->msg.type == MIDI_MSG_TYPE_MISC) return LOG_STAT(STAT_ERR_ARGS, "event %zu is not a channel message", i);
+    if(event->tick < writer->last_tick) {
+      return LOG_STAT(STAT_ERR_ARGS, "event %zu at tick %" PRIu64 " is before the previous one", i, event->tick);
+    }
+    const uint64_t delta = event->tick - writer->last_tick;
+    if(delta > MIDI_SMF_VLQ_MAX) return LOG_STAT(STAT_ERR_RANGE, "event %zu is too long after the previous one", i);
+    if(writer->track_len + MAX_EVENT_SIZE + END_OF_TRACK_SIZE > MAX_TRACK_LEN) {
+      return LOG_STAT(STAT_ERR_RANGE, "track is full");
+    }
+
+    if(writer->capacity - writer->len < MAX_EVENT_SIZE) {
+      const STAT_Val st = flush(writer);
+      if(st != OK) return st;
+    }
+
+    // the delta time only counts once the message is encoded as well
+    uint8_t *      out       = &(writer->buffer[writer->len]);
+    const size_t   delta_len = MIDI_smf_encode_vlq((uint32_t)delta, out);
+    size_t         msg_len   = 0;
+    const STAT_Val st =
+        MIDI_encode_msg(&(writer->encoder), event->msg, &out[delta_len], MIDI_ENCODER_MAX_MSG_SIZE, &msg_len);
+    if(st != OK) return st;
+
+    writer->len += delta_len + msg_len;
+    writer->track_len += delta_len + msg_len;
+    writer->last_tick = event->tick;
+    (*consumed)++;
+  }
+
+  return OK;
+}
+
+STAT_Val MIDI_smf_writer_flush(MIDI_SmfWriter * restrict writer) {
+  if(writer == NULL) return LOG_STAT(STAT_ERR_ARGS, "writer pointer is NULL");
+  if(writer->fd < 0) return LOG_STAT(STAT_ERR_PRECONDITION, "writer is not open");
+
+  return flush(writer);
+}
+
+STAT_Val MIDI_smf_writer_close(MIDI_SmfWriter * restrict writer) {
+  if(writer == NULL) return LOG_STAT(STAT_ERR_ARGS, "writer pointer is NULL");
+  if(writer->fd < 0) return LOG_STAT(STAT_ERR_PRECONDITION, "writer is not open");
+
+  if(writer->capacity - writer->len < END_OF_TRACK_SIZE) {
+    const STAT_Val st = flush(writer);
+    if(st != OK) {
+      close(writer->fd);
+      writer->fd = -1;
+      return st;
+    }
+  }
+
+  uint8_t * p = &(writer->buffer[writer->len]);
+  p[0]        = 0x00; // delta time
+  p[1]        = MIDI_SMF_META;
+  p[2]        = MIDI_SMF_META_END_OF_TRACK;
+  p[3]        = 0x00; // length
+  writer->len += END_OF_TRACK_SIZE;
+  writer->track_len += END_OF_TRACK_SIZE;
+
+  STAT_Val st = flush(writer);
+
+  if(st == OK) {
+    uint8_t track_len[4];
+    put_u32(track_len, (uint32_t)writer->track_len);
+    if(pwrite(writer->fd, track_len, sizeof(track_len), TRACK_LEN_OFFSET) != (ssize_t)sizeof(track_len)) {
+      st = LOG_STAT(STAT_ERR_IO, "can't write track length");
+    }
+  }
+
+  if(close(writer->fd) != 0 && st == OK) st = LOG_STAT(STAT_ERR_IO, "can't close file");
+  writer->fd = -1;
+
+  return st;
+}
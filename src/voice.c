@@ -0,0 +1,265 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "voice.h"
+
+#include <string.h>
+
+#include <cfac/log.h>
+
+#define OK STAT_OK
+
+#define SUSTAIN_THRESHOLD 64
+
+static void set_note(MIDI_NoteSet * set, uint8_t note) { set->bits[note >> 6] |= 1ull << (note & 63); }
+static void clear_note(MIDI_NoteSet * set, uint8_t note) { set->bits[note >> 6] &= ~(1ull << (note & 63)); }
+
+// the free and active lists, through prev and next
+
+static void list_append(MIDI_Voice * voices, MIDI_VoiceList * list, uint8_t v) {
+  voices[v].prev = list->tail;
+  voices[v].next = MIDI_VOICE_NONE;
+  if(list->tail != MIDI_VOICE_NONE) voices[list->tail].next = v;
+  else list->head = v;
+  list->tail = v;
+}
+
+static void list_remove(MIDI_Voice * voices, MIDI_VoiceList * list, uint8_t v) {
+  const uint8_t prev = voices[v].prev;
+  const uint8_t next = voices[v].next;
+  if(prev != MIDI_VOICE_NONE) voices[prev].next = next;
+  else list->head = next;
+  if(next != MIDI_VOICE_NONE) voices[next].prev = prev;
+  else list->tail = prev;
+}
+
+// the velocity lists, through prev_vel and next_vel
+
+static void vel_append(MIDI_VoiceAllocator * restrict allocator, uint8_t v) {
+  MIDI_Voice *     voices = allocator->voices;
+  MIDI_VoiceList * list   = &(allocator->by_velocity[voices[v].velocity]);
+
+  voices[v].prev_vel = list->tail;
+  voices[v].next_vel = MIDI_VOICE_NONE;
+  if(list->tail != MIDI_VOICE_NONE) voices[list->tail].next_vel = v;
+  else list->head = v;
+  list->tail = v;
+
+  set_note(&(allocator->velocities), voices[v].velocity);
+}
+
+static void vel_remove(MIDI_VoiceAllocator * restrict allocator, uint8_t v) {
+  MIDI_Voice *     voices = allocator->voices;
+  MIDI_VoiceList * list   = &(allocator->by_velocity[voices[v].velocity]);
+
+  const uint8_t prev = voices[v].prev_vel;
+  const uint8_t next = voices[v].next_vel;
+  if(prev != MIDI_VOICE_NONE) voices[prev].next_vel = next;
+  else list->head = next;
+  if(next != MIDI_VOICE_NONE) voices[next].prev_vel = prev;
+  else list->tail = prev;
+
+  if(list->head == MIDI_VOICE_NONE) clear_note(&(allocator->velocities), voices[v].velocity);
+}
+
+// takes an active voice off its note and out of the active lists
+static void deactivate(MIDI_VoiceAllocator * restrict allocator, uint8_t v) {
+  MIDI_Voice * voice = &(allocator->voices[v]);
+
+  list_remove(allocator->voices, &(allocator->active), v);
+  vel_remove(allocator, v);
+  allocator->note_to_voice[voice->note] = MIDI_VOICE_NONE;
+  clear_note(&(allocator->notes), voice->note);
+}
+
+static uint8_t pick_victim(const MIDI_VoiceAllocator * restrict allocator) {
+  switch(allocator->policy) {
+  case MIDI_STEAL_QUIETEST:
+    return allocator->by_velocity[MIDI_note_set_lowest(&(allocator->velocities))].head;
+  case MIDI_STEAL_LOWEST: return allocator->note_to_voice[MIDI_note_set_lowest(&(allocator->notes))];
+  case MIDI_STEAL_HIGHEST: return allocator->note_to_voice[MIDI_note_set_highest(&(allocator->notes))];
+  default: return allocator->active.head;
+  }
+}
+
+static size_t note_on(MIDI_VoiceAllocator * restrict allocator,
+                      uint8_t                        note,
+                      uint8_t                        velocity,
+                      MIDI_VoiceEvent * restrict     events) {
+  size_t  n = 0;
+  uint8_t v = allocator->note_to_voice[note];
+
+  if(v != MIDI_VOICE_NONE) {
+    deactivate(allocator, v); // played again, retrigger its voice
+  } else if(allocator->free.head != MIDI_VOICE_NONE) {
+    v = allocator->free.head;
+    list_remove(allocator->voices, &(allocator->free), v);
+  } else {
+    v = pick_victim(allocator);
+    deactivate(allocator, v);
+    events[n++] = (MIDI_VoiceEvent){.type = MIDI_VOICE_KILL, .voice = v, .note = allocator->voices[v].note};
+  }
+
+  MIDI_Voice * voice = &(allocator->voices[v]);
+  voice->note        = note;
+  voice->velocity    = velocity;
+  voice->state       = MIDI_VOICE_ON;
+  list_append(allocator->voices, &(allocator->active), v);
+  vel_append(allocator, v);
+  allocator->note_to_voice[note] = v;
+  set_note(&(allocator->notes), note);
+
+  events[n++] = (MIDI_VoiceEvent){.type = MIDI_VOICE_START, .voice = v, .note = note, .velocity = velocity};
+  return n;
+}
+
+static size_t release(MIDI_VoiceAllocator * restrict allocator,
+                      uint8_t                        v,
+                      MIDI_VoiceEventType            type,
+                      MIDI_VoiceEvent * restrict     events) {
+  MIDI_Voice * voice = &(allocator->voices[v]);
+
+  deactivate(allocator, v);
+  voice->state = MIDI_VOICE_FREE;
+  list_append(allocator->voices, &(allocator->free), v);
+
+  events[0] = (MIDI_VoiceEvent){.type = (uint8_t)type, .voice = v, .note = voice->note};
+  return 1;
+}
+
+static size_t note_off(MIDI_VoiceAllocator * restrict allocator, uint8_t note, MIDI_VoiceEvent * restrict events) {
+  const uint8_t v = allocator->note_to_voice[note];
+  if(v == MIDI_VOICE_NONE) return 0;
+
+  if(allocator->sustain) {
+    allocator->voices[v].state = MIDI_VOICE_SUSTAINED;
+    return 0;
+  }
+  return release(allocator, v, MIDI_VOICE_RELEASE, events);
+}
+
+// releases (or kills) every voice that is in state, or every active one if state is MIDI_VOICE_FREE
+static size_t release_all(MIDI_VoiceAllocator * restrict allocator,
+                          MIDI_VoiceState                state,
+                          MIDI_VoiceEventType            type,
+                          MIDI_VoiceEvent * restrict     events) {
+  size_t n = 0;
+
+  for(uint8_t v = allocator->active.head; v != MIDI_VOICE_NONE;) {
+    const uint8_t next = allocator->voices[v].next;
+    if(state == MIDI_VOICE_FREE || allocator->voices[v].state == state) n += release(allocator, v, type, &(events[n]));
+    v = next;
+  }
+
+  return n;
+}
+
+static size_t set_sustain(MIDI_VoiceAllocator * restrict allocator, bool sustain, MIDI_VoiceEvent * restrict events) {
+  const bool was_down = allocator->sustain;
+  allocator->sustain  = sustain;
+  if(!was_down || sustain) return 0;
+
+  return release_all(allocator, MIDI_VOICE_SUSTAINED, MIDI_VOICE_RELEASE, events);
+}
+
+STAT_Val MIDI_voice_init(MIDI_VoiceAllocator * restrict allocator,
+                         MIDI_Channel                   channel,
+                         size_t                         num_voices,
+                         MIDI_StealPolicy               policy) {
+  if(allocator == NULL) return LOG_STAT(STAT_ERR_ARGS, "allocator pointer is NULL");
+  if(channel > 16) return LOG_STAT(STAT_ERR_ARGS, "invalid channel %d", channel);
+  if(num_voices == 0 || num_voices > MIDI_VOICES_MAX) {
+    return LOG_STAT(STAT_ERR_RANGE, "%zu voices, must be 1-%d", num_voices, MIDI_VOICES_MAX);
+  }
+  if(policy > MIDI_STEAL_HIGHEST) return LOG_STAT(STAT_ERR_ARGS, "invalid policy %d", policy);
+
+  allocator->channel    = channel;
+  allocator->policy     = (uint8_t)policy;
+  allocator->num_voices = (uint8_t)num_voices;
+  allocator->sustain    = false;
+  allocator->notes      = (MIDI_NoteSet){0};
+  allocator->velocities = (MIDI_NoteSet){0};
+  allocator->free       = (MIDI_VoiceList){MIDI_VOICE_NONE, MIDI_VOICE_NONE};
+  allocator->active     = (MIDI_VoiceList){MIDI_VOICE_NONE, MIDI_VOICE_NONE};
+  memset(allocator->note_to_voice, MIDI_VOICE_NONE, sizeof(allocator->note_to_voice));
+  memset(allocator->by_velocity, MIDI_VOICE_NONE, sizeof(allocator->by_velocity));
+
+  for(uint8_t v = 0; v < num_voices; v++) {
+    allocator->voices[v] = (MIDI_Voice){.state = MIDI_VOICE_FREE};
+    list_append(allocator->voices, &(allocator->free), v);
+  }
+
+  return OK;
+}
+
+STAT_Val MIDI_voice_process(MIDI_VoiceAllocator * restrict allocator,
+                            MIDI_Message                   msg,
+                            MIDI_VoiceEvent * restrict     events,
+                            size_t                         max,
+                            size_t * restrict              num_events) {
+  if(allocator == NULL || events == NULL || num_events == NULL) return LOG_STAT(STAT_ERR_ARGS, "NULL pointer");
+  if(max < (size_t)allocator->num_voices + 1) {
+    return LOG_STAT(STAT_ERR_ARGS, "room for %zu events, needs %d", max, allocator->num_voices + 1);
+  }
+
+  *num_events = 0;
+  if(allocator->channel != 0 && msg.channel != allocator->channel) return OK;
+
+  switch(msg.type) {
+  case MIDI_MSG_TYPE_NOTE_ON:
+    if(msg.data.note_on.velocity > 0) {
+      *num_events = note_on(allocator, msg.data.note_on.note & 0x7f, msg.data.note_on.velocity & 0x7f, events);
+    } else {
+      *num_events = note_off(allocator, msg.data.note_on.note & 0x7f, events);
+    }
+    break;
+
+  case MIDI_MSG_TYPE_NOTE_OFF: *num_events = note_off(allocator, msg.data.note_off.note & 0x7f, events); break;
+
+  case MIDI_MSG_TYPE_CONTROL_CHANGE:
+    switch(msg.data.control_change.control) {
+    case MIDI_CTRL_DAMPER_PEDAL_ON_OFF:
+      *num_events = set_sustain(allocator, msg.data.control_change.value >= SUSTAIN_THRESHOLD, events);
+      break;
+    case MIDI_CTRL_RESET_ALL_CONTROLLERS: *num_events = set_sustain(allocator, false, events); break;
+    case MIDI_CTRL_ALL_SOUND_OFF:
+      *num_events = release_all(allocator, MIDI_VOICE_FREE, MIDI_VOICE_KILL, events);
+      break;
+    case MIDI_CTRL_ALL_NOTES_OFF:
+    case MIDI_CTRL_OMNI_MODE_ON:
+    case MIDI_CTRL_OMNI_MODE_OFF:
+    case MIDI_CTRL_MONO_MODE:
+    case MIDI_CTRL_POLY_MODE:
+      if(allocator->sustain) {
+        for(uint8_t v = allocator->active.head; v != MIDI_VOICE_NONE; v = allocator->voices[v].next) {
+          allocator->voices[v].state = MIDI_VOICE_SUSTAINED;
+        }
+      } else {
+        *num_events = release_all(allocator, MIDI_VOICE_FREE, MIDI_VOICE_RELEASE, events);
+      }
+      break;
+    default: break;
+    }
+    break;
+
+  default: break;
+  }
+
+  return OK;
+}
@@ -0,0 +1,508 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Runs a raw MIDI capture through the parser, to debug what a device sent us. It does one of:
+//   dump        print every message with its time
+//   replay      write the messages to stdout at their original times (or faster, see -s), e.g. into a MIDI port
+//   throughput  only parse, and report how fast that went
+//
+// usage: midi_capture <dump|replay|throughput> [-c channel] [-t] [-s speed] [-n passes] <capture, or - for stdin>
+//   -c  parse only this channel (1-16), all channels by default
+//   -t  the capture is timestamped chunks, see below
+//   -s  replay speed, 1 (default) for the original timing, 2 for twice as fast, 0 for as fast as possible
+//   -n  number of times to parse the capture for throughput, it has to be a file for more than one
+//
+// A capture is the raw bytes as they came off the wire, or with -t, a sequence of chunks as e.g. a driver handed them
+// over: a 64-bit time in nanoseconds, a 32-bit length and then that many bytes, both numbers little-endian. Raw bytes
+// carry no time, they're taken to have come in back to back at the MIDI wire rate.
+//
+// Files are mapped into memory, so captures of many GB are parsed without copying them, stdin is read in big blocks.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "encoder.h"
+#include "parser.h"
+
+#define WIRE_BYTE_NS      320000    // 10 bits per byte at 31250 baud
+#define READ_BLOCK_SIZE   (1 << 20) // for input that can't be mapped
+#define CHUNK_HEADER_SIZE 12        // 64-bit time and 32-bit length
+#define PARSER_BUFFER     1024      // messages buffered in the parser before we have to drain it
+#define POP_BATCH         256
+#define REPLAY_OUT_SIZE   (1 << 16)
+
+typedef enum Mode {
+  MODE_DUMP,
+  MODE_REPLAY,
+  MODE_THROUGHPUT,
+} Mode;
+
+typedef struct Options {
+  Mode         mode;
+  MIDI_Channel channel;     // 0 for all channels
+  bool         timestamped; // capture is made of timestamped chunks
+  double       speed;       // replay speed, 0 to not wait at all
+  long         passes;      // for throughput
+  const char * path;
+} Options;
+
+typedef struct Source {
+  int             fd;
+  const uint8_t * map; // the whole file if it could be mapped, NULL if it's read in blocks
+  size_t          map_len;
+  bool            map_done;
+  uint8_t *       block;
+  bool            failed;
+} Source;
+
+// splits timestamped captures into chunks, a chunk may be spread over any number of blocks read from stdin
+typedef struct ChunkReader {
+  uint8_t        header[CHUNK_HEADER_SIZE];
+  size_t         header_len;
+  MIDI_Timestamp time;
+  size_t         remaining; // bytes left of the current chunk
+} ChunkReader;
+
+typedef struct App {
+  Options        options;
+  MIDI_Parser    parser;
+  MIDI_Message   msgs[PARSER_BUFFER];
+  MIDI_Timestamp times[PARSER_BUFFER];
+  uint64_t       num_bytes;
+  uint64_t       num_msgs;
+  uint64_t       raw_offset; // bytes of a raw capture parsed so far, their times follow from it
+
+  // replay only
+  MIDI_Encoder   encoder;
+  bool           started;
+  MIDI_Timestamp first_time;
+  double         start_seconds;
+  uint8_t        out[REPLAY_OUT_SIZE];
+  size_t         out_len;
+  bool           failed;
+} App;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+static size_t min_size(size_t a, size_t b) { return (a < b) ? a : b; }
+
+static uint64_t read_le(const uint8_t * bytes, size_t n) {
+  uint64_t value = 0;
+  for(size_t i = 0; i < n; i++) value |= (uint64_t)bytes[i] << (8 * i);
+  return value;
+}
+
+// --- input ---
+
+static bool source_open(Source * src, const char * path) {
+  *src = (Source){.fd = STDIN_FILENO};
+
+  if(strcmp(path, "-") != 0) {
+    src->fd = open(path, O_RDONLY);
+    if(src->fd < 0) {
+      fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+      return false;
+    }
+  }
+
+  struct stat info;
+  if(fstat(src->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void * map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, src->fd, 0);
+    if(map != MAP_FAILED) {
+      madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);
+      src->map     = map;
+      src->map_len = (size_t)info.st_size;
+      return true;
+    }
+  }
+
+  src->block = malloc(READ_BLOCK_SIZE);
+  if(src->block == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return false;
+  }
+  return true;
+}
+
+// Points data at the next part of the input and returns its length, 0 at the end (or on an error, see failed).
+static size_t source_next(Source * src, const uint8_t ** data) {
+  if(src->map != NULL) {
+    if(src->map_done) return 0;
+    src->map_done = true;
+    *data         = src->map;
+    return src->map_len;
+  }
+
+  ssize_t len = 0;
+  do {
+    len = read(src->fd, src->block, READ_BLOCK_SIZE);
+  } while(len < 0 && errno == EINTR);
+
+  if(len < 0) {
+    fprintf(stderr, "can't read input: %s\n", strerror(errno));
+    src->failed = true;
+    return 0;
+  }
+
+  *data = src->block;
+  return (size_t)len;
+}
+
+static bool source_rewind(Source * src) {
+  if(src->map != NULL) {
+    src->map_done = false;
+    return true;
+  }
+  return lseek(src->fd, 0, SEEK_SET) == 0;
+}
+
+static void source_close(Source * src) {
+  if(src->map != NULL) munmap((void *)src->map, src->map_len);
+  free(src->block);
+  if(src->fd != STDIN_FILENO) close(src->fd);
+}
+
+// --- replay output ---
+
+static void flush_out(App * app) {
+  size_t done = 0;
+  while(done < app->out_len && !app->failed) {
+    const ssize_t len = write(STDOUT_FILENO, &(app->out[done]), app->out_len - done);
+    if(len < 0 && errno == EINTR) continue;
+    if(len < 0) {
+      fprintf(stderr, "can't write output: %s\n", strerror(errno));
+      app->failed = true;
+    } else {
+      done += (size_t)len;
+    }
+  }
+  app->out_len = 0;
+}
+
+static void put_bytes(App * app, const uint8_t * bytes, size_t n) {
+  while(n > 0) {
+    if(app->out_len == REPLAY_OUT_SIZE) flush_out(app);
+
+    const size_t len = min_size(n, REPLAY_OUT_SIZE - app->out_len);
+    memcpy(&(app->out[app->out_len]), bytes, len);
+    app->out_len += len;
+    bytes += len;
+    n -= len;
+  }
+}
+
+// waits for the moment the byte at time is due, relative to the first one. A clock that steps back (or captures that
+// were put one after the other) starts the timing over from there, rather than waiting for a time that has passed.
+static void wait_until(App * app, MIDI_Timestamp time) {
+  if(app->options.speed <= 0.0) return;
+
+  if(!app->started || time < app->first_time) {
+    app->started       = true;
+    app->first_time    = time;
+    app->start_seconds = now_seconds();
+    return;
+  }
+
+  const double due = app->start_seconds + ((double)(time - app->first_time) * 1e-9 / app->options.speed);
+  if(due <= now_seconds()) return;
+
+  flush_out(app); // everything before this has to go out on time as well
+
+  const struct timespec ts = {.tv_sec = (time_t)due, .tv_nsec = (long)((due - (double)(time_t)due) * 1e9)};
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+// --- parsing ---
+
+static void dump_msg(MIDI_TimedMessage tm) {
+  char      str[64];
+  const int len = MIDI_message_to_str_buffer_short(str, sizeof(str), tm.msg);
+
+  printf("%16.6f ", (double)tm.timestamp * 1e-9);
+  if(tm.msg.channel != 0) {
+    printf("ch%-2u ", tm.msg.channel);
+  } else {
+    printf("     ");
+  }
+  printf("%.*s\n", len, str);
+}
+
+static void replay_msg(App * app, MIDI_TimedMessage tm) {
+  uint8_t bytes[MIDI_ENCODER_MAX_MSG_SIZE];
+  size_t  written = 0;
+
+  wait_until(app, tm.timestamp);
+  if(MIDI_encode_msg(&(app->encoder), tm.msg, bytes, sizeof(bytes), &written) == STAT_OK) {
+    put_bytes(app, bytes, written);
+  }
+}
+
+static void drain(App * app) {
+  if(app->options.mode == MODE_THROUGHPUT) {
+    app->num_msgs += MIDI_parser_commit_msgs(&(app->parser), PARSER_BUFFER);
+    return;
+  }
+
+  MIDI_TimedMessage msgs[POP_BATCH];
+  size_t            n = 0;
+  while((n = MIDI_parser_pop_timed_msgs(&(app->parser), msgs, POP_BATCH)) > 0) {
+    app->num_msgs += n;
+    for(size_t i = 0; i < n; i++) {
+      if(app->options.mode == MODE_DUMP) {
+        dump_msg(msgs[i]);
+      } else {
+        replay_msg(app, msgs[i]);
+      }
+    }
+  }
+}
+
+static void on_sysex(void * context, MIDI_SysExEvent event, const uint8_t * data, size_t len) {
+  App *                app  = (App *)context;
+  const MIDI_Timestamp time = app->parser.msg_buffer.now;
+
+  // messages that came in before this part of the dump go first, real-time ones can come in the middle of it
+  drain(app);
+
+  if(app->options.mode == MODE_DUMP) {
+    if(event == MIDI_SYSEX_END) printf("%16.6f      SYSEX{%zu bytes}\n", (double)time * 1e-9, len);
+    if(event == MIDI_SYSEX_ABORT) printf("%16.6f      SYSEX{%zu bytes, aborted}\n", (double)time * 1e-9, len);
+    return;
+  }
+
+  switch(event) {
+  case MIDI_SYSEX_START:
+    wait_until(app, time);
+    put_bytes(app, (const uint8_t[]){0xf0}, 1);
+    MIDI_encoder_reset(&(app->encoder));
+    break;
+  case MIDI_SYSEX_CHUNK: put_bytes(app, data, len); break;
+  case MIDI_SYSEX_END: put_bytes(app, (const uint8_t[]){0xf7}, 1); break;
+  case MIDI_SYSEX_ABORT: break; // the status byte that cut it short ends it on the other side just the same
+  }
+}
+
+static bool init_parser(App * app) {
+  MIDI_Parser * parser = &(app->parser);
+
+  STAT_Val res = (app->options.channel != 0) ? MIDI_parser_init(parser, app->options.channel)
+                                             : MIDI_parser_init_omni(parser, MIDI_CHANNEL_MASK_ALL);
+  if(res == STAT_OK) res = MIDI_parser_set_buffer(parser, app->msgs, PARSER_BUFFER);
+  if(res == STAT_OK && app->options.mode != MODE_THROUGHPUT) {
+    res = MIDI_parser_set_timestamp_buffer(parser, app->times, PARSER_BUFFER);
+    if(res == STAT_OK) res = MIDI_parser_set_sysex_callback(parser, on_sysex, app);
+  }
+  if(res == STAT_OK) res = MIDI_encoder_init(&(app->encoder), 1, false);
+
+  return res == STAT_OK;
+}
+
+// Parses n bytes, the first of which came in at time, and every next one ns_per_byte later.
+static void parse(App * app, const uint8_t * bytes, size_t n, MIDI_Timestamp time, uint64_t ns_per_byte) {
+  const MIDI_Timestamp last = time + ((n > 0) ? (n - 1) * ns_per_byte : 0);
+
+  size_t i = 0;
+  while(i < n) {
+    size_t consumed = 0;
+    if(app->options.mode == MODE_THROUGHPUT) {
+      MIDI_parse_bytes(&(app->parser), &(bytes[i]), n - i, &consumed);
+    } else {
+      MIDI_parse_chunk_timed(&(app->parser), &(bytes[i]), n - i, time + (i * ns_per_byte), last, &consumed);
+    }
+    i += consumed;
+    drain(app);
+  }
+  app->num_bytes += n;
+}
+
+static void parse_chunks(App * app, ChunkReader * reader, const uint8_t * data, size_t len) {
+  while(len > 0) {
+    if(reader->remaining == 0) {
+      const size_t n = min_size(CHUNK_HEADER_SIZE - reader->header_len, len);
+      memcpy(&(reader->header[reader->header_len]), data, n);
+      reader->header_len += n;
+      data += n;
+      len -= n;
+
+      if(reader->header_len == CHUNK_HEADER_SIZE) {
+        reader->time       = read_le(reader->header, 8);
+        reader->remaining  = (size_t)read_le(&(reader->header[8]), 4);
+        reader->header_len = 0;
+      }
+      continue;
+    }
+
+    // all bytes of a chunk were handed over at once, so they all get its time
+    const size_t n = min_size(reader->remaining, len);
+    parse(app, data, n, reader->time, 0);
+    data += n;
+    len -= n;
+    reader->remaining -= n;
+  }
+}
+
+static bool run_pass(App * app, Source * src) {
+  if(!init_parser(app)) {
+    fprintf(stderr, "can't set up the parser\n");
+    return false;
+  }
+  app->raw_offset = 0;
+
+  ChunkReader     reader = {0};
+  const uint8_t * data   = NULL;
+  size_t          len    = 0;
+  while((len = source_next(src, &data)) > 0) {
+    if(app->options.timestamped) {
+      parse_chunks(app, &reader, data, len);
+    } else {
+      parse(app, data, len, app->raw_offset * WIRE_BYTE_NS, WIRE_BYTE_NS);
+      app->raw_offset += len;
+    }
+    if(app->failed) return false;
+  }
+
+  if(reader.header_len != 0 || reader.remaining != 0) fprintf(stderr, "capture ends in the middle of a chunk\n");
+
+  return !src->failed;
+}
+
+static int run_throughput(App * app, Source * src) {
+  double best = 0.0;
+
+  for(long pass = 0; pass < app->options.passes; pass++) {
+    if(pass > 0 && !source_rewind(src)) {
+      fprintf(stderr, "can't parse the input again, it has to be a file for more than one pass\n");
+      return 1;
+    }
+
+    app->num_bytes = 0;
+    app->num_msgs  = 0;
+
+    const double start = now_seconds();
+    if(!run_pass(app, src)) return 1;
+    const double seconds = now_seconds() - start;
+
+    const double mb_per_s = (seconds > 0.0) ? ((double)app->num_bytes * 1e-6 / seconds) : 0.0;
+    if(mb_per_s > best) best = mb_per_s;
+
+    printf("pass %ld: %llu bytes, %llu messages in %.3f s, %.2f MB/s, %.2f Mmsgs/s, %.2f ns/byte\n",
+           pass + 1,
+           (unsigned long long)app->num_bytes,
+           (unsigned long long)app->num_msgs,
+           seconds,
+           mb_per_s,
+           (seconds > 0.0) ? ((double)app->num_msgs * 1e-6 / seconds) : 0.0,
+           (app->num_bytes > 0) ? (seconds * 1e9 / (double)app->num_bytes) : 0.0);
+  }
+
+  if(app->options.passes > 1) printf("best: %.2f MB/s\n", best);
+  return 0;
+}
+
+// --- command line ---
+
+static void print_usage(const char * name) {
+  fprintf(stderr,
+          "usage: %s <dump|replay|throughput> [-c channel] [-t] [-s speed] [-n passes] <capture, or - for stdin>\n",
+          name);
+}
+
+static bool parse_options(int argc, char ** argv, Options * options) {
+  *options = (Options){.speed = 1.0, .passes = 1};
+  if(argc < 2) return false;
+
+  if(strcmp(argv[1], "dump") == 0) {
+    options->mode = MODE_DUMP;
+  } else if(strcmp(argv[1], "replay") == 0) {
+    options->mode = MODE_REPLAY;
+  } else if(strcmp(argv[1], "throughput") == 0) {
+    options->mode = MODE_THROUGHPUT;
+  } else {
+    return false;
+  }
+
+  int opt = 0;
+  optind  = 2;
+  while((opt = getopt(argc, argv, "c:ts:n:")) != -1) {
+    switch(opt) {
+    case 'c': {
+      const long channel = strtol(optarg, NULL, 10);
+      if(channel < 1 || channel > 16) return false;
+      options->channel = (MIDI_Channel)channel;
+      break;
+    }
+    case 't': options->timestamped = true; break;
+    case 's':
+      options->speed = strtod(optarg, NULL);
+      if(options->speed < 0.0) return false;
+      break;
+    case 'n':
+      options->passes = strtol(optarg, NULL, 10);
+      if(options->passes < 1) return false;
+      break;
+    default: return false;
+    }
+  }
+
+  if(optind != argc - 1) return false;
+  options->path = argv[optind];
+
+  return true;
+}
+
+int main(int argc, char ** argv) {
+  static App app; // too big for the stack of some systems, and the parser can't move once its buffer is set
+
+  if(!parse_options(argc, argv, &(app.options))) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  Source src;
+  if(!source_open(&src, app.options.path)) return 1;
+
+  int res = 0;
+  if(app.options.mode == MODE_THROUGHPUT) {
+    res = run_throughput(&app, &src);
+  } else {
+    static char stdout_buffer[1 << 16];
+    setvbuf(stdout, stdout_buffer, _IOFBF, sizeof(stdout_buffer));
+
+    res = run_pass(&app, &src) ? 0 : 1;
+    flush_out(&app);
+    if(app.failed) res = 1;
+  }
+
+  source_close(&src);
+  return res;
+}
@@ -0,0 +1,219 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OK STAT_OK
+
+#include "cc14.h"
+#include "test_msgs.h"
+
+static Result expect_cc14(MIDI_ControlChange14 cc14, MIDI_Channel channel, uint8_t control, uint16_t value) {
+  Result r = PASS;
+
+  EXPECT_EQ(&r, channel, cc14.channel);
+  EXPECT_EQ(&r, control, cc14.control);
+  EXPECT_EQ(&r, value, cc14.value);
+
+  return r;
+}
+
+static Result tst_pairs(void) {
+  Result r = PASS;
+
+  MIDI_Cc14Pairer pairer;
+  EXPECT_EQ(&r, OK, MIDI_cc14_init(&pairer, MIDI_CC14_DEFINED_CONTROLS, MIDI_CC14_WAIT_FOR_LSB, 0));
+
+  MIDI_ControlChange14 out = {0};
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_MOD_WHEEL, 0x12), 0, &out));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_MOD_WHEEL_LSB, 0x34), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 1, MIDI_CTRL_MOD_WHEEL, (0x12 << 7) | 0x34));
+
+  // an LSB on its own goes with the last MSB
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_MOD_WHEEL_LSB, 0x35), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 1, MIDI_CTRL_MOD_WHEEL, (0x12 << 7) | 0x35));
+
+  // or with 0 if there wasn't any
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(2, MIDI_CTRL_VOLUME_LSB, 0x7f), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 2, MIDI_CTRL_VOLUME, 0x7f));
+
+  // channels and controllers are kept apart
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(16, MIDI_CTRL_GENERAL_D, 0x7f), 0, &out));
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(3, MIDI_CTRL_GENERAL_D, 0x01), 0, &out));
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(16, MIDI_CTRL_BANK_SELECT, 0x02), 0, &out));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(16, MIDI_CTRL_GENERAL_D_LSB, 0x7f), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 16, MIDI_CTRL_GENERAL_D, 0x3fff));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(3, MIDI_CTRL_GENERAL_D_LSB, 0x00), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 3, MIDI_CTRL_GENERAL_D, 0x01 << 7));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(16, MIDI_CTRL_BANK_SELECT_LSB, 0x03), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 16, MIDI_CTRL_BANK_SELECT, (0x02 << 7) | 0x03));
+
+  // a second MSB lets the first one go without its LSB
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_PAN, 0x40), 0, &out));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_PAN, 0x41), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 1, MIDI_CTRL_PAN, 0x40 << 7));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_PAN_LSB, 0x01), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 1, MIDI_CTRL_PAN, (0x41 << 7) | 0x01));
+
+  return r;
+}
+
+static Result tst_pass(void) {
+  Result r = PASS;
+
+  MIDI_Cc14Pairer pairer;
+  EXPECT_EQ(&r, OK, MIDI_cc14_init(&pairer, 1u << MIDI_CTRL_MOD_WHEEL, MIDI_CC14_WAIT_FOR_LSB, 0));
+
+  const MIDI_Message passed[] = {
+      cc(1, MIDI_CTRL_VOLUME, 1),     // not paired
+      cc(1, MIDI_CTRL_VOLUME_LSB, 1), // not paired
+      cc(1, MIDI_CTRL_DAMPER_PEDAL_ON_OFF, 127),
+      cc(1, MIDI_CTRL_UNDEFINED3, 1),
+      cc(0, MIDI_CTRL_MOD_WHEEL, 1), // no channel
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .channel = 1, .data.note_on = {.note = MIDI_CTRL_MOD_WHEEL, .velocity = 1}},
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 1, .data.pitch_bend = {.value = 1}},
+  };
+
+  for(size_t i = 0; i < sizeof(passed) / sizeof(passed[0]); i++) {
+    MIDI_ControlChange14 out = {0};
+    EXPECT_EQ(&r, MIDI_CC14_PASS, MIDI_cc14_process(&pairer, passed[i], 0, &out));
+  }
+
+  MIDI_ControlChange14 out[4];
+  EXPECT_EQ(&r, 0, MIDI_cc14_flush(&pairer, out, 4));
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_cc14_init(NULL, 0, MIDI_CC14_WAIT_FOR_LSB, 0));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_cc14_init(&pairer, 0, (MIDI_Cc14Mode)7, 0));
+
+  return r;
+}
+
+static Result tst_timeout(void) {
+  Result r = PASS;
+
+  MIDI_Cc14Pairer pairer;
+  EXPECT_EQ(&r, OK, MIDI_cc14_init(&pairer, MIDI_CC14_DEFINED_CONTROLS, MIDI_CC14_WAIT_FOR_LSB, 100));
+
+  MIDI_ControlChange14 out[4];
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_VOLUME, 10), 1000, &out[0]));
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(5, MIDI_CTRL_EXPRESSION, 20), 1050, &out[0]));
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(5, MIDI_CTRL_BREATH_CONTROL, 30), 1090, &out[0]));
+
+  EXPECT_EQ(&r, 0, MIDI_cc14_poll(&pairer, 1099, out, 4));
+  EXPECT_EQ(&r, 0, MIDI_cc14_poll(&pairer, 500, out, 4)); // a clock that went back doesn't expire anything
+
+  EXPECT_EQ(&r, 1, MIDI_cc14_poll(&pairer, 1100, out, 4));
+  EXPECT_EQ(&r, PASS, expect_cc14(out[0], 1, MIDI_CTRL_VOLUME, 10 << 7));
+
+  // as many as fit, the rest on the next call
+  EXPECT_EQ(&r, 1, MIDI_cc14_poll(&pairer, 2000, out, 1));
+  EXPECT_EQ(&r, PASS, expect_cc14(out[0], 5, MIDI_CTRL_BREATH_CONTROL, 30 << 7));
+  EXPECT_EQ(&r, 1, MIDI_cc14_poll(&pairer, 2000, out, 1));
+  EXPECT_EQ(&r, PASS, expect_cc14(out[0], 5, MIDI_CTRL_EXPRESSION, 20 << 7));
+  EXPECT_EQ(&r, 0, MIDI_cc14_poll(&pairer, 2000, out, 1));
+
+  // until a poll lets it go, an MSB waits for its LSB however long that takes
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(2, MIDI_CTRL_VOLUME, 40), 1000, &out[0]));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(2, MIDI_CTRL_VOLUME_LSB, 1), 5000, &out[0]));
+  EXPECT_EQ(&r, PASS, expect_cc14(out[0], 2, MIDI_CTRL_VOLUME, (40 << 7) | 1));
+  EXPECT_EQ(&r, 0, MIDI_cc14_poll(&pairer, 5000, out, 4));
+
+  // a late LSB still refines the value
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_VOLUME_LSB, 5), 2001, &out[0]));
+  EXPECT_EQ(&r, PASS, expect_cc14(out[0], 1, MIDI_CTRL_VOLUME, (10 << 7) | 5));
+
+  // without a timeout, only flush lets go
+  EXPECT_EQ(&r, OK, MIDI_cc14_init(&pairer, MIDI_CC14_DEFINED_CONTROLS, MIDI_CC14_WAIT_FOR_LSB, 0));
+  EXPECT_EQ(&r, MIDI_CC14_HELD, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_VOLUME, 10), 0, &out[0]));
+  EXPECT_EQ(&r, 0, MIDI_cc14_poll(&pairer, UINT64_MAX, out, 4));
+  EXPECT_EQ(&r, 1, MIDI_cc14_flush(&pairer, out, 4));
+  EXPECT_EQ(&r, 0, MIDI_cc14_flush(&pairer, out, 4));
+
+  return r;
+}
+
+static Result tst_msb_immediate(void) {
+  Result r = PASS;
+
+  MIDI_Cc14Pairer pairer;
+  EXPECT_EQ(&r, OK, MIDI_cc14_init(&pairer, MIDI_CC14_DEFINED_CONTROLS, MIDI_CC14_MSB_IMMEDIATE, 0));
+
+  MIDI_ControlChange14 out = {0};
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_MOD_WHEEL, 0x12), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 1, MIDI_CTRL_MOD_WHEEL, 0x12 << 7));
+  EXPECT_EQ(&r, MIDI_CC14_EMIT, MIDI_cc14_process(&pairer, cc(1, MIDI_CTRL_MOD_WHEEL_LSB, 0x34), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_cc14(out, 1, MIDI_CTRL_MOD_WHEEL, (0x12 << 7) | 0x34));
+
+  MIDI_ControlChange14 flushed[4];
+  EXPECT_EQ(&r, 0, MIDI_cc14_flush(&pairer, flushed, 4));
+
+  return r;
+}
+
+// behind a parser, a stream of paired updates halves the number of messages
+static Result tst_behind_parser(void) {
+  Result r = PASS;
+
+  MIDI_Cc14Pairer pairer;
+  EXPECT_EQ(&r, OK, MIDI_cc14_init(&pairer, MIDI_CC14_DEFINED_CONTROLS, MIDI_CC14_WAIT_FOR_LSB, 0));
+
+  uint8_t bytes[1 + 4 * 8];
+  size_t  n = 0;
+  bytes[n++] = 0xb3; // channel 4, running status from here on
+  for(uint16_t i = 0; i < 8; i++) {
+    const uint16_t value = (uint16_t)(i * 2000);
+    bytes[n++]           = MIDI_CTRL_BREATH_CONTROL;
+    bytes[n++]           = (value >> 7) & 0x7f;
+    bytes[n++]           = MIDI_CTRL_BREATH_CONTROL_LSB;
+    bytes[n++]           = value & 0x7f;
+  }
+
+  MIDI_Message msgs[2 * 8];
+  const size_t num_msgs = parse_msgs(bytes, n, msgs, 2 * 8);
+  EXPECT_EQ(&r, 2 * 8, num_msgs);
+
+  size_t num_emitted = 0;
+  for(size_t i = 0; i < num_msgs; i++) {
+    MIDI_ControlChange14 out;
+    if(MIDI_cc14_process(&pairer, msgs[i], 0, &out) == MIDI_CC14_EMIT) {
+      EXPECT_EQ(&r, PASS, expect_cc14(out, 4, MIDI_CTRL_BREATH_CONTROL, (uint16_t)(num_emitted * 2000)));
+      num_emitted++;
+    }
+  }
+  EXPECT_EQ(&r, 8, num_emitted);
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_pairs,
+      tst_pass,
+      tst_timeout,
+      tst_msb_immediate,
+      tst_behind_parser,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
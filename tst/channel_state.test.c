@@ -0,0 +1,266 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OK STAT_OK
+
+#include "channel_state.h"
+#include "test_msgs.h"
+
+static Result tst_note_set(void) {
+  Result r = PASS;
+
+  MIDI_NoteSet set = {0};
+  EXPECT_TRUE(&r, MIDI_note_set_is_empty(&set));
+  EXPECT_EQ(&r, 0, MIDI_note_set_count(&set));
+
+  const uint8_t notes[] = {0, 1, 63, 64, 100, 127};
+  for(size_t i = 0; i < sizeof(notes); i++) set.bits[notes[i] >> 6] |= 1ull << (notes[i] & 63);
+
+  EXPECT_FALSE(&r, MIDI_note_set_is_empty(&set));
+  EXPECT_EQ(&r, sizeof(notes), MIDI_note_set_count(&set));
+  EXPECT_TRUE(&r, MIDI_note_set_contains(&set, 63));
+  EXPECT_TRUE(&r, MIDI_note_set_contains(&set, 64));
+  EXPECT_FALSE(&r, MIDI_note_set_contains(&set, 65));
+  EXPECT_EQ(&r, 0, MIDI_note_set_lowest(&set));
+  EXPECT_EQ(&r, 127, MIDI_note_set_highest(&set));
+
+  const MIDI_NoteSet low  = {{1ull << 5, 0}};
+  const MIDI_NoteSet high = {{0, 1ull << 5}};
+  EXPECT_EQ(&r, 5, MIDI_note_set_highest(&low));
+  EXPECT_EQ(&r, 69, MIDI_note_set_lowest(&high));
+
+  uint8_t array[MIDI_NUM_NOTES];
+  EXPECT_EQ(&r, sizeof(notes), MIDI_note_set_to_array(&set, array));
+  for(size_t i = 0; i < sizeof(notes); i++) EXPECT_EQ(&r, notes[i], array[i]);
+
+  for(size_t i = 0; i < sizeof(notes); i++) EXPECT_EQ(&r, notes[i], MIDI_note_set_pop_lowest(&set));
+  EXPECT_TRUE(&r, MIDI_note_set_is_empty(&set));
+
+  return r;
+}
+
+static Result tst_notes(void) {
+  Result r = PASS;
+
+  MIDI_ChannelState state;
+  EXPECT_EQ(&r, OK, MIDI_channel_state_init(&state, 3));
+  EXPECT_EQ(&r, 0, MIDI_channel_state_num_held(&state));
+
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(3, MIDI_NOTE_C_4, 100)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(3, MIDI_NOTE_E_4, 90)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(3, 127, 1)));
+  EXPECT_FALSE(&r, MIDI_channel_state_process(&state, note_on(4, MIDI_NOTE_G_4, 80)));
+
+  EXPECT_EQ(&r, 3, MIDI_channel_state_num_held(&state));
+  EXPECT_TRUE(&r, MIDI_channel_state_is_held(&state, MIDI_NOTE_C_4));
+  EXPECT_FALSE(&r, MIDI_channel_state_is_held(&state, MIDI_NOTE_G_4));
+  EXPECT_EQ(&r, 100, MIDI_channel_state_velocity(&state, MIDI_NOTE_C_4));
+  EXPECT_EQ(&r, 1, MIDI_channel_state_velocity(&state, 127));
+
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_off(3, MIDI_NOTE_C_4, 0)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(3, MIDI_NOTE_E_4, 0)));
+  EXPECT_EQ(&r, 1, MIDI_channel_state_num_held(&state));
+  EXPECT_EQ(&r, 0, MIDI_channel_state_velocity(&state, MIDI_NOTE_C_4));
+  EXPECT_FALSE(&r, MIDI_channel_state_is_held(&state, MIDI_NOTE_E_4));
+
+  // poly aftertouch only sticks to held notes
+  MIDI_Message poly = {.type = MIDI_MSG_TYPE_AFTERTOUCH_POLY, .channel = 3, .data.aftertouch_poly = {127, 42}};
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, poly));
+  poly.data.aftertouch_poly.note = MIDI_NOTE_C_4;
+  EXPECT_FALSE(&r, MIDI_channel_state_process(&state, poly));
+  EXPECT_EQ(&r, 42, state.poly_pressure[127]);
+  EXPECT_EQ(&r, 0, state.poly_pressure[MIDI_NOTE_C_4]);
+
+  // all notes off and the mode changes that imply it
+  const uint8_t all_off[] = {MIDI_CTRL_ALL_NOTES_OFF,
+                             MIDI_CTRL_ALL_SOUND_OFF,
+                             MIDI_CTRL_OMNI_MODE_ON,
+                             MIDI_CTRL_OMNI_MODE_OFF,
+                             MIDI_CTRL_MONO_MODE,
+                             MIDI_CTRL_POLY_MODE};
+  for(size_t i = 0; i < sizeof(all_off); i++) {
+    EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(3, MIDI_NOTE_C_4, 100)));
+    EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(3, MIDI_NOTE_C_6, 100)));
+    EXPECT_TRUE(&r, MIDI_channel_state_process(&state, cc(3, all_off[i], 0)));
+    EXPECT_EQ(&r, 0, MIDI_channel_state_num_held(&state));
+    EXPECT_EQ(&r, 0, MIDI_channel_state_velocity(&state, MIDI_NOTE_C_6));
+    EXPECT_EQ(&r, 0, state.poly_pressure[127]);
+    EXPECT_EQ(&r, 0, MIDI_channel_state_control(&state, all_off[i]));
+  }
+
+  // a state for any channel
+  EXPECT_EQ(&r, OK, MIDI_channel_state_init(&state, 0));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(16, MIDI_NOTE_C_4, 100)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(1, MIDI_NOTE_C_5, 100)));
+  EXPECT_EQ(&r, 2, MIDI_channel_state_num_held(&state));
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_channel_state_init(NULL, 1));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_channel_state_init(&state, 17));
+
+  return r;
+}
+
+static Result tst_controllers(void) {
+  Result r = PASS;
+
+  MIDI_ChannelState state;
+  EXPECT_EQ(&r, OK, MIDI_channel_state_init(&state, 1));
+  EXPECT_EQ(&r, 0x7f, MIDI_channel_state_control(&state, MIDI_CTRL_EXPRESSION));
+  EXPECT_EQ(&r, 0x7f, MIDI_channel_state_control(&state, MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB));
+  EXPECT_EQ(&r, 0, MIDI_channel_state_control(&state, MIDI_CTRL_VOLUME));
+  EXPECT_EQ(&r, 0, state.pitch_bend);
+
+  const uint8_t reset[] = {MIDI_CTRL_MOD_WHEEL,
+                           MIDI_CTRL_EXPRESSION,
+                           MIDI_CTRL_DAMPER_PEDAL_ON_OFF,
+                           MIDI_CTRL_PORTAMENTO_ON_OFF,
+                           MIDI_CTRL_SOSTENUTO_PEDAL_ON_OFF,
+                           MIDI_CTRL_SOFT_PEDAL_ON_OFF,
+                           MIDI_CTRL_REGISTERED_PARAM_NUMBER_LSB,
+                           MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB,
+                           MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_LSB,
+                           MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_MSB};
+  const uint8_t kept[] = {MIDI_CTRL_BANK_SELECT,
+                          MIDI_CTRL_VOLUME,
+                          MIDI_CTRL_PAN,
+                          MIDI_CTRL_SOUND_VARIATION,
+                          MIDI_CTRL_EFFECT3,
+                          MIDI_CTRL_DATA_ENTRY};
+
+  for(size_t i = 0; i < sizeof(reset); i++) EXPECT_TRUE(&r, MIDI_channel_state_process(&state, cc(1, reset[i], 5)));
+  for(size_t i = 0; i < sizeof(kept); i++) EXPECT_TRUE(&r, MIDI_channel_state_process(&state, cc(1, kept[i], 5)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, pitch_bend(1, -1000)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(1, MIDI_NOTE_A_4, 64)));
+  const MIDI_Message pressure = {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = 1, .data.aftertouch_mono = {33}};
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, pressure));
+
+  for(size_t i = 0; i < sizeof(reset); i++) EXPECT_EQ(&r, 5, MIDI_channel_state_control(&state, reset[i]));
+  EXPECT_EQ(&r, -1000, state.pitch_bend);
+  EXPECT_EQ(&r, 33, state.pressure);
+
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, cc(1, MIDI_CTRL_RESET_ALL_CONTROLLERS, 0)));
+
+  MIDI_ChannelState fresh;
+  EXPECT_EQ(&r, OK, MIDI_channel_state_init(&fresh, 1));
+  for(size_t i = 0; i < sizeof(reset); i++) {
+    EXPECT_EQ(&r, MIDI_channel_state_control(&fresh, reset[i]), MIDI_channel_state_control(&state, reset[i]));
+  }
+  for(size_t i = 0; i < sizeof(kept); i++) EXPECT_EQ(&r, 5, MIDI_channel_state_control(&state, kept[i]));
+  EXPECT_EQ(&r, 0, state.pitch_bend);
+  EXPECT_EQ(&r, 0, state.pressure);
+  EXPECT_TRUE(&r, MIDI_channel_state_is_held(&state, MIDI_NOTE_A_4)); // the notes aren't touched
+
+  EXPECT_FALSE(&r, MIDI_channel_state_process(&state, cc(1, MIDI_CTRL_LOCAL_ON_OFF, 0)));
+  const MIDI_Message program = {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = 1, .data.program_change = {1}};
+  EXPECT_FALSE(&r, MIDI_channel_state_process(&state, program));
+
+  return r;
+}
+
+static Result tst_snapshot_diff(void) {
+  Result r = PASS;
+
+  MIDI_ChannelState state;
+  MIDI_ChannelState snapshot;
+  EXPECT_EQ(&r, OK, MIDI_channel_state_init(&state, 1));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(1, MIDI_NOTE_C_4, 100)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(1, MIDI_NOTE_C_6, 100)));
+  MIDI_channel_state_snapshot(&state, &snapshot);
+
+  MIDI_ChannelStateDiff diff;
+  EXPECT_FALSE(&r, MIDI_channel_state_diff(&snapshot, &state, &diff));
+  EXPECT_TRUE(&r, MIDI_note_set_is_empty(&diff.pressed));
+  EXPECT_TRUE(&r, MIDI_note_set_is_empty(&diff.released));
+
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_off(1, MIDI_NOTE_C_6, 0)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, note_on(1, MIDI_NOTE_G_B_2, 100)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, cc(1, MIDI_CTRL_VOLUME, 100)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, cc(1, MIDI_CTRL_CUTOFF_FREQUENCY, 1)));
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, cc(1, MIDI_CTRL_UNDEFINED20, 0))); // same as before
+  EXPECT_TRUE(&r, MIDI_channel_state_process(&state, pitch_bend(1, 8191)));
+
+  EXPECT_TRUE(&r, MIDI_channel_state_diff(&snapshot, &state, &diff));
+  EXPECT_EQ(&r, 1, MIDI_note_set_count(&diff.pressed));
+  EXPECT_TRUE(&r, MIDI_note_set_contains(&diff.pressed, MIDI_NOTE_G_B_2));
+  EXPECT_EQ(&r, 1, MIDI_note_set_count(&diff.released));
+  EXPECT_TRUE(&r, MIDI_note_set_contains(&diff.released, MIDI_NOTE_C_6));
+  EXPECT_EQ(&r, 1ull << MIDI_CTRL_VOLUME, diff.controls[0]);
+  EXPECT_EQ(&r, 1ull << (MIDI_CTRL_CUTOFF_FREQUENCY - 64), diff.controls[1]);
+  EXPECT_TRUE(&r, diff.pitch_bend);
+  EXPECT_FALSE(&r, diff.pressure);
+
+  // the other way around
+  EXPECT_TRUE(&r, MIDI_channel_state_diff(&state, &snapshot, &diff));
+  EXPECT_TRUE(&r, MIDI_note_set_contains(&diff.released, MIDI_NOTE_G_B_2));
+  EXPECT_TRUE(&r, MIDI_note_set_contains(&diff.pressed, MIDI_NOTE_C_6));
+
+  return r;
+}
+
+// fed by a parser, with running status and note on velocity 0 as note off
+static Result tst_behind_parser(void) {
+  Result r = PASS;
+
+  MIDI_ChannelState state;
+  EXPECT_EQ(&r, OK, MIDI_channel_state_init(&state, 2));
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    0x91, 0x3c, 0x64, 0x40, 0x50, 0x43, 0x20, // three notes down
+    0x3c, 0x00,                               // one up again
+    0x92, 0x3c, 0x64,                         // channel 3
+    0xb1, 0x07, 0x66,                         // volume
+    0xe1, 0x00, 0x60,                         // bend up
+  };
+  // clang-format on
+
+  MIDI_Message msgs[8];
+  const size_t num_msgs = parse_msgs(bytes, sizeof(bytes), msgs, 8);
+  EXPECT_EQ(&r, 7, num_msgs);
+  for(size_t i = 0; i < num_msgs; i++) MIDI_channel_state_process(&state, msgs[i]);
+
+  uint8_t notes[MIDI_NUM_NOTES];
+  EXPECT_EQ(&r, 2, MIDI_note_set_to_array(&(state.held), notes));
+  EXPECT_EQ(&r, 0x40, notes[0]);
+  EXPECT_EQ(&r, 0x43, notes[1]);
+  EXPECT_EQ(&r, 0x20, MIDI_channel_state_velocity(&state, 0x43));
+  EXPECT_EQ(&r, 0x66, MIDI_channel_state_control(&state, MIDI_CTRL_VOLUME));
+  EXPECT_EQ(&r, 0x1000, state.pitch_bend);
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_note_set,
+      tst_notes,
+      tst_controllers,
+      tst_snapshot_diff,
+      tst_behind_parser,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
@@ -0,0 +1,388 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OK STAT_OK
+
+#include "encoder.h"
+#include "parser.h"
+
+#define TEST_CHANNEL 2
+
+static Result expect_round_trip(const MIDI_Message * msgs, size_t n, const uint8_t * bytes, size_t bytes_len) {
+  Result r = PASS;
+
+  static MIDI_Message storage[1024];
+  EXPECT_TRUE(&r, n <= 1024);
+
+  MIDI_Parser parser;
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(&parser, MIDI_CHANNEL_MASK_ALL));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(&parser, storage, 1024));
+  for(size_t i = 0; i < bytes_len; i++) EXPECT_EQ(&r, OK, MIDI_parse_byte(&parser, bytes[i]));
+  if(HAS_FAILED(&r)) return r;
+
+  for(size_t i = 0; i < n; i++) {
+    EXPECT_TRUE(&r, MIDI_parser_has_output(&parser));
+    if(HAS_FAILED(&r)) return r;
+
+    const MIDI_Message msg = MIDI_parser_pop_msg(&parser);
+    EXPECT_EQ(&r, msgs[i].type, msg.type);
+    if(msgs[i].type == MIDI_MSG_TYPE_MISC) {
+      EXPECT_EQ(&r, 0, msg.channel);
+    } else {
+      EXPECT_EQ(&r, (msgs[i].channel != 0) ? msgs[i].channel : TEST_CHANNEL, msg.channel);
+    }
+    if(msgs[i].type == MIDI_MSG_TYPE_PITCH_BEND) {
+      EXPECT_EQ(&r, msgs[i].data.pitch_bend.value, msg.data.pitch_bend.value);
+    } else if(msgs[i].type == MIDI_MSG_TYPE_MISC) {
+      EXPECT_EQ(&r, msgs[i].data.misc.status, msg.data.misc.status);
+    } else {
+      EXPECT_EQ(&r, msgs[i].data.note_on.note, msg.data.note_on.note);
+      EXPECT_EQ(&r, msgs[i].data.note_on.velocity, msg.data.note_on.velocity);
+    }
+  }
+  EXPECT_FALSE(&r, MIDI_parser_has_output(&parser));
+
+  return r;
+}
+
+static Result tst_init(void) {
+  Result r = PASS;
+
+  MIDI_Encoder encoder;
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encoder_init(NULL, TEST_CHANNEL, true));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encoder_init(&encoder, 0, true));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encoder_init(&encoder, 17, true));
+  EXPECT_EQ(&r, OK, MIDI_encoder_init(&encoder, TEST_CHANNEL, true));
+  EXPECT_EQ(&r, TEST_CHANNEL, encoder.channel);
+  EXPECT_TRUE(&r, encoder.use_running_status);
+  EXPECT_EQ(&r, 0, encoder.running_status);
+
+  return r;
+}
+
+static Result tst_encode_msg(void) {
+  Result r = PASS;
+
+  MIDI_Encoder encoder;
+  EXPECT_EQ(&r, OK, MIDI_encoder_init(&encoder, TEST_CHANNEL, false));
+
+  uint8_t bytes[8] = {0};
+  size_t  written  = 0;
+
+  const MIDI_Message note_on = {.type         = MIDI_MSG_TYPE_NOTE_ON,
+                                .data.note_on = {.note = MIDI_NOTE_A_4, .velocity = 100}};
+  EXPECT_EQ(&r, OK, MIDI_encode_msg(&encoder, note_on, bytes, sizeof(bytes), &written));
+  EXPECT_EQ(&r, 3, written);
+  EXPECT_EQ(&r, 0x91, bytes[0]); // channel 2
+  EXPECT_EQ(&r, MIDI_NOTE_A_4, bytes[1]);
+  EXPECT_EQ(&r, 100, bytes[2]);
+
+  // without running status every message gets a status byte
+  EXPECT_EQ(&r, OK, MIDI_encode_msg(&encoder, note_on, bytes, sizeof(bytes), &written));
+  EXPECT_EQ(&r, 3, written);
+
+  const MIDI_Message pitch_bend = {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 16, .data.pitch_bend = {.value = 0}};
+  EXPECT_EQ(&r, OK, MIDI_encode_msg(&encoder, pitch_bend, bytes, sizeof(bytes), &written));
+  EXPECT_EQ(&r, 3, written);
+  EXPECT_EQ(&r, 0xef, bytes[0]);
+  EXPECT_EQ(&r, 0x00, bytes[1]);
+  EXPECT_EQ(&r, 0x40, bytes[2]);
+
+  // no room
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_encode_msg(&encoder, note_on, bytes, 2, &written));
+  EXPECT_EQ(&r, 0, written);
+
+  // can't be encoded
+  EXPECT_EQ(&r,
+            STAT_ERR_ARGS,
+            MIDI_encode_msg(&encoder,
+                            (MIDI_Message){.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = 128, .velocity = 1}},
+                            bytes,
+                            sizeof(bytes),
+                            &written));
+  EXPECT_EQ(&r,
+            STAT_ERR_ARGS,
+            MIDI_encode_msg(&encoder,
+                            (MIDI_Message){.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend = {.value = 8192}},
+                            bytes,
+                            sizeof(bytes),
+                            &written));
+  EXPECT_EQ(&r,
+            STAT_ERR_ARGS,
+            MIDI_encode_msg(&encoder, (MIDI_Message){.type = MIDI_MSG_TYPE_MISC}, bytes, sizeof(bytes), &written));
+
+  return r;
+}
+
+static Result tst_running_status(void) {
+  Result r = PASS;
+
+  MIDI_Encoder encoder;
+  EXPECT_EQ(&r, OK, MIDI_encoder_init(&encoder, TEST_CHANNEL, true));
+
+  const MIDI_Message msgs[] = {
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_A_4, .velocity = 100}},
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_C_5, .velocity = 90}},
+      {.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_A_4, .velocity = 63}},  // as note on
+      {.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_C_5, .velocity = 10}},  // real note off
+      {.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_D_5, .velocity = 63}},  // running
+      {.type = MIDI_MSG_TYPE_NOTE_OFF, .channel = 3, .data.note_off = {.note = MIDI_NOTE_D_5, .velocity = 63}},
+  };
+
+  const uint8_t expect_bytes[] = {
+      0x91, MIDI_NOTE_A_4, 100, MIDI_NOTE_C_5, 90, MIDI_NOTE_A_4, 0,
+      0x81, MIDI_NOTE_C_5, 10, MIDI_NOTE_D_5, 63,
+      0x82, MIDI_NOTE_D_5, 63,
+  };
+
+  const size_t n = sizeof(msgs) / sizeof(msgs[0]);
+
+  uint8_t bytes[64] = {0};
+  size_t  consumed  = 0;
+  size_t  written   = 0;
+  EXPECT_EQ(&r, OK, MIDI_encode_msgs(&encoder, msgs, n, bytes, sizeof(bytes), &consumed, &written));
+  EXPECT_EQ(&r, n, consumed);
+  EXPECT_EQ(&r, sizeof(expect_bytes), written);
+  if(HAS_FAILED(&r)) return r;
+
+  for(size_t i = 0; i < sizeof(expect_bytes); i++) EXPECT_EQ(&r, expect_bytes[i], bytes[i]);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_round_trip(msgs, n, bytes, written));
+
+  // after a reset the status byte is written again
+  EXPECT_EQ(&r, OK, MIDI_encoder_reset(&encoder));
+  EXPECT_EQ(&r, OK, MIDI_encode_msg(&encoder, msgs[5], bytes, sizeof(bytes), &written));
+  EXPECT_EQ(&r, 3, written);
+
+  return r;
+}
+
+static Result tst_real_time(void) {
+  Result r = PASS;
+
+  MIDI_Encoder encoder;
+  EXPECT_EQ(&r, OK, MIDI_encoder_init(&encoder, TEST_CHANNEL, true));
+
+  const MIDI_Message msgs[] = {
+      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 1}},
+      {.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = MIDI_RT_CLOCK}},
+      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 2}},
+      {.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = MIDI_RT_STOP}},
+  };
+  const size_t n = sizeof(msgs) / sizeof(msgs[0]);
+
+  // real-time bytes don't break running status
+  const uint8_t expect_bytes[] = {0xb1, MIDI_CTRL_VOLUME, 1, 0xf8, MIDI_CTRL_VOLUME, 2, 0xfc};
+
+  uint8_t bytes[16] = {0};
+  size_t  consumed  = 0;
+  size_t  written   = 0;
+  EXPECT_EQ(&r, OK, MIDI_encode_msgs(&encoder, msgs, n, bytes, sizeof(bytes), &consumed, &written));
+  EXPECT_EQ(&r, n, consumed);
+  EXPECT_EQ(&r, sizeof(expect_bytes), written);
+  if(HAS_FAILED(&r)) return r;
+
+  for(size_t i = 0; i < sizeof(expect_bytes); i++) EXPECT_EQ(&r, expect_bytes[i], bytes[i]);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_round_trip(msgs, n, bytes, written));
+
+  // undefined real-time bytes and system common messages can't be encoded
+  EXPECT_EQ(&r,
+            STAT_ERR_ARGS,
+            MIDI_encode_msg(&encoder,
+                            (MIDI_Message){.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = 0xf9}},
+                            bytes,
+                            sizeof(bytes),
+                            &written));
+  EXPECT_EQ(&r,
+            STAT_ERR_ARGS,
+            MIDI_encode_msg(&encoder,
+                            (MIDI_Message){.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = 0xf0}},
+                            bytes,
+                            sizeof(bytes),
+                            &written));
+
+  return r;
+}
+
+static Result tst_encode_msgs_stops_when_full(void) {
+  Result r = PASS;
+
+  MIDI_Encoder encoder;
+  EXPECT_EQ(&r, OK, MIDI_encoder_init(&encoder, TEST_CHANNEL, true));
+
+  const MIDI_Message msgs[] = {
+      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 1}},
+      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 2}},
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend = {.value = -100}},
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend = {.value = 100}},
+  };
+  const size_t n = sizeof(msgs) / sizeof(msgs[0]);
+
+  // 3 + 2 bytes for the CCs, the pitch bend needs 3 more
+  uint8_t bytes[16] = {0};
+  size_t  consumed  = 0;
+  size_t  written   = 0;
+  EXPECT_EQ(&r, OK, MIDI_encode_msgs(&encoder, msgs, n, bytes, 7, &consumed, &written));
+  EXPECT_EQ(&r, 2, consumed);
+  EXPECT_EQ(&r, 5, written);
+  if(HAS_FAILED(&r)) return r;
+
+  // resuming continues as if nothing happened
+  size_t consumed_rest = 0;
+  size_t written_rest  = 0;
+  EXPECT_EQ(&r,
+            OK,
+            MIDI_encode_msgs(&encoder,
+                             &msgs[consumed],
+                             n - consumed,
+                             &bytes[written],
+                             sizeof(bytes) - written,
+                             &consumed_rest,
+                             &written_rest));
+  EXPECT_EQ(&r, n - consumed, consumed_rest);
+  EXPECT_EQ(&r, 5, written_rest);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_round_trip(msgs, n, bytes, written + written_rest));
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encode_msgs(NULL, msgs, n, bytes, sizeof(bytes), &consumed, &written));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encode_msgs(&encoder, NULL, n, bytes, sizeof(bytes), &consumed, &written));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encode_msgs(&encoder, msgs, n, NULL, sizeof(bytes), &consumed, &written));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encode_msgs(&encoder, msgs, n, bytes, sizeof(bytes), NULL, &written));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_encode_msgs(&encoder, msgs, n, bytes, sizeof(bytes), &consumed, NULL));
+
+  return r;
+}
+
+static Result tst_single_data_byte_msgs(void) {
+  Result r = PASS;
+
+  MIDI_Encoder encoder;
+  EXPECT_EQ(&r, OK, MIDI_encoder_init(&encoder, TEST_CHANNEL, true));
+
+  const MIDI_Message msgs[] = {
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .data.program_change = {.program = 5}},
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .data.aftertouch_mono = {.value = 10}},
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .data.aftertouch_mono = {.value = 11}}, // running status
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_POLY, .data.aftertouch_poly = {.note = MIDI_NOTE_A_4, .value = 12}},
+  };
+  const size_t n = sizeof(msgs) / sizeof(msgs[0]);
+
+  uint8_t bytes[16] = {0};
+  size_t  consumed  = 0;
+  size_t  written   = 0;
+  EXPECT_EQ(&r, OK, MIDI_encode_msgs(&encoder, msgs, n, bytes, sizeof(bytes), &consumed, &written));
+  EXPECT_EQ(&r, n, consumed);
+
+  // clang-format off
+  const uint8_t expect_bytes[] = {0xc1, 5, 0xd1, 10, 11, 0xa1, MIDI_NOTE_A_4, 12};
+  // clang-format on
+  EXPECT_EQ(&r, sizeof(expect_bytes), written);
+  if(HAS_FAILED(&r)) return r;
+  for(size_t i = 0; i < sizeof(expect_bytes); i++) EXPECT_EQ(&r, expect_bytes[i], bytes[i]);
+
+  EXPECT_EQ(&r, PASS, expect_round_trip(msgs, n, bytes, written));
+
+  return r;
+}
+
+static Result tst_round_trip_random(void) {
+  Result r = PASS;
+
+  MIDI_Encoder encoder;
+  EXPECT_EQ(&r, OK, MIDI_encoder_init(&encoder, TEST_CHANNEL, true));
+
+  // a simple LCG keeps this reproducible
+  uint32_t     seed = 12345;
+  MIDI_Message msgs[1000];
+  for(size_t i = 0; i < sizeof(msgs) / sizeof(msgs[0]); i++) {
+    seed = (seed * 1103515245u) + 12345u;
+
+    const uint8_t      a       = (seed >> 8) & 0x7f;
+    const uint8_t      b       = (seed >> 16) & 0x7f;
+    const MIDI_Channel channel = (seed >> 24) % 3; // 0 (encoder default), 1 or 2, so running status kicks in often
+
+    switch((seed >> 28) % 7) {
+    case 0:
+      // odd velocities are sent as is, the rest as the default so some of them go out as note on velocity 0
+      msgs[i] = (MIDI_Message){.type          = MIDI_MSG_TYPE_NOTE_OFF,
+                               .channel       = channel,
+                               .data.note_off = {a, (b % 2) ? b : MIDI_NOTE_OFF_DEFAULT_VELOCITY}};
+      break;
+    case 1:
+      msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_NOTE_ON, .channel = channel, .data.note_on = {a, b | 1}};
+      break;
+    case 2:
+      msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .channel = channel, .data.control_change = {a, b}};
+      break;
+    case 3:
+      msgs[i] = (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+                               .channel              = channel,
+                               .data.aftertouch_poly = {a, b}};
+      break;
+    case 4:
+      msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = channel, .data.program_change = {a}};
+      break;
+    case 5:
+      msgs[i] = (MIDI_Message){.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = channel, .data.aftertouch_mono = {a}};
+      break;
+    default:
+      msgs[i] = (MIDI_Message){.type            = MIDI_MSG_TYPE_PITCH_BEND,
+                               .channel         = channel,
+                               .data.pitch_bend = {.value = (int16_t)(((a << 7) | b) - 8192)}};
+      break;
+    }
+  }
+
+  const size_t n = sizeof(msgs) / sizeof(msgs[0]);
+
+  uint8_t bytes[sizeof(msgs) / sizeof(msgs[0]) * MIDI_ENCODER_MAX_MSG_SIZE];
+  size_t  consumed = 0;
+  size_t  written  = 0;
+  EXPECT_EQ(&r, OK, MIDI_encode_msgs(&encoder, msgs, n, bytes, sizeof(bytes), &consumed, &written));
+  EXPECT_EQ(&r, n, consumed);
+  EXPECT_TRUE(&r, written < sizeof(bytes)); // running status should save at least something
+  if(HAS_FAILED(&r)) return r;
+
+  return expect_round_trip(msgs, n, bytes, written);
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_init,
+      tst_encode_msg,
+      tst_running_status,
+      tst_real_time,
+      tst_encode_msgs_stops_when_full,
+      tst_single_data_byte_msgs,
+      tst_round_trip_random,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
@@ -33,7 +33,10 @@ static Result tst_size(void) {
 
   EXPECT_EQ(&r, sizeof(MIDI_NoteOff), 2);
   EXPECT_EQ(&r, sizeof(MIDI_NoteOn), 2);
+  EXPECT_EQ(&r, sizeof(MIDI_AftertouchPoly), 2);
   EXPECT_EQ(&r, sizeof(MIDI_ControlChange), 2);
+  EXPECT_EQ(&r, sizeof(MIDI_ProgramChange), 1);
+  EXPECT_EQ(&r, sizeof(MIDI_AftertouchMono), 1);
   EXPECT_EQ(&r, sizeof(MIDI_PitchBend), 2);
 
   EXPECT_EQ(&r, sizeof(MIDI_Message), 4);
@@ -94,6 +97,56 @@ static Result tst_to_string(void) {
     EXPECT_EQ(&r, strlen(expect_str), strlen(str));
     EXPECT_STREQ(&r, expect_str, str);
   }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[] =
+        "MIDI_Message{.type=AFTERTOUCH_POLY, .data=MIDI_AftertouchPoly{.note=C4, .value=12}}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer(str,
+                                         1024,
+                                         (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+                                                        .data.aftertouch_poly = {.note  = MIDI_NOTE_C_4,
+                                                                                 .value = 12}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "MIDI_Message{.type=PROGRAM_CHANGE, .data=MIDI_ProgramChange{.program=42}}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer(str,
+                                         1024,
+                                         (MIDI_Message){.type                = MIDI_MSG_TYPE_PROGRAM_CHANGE,
+                                                        .data.program_change = {.program = 42}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "MIDI_Message{.type=AFTERTOUCH_MONO, .data=MIDI_AftertouchMono{.value=127}}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer(str,
+                                         1024,
+                                         (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_MONO,
+                                                        .data.aftertouch_mono = {.value = 127}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "MIDI_Message{.type=MISC, .data=MIDI_Misc{.status=ACTIVE_SENSING}}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer(str,
+                                         1024,
+                                         (MIDI_Message){.type      = MIDI_MSG_TYPE_MISC,
+                                                        .data.misc = {.status = MIDI_RT_ACTIVE_SENSING}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
 
   return r;
 }
@@ -152,6 +205,285 @@ static Result tst_to_string_short(void) {
     EXPECT_EQ(&r, strlen(expect_str), strlen(str));
     EXPECT_STREQ(&r, expect_str, str);
   }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "PAT{C4,12}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer_short(str,
+                                               1024,
+                                               (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+                                                              .data.aftertouch_poly = {.note  = MIDI_NOTE_C_4,
+                                                                                       .value = 12}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "PC{42}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer_short(str,
+                                               1024,
+                                               (MIDI_Message){.type                = MIDI_MSG_TYPE_PROGRAM_CHANGE,
+                                                              .data.program_change = {.program = 42}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "AT{127}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer_short(str,
+                                               1024,
+                                               (MIDI_Message){.type                 = MIDI_MSG_TYPE_AFTERTOUCH_MONO,
+                                                              .data.aftertouch_mono = {.value = 127}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "MISC{CLOCK}";
+    EXPECT_EQ(&r,
+              strlen(expect_str),
+              MIDI_message_to_str_buffer_short(str,
+                                               1024,
+                                               (MIDI_Message){.type      = MIDI_MSG_TYPE_MISC,
+                                                              .data.misc = {.status = MIDI_RT_CLOCK}}));
+    EXPECT_EQ(&r, strlen(expect_str), strlen(str));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+
+  return r;
+}
+
+static Result tst_packed(void) {
+  Result r = PASS;
+
+  EXPECT_EQ(&r, sizeof(MIDI_PackedMessage), 4);
+
+  {
+    const MIDI_Message       msg = {.type         = MIDI_MSG_TYPE_NOTE_ON,
+                                    .channel      = 3,
+                                    .data.note_on = {.note = MIDI_NOTE_A_4, .velocity = 100}};
+    const MIDI_PackedMessage p   = MIDI_message_to_packed(msg);
+    EXPECT_EQ(&r, 0x20924564, p); // 0x2 channel voice, group 0, status 0x92, A4 (69), velocity 100
+    EXPECT_EQ(&r, MIDI_MSG_TYPE_NOTE_ON, MIDI_packed_type(p));
+    EXPECT_EQ(&r, 3, MIDI_packed_channel(p));
+    EXPECT_EQ(&r, MIDI_NOTE_A_4, MIDI_packed_data1(p));
+    EXPECT_EQ(&r, 100, MIDI_packed_data2(p));
+  }
+  {
+    const MIDI_Message msg = {.type                 = MIDI_MSG_TYPE_AFTERTOUCH_MONO,
+                              .channel              = 1,
+                              .data.aftertouch_mono = {.value = 5}};
+    EXPECT_EQ(&r, 0x20d00500, MIDI_message_to_packed(msg)); // single data byte, second one is 0
+  }
+  {
+    const MIDI_Message msg = {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 16, .data.pitch_bend = {.value = 0}};
+    EXPECT_EQ(&r, 0x20ef0040, MIDI_message_to_packed(msg)); // center is lsb 0x00, msb 0x40
+  }
+
+  // round trips
+  for(int value = -8192; value <= 8191; value++) {
+    const MIDI_Message msg = {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 7, .data.pitch_bend = {.value = value}};
+    const MIDI_Message res = MIDI_packed_to_message(MIDI_message_to_packed(msg));
+    EXPECT_EQ(&r, msg.type, res.type);
+    EXPECT_EQ(&r, msg.channel, res.channel);
+    EXPECT_EQ(&r, msg.data.pitch_bend.value, res.data.pitch_bend.value);
+    if(HAS_FAILED(&r)) return r;
+  }
+  for(MIDI_Channel channel = 1; channel <= 16; channel++) {
+    for(uint8_t a = 0; a < 128; a++) {
+      const MIDI_Message msgs[] = {
+          {.type = MIDI_MSG_TYPE_NOTE_OFF, .channel = channel, .data.note_off = {.note = a, .velocity = 127 - a}},
+          {.type = MIDI_MSG_TYPE_NOTE_ON, .channel = channel, .data.note_on = {.note = 127 - a, .velocity = a}},
+          {.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+           .channel             = channel,
+           .data.control_change = {.control = a, .value = a / 2}},
+          {.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+           .channel              = channel,
+           .data.aftertouch_poly = {.note = a, .value = 127 - a}},
+          {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = channel, .data.program_change = {.program = a}},
+          {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = channel, .data.aftertouch_mono = {.value = a}},
+      };
+      for(size_t i = 0; i < sizeof(msgs) / sizeof(msgs[0]); i++) {
+        const MIDI_Message res = MIDI_packed_to_message(MIDI_message_to_packed(msgs[i]));
+        EXPECT_EQ(&r, msgs[i].type, res.type);
+        EXPECT_EQ(&r, msgs[i].channel, res.channel);
+        EXPECT_EQ(&r, msgs[i].data.note_on.note, res.data.note_on.note);
+        EXPECT_EQ(&r, msgs[i].data.note_on.velocity, res.data.note_on.velocity);
+      }
+      if(HAS_FAILED(&r)) return r;
+    }
+  }
+
+  {
+    const MIDI_Message msg = {.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = MIDI_RT_CLOCK}};
+    EXPECT_EQ(&r, 0x10f80000, MIDI_message_to_packed(msg));
+    EXPECT_EQ(&r, MIDI_MSG_TYPE_MISC, MIDI_packed_to_message(0x10f80000).type);
+    EXPECT_EQ(&r, MIDI_RT_CLOCK, MIDI_packed_to_message(0x10f80000).data.misc.status);
+  }
+
+  // anything that isn't a channel voice word doesn't unpack to a channel voice message
+  EXPECT_EQ(&r, MIDI_MSG_TYPE_MISC, MIDI_packed_to_message(0).type);
+
+  return r;
+}
+
+// the snprintf based formatting these functions used to do, the output should stay exactly the same
+static int ref_note_msg_to_str_buffer(char *       str,
+                                      int          max_len,
+                                      const char * prefix,
+                                      uint8_t      note,
+                                      const char * value_prefix,
+                                      uint8_t      value) {
+  int len = 0;
+  if(len < max_len) len += snprintf(str, max_len, "%s", prefix);
+  if(len < max_len) {
+    len += snprintf(&str[len], max_len - len, "%s%d", MIDI_note_get_note_only_str(note), MIDI_note_get_octave(note));
+  }
+  if(len < max_len) {
+    len += snprintf(&str[len], (max_len - len), "%s%u}", (prefix[0] == 'M') ? value_prefix : ",", value);
+  }
+  return len;
+}
+
+static int ref_data_to_str_buffer(char * str, int max_len, MIDI_Message msg, bool is_short) {
+  switch(msg.type) {
+  case MIDI_MSG_TYPE_NOTE_OFF:
+    return ref_note_msg_to_str_buffer(str,
+                                      max_len,
+                                      is_short ? "OFF{" : "MIDI_NoteOff{.note=",
+                                      msg.data.note_off.note,
+                                      ", .velocity=",
+                                      msg.data.note_off.velocity);
+  case MIDI_MSG_TYPE_NOTE_ON:
+    return ref_note_msg_to_str_buffer(str,
+                                      max_len,
+                                      is_short ? "ON{" : "MIDI_NoteOn{.note=",
+                                      msg.data.note_on.note,
+                                      ", .velocity=",
+                                      msg.data.note_on.velocity);
+  case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+    return ref_note_msg_to_str_buffer(str,
+                                      max_len,
+                                      is_short ? "PAT{" : "MIDI_AftertouchPoly{.note=",
+                                      msg.data.aftertouch_poly.note,
+                                      ", .value=",
+                                      msg.data.aftertouch_poly.value);
+  case MIDI_MSG_TYPE_CONTROL_CHANGE:
+    return snprintf(str,
+                    max_len,
+                    is_short ? "CC{%s,%u}" : "MIDI_ControlChange{.control=%s, .value=%u}",
+                    MIDI_ctrl_to_str(msg.data.control_change.control),
+                    msg.data.control_change.value);
+  case MIDI_MSG_TYPE_PROGRAM_CHANGE:
+    return snprintf(str,
+                    max_len,
+                    is_short ? "PC{%u}" : "MIDI_ProgramChange{.program=%u}",
+                    msg.data.program_change.program);
+  case MIDI_MSG_TYPE_AFTERTOUCH_MONO:
+    return snprintf(str,
+                    max_len,
+                    is_short ? "AT{%u}" : "MIDI_AftertouchMono{.value=%u}",
+                    msg.data.aftertouch_mono.value);
+  case MIDI_MSG_TYPE_PITCH_BEND:
+    return snprintf(str, max_len, is_short ? "PB{%d}" : "MIDI_PitchBend{.value=%d}", msg.data.pitch_bend.value);
+  case MIDI_MSG_TYPE_MISC:
+    return snprintf(str,
+                    max_len,
+                    is_short ? "MISC{%s}" : "MIDI_Misc{.status=%s}",
+                    MIDI_real_time_to_str(msg.data.misc.status));
+  default: return snprintf(str, max_len, "??");
+  }
+}
+
+static int ref_message_to_str_buffer(char * str, int max_len, MIDI_Message msg) {
+  int len = 0;
+  if(len < max_len) len += snprintf(str, max_len, "MIDI_Message{.type=%s, .data=", MIDI_message_type_to_str(msg.type));
+  if(len < max_len) len += ref_data_to_str_buffer(&str[len], max_len - len, msg, false);
+  if(len < max_len) len += snprintf(&str[len], (max_len - len), "}");
+  return len;
+}
+
+static int ref_message_to_str_buffer_short(char * str, int max_len, MIDI_Message msg) {
+  return (0 < max_len) ? ref_data_to_str_buffer(str, max_len, msg, true) : 0;
+}
+
+static Result tst_to_string_matches_snprintf(void) {
+  Result r = PASS;
+
+  // a simple LCG keeps this reproducible
+  uint32_t seed = 42;
+  for(size_t i = 0; i < 2000; i++) {
+    seed = (seed * 1103515245u) + 12345u;
+
+    MIDI_Message msg = {.type = (seed >> 8) % 8};
+    if(msg.type == MIDI_MSG_TYPE_PITCH_BEND) {
+      msg.data.pitch_bend.value = (int16_t)((seed >> 12) % 16384) - 8192;
+    } else {
+      msg.data.note_on.note     = (seed >> 12) & 0xff; // not just valid values, formatting shouldn't care
+      msg.data.note_on.velocity = (seed >> 20) & 0xff;
+      if(msg.type == MIDI_MSG_TYPE_MISC) msg.data.misc.status = 0xf8 + ((seed >> 12) % 8);
+    }
+
+    for(int max_len = 0; max_len < 100; max_len++) {
+      char str[100 + 1]    = {0};
+      char expect[100 + 1] = {0};
+
+      EXPECT_EQ(&r, ref_message_to_str_buffer(expect, max_len, msg), MIDI_message_to_str_buffer(str, max_len, msg));
+      EXPECT_STREQ(&r, expect, str);
+
+      memset(str, 0, sizeof(str));
+      memset(expect, 0, sizeof(expect));
+
+      EXPECT_EQ(&r,
+                ref_message_to_str_buffer_short(expect, max_len, msg),
+                MIDI_message_to_str_buffer_short(str, max_len, msg));
+      EXPECT_STREQ(&r, expect, str);
+
+      if(HAS_FAILED(&r)) return r;
+    }
+  }
+
+  return r;
+}
+
+static Result tst_messages_to_string(void) {
+  Result r = PASS;
+
+  const MIDI_Message msgs[] = {
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_D_5, .velocity = 27}},
+      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_EFFECT1, .value = 101}},
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend = {.value = -1023}},
+  };
+  const size_t n = sizeof(msgs) / sizeof(msgs[0]);
+
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "ON{D5,27}\nCC{EFFECT1,101}\nPB{-1023}\n";
+    EXPECT_EQ(&r, strlen(expect_str), MIDI_messages_to_str_buffer_short(str, 1024, msgs, n));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    char       str[1024 + 1] = {0};
+    const char expect_str[]  = "MIDI_Message{.type=NOTE_ON, .data=MIDI_NoteOn{.note=D5, .velocity=27}}\n"
+                               "MIDI_Message{.type=CONTROL_CHANGE, .data=MIDI_ControlChange{.control=EFFECT1, "
+                               ".value=101}}\n"
+                               "MIDI_Message{.type=PITCH_BEND, .data=MIDI_PitchBend{.value=-1023}}\n";
+    EXPECT_EQ(&r, strlen(expect_str), MIDI_messages_to_str_buffer(str, 1024, msgs, n));
+    EXPECT_STREQ(&r, expect_str, str);
+  }
+  {
+    // truncated in the middle of the second message
+    char str[16 + 1] = {0};
+    EXPECT_EQ(&r, strlen("ON{D5,27}\nCC{EFFECT1,101}"), MIDI_messages_to_str_buffer_short(str, 16, msgs, n));
+    EXPECT_STREQ(&r, "ON{D5,27}\nCC{EF", str);
+  }
+
+  EXPECT_EQ(&r, 0, MIDI_messages_to_str_buffer_short(NULL, 16, msgs, n));
 
   return r;
 }
@@ -161,6 +493,9 @@ int main(void) {
       tst_size,
       tst_to_string,
       tst_to_string_short,
+      tst_packed,
+      tst_to_string_matches_snprintf,
+      tst_messages_to_string,
   };
 
   return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
@@ -0,0 +1,239 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OK STAT_OK
+
+#include "msg_queue.h"
+
+#define TEST_CAPACITY 8
+
+#define STRESS_CAPACITY 64
+#define STRESS_NUM_MSGS 200000
+
+static MIDI_Message make_msg(size_t seq) {
+  return (MIDI_Message){.type            = MIDI_MSG_TYPE_PITCH_BEND,
+                        .channel         = (uint8_t)(seq >> 16),
+                        .data.pitch_bend = {.value = (int16_t)(seq & 0xffff)}};
+}
+
+static bool is_msg(MIDI_Message msg, size_t seq) {
+  const MIDI_Message expect = make_msg(seq);
+  return (msg.type == expect.type) && (msg.channel == expect.channel) &&
+         (msg.data.pitch_bend.value == expect.data.pitch_bend.value);
+}
+
+static Result tst_init(void) {
+  Result r = PASS;
+
+  MIDI_MsgQueue queue                  = {0};
+  MIDI_Message  storage[TEST_CAPACITY] = {0};
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_msg_queue_init(NULL, storage, TEST_CAPACITY));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_msg_queue_init(&queue, NULL, TEST_CAPACITY));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_msg_queue_init(&queue, storage, 0));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_msg_queue_init(&queue, storage, 6));
+
+  EXPECT_EQ(&r, OK, MIDI_msg_queue_init(&queue, storage, TEST_CAPACITY));
+  EXPECT_EQ(&r, TEST_CAPACITY, MIDI_msg_queue_capacity(&queue));
+
+  // the indices should not share a cache line
+  EXPECT_TRUE(&r, (offsetof(MIDI_MsgQueue, begin_idx) - offsetof(MIDI_MsgQueue, end_idx)) >= MIDI_CACHE_LINE_SIZE);
+  EXPECT_TRUE(&r, (offsetof(MIDI_MsgQueue, data) - offsetof(MIDI_MsgQueue, begin_idx)) >= MIDI_CACHE_LINE_SIZE);
+
+  return r;
+}
+
+static Result tst_push_pop(void) {
+  Result r = PASS;
+
+  MIDI_MsgQueue queue                  = {0};
+  MIDI_Message  storage[TEST_CAPACITY] = {0};
+  MIDI_Message  msg                    = {0};
+
+  EXPECT_EQ(&r, OK, MIDI_msg_queue_init(&queue, storage, TEST_CAPACITY));
+  EXPECT_FALSE(&r, MIDI_msg_queue_pop(&queue, &msg));
+
+  // go around a few times to make sure wrapping works
+  size_t push_seq = 0;
+  size_t pop_seq  = 0;
+  for(size_t round = 0; round < 5; round++) {
+    for(size_t i = 0; i < TEST_CAPACITY; i++) EXPECT_TRUE(&r, MIDI_msg_queue_push(&queue, make_msg(push_seq++)));
+    EXPECT_FALSE(&r, MIDI_msg_queue_push(&queue, make_msg(push_seq)));
+
+    for(size_t i = 0; i < (TEST_CAPACITY - 3); i++) {
+      EXPECT_TRUE(&r, MIDI_msg_queue_pop(&queue, &msg));
+      EXPECT_TRUE(&r, is_msg(msg, pop_seq++));
+    }
+    for(size_t i = 0; i < (TEST_CAPACITY - 3); i++) EXPECT_TRUE(&r, MIDI_msg_queue_push(&queue, make_msg(push_seq++)));
+
+    while(MIDI_msg_queue_pop(&queue, &msg)) EXPECT_TRUE(&r, is_msg(msg, pop_seq++));
+    EXPECT_EQ(&r, push_seq, pop_seq);
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  return r;
+}
+
+static Result tst_push_pop_n(void) {
+  Result r = PASS;
+
+  MIDI_MsgQueue queue                  = {0};
+  MIDI_Message  storage[TEST_CAPACITY] = {0};
+  MIDI_Message  in[TEST_CAPACITY * 2]  = {0};
+  MIDI_Message  out[TEST_CAPACITY * 2] = {0};
+
+  for(size_t i = 0; i < (TEST_CAPACITY * 2); i++) in[i] = make_msg(i);
+
+  EXPECT_EQ(&r, OK, MIDI_msg_queue_init(&queue, storage, TEST_CAPACITY));
+
+  // only as many as fit get in
+  EXPECT_EQ(&r, TEST_CAPACITY, MIDI_msg_queue_push_n(&queue, in, TEST_CAPACITY * 2));
+  EXPECT_EQ(&r, 0, MIDI_msg_queue_push_n(&queue, in, 1));
+
+  EXPECT_EQ(&r, 5, MIDI_msg_queue_pop_n(&queue, out, 5));
+  for(size_t i = 0; i < 5; i++) EXPECT_TRUE(&r, is_msg(out[i], i));
+
+  // this one wraps around the end of the storage
+  EXPECT_EQ(&r, 5, MIDI_msg_queue_push_n(&queue, &in[TEST_CAPACITY], 5));
+
+  EXPECT_EQ(&r, TEST_CAPACITY, MIDI_msg_queue_pop_n(&queue, out, TEST_CAPACITY * 2));
+  for(size_t i = 0; i < TEST_CAPACITY; i++) EXPECT_TRUE(&r, is_msg(out[i], 5 + i));
+
+  EXPECT_EQ(&r, 0, MIDI_msg_queue_pop_n(&queue, out, TEST_CAPACITY));
+
+  return r;
+}
+
+// Either side can give up without hanging the other: the consumer keeps going after a wrong message and stops once the
+// producer is done and the queue is empty, and the producer stops as soon as the consumer is done.
+typedef struct StressEnv {
+  MIDI_MsgQueue queue;
+  MIDI_Message  storage[STRESS_CAPACITY];
+  atomic_bool   producer_done;
+  atomic_bool   consumer_done;
+  size_t        num_received; // only touched by the consumer until it's joined
+  size_t        num_errors;
+} StressEnv;
+
+static void * stress_producer(void * arg) {
+  StressEnv * env = (StressEnv *)arg;
+
+  MIDI_Message batch[7];
+  size_t       seq = 0;
+  while(seq < STRESS_NUM_MSGS && !atomic_load(&(env->consumer_done))) {
+    if((seq % 3) == 0) {
+      // mix in some batches, of an odd size so they straddle the wrap-around point
+      size_t n = 0;
+      while(n < 7 && (seq + n) < STRESS_NUM_MSGS) {
+        batch[n] = make_msg(seq + n);
+        n++;
+      }
+      const size_t pushed = MIDI_msg_queue_push_n(&(env->queue), batch, n);
+      if(pushed == 0) sched_yield(); // full, give the consumer a chance, we may well share a core with it
+      seq += pushed;
+    } else if(MIDI_msg_queue_push(&(env->queue), make_msg(seq))) {
+      seq++;
+    } else {
+      sched_yield();
+    }
+  }
+  atomic_store(&(env->producer_done), true);
+
+  return NULL;
+}
+
+static void * stress_consumer(void * arg) {
+  StressEnv * env = (StressEnv *)arg;
+
+  MIDI_Message batch[5];
+  size_t       seq = 0;
+  while(seq < STRESS_NUM_MSGS) {
+    // checked before popping, so when it's set an empty queue means everything pushed has been popped
+    const bool producer_done = atomic_load(&(env->producer_done));
+
+    size_t n = 0;
+    if((seq % 2) == 0) {
+      n = MIDI_msg_queue_pop_n(&(env->queue), batch, 5);
+    } else if(MIDI_msg_queue_pop(&(env->queue), &(batch[0]))) {
+      n = 1;
+    }
+
+    if(n == 0) {
+      if(producer_done) break; // lost messages, don't wait for them forever
+      sched_yield();           // empty, give the producer a chance
+    }
+    for(size_t i = 0; i < n; i++) {
+      if(!is_msg(batch[i], seq++)) env->num_errors++;
+    }
+  }
+  env->num_received = seq;
+  atomic_store(&(env->consumer_done), true);
+
+  return NULL;
+}
+
+static Result tst_threaded_stress(void) {
+  Result r = PASS;
+
+  StressEnv * env = aligned_alloc(MIDI_CACHE_LINE_SIZE, sizeof(StressEnv));
+  EXPECT_NE(&r, NULL, env);
+  if(HAS_FAILED(&r)) return r;
+
+  *env = (StressEnv){0};
+  EXPECT_EQ(&r, OK, MIDI_msg_queue_init(&(env->queue), env->storage, STRESS_CAPACITY));
+
+  pthread_t producer;
+  pthread_t consumer;
+  EXPECT_EQ(&r, 0, pthread_create(&consumer, NULL, stress_consumer, env));
+  EXPECT_EQ(&r, 0, pthread_create(&producer, NULL, stress_producer, env));
+
+  EXPECT_EQ(&r, 0, pthread_join(producer, NULL));
+  EXPECT_EQ(&r, 0, pthread_join(consumer, NULL));
+
+  EXPECT_EQ(&r, STRESS_NUM_MSGS, env->num_received);
+  EXPECT_EQ(&r, 0, env->num_errors);
+
+  MIDI_Message msg;
+  EXPECT_FALSE(&r, MIDI_msg_queue_pop(&(env->queue), &msg));
+
+  free(env);
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_init,
+      tst_push_pop,
+      tst_push_pop_n,
+      tst_threaded_stress,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
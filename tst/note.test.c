@@ -89,12 +89,34 @@ static Result tst_to_string(void) {
   return r;
 }
 
+static Result tst_to_string_matches_snprintf(void) {
+  Result r = PASS;
+
+  for(int n = MIDI_NOTE_BEGIN; n < 256; n++) {
+    for(size_t max_len = 0; max_len < 8; max_len++) {
+      char str[8 + 1]    = {0};
+      char expect[8 + 1] = {0};
+
+      const int expect_len =
+          (max_len == 0) ? 0
+                         : snprintf(expect, max_len, "%s%d", MIDI_note_get_note_only_str(n), MIDI_note_get_octave(n));
+
+      EXPECT_EQ(&r, expect_len, MIDI_note_to_str_buffer(str, max_len, n));
+      EXPECT_STREQ(&r, expect, str);
+      if(HAS_FAILED(&r)) return r;
+    }
+  }
+
+  return r;
+}
+
 int main(void) {
 
   Test tests[] = {
       tst_size,
       tst_difference,
       tst_to_string,
+      tst_to_string_matches_snprintf,
   };
 
   return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
@@ -23,6 +23,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define OK STAT_OK
 
@@ -34,6 +35,8 @@
 #define TO_BE_IGNORED_CHANNEL      3
 #define TO_BE_IGNORED_CHANNEL_BITS (TO_BE_IGNORED_CHANNEL - 1)
 
+#define STATUS_BIT (1 << 7) // 0b1000'0000
+
 static Result setup(void ** env_p);
 static Result teardown(void ** env_p);
 
@@ -70,6 +73,7 @@ static Result tst_note_on(void * env) {
 
   const MIDI_Message peek_res = MIDI_parser_peek_msg(parser);
   EXPECT_EQ(&r, MIDI_MSG_TYPE_NOTE_ON, peek_res.type);
+  EXPECT_EQ(&r, TEST_CHANNEL, peek_res.channel);
   EXPECT_EQ(&r, note, peek_res.data.note_on.note);
   EXPECT_EQ(&r, 100, peek_res.data.note_on.velocity);
 
@@ -114,81 +118,66 @@ static Result tst_note_on_zero_velocity(void * env) {
 
   return r;
 }
-static uint8_t pitch_bend_lsb(int16_t value) {
-  return value & 0x7f; // 0b0111'1111
-}
-static uint8_t pitch_bend_msb(int16_t value) {
-  const int16_t mid_point = (0x40) << 7;
-  return ((value + mid_point) >> 7) & 0x7f; // 0b0111'1111;
-}
-
-static Result tst_multiple_msgs(void * env) {
-  Result        r      = PASS;
-  MIDI_Parser * parser = (MIDI_Parser *)env;
-
-  printf("start test %s\n", __func__);
 
-  const uint8_t status_bit = (1 << 7); // 0b1000'0000
+#define PITCH_BEND_LSB(value) ((value)&0x7f)                       // 0b0111'1111
+#define PITCH_BEND_MSB(value) ((((value) + (0x40 << 7)) >> 7) & 0x7f) // 0b0111'1111
 
-  const uint8_t bytes[] = {
-      // clang-format off
-      status_bit | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TEST_CHANNEL_BITS,  MIDI_NOTE_A_3,    27,
-                                                                              MIDI_NOTE_D_5,    40,
-                                                                              MIDI_NOTE_A_3,     0,
-                                                                              MIDI_NOTE_F_2,    29,
-      status_bit | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TEST_CHANNEL_BITS,  MIDI_NOTE_G_8,    20,
-      status_bit | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TO_BE_IGNORED_CHANNEL_BITS,   MIDI_NOTE_A_3,    99, 
-                                                                                        MIDI_NOTE_A_4,    21, 
-      status_bit | (MIDI_MSG_TYPE_NOTE_OFF << 4)        | TEST_CHANNEL_BITS,  MIDI_NOTE_D_5,    100,
-                                                                              MIDI_NOTE_F_2,    29,
-      status_bit | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TO_BE_IGNORED_CHANNEL_BITS,   MIDI_NOTE_G_3,    99, 
-      status_bit | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4)  | TEST_CHANNEL_BITS,  MIDI_CTRL_ATTACK_TIME,      29,
-                                                                              MIDI_CTRL_CUTOFF_FREQUENCY, 99,
-                                                                              MIDI_CTRL_EFFECT1,          20,
-      status_bit | (MIDI_MSG_TYPE_NOTE_OFF << 4)        | TEST_CHANNEL_BITS,  MIDI_NOTE_G_8,    19,
-      status_bit | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4)  | TO_BE_IGNORED_CHANNEL_BITS,   MIDI_CTRL_MOD_WHEEL,  29,
-      status_bit | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4)  | TEST_CHANNEL_BITS,  MIDI_CTRL_GENERAL_A,        101,
-                                                                              MIDI_CTRL_GENERAL_A_LSB,    29,
-      status_bit | (MIDI_MSG_TYPE_PITCH_BEND << 4)  | TEST_CHANNEL_BITS,  pitch_bend_lsb(8000), pitch_bend_msb(8000),
-      status_bit | (MIDI_MSG_TYPE_PITCH_BEND << 4)  | TO_BE_IGNORED_CHANNEL_BITS,  pitch_bend_lsb(-2), pitch_bend_msb(-2),
-      status_bit | (MIDI_MSG_TYPE_PITCH_BEND << 4)  | TEST_CHANNEL_BITS,  pitch_bend_lsb(-5000), pitch_bend_msb(-5000),
-                                                                          pitch_bend_lsb(0),     pitch_bend_msb(0),
-                                                                          pitch_bend_lsb(5),     pitch_bend_msb(5),
+static const uint8_t multiple_msgs_bytes[] = {
+    // clang-format off
+    STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TEST_CHANNEL_BITS,  MIDI_NOTE_A_3,    27,
+                                                                            MIDI_NOTE_D_5,    40,
+                                                                            MIDI_NOTE_A_3,     0,
+                                                                            MIDI_NOTE_F_2,    29,
+    STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TEST_CHANNEL_BITS,  MIDI_NOTE_G_8,    20,
+    STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TO_BE_IGNORED_CHANNEL_BITS,   MIDI_NOTE_A_3,    99, 
+                                                                                      MIDI_NOTE_A_4,    21, 
+    STATUS_BIT | (MIDI_MSG_TYPE_NOTE_OFF << 4)        | TEST_CHANNEL_BITS,  MIDI_NOTE_D_5,    100,
+                                                                            MIDI_NOTE_F_2,    29,
+    STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4)         | TO_BE_IGNORED_CHANNEL_BITS,   MIDI_NOTE_G_3,    99, 
+    STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4)  | TEST_CHANNEL_BITS,  MIDI_CTRL_ATTACK_TIME,      29,
+                                                                            MIDI_CTRL_CUTOFF_FREQUENCY, 99,
+                                                                            MIDI_CTRL_EFFECT1,          20,
+    STATUS_BIT | (MIDI_MSG_TYPE_NOTE_OFF << 4)        | TEST_CHANNEL_BITS,  MIDI_NOTE_G_8,    19,
+    STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4)  | TO_BE_IGNORED_CHANNEL_BITS,   MIDI_CTRL_MOD_WHEEL,  29,
+    STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4)  | TEST_CHANNEL_BITS,  MIDI_CTRL_GENERAL_A,        101,
+                                                                            MIDI_CTRL_GENERAL_A_LSB,    29,
+    STATUS_BIT | (MIDI_MSG_TYPE_PITCH_BEND << 4)  | TEST_CHANNEL_BITS,  PITCH_BEND_LSB(8000), PITCH_BEND_MSB(8000),
+    STATUS_BIT | (MIDI_MSG_TYPE_PITCH_BEND << 4)  | TO_BE_IGNORED_CHANNEL_BITS,  PITCH_BEND_LSB(-2), PITCH_BEND_MSB(-2),
+    STATUS_BIT | (MIDI_MSG_TYPE_PITCH_BEND << 4)  | TEST_CHANNEL_BITS,  PITCH_BEND_LSB(-5000), PITCH_BEND_MSB(-5000),
+                                                                        PITCH_BEND_LSB(0),     PITCH_BEND_MSB(0),
+                                                                        PITCH_BEND_LSB(5),     PITCH_BEND_MSB(5),
 
-      // clang-format on
-  };
+    // clang-format on
+};
 
-  const MIDI_Message expect_msgs[] = {
-      // clang-format off
-      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_A_3, .velocity = 27}},
-      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_D_5, .velocity = 40}},
-      {.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_A_3, .velocity = 63}},
-      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_F_2, .velocity = 29}},
-      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_G_8, .velocity = 20}},
-      {.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_D_5, .velocity = 100}},
-      {.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_F_2, .velocity = 29}},
-      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_ATTACK_TIME, .value = 29}},
-      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_CUTOFF_FREQUENCY, .value = 99}},
-      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_EFFECT1, .value = 20}},
-      {.type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_G_8, .velocity = 19}},
-      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_GENERAL_A, .value = 101}},
-      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_GENERAL_A_LSB, .value = 29}},
-      {.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 8000},
-      {.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = -5000},
-      {.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 0},
-      {.type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 5},
-      // clang-format on
-  };
+static const MIDI_Message multiple_msgs_expect[] = {
+    // clang-format off
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_A_3, .velocity = 27}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_D_5, .velocity = 40}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_A_3, .velocity = 63}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_F_2, .velocity = 29}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_G_8, .velocity = 20}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_D_5, .velocity = 100}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_F_2, .velocity = 29}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_ATTACK_TIME, .value = 29}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_CUTOFF_FREQUENCY, .value = 99}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_EFFECT1, .value = 20}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_G_8, .velocity = 19}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_GENERAL_A, .value = 101}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_GENERAL_A_LSB, .value = 29}},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 8000},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = -5000},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 0},
+    {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 5},
+    // clang-format on
+};
 
-  for(size_t i = 0; i < sizeof(bytes); i++) {
-    EXPECT_TRUE(&r, MIDI_parser_is_ready(parser));
-    if(HAS_FAILED(&r)) return r;
+#define MULTIPLE_MSGS_EXPECT_COUNT (sizeof(multiple_msgs_expect) / sizeof(multiple_msgs_expect[0]))
 
-    EXPECT_EQ(&r, OK, MIDI_parse_byte(parser, bytes[i]));
-    if(HAS_FAILED(&r)) return r;
-  }
+static Result expect_output(MIDI_Parser * parser, const MIDI_Message * expect_msgs, size_t n) {
+  Result r = PASS;
 
-  for(size_t i = 0; i < (sizeof(expect_msgs) / sizeof(expect_msgs[0])); i++) {
+  for(size_t i = 0; i < n; i++) {
     const MIDI_Message expect = expect_msgs[i];
 
     EXPECT_TRUE(&r, MIDI_parser_has_output(parser));
@@ -198,6 +187,8 @@ static Result tst_multiple_msgs(void * env) {
     const MIDI_Message pop_res  = MIDI_parser_pop_msg(parser);
     EXPECT_EQ(&r, expect.type, peek_res.type);
     EXPECT_EQ(&r, expect.type, pop_res.type);
+    EXPECT_EQ(&r, expect.channel, peek_res.channel);
+    EXPECT_EQ(&r, expect.channel, pop_res.channel);
 
     if(!HAS_FAILED(&r)) {
       switch(expect.type) {
@@ -223,6 +214,24 @@ static Result tst_multiple_msgs(void * env) {
         EXPECT_EQ(&r, expect.data.pitch_bend.value, peek_res.data.pitch_bend.value);
         EXPECT_EQ(&r, expect.data.pitch_bend.value, pop_res.data.pitch_bend.value);
         break;
+      case MIDI_MSG_TYPE_AFTERTOUCH_POLY:
+        EXPECT_EQ(&r, expect.data.aftertouch_poly.note, peek_res.data.aftertouch_poly.note);
+        EXPECT_EQ(&r, expect.data.aftertouch_poly.value, peek_res.data.aftertouch_poly.value);
+        EXPECT_EQ(&r, expect.data.aftertouch_poly.note, pop_res.data.aftertouch_poly.note);
+        EXPECT_EQ(&r, expect.data.aftertouch_poly.value, pop_res.data.aftertouch_poly.value);
+        break;
+      case MIDI_MSG_TYPE_PROGRAM_CHANGE:
+        EXPECT_EQ(&r, expect.data.program_change.program, peek_res.data.program_change.program);
+        EXPECT_EQ(&r, expect.data.program_change.program, pop_res.data.program_change.program);
+        break;
+      case MIDI_MSG_TYPE_AFTERTOUCH_MONO:
+        EXPECT_EQ(&r, expect.data.aftertouch_mono.value, peek_res.data.aftertouch_mono.value);
+        EXPECT_EQ(&r, expect.data.aftertouch_mono.value, pop_res.data.aftertouch_mono.value);
+        break;
+      case MIDI_MSG_TYPE_MISC:
+        EXPECT_EQ(&r, expect.data.misc.status, peek_res.data.misc.status);
+        EXPECT_EQ(&r, expect.data.misc.status, pop_res.data.misc.status);
+        break;
       default: EXPECT_FALSE(&r, true); break;
       }
     }
@@ -248,12 +257,1352 @@ static Result tst_multiple_msgs(void * env) {
   return r;
 }
 
+static Result tst_multiple_msgs(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  printf("start test %s\n", __func__);
+
+  for(size_t i = 0; i < sizeof(multiple_msgs_bytes); i++) {
+    EXPECT_TRUE(&r, MIDI_parser_is_ready(parser));
+    if(HAS_FAILED(&r)) return r;
+
+    EXPECT_EQ(&r, OK, MIDI_parse_byte(parser, multiple_msgs_bytes[i]));
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  return expect_output(parser, multiple_msgs_expect, MULTIPLE_MSGS_EXPECT_COUNT);
+}
+
+static Result tst_note_on_bulk(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t bytes[] = {
+      STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TEST_CHANNEL_BITS,
+      MIDI_NOTE_C_4,
+      100,
+      MIDI_NOTE_F_2,
+      0,
+  };
+  const MIDI_Message expect_msgs[] = {
+      {.channel = TEST_CHANNEL,
+       .type    = MIDI_MSG_TYPE_NOTE_ON,
+       .data.note_on = {.note = MIDI_NOTE_C_4, .velocity = 100}},
+      {.channel = TEST_CHANNEL,
+       .type    = MIDI_MSG_TYPE_NOTE_OFF,
+       .data.note_off = {.note = MIDI_NOTE_F_2, .velocity = 63}},
+  };
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  return expect_output(parser, expect_msgs, sizeof(expect_msgs) / sizeof(expect_msgs[0]));
+}
+
+static Result tst_multiple_msgs_bulk(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(multiple_msgs_bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  return expect_output(parser, multiple_msgs_expect, MULTIPLE_MSGS_EXPECT_COUNT);
+}
+
+static Result tst_multiple_msgs_bulk_split(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  // feeding the stream in arbitrary chunks should not make a difference, state carries over between calls
+  const size_t chunk_sizes[] = {1, 2, 5, 3, 7, 11};
+
+  size_t offset = 0;
+  for(size_t i = 0; offset < sizeof(multiple_msgs_bytes); i++) {
+    const size_t remaining = sizeof(multiple_msgs_bytes) - offset;
+    size_t       n         = chunk_sizes[i % (sizeof(chunk_sizes) / sizeof(chunk_sizes[0]))];
+    if(n > remaining) n = remaining;
+
+    size_t consumed = 0;
+    EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, &multiple_msgs_bytes[offset], n, &consumed));
+    EXPECT_EQ(&r, n, consumed);
+    if(HAS_FAILED(&r)) return r;
+
+    offset += consumed;
+  }
+
+  return expect_output(parser, multiple_msgs_expect, MULTIPLE_MSGS_EXPECT_COUNT);
+}
+
+static Result tst_bulk_stops_when_full(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  // a running status CC flood that produces more messages than fit in the buffer
+  const size_t num_msgs = MIDI_OUT_BUFFER_SIZE + 10;
+  uint8_t      bytes[1 + (2 * (MIDI_OUT_BUFFER_SIZE + 10))];
+
+  bytes[0] = STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | TEST_CHANNEL_BITS;
+  for(size_t i = 0; i < num_msgs; i++) {
+    bytes[1 + (i * 2)]     = MIDI_CTRL_CUTOFF_FREQUENCY;
+    bytes[1 + (i * 2) + 1] = (uint8_t)i;
+  }
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, 1 + (2 * MIDI_OUT_BUFFER_SIZE), consumed);
+  EXPECT_FALSE(&r, MIDI_parser_is_ready(parser));
+  if(HAS_FAILED(&r)) return r;
+
+  // parser refuses more input until the buffer is drained
+  size_t consumed_when_full = 1;
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_parse_bytes(parser, &bytes[consumed], 1, &consumed_when_full));
+  EXPECT_EQ(&r, 0, consumed_when_full);
+
+  size_t num_popped = 0;
+  while(MIDI_parser_has_output(parser)) {
+    const MIDI_Message msg = MIDI_parser_pop_msg(parser);
+    EXPECT_EQ(&r, MIDI_MSG_TYPE_CONTROL_CHANGE, msg.type);
+    EXPECT_EQ(&r, num_popped, msg.data.control_change.value);
+    num_popped++;
+  }
+  EXPECT_EQ(&r, MIDI_OUT_BUFFER_SIZE, num_popped);
+
+  size_t consumed_after_drain = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, &bytes[consumed], sizeof(bytes) - consumed, &consumed_after_drain));
+  EXPECT_EQ(&r, sizeof(bytes) - consumed, consumed_after_drain);
+
+  while(MIDI_parser_has_output(parser)) {
+    const MIDI_Message msg = MIDI_parser_pop_msg(parser);
+    EXPECT_EQ(&r, MIDI_MSG_TYPE_CONTROL_CHANGE, msg.type);
+    EXPECT_EQ(&r, num_popped, msg.data.control_change.value);
+    num_popped++;
+  }
+  EXPECT_EQ(&r, num_msgs, num_popped);
+
+  return r;
+}
+
+static Result tst_multiple_msgs_engines(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_switch(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(multiple_msgs_bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_output(parser, multiple_msgs_expect, MULTIPLE_MSGS_EXPECT_COUNT));
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+  EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_table(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(multiple_msgs_bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  return expect_output(parser, multiple_msgs_expect, MULTIPLE_MSGS_EXPECT_COUNT);
+}
+
+static Result tst_engines_agree_on_random_input(void * env) {
+  Result        r             = PASS;
+  MIDI_Parser * switch_parser = (MIDI_Parser *)env;
+  MIDI_Parser   table_parser  = {0};
+
+  EXPECT_EQ(&r, OK, MIDI_parser_init(&table_parser, TEST_CHANNEL));
+  if(HAS_FAILED(&r)) return r;
+
+  uint32_t rand_state = 42;
+  for(size_t i = 0; i < 100000; i++) {
+    rand_state = (rand_state * 1664525u) + 1013904223u;
+
+    // bias towards data bytes and status bytes on our channel, otherwise hardly any message gets completed
+    uint8_t byte = (uint8_t)(rand_state >> 24);
+    if((rand_state & 0x300) != 0) byte &= 0x7f;
+    else if((rand_state & 0x400) != 0) byte = (byte & 0xf0) | TEST_CHANNEL_BITS;
+
+    size_t consumed = 0;
+    EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_switch(switch_parser, &byte, 1, &consumed));
+    EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_table(&table_parser, &byte, 1, &consumed));
+    EXPECT_EQ(&r, switch_parser->state, table_parser.state);
+    EXPECT_EQ(&r, MIDI_parser_has_output(switch_parser), MIDI_parser_has_output(&table_parser));
+    if(HAS_FAILED(&r)) return r;
+
+    while(MIDI_parser_has_output(switch_parser)) {
+      const MIDI_Message switch_msg = MIDI_parser_pop_msg(switch_parser);
+      const MIDI_Message table_msg  = MIDI_parser_pop_msg(&table_parser);
+
+      EXPECT_EQ(&r, switch_msg.type, table_msg.type);
+      EXPECT_EQ(&r, switch_msg.channel, table_msg.channel);
+      EXPECT_EQ(&r, switch_msg.data.pitch_bend.value, table_msg.data.pitch_bend.value); // compares all data bytes
+      if(HAS_FAILED(&r)) return r;
+    }
+  }
+
+#ifdef MIDI_PARSER_STATS
+  // the table engine has to count the same things as the switch engine, without going through its retry loop
+  MIDI_ParserStats switch_stats;
+  MIDI_ParserStats table_stats;
+  EXPECT_EQ(&r, OK, MIDI_parser_get_stats(switch_parser, &switch_stats, false));
+  EXPECT_EQ(&r, OK, MIDI_parser_get_stats(&table_parser, &table_stats, false));
+  EXPECT_EQ(&r, switch_stats.bytes, table_stats.bytes);
+  EXPECT_EQ(&r, switch_stats.skipped_bytes, table_stats.skipped_bytes);
+  EXPECT_EQ(&r, switch_stats.retries, table_stats.retries);
+  EXPECT_EQ(&r, switch_stats.other_channel_resets, table_stats.other_channel_resets);
+  EXPECT_NE(&r, 0, switch_stats.skipped_bytes);
+  EXPECT_NE(&r, 0, switch_stats.retries);
+  EXPECT_NE(&r, 0, switch_stats.other_channel_resets);
+#endif
+
+  return r;
+}
+
+static Result tst_omni(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const MIDI_Message expect_msgs[] = {
+      // clang-format off
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_A_3, .velocity = 27}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_D_5, .velocity = 40}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_A_3, .velocity = 63}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_F_2, .velocity = 29}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_G_8, .velocity = 20}},
+      {.channel = TO_BE_IGNORED_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_A_3, .velocity = 99}},
+      {.channel = TO_BE_IGNORED_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_A_4, .velocity = 21}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_D_5, .velocity = 100}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_F_2, .velocity = 29}},
+      {.channel = TO_BE_IGNORED_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_G_3, .velocity = 99}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_ATTACK_TIME, .value = 29}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_CUTOFF_FREQUENCY, .value = 99}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_EFFECT1, .value = 20}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_G_8, .velocity = 19}},
+      {.channel = TO_BE_IGNORED_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_MOD_WHEEL, .value = 29}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_GENERAL_A, .value = 101}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_GENERAL_A_LSB, .value = 29}},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 8000},
+      {.channel = TO_BE_IGNORED_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = -2},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = -5000},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 0},
+      {.channel = TEST_CHANNEL, .type = MIDI_MSG_TYPE_PITCH_BEND, .data.pitch_bend.value = 5},
+      // clang-format on
+  };
+
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(parser, MIDI_CHANNEL_MASK_ALL));
+  EXPECT_EQ(&r, MIDI_CHANNEL_OMNI, parser->channel);
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(multiple_msgs_bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, sizeof(expect_msgs) / sizeof(expect_msgs[0])));
+  if(HAS_FAILED(&r)) return r;
+
+  // same thing for the other engine
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(parser, MIDI_CHANNEL_MASK_ALL));
+  EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_table(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(multiple_msgs_bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  return expect_output(parser, expect_msgs, sizeof(expect_msgs) / sizeof(expect_msgs[0]));
+}
+
+static Result tst_omni_channel_mask(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  // an omni parser that only listens to our test channel should behave exactly like a regular parser
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(parser, MIDI_channel_to_mask(TEST_CHANNEL)));
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(multiple_msgs_bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_output(parser, multiple_msgs_expect, MULTIPLE_MSGS_EXPECT_COUNT));
+
+  // and one that listens to nothing outputs nothing
+  EXPECT_EQ(&r, OK, MIDI_parser_set_channel_mask(parser, 0));
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+
+  // the mask can only be changed on omni parsers
+  EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_parser_set_channel_mask(parser, MIDI_CHANNEL_MASK_ALL));
+
+  return r;
+}
+
+static Result tst_omni_running_status_channel_change(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t bytes[] = {
+      // clang-format off
+      STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | 0,    MIDI_NOTE_C_4, 100,
+                                                        MIDI_NOTE_E_4, 90,
+      STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | 15,   MIDI_NOTE_C_4, 80,
+                                                        MIDI_NOTE_C_4, 0,
+      STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | 9,    MIDI_NOTE_G_4, // interrupted by a status byte
+      STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | 0,    MIDI_NOTE_E_4, 0,
+      STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | 4,  MIDI_CTRL_VOLUME, 127, // channel 5 is masked out
+                                                             MIDI_CTRL_PAN, 64,
+      STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | 5,  MIDI_CTRL_VOLUME, 126,
+                                                             MIDI_CTRL_PAN, 63,
+      // clang-format on
+  };
+  const MIDI_Message expect_msgs[] = {
+      // clang-format off
+      {.channel = 1, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_C_4, .velocity = 100}},
+      {.channel = 1, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_E_4, .velocity = 90}},
+      {.channel = 16, .type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_C_4, .velocity = 80}},
+      {.channel = 16, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_C_4, .velocity = 63}},
+      {.channel = 1, .type = MIDI_MSG_TYPE_NOTE_OFF, .data.note_off = {.note = MIDI_NOTE_E_4, .velocity = 63}},
+      {.channel = 6, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 126}},
+      {.channel = 6, .type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = MIDI_CTRL_PAN, .value = 63}},
+      // clang-format on
+  };
+
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(parser, MIDI_CHANNEL_MASK_ALL & ~MIDI_channel_to_mask(5)));
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, sizeof(expect_msgs) / sizeof(expect_msgs[0])));
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(parser, MIDI_CHANNEL_MASK_ALL & ~MIDI_channel_to_mask(5)));
+  EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_table(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  return expect_output(parser, expect_msgs, sizeof(expect_msgs) / sizeof(expect_msgs[0]));
+}
+
+static Result tst_bulk_args(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t bytes[]  = {STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TEST_CHANNEL_BITS};
+  size_t        consumed = 0;
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parse_bytes(NULL, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parse_bytes(parser, NULL, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parse_bytes(parser, bytes, sizeof(bytes), NULL));
+
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, NULL, 0, &consumed));
+  EXPECT_EQ(&r, 0, consumed);
+
+  return r;
+}
+
+// bytes for a running status CC flood on TEST_CHANNEL, values count up from 0
+static size_t make_cc_flood(uint8_t * bytes, size_t num_msgs, MIDI_Control control) {
+  bytes[0] = STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | TEST_CHANNEL_BITS;
+  for(size_t i = 0; i < num_msgs; i++) {
+    bytes[1 + (i * 2)]     = control;
+    bytes[1 + (i * 2) + 1] = (uint8_t)i;
+  }
+  return 1 + (2 * num_msgs);
+}
+
+static Result tst_external_buffer(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Message storage[128];
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_buffer(NULL, storage, 128));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_buffer(parser, NULL, 128));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_buffer(parser, storage, 0));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_buffer(parser, storage, 100));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 128));
+  EXPECT_EQ(&r, 128, MIDI_INT_buff_capacity(&(parser->msg_buffer)));
+  if(HAS_FAILED(&r)) return r;
+
+  uint8_t      bytes[1 + (2 * 200)];
+  const size_t n = make_cc_flood(bytes, 200, MIDI_CTRL_CUTOFF_FREQUENCY);
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, n, &consumed));
+  EXPECT_EQ(&r, 1 + (2 * 128), consumed);
+  EXPECT_EQ(&r, 128, MIDI_INT_buff_count(&(parser->msg_buffer)));
+  EXPECT_FALSE(&r, MIDI_parser_is_ready(parser));
+
+  // can't swap buffers while there are messages in it
+  MIDI_Message other_storage[4];
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_parser_set_buffer(parser, other_storage, 4));
+
+  for(size_t i = 0; i < 128; i++) {
+    const MIDI_Message msg = MIDI_parser_pop_msg(parser);
+    EXPECT_EQ(&r, i, msg.data.control_change.value);
+    EXPECT_EQ(&r, msg.data.control_change.value, storage[i].data.control_change.value);
+  }
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+  EXPECT_EQ(&r, 0, MIDI_parser_get_dropped_count(parser));
+
+  return r;
+}
+
+static Result tst_overflow_drop_oldest(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_overflow_policy(NULL, MIDI_OVERFLOW_DROP_OLDEST));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_overflow_policy(parser, (MIDI_OverflowPolicy)42));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_DROP_OLDEST));
+
+  uint8_t      bytes[1 + (2 * (MIDI_OUT_BUFFER_SIZE + 10))];
+  const size_t n = make_cc_flood(bytes, MIDI_OUT_BUFFER_SIZE + 10, MIDI_CTRL_CUTOFF_FREQUENCY);
+
+  // never stops early, the parser stays ready
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, n, &consumed));
+  EXPECT_EQ(&r, n, consumed);
+  EXPECT_TRUE(&r, MIDI_parser_is_ready(parser));
+  EXPECT_EQ(&r, 10, MIDI_parser_get_dropped_count(parser));
+
+  // the newest messages are kept
+  for(size_t i = 0; i < MIDI_OUT_BUFFER_SIZE; i++) {
+    EXPECT_EQ(&r, i + 10, MIDI_parser_pop_msg(parser).data.control_change.value);
+  }
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+
+  return r;
+}
+
+static Result tst_overflow_drop_newest(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_DROP_NEWEST));
+
+  uint8_t      bytes[1 + (2 * (MIDI_OUT_BUFFER_SIZE + 10))];
+  const size_t n = make_cc_flood(bytes, MIDI_OUT_BUFFER_SIZE + 10, MIDI_CTRL_CUTOFF_FREQUENCY);
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, n, &consumed));
+  EXPECT_EQ(&r, n, consumed);
+  EXPECT_EQ(&r, 10, MIDI_parser_get_dropped_count(parser));
+
+  // the oldest messages are kept
+  for(size_t i = 0; i < MIDI_OUT_BUFFER_SIZE; i++) {
+    EXPECT_EQ(&r, i, MIDI_parser_pop_msg(parser).data.control_change.value);
+  }
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+
+  return r;
+}
+
+static Result tst_overflow_coalesce_order(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const MIDI_Channel other = TEST_CHANNEL + 1;
+
+  MIDI_Message storage[4];
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(parser, MIDI_channel_to_mask(TEST_CHANNEL) | MIDI_channel_to_mask(other)));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 4));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_COALESCE));
+
+  const uint8_t note_status = STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TEST_CHANNEL_BITS;
+  const uint8_t pb_status   = STATUS_BIT | (MIDI_MSG_TYPE_PITCH_BEND << 4) | TEST_CHANNEL_BITS;
+  const uint8_t other_pb    = STATUS_BIT | (MIDI_MSG_TYPE_PITCH_BEND << 4) | (TEST_CHANNEL_BITS + 1);
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    note_status, MIDI_NOTE_C_4,        100,                   // [0] dropped for +300
+    other_pb,    PITCH_BEND_LSB(100),  PITCH_BEND_MSB(100),   // [1] replaced by -100
+    pb_status,   PITCH_BEND_LSB(-300), PITCH_BEND_MSB(-300),  // [2] kept, the D4 after it has to start with it
+    note_status, MIDI_NOTE_D_4,        100,                   // [3] buffer is full now
+    pb_status,   PITCH_BEND_LSB(300),  PITCH_BEND_MSB(300),   // can't go into [2] past D4, drops [0]
+    other_pb,    PITCH_BEND_LSB(-100), PITCH_BEND_MSB(-100),  // last on its channel, coalesces into [1]
+    pb_status,   PITCH_BEND_LSB(400),  PITCH_BEND_MSB(400),   // last on its channel, coalesces into +300
+  };
+  // clang-format on
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  EXPECT_EQ(&r, 3, MIDI_parser_get_dropped_count(parser));
+  if(HAS_FAILED(&r)) return r;
+
+  const MIDI_Message expect_msgs[] = {
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = other, .data.pitch_bend = {.value = -100}},
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = TEST_CHANNEL, .data.pitch_bend = {.value = -300}},
+      {.type         = MIDI_MSG_TYPE_NOTE_ON,
+       .channel      = TEST_CHANNEL,
+       .data.note_on = {.note = MIDI_NOTE_D_4, .velocity = 100}},
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = TEST_CHANNEL, .data.pitch_bend = {.value = 400}},
+  };
+
+  return expect_output(parser, expect_msgs, sizeof(expect_msgs) / sizeof(expect_msgs[0]));
+}
+
+static Result tst_overflow_coalesce_aftertouch(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Message storage[4];
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 4));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_COALESCE));
+
+  const uint8_t poly_status = STATUS_BIT | (MIDI_MSG_TYPE_AFTERTOUCH_POLY << 4) | TEST_CHANNEL_BITS;
+  const uint8_t mono_status = STATUS_BIT | (MIDI_MSG_TYPE_AFTERTOUCH_MONO << 4) | TEST_CHANNEL_BITS;
+  const uint8_t pc_status   = STATUS_BIT | (MIDI_MSG_TYPE_PROGRAM_CHANGE << 4) | TEST_CHANNEL_BITS;
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    pc_status,   5,                     // [0] dropped for B4 3
+    poly_status, MIDI_NOTE_A_4, 1,      // [1] dropped for A4 5
+                 MIDI_NOTE_B_4, 2,      // [2] dropped for program 6, B4 3 can't replace it
+    mono_status, 10,                    // [3] buffer is full now
+                 11,                    // coalesces into [3]
+    poly_status, MIDI_NOTE_B_4, 3,      // can't go into [2] past the mono aftertouch, drops [0]
+                 MIDI_NOTE_B_4, 4,      // coalesces into B4 3
+                 MIDI_NOTE_A_4, 5,      // another note, drops [1]
+    pc_status,   6,                     // never coalesced, drops [2]
+  };
+  // clang-format on
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  EXPECT_EQ(&r, 5, MIDI_parser_get_dropped_count(parser));
+  if(HAS_FAILED(&r)) return r;
+
+  const MIDI_Message expect_msgs[] = {
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = TEST_CHANNEL, .data.aftertouch_mono = {.value = 11}},
+      {.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+       .channel              = TEST_CHANNEL,
+       .data.aftertouch_poly = {.note = MIDI_NOTE_B_4, .value = 4}},
+      {.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+       .channel              = TEST_CHANNEL,
+       .data.aftertouch_poly = {.note = MIDI_NOTE_A_4, .value = 5}},
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = TEST_CHANNEL, .data.program_change = {.program = 6}},
+  };
+
+  return expect_output(parser, expect_msgs, sizeof(expect_msgs) / sizeof(expect_msgs[0]));
+}
+
+typedef STAT_Val (*ParseBytesFn)(MIDI_Parser * restrict parser, const uint8_t * bytes, size_t n, size_t * consumed);
+
+static Result tst_stats(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_ParserStats stats = {.bytes = 42};
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_get_stats(NULL, &stats, false));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_get_stats(parser, NULL, false));
+
+#ifndef MIDI_PARSER_STATS
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_parser_get_stats(parser, &stats, false));
+  EXPECT_EQ(&r, 0, stats.bytes);
+#else
+  const uint8_t note_on = 0x90 | TEST_CHANNEL_BITS;
+  const uint8_t other   = 0x90 | (TEST_CHANNEL_BITS + 1);
+  const uint8_t bytes[] = {
+      0x40,                                // data byte without a status, skipped
+      note_on, MIDI_NOTE_A_4, 100,         //
+      note_on, MIDI_NOTE_B_4,              // ends running status, a retry
+      note_on, MIDI_NOTE_B_4, 100,         // cuts the previous note short, another retry
+      0xf8,                                // clock
+      0xf9,    0xf4,          0xf7,        // undefined, system common and a stray SysEx end, all skipped
+      other,   60,            100,         // resets us, the data bytes after it are skipped
+      0xf0,    1,             2,    0xf7,  // SysEx dump
+      note_on, 60,            100,  61, 0, //
+  };
+
+  const ParseBytesFn engines[] = {MIDI_INT_parse_bytes_switch, MIDI_INT_parse_bytes_table};
+  for(size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+    EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+    EXPECT_EQ(&r, OK, MIDI_parser_get_stats(parser, &stats, false));
+    EXPECT_EQ(&r, 0, stats.bytes);
+
+    size_t consumed = 0;
+    EXPECT_EQ(&r, OK, engines[i](parser, bytes, sizeof(bytes), &consumed));
+    EXPECT_EQ(&r, OK, MIDI_parser_get_stats(parser, &stats, false));
+    EXPECT_EQ(&r, sizeof(bytes), stats.bytes);
+    EXPECT_EQ(&r, 6, stats.skipped_bytes);
+    EXPECT_EQ(&r, 2, stats.retries);
+    EXPECT_EQ(&r, 1, stats.other_channel_resets);
+    EXPECT_EQ(&r, 0, stats.overwritten);
+    EXPECT_EQ(&r, 5, stats.buffer_high_water);
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  // reset starts over, except for the high-water mark which can't go below what's buffered now
+  EXPECT_EQ(&r, OK, MIDI_parser_get_stats(parser, &stats, true));
+  EXPECT_EQ(&r, sizeof(bytes), stats.bytes);
+  MIDI_parser_pop_msgs(parser, (MIDI_Message[2]){0}, 2);
+  EXPECT_EQ(&r, OK, MIDI_parser_get_stats(parser, &stats, false));
+  EXPECT_EQ(&r, 0, stats.bytes);
+  EXPECT_EQ(&r, 0, stats.skipped_bytes);
+  EXPECT_EQ(&r, 0, stats.retries);
+  EXPECT_EQ(&r, 0, stats.other_channel_resets);
+  EXPECT_EQ(&r, 5, stats.buffer_high_water);
+
+  // with everything buffered messages that are overwritten are counted, dropping the new one isn't an overwrite
+  uint8_t      flood[1 + (2 * (MIDI_OUT_BUFFER_SIZE + 10))];
+  const size_t n = make_cc_flood(flood, MIDI_OUT_BUFFER_SIZE + 10, MIDI_CTRL_CUTOFF_FREQUENCY);
+
+  const MIDI_OverflowPolicy policies[] = {MIDI_OVERFLOW_DROP_OLDEST, MIDI_OVERFLOW_COALESCE, MIDI_OVERFLOW_DROP_NEWEST};
+  const uint32_t            expect_overwritten[] = {10, 10, 0};
+  for(size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+    EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, policies[i]));
+
+    size_t consumed = 0;
+    EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, flood, n, &consumed));
+    EXPECT_EQ(&r, 10, MIDI_parser_get_dropped_count(parser));
+    EXPECT_EQ(&r, OK, MIDI_parser_get_stats(parser, &stats, false));
+    EXPECT_EQ(&r, expect_overwritten[i], stats.overwritten);
+    EXPECT_EQ(&r, MIDI_OUT_BUFFER_SIZE, stats.buffer_high_water);
+    if(HAS_FAILED(&r)) return r;
+  }
+#endif
+
+  return r;
+}
+
+static Result tst_pop_msgs(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Message storage[8];
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 8));
+
+  MIDI_Message out[8] = {0};
+  EXPECT_EQ(&r, 0, MIDI_parser_pop_msgs(NULL, out, 8));
+  EXPECT_EQ(&r, 0, MIDI_parser_pop_msgs(parser, NULL, 8));
+  EXPECT_EQ(&r, 0, MIDI_parser_pop_msgs(parser, out, 8));
+
+  uint8_t      bytes[1 + (2 * 11)];
+  const size_t n = make_cc_flood(bytes, 11, MIDI_CTRL_CUTOFF_FREQUENCY);
+
+  // 5 messages, then pop 3 so the next 6 wrap around the end of the ring
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, 1 + (2 * 5), &consumed));
+  EXPECT_EQ(&r, 3, MIDI_parser_pop_msgs(parser, out, 3));
+  for(size_t i = 0; i < 3; i++) EXPECT_EQ(&r, i, out[i].data.control_change.value);
+
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, &bytes[consumed], n - consumed, &consumed));
+  EXPECT_EQ(&r, 8, MIDI_INT_buff_count(&(parser->msg_buffer)));
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, 8, MIDI_parser_pop_msgs(parser, out, 100));
+  for(size_t i = 0; i < 8; i++) {
+    EXPECT_EQ(&r, MIDI_MSG_TYPE_CONTROL_CHANGE, out[i].type);
+    EXPECT_EQ(&r, TEST_CHANNEL, out[i].channel);
+    EXPECT_EQ(&r, i + 3, out[i].data.control_change.value);
+  }
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+
+  return r;
+}
+
+static Result tst_peek_commit_msgs(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Message storage[8];
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 8));
+
+  MIDI_MsgSpans spans;
+  EXPECT_EQ(&r, 0, MIDI_parser_peek_msgs(NULL, &spans));
+  EXPECT_EQ(&r, 0, MIDI_parser_peek_msgs(parser, NULL));
+  EXPECT_EQ(&r, 0, MIDI_parser_peek_msgs(parser, &spans));
+  EXPECT_EQ(&r, 0, spans.first_len);
+  EXPECT_EQ(&r, 0, spans.second_len);
+
+  uint8_t      bytes[1 + (2 * 10)];
+  const size_t n = make_cc_flood(bytes, 10, MIDI_CTRL_CUTOFF_FREQUENCY);
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, 1 + (2 * 6), &consumed));
+
+  // single span
+  EXPECT_EQ(&r, 6, MIDI_parser_peek_msgs(parser, &spans));
+  EXPECT_EQ(&r, 6, spans.first_len);
+  EXPECT_EQ(&r, NULL, spans.second);
+  EXPECT_EQ(&r, 0, spans.second_len);
+  EXPECT_TRUE(&r, spans.first == storage);
+  EXPECT_EQ(&r, 4, MIDI_parser_commit_msgs(parser, 4));
+  EXPECT_EQ(&r, 2, MIDI_INT_buff_count(&(parser->msg_buffer)));
+  if(HAS_FAILED(&r)) return r;
+
+  // wrapped, 4 at the end of the storage and 2 at the start
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, &bytes[consumed], n - consumed, &consumed));
+  EXPECT_EQ(&r, 6, MIDI_parser_peek_msgs(parser, &spans));
+  EXPECT_EQ(&r, 4, spans.first_len);
+  EXPECT_EQ(&r, 2, spans.second_len);
+  EXPECT_TRUE(&r, spans.first == &storage[4]);
+  EXPECT_TRUE(&r, spans.second == storage);
+  if(HAS_FAILED(&r)) return r;
+
+  for(size_t i = 0; i < spans.first_len; i++) EXPECT_EQ(&r, i + 4, spans.first[i].data.control_change.value);
+  for(size_t i = 0; i < spans.second_len; i++) EXPECT_EQ(&r, i + 8, spans.second[i].data.control_change.value);
+
+  // committing more than is there only removes what is there
+  EXPECT_EQ(&r, 6, MIDI_parser_commit_msgs(parser, 100));
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+  EXPECT_EQ(&r, 0, MIDI_parser_commit_msgs(parser, 1));
+  EXPECT_EQ(&r, 0, MIDI_parser_commit_msgs(NULL, 1));
+
+  return r;
+}
+
+static Result tst_pop_packed_msgs(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, multiple_msgs_bytes, sizeof(multiple_msgs_bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(multiple_msgs_bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  MIDI_PackedMessage out[MULTIPLE_MSGS_EXPECT_COUNT + 1] = {0};
+  EXPECT_EQ(&r, MULTIPLE_MSGS_EXPECT_COUNT, MIDI_parser_pop_packed_msgs(parser, out, MULTIPLE_MSGS_EXPECT_COUNT + 1));
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+  if(HAS_FAILED(&r)) return r;
+
+  for(size_t i = 0; i < MULTIPLE_MSGS_EXPECT_COUNT; i++) {
+    const MIDI_Message msg = MIDI_packed_to_message(out[i]);
+    EXPECT_EQ(&r, multiple_msgs_expect[i].type, msg.type);
+    EXPECT_EQ(&r, multiple_msgs_expect[i].channel, msg.channel);
+    EXPECT_EQ(&r, multiple_msgs_expect[i].data.pitch_bend.value, msg.data.pitch_bend.value);
+  }
+
+  return r;
+}
+
+static Result tst_real_time(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t note_on = STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TEST_CHANNEL_BITS;
+  const uint8_t cc      = STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | TEST_CHANNEL_BITS;
+  const uint8_t other   = STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TO_BE_IGNORED_CHANNEL_BITS;
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    note_on, MIDI_RT_CLOCK, MIDI_NOTE_A_4, MIDI_RT_CLOCK, 100,  // clocks in the middle of a note on
+    MIDI_NOTE_B_4, 0xf9, 90,                                    // undefined real-time byte is skipped
+    cc, MIDI_CTRL_VOLUME, MIDI_RT_ACTIVE_SENSING, 1,
+    MIDI_CTRL_VOLUME, 0xfd, MIDI_RT_START, 2,                   // running status survives real-time bytes
+    other, MIDI_RT_STOP, MIDI_NOTE_C_4, 1,                      // real-time isn't channel specific
+  };
+  // clang-format on
+
+  const MIDI_Message expect_msgs[] = {
+      {.type = MIDI_MSG_TYPE_MISC, .channel = 0, .data.misc = {.status = MIDI_RT_CLOCK}},
+      {.type = MIDI_MSG_TYPE_MISC, .channel = 0, .data.misc = {.status = MIDI_RT_CLOCK}},
+      {.type         = MIDI_MSG_TYPE_NOTE_ON,
+       .channel      = TEST_CHANNEL,
+       .data.note_on = {.note = MIDI_NOTE_A_4, .velocity = 100}},
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .channel = TEST_CHANNEL, .data.note_on = {.note = MIDI_NOTE_B_4, .velocity = 90}},
+      {.type = MIDI_MSG_TYPE_MISC, .channel = 0, .data.misc = {.status = MIDI_RT_ACTIVE_SENSING}},
+      {.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+       .channel             = TEST_CHANNEL,
+       .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 1}},
+      {.type = MIDI_MSG_TYPE_MISC, .channel = 0, .data.misc = {.status = MIDI_RT_START}},
+      {.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+       .channel             = TEST_CHANNEL,
+       .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 2}},
+      {.type = MIDI_MSG_TYPE_MISC, .channel = 0, .data.misc = {.status = MIDI_RT_STOP}},
+  };
+  const size_t num_expect = sizeof(expect_msgs) / sizeof(expect_msgs[0]);
+
+  for(size_t i = 0; i < sizeof(bytes); i++) EXPECT_EQ(&r, OK, MIDI_parse_byte(parser, bytes[i]));
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, num_expect));
+  if(HAS_FAILED(&r)) return r;
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+  EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_switch(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, num_expect));
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+  EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_table(parser, bytes, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  if(HAS_FAILED(&r)) return r;
+
+  return expect_output(parser, expect_msgs, num_expect);
+}
+
+#define SYSEX_LOG_MAX_EVENTS 16
+
+// records SysEx events, with a copy of the payload as the chunks are only valid during the callback
+typedef struct SysExLog {
+  MIDI_SysExEvent events[SYSEX_LOG_MAX_EVENTS];
+  const uint8_t * data[SYSEX_LOG_MAX_EVENTS];
+  size_t          len[SYSEX_LOG_MAX_EVENTS];
+  size_t          num_events;
+  MIDI_SysExEvent last_event; // also recorded when events[] is full
+  size_t          last_len;
+  uint8_t         payload[64];
+  size_t          payload_len;
+} SysExLog;
+
+static void log_sysex(void * context, MIDI_SysExEvent event, const uint8_t * data, size_t len) {
+  SysExLog * log = (SysExLog *)context;
+
+  if(log->num_events < SYSEX_LOG_MAX_EVENTS) {
+    log->events[log->num_events] = event;
+    log->data[log->num_events]   = data;
+    log->len[log->num_events]    = len;
+    log->num_events++;
+  }
+  log->last_event = event;
+  log->last_len   = len;
+  if(event == MIDI_SYSEX_CHUNK && log->payload_len + len <= sizeof(log->payload)) {
+    memcpy(&(log->payload[log->payload_len]), data, len);
+    log->payload_len += len;
+  }
+}
+
+typedef enum ParseMode { PARSE_BYTE, PARSE_BYTES, PARSE_BYTES_SWITCH, PARSE_BYTES_TABLE, PARSE_MODE_COUNT } ParseMode;
+
+static Result parse_all(MIDI_Parser * parser, ParseMode mode, const uint8_t * bytes, size_t n) {
+  Result r        = PASS;
+  size_t consumed = 0;
+
+  switch(mode) {
+  case PARSE_BYTE:
+    for(size_t i = 0; i < n; i++) EXPECT_EQ(&r, OK, MIDI_parse_byte(parser, bytes[i]));
+    return r;
+  case PARSE_BYTES: EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, n, &consumed)); break;
+  case PARSE_BYTES_SWITCH: EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_switch(parser, bytes, n, &consumed)); break;
+  case PARSE_BYTES_TABLE: EXPECT_EQ(&r, OK, MIDI_INT_parse_bytes_table(parser, bytes, n, &consumed)); break;
+  default: EXPECT_FALSE(&r, true); break;
+  }
+  EXPECT_EQ(&r, n, consumed);
+
+  return r;
+}
+
+static Result tst_sysex(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t note_on = STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TEST_CHANNEL_BITS;
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    note_on, MIDI_NOTE_A_4, 100,
+    0xf0, 0x7e, 0x01, 0x02, MIDI_RT_CLOCK, 0x03, 0x04, 0xf7, // clock splits the payload in two chunks
+    MIDI_NOTE_B_4, 100,                                      // running status was cancelled by the dump
+    note_on, MIDI_NOTE_C_4, 100,
+  };
+  const uint8_t payload[] = {0x7e, 0x01, 0x02, 0x03, 0x04};
+  // clang-format on
+
+  const MIDI_Message expect_msgs[] = {
+      {.type         = MIDI_MSG_TYPE_NOTE_ON,
+       .channel      = TEST_CHANNEL,
+       .data.note_on = {.note = MIDI_NOTE_A_4, .velocity = 100}},
+      {.type = MIDI_MSG_TYPE_MISC, .channel = 0, .data.misc = {.status = MIDI_RT_CLOCK}},
+      {.type         = MIDI_MSG_TYPE_NOTE_ON,
+       .channel      = TEST_CHANNEL,
+       .data.note_on = {.note = MIDI_NOTE_C_4, .velocity = 100}},
+  };
+  const size_t num_expect = sizeof(expect_msgs) / sizeof(expect_msgs[0]);
+
+  for(ParseMode mode = 0; mode < PARSE_MODE_COUNT; mode++) {
+    SysExLog log = {0};
+    EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+    EXPECT_EQ(&r, OK, MIDI_parser_set_sysex_callback(parser, log_sysex, &log));
+    EXPECT_EQ(&r, PASS, parse_all(parser, mode, bytes, sizeof(bytes)));
+    EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, num_expect));
+    if(HAS_FAILED(&r)) return r;
+
+    EXPECT_EQ(&r, MIDI_SYSEX_START, log.events[0]);
+    EXPECT_EQ(&r, MIDI_SYSEX_END, log.last_event);
+    EXPECT_EQ(&r, sizeof(payload), log.last_len);
+    EXPECT_EQ(&r, sizeof(payload), log.payload_len);
+    EXPECT_EQ(&r, 0, memcmp(payload, log.payload, sizeof(payload)));
+    if(HAS_FAILED(&r)) return r;
+
+    if(mode != PARSE_BYTE) {
+      // the chunks are the runs of data bytes in the input itself
+      EXPECT_EQ(&r, 4, log.num_events);
+      EXPECT_EQ(&r, MIDI_SYSEX_CHUNK, log.events[1]);
+      EXPECT_EQ(&r, &(bytes[4]), log.data[1]);
+      EXPECT_EQ(&r, 3, log.len[1]);
+      EXPECT_EQ(&r, MIDI_SYSEX_CHUNK, log.events[2]);
+      EXPECT_EQ(&r, &(bytes[8]), log.data[2]);
+      EXPECT_EQ(&r, 2, log.len[2]);
+      if(HAS_FAILED(&r)) return r;
+    }
+  }
+
+  return r;
+}
+
+static Result tst_sysex_abort(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t note_on = STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TEST_CHANNEL_BITS;
+  const uint8_t cc      = STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | TEST_CHANNEL_BITS;
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    0xf0, 0x01, 0x02, note_on, MIDI_NOTE_A_4, 100, // a channel message cuts the dump short, and is parsed
+    0xf0, 0x03, 0xf0, 0x04, 0x05, 0xf7,            // a new dump aborts the previous one
+    cc, MIDI_CTRL_VOLUME, 1, 0xf1, 0x10,           // system common cancels running status, its data is skipped
+    MIDI_CTRL_VOLUME, 2,
+  };
+  // clang-format on
+
+  const MIDI_Message expect_msgs[] = {
+      {.type         = MIDI_MSG_TYPE_NOTE_ON,
+       .channel      = TEST_CHANNEL,
+       .data.note_on = {.note = MIDI_NOTE_A_4, .velocity = 100}},
+      {.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+       .channel             = TEST_CHANNEL,
+       .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 1}},
+  };
+  const size_t num_expect = sizeof(expect_msgs) / sizeof(expect_msgs[0]);
+
+  const MIDI_SysExEvent expect_events[] = {
+      MIDI_SYSEX_START, MIDI_SYSEX_CHUNK, MIDI_SYSEX_ABORT, MIDI_SYSEX_START,
+      MIDI_SYSEX_CHUNK, MIDI_SYSEX_ABORT, MIDI_SYSEX_START, MIDI_SYSEX_CHUNK,
+      MIDI_SYSEX_END,
+  };
+  const size_t num_expect_events = sizeof(expect_events) / sizeof(expect_events[0]);
+
+  for(ParseMode mode = PARSE_BYTES; mode < PARSE_MODE_COUNT; mode++) {
+    SysExLog log = {0};
+    EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+    EXPECT_EQ(&r, OK, MIDI_parser_set_sysex_callback(parser, log_sysex, &log));
+    EXPECT_EQ(&r, PASS, parse_all(parser, mode, bytes, sizeof(bytes)));
+    EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, num_expect));
+    EXPECT_EQ(&r, num_expect_events, log.num_events);
+    if(HAS_FAILED(&r)) return r;
+
+    for(size_t i = 0; i < num_expect_events; i++) EXPECT_EQ(&r, expect_events[i], log.events[i]);
+    EXPECT_EQ(&r, 2, log.len[2]); // total length of the aborted dumps
+    EXPECT_EQ(&r, 1, log.len[5]);
+    EXPECT_EQ(&r, 2, log.len[8]);
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  // without a callback, dumps are skipped just the same
+  EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+  EXPECT_EQ(&r, PASS, parse_all(parser, PARSE_BYTES, bytes, sizeof(bytes)));
+  EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, num_expect));
+
+  return r;
+}
+
+static Result tst_sysex_long_dump(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  // a long dump with a clock every so often, the clocks should come through while the dump is still going
+  enum { DUMP_LEN = 4096, CLOCK_INTERVAL = 100 };
+  static uint8_t bytes[DUMP_LEN + (DUMP_LEN / CLOCK_INTERVAL) + 2];
+  size_t         n = 0;
+
+  bytes[n++] = 0xf0;
+  for(size_t i = 0; i < DUMP_LEN; i++) {
+    if(i % CLOCK_INTERVAL == CLOCK_INTERVAL - 1) bytes[n++] = MIDI_RT_CLOCK;
+    bytes[n++] = (uint8_t)(i & 0x7f);
+  }
+  bytes[n++] = 0xf7;
+
+  for(ParseMode mode = 0; mode < PARSE_MODE_COUNT; mode++) {
+    SysExLog log = {0};
+    EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+    EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_DROP_OLDEST));
+    EXPECT_EQ(&r, OK, MIDI_parser_set_sysex_callback(parser, log_sysex, &log));
+    EXPECT_EQ(&r, PASS, parse_all(parser, mode, bytes, n));
+    if(HAS_FAILED(&r)) return r;
+
+    EXPECT_EQ(&r, MIDI_SYSEX_END, log.last_event);
+    EXPECT_EQ(&r, DUMP_LEN, log.last_len);
+    const size_t num_clocks = MIDI_parser_get_dropped_count(parser) + MIDI_INT_buff_count(&(parser->msg_buffer));
+    EXPECT_EQ(&r, DUMP_LEN / CLOCK_INTERVAL, num_clocks);
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  return r;
+}
+
+static Result tst_aftertouch_program_change(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t poly  = STATUS_BIT | (MIDI_MSG_TYPE_AFTERTOUCH_POLY << 4) | TEST_CHANNEL_BITS;
+  const uint8_t pc    = STATUS_BIT | (MIDI_MSG_TYPE_PROGRAM_CHANGE << 4) | TEST_CHANNEL_BITS;
+  const uint8_t mono  = STATUS_BIT | (MIDI_MSG_TYPE_AFTERTOUCH_MONO << 4) | TEST_CHANNEL_BITS;
+  const uint8_t other = STATUS_BIT | (MIDI_MSG_TYPE_AFTERTOUCH_MONO << 4) | TO_BE_IGNORED_CHANNEL_BITS;
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    poly, MIDI_NOTE_A_4, 10, MIDI_NOTE_B_4, MIDI_RT_CLOCK, 20, // running status, clock in between
+    pc, 5, 6,                                                  // program change has running status too
+    mono, 1, 2, 3,
+    other, 4, 5,                                               // ignored channel
+    mono, 6, poly, MIDI_NOTE_C_4,                              // incomplete poly aftertouch is dropped
+    pc,
+  };
+  // clang-format on
+
+  const MIDI_Message expect_msgs[] = {
+      {.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+       .channel              = TEST_CHANNEL,
+       .data.aftertouch_poly = {.note = MIDI_NOTE_A_4, .value = 10}},
+      {.type = MIDI_MSG_TYPE_MISC, .channel = 0, .data.misc = {.status = MIDI_RT_CLOCK}},
+      {.type                 = MIDI_MSG_TYPE_AFTERTOUCH_POLY,
+       .channel              = TEST_CHANNEL,
+       .data.aftertouch_poly = {.note = MIDI_NOTE_B_4, .value = 20}},
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = TEST_CHANNEL, .data.program_change = {.program = 5}},
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = TEST_CHANNEL, .data.program_change = {.program = 6}},
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = TEST_CHANNEL, .data.aftertouch_mono = {.value = 1}},
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = TEST_CHANNEL, .data.aftertouch_mono = {.value = 2}},
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = TEST_CHANNEL, .data.aftertouch_mono = {.value = 3}},
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = TEST_CHANNEL, .data.aftertouch_mono = {.value = 6}},
+  };
+  const size_t num_expect = sizeof(expect_msgs) / sizeof(expect_msgs[0]);
+
+  for(ParseMode mode = 0; mode < PARSE_MODE_COUNT; mode++) {
+    EXPECT_EQ(&r, OK, MIDI_parser_init(parser, TEST_CHANNEL));
+    EXPECT_EQ(&r, PASS, parse_all(parser, mode, bytes, sizeof(bytes)));
+    EXPECT_EQ(&r, PASS, expect_output(parser, expect_msgs, num_expect));
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  return r;
+}
+
+static Result expect_timed_output(MIDI_Parser *          parser,
+                                  const MIDI_Message *   expect_msgs,
+                                  const MIDI_Timestamp * expect_timestamps,
+                                  size_t                 n) {
+  Result r = PASS;
+
+  for(size_t i = 0; i < n; i++) {
+    EXPECT_TRUE(&r, MIDI_parser_has_output(parser));
+    EXPECT_EQ(&r, expect_timestamps[i], MIDI_parser_peek_timestamp(parser));
+
+    const MIDI_TimedMessage timed = MIDI_parser_pop_timed_msg(parser);
+    EXPECT_EQ(&r, expect_timestamps[i], timed.timestamp);
+    EXPECT_EQ(&r, expect_msgs[i].type, timed.msg.type);
+    EXPECT_EQ(&r, expect_msgs[i].data.pitch_bend.value, timed.msg.data.pitch_bend.value); // compares all data bytes
+    if(HAS_FAILED(&r)) {
+      printf("message %zu\n", i);
+      return r;
+    }
+  }
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+
+  return r;
+}
+
+static Result tst_timestamps(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const uint8_t note_on = STATUS_BIT | (MIDI_MSG_TYPE_NOTE_ON << 4) | TEST_CHANNEL_BITS;
+  const uint8_t cc      = STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | TEST_CHANNEL_BITS;
+
+  // clang-format off
+  const uint8_t        bytes[]      = {note_on, MIDI_NOTE_C_4, 100, MIDI_NOTE_E_4, MIDI_RT_CLOCK, 90, cc, 7, 100};
+  const MIDI_Timestamp timestamps[] = {10,      11,            12,  13,            14,            15, 16, 17, 18};
+  // clang-format on
+
+  // each message is stamped with its last byte, the clock with its own
+  const MIDI_Message expect_msgs[] = {
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_C_4, .velocity = 100}},
+      {.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = MIDI_RT_CLOCK}},
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .data.note_on = {.note = MIDI_NOTE_E_4, .velocity = 90}},
+      {.type = MIDI_MSG_TYPE_CONTROL_CHANGE, .data.control_change = {.control = 7, .value = 100}},
+  };
+  const MIDI_Timestamp expect_timestamps[] = {12, 14, 15, 18};
+
+  MIDI_Timestamp storage[MIDI_OUT_BUFFER_SIZE];
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, storage, MIDI_OUT_BUFFER_SIZE));
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes_timed(parser, bytes, timestamps, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  EXPECT_EQ(&r, PASS, expect_timed_output(parser, expect_msgs, expect_timestamps, 4));
+
+  for(size_t i = 0; i < sizeof(bytes); i++) EXPECT_EQ(&r, OK, MIDI_parse_byte_timed(parser, bytes[i], timestamps[i]));
+  EXPECT_EQ(&r, PASS, expect_timed_output(parser, expect_msgs, expect_timestamps, 4));
+
+  // in bulk
+  MIDI_TimedMessage out[8];
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes_timed(parser, bytes, timestamps, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, 4, MIDI_parser_pop_timed_msgs(parser, out, 8));
+  for(size_t i = 0; i < 4; i++) {
+    EXPECT_EQ(&r, expect_timestamps[i], out[i].timestamp);
+    EXPECT_EQ(&r, expect_msgs[i].type, out[i].msg.type);
+  }
+
+  // untimed parsing leaves the time where it was
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes(parser, bytes, 3, &consumed));
+  EXPECT_EQ(&r, 18, MIDI_parser_pop_timed_msg(parser).timestamp);
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parse_bytes_timed(parser, bytes, NULL, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parse_byte_timed(NULL, bytes[0], 0));
+
+  return r;
+}
+
+static Result tst_timestamps_chunk(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Timestamp storage[MIDI_OUT_BUFFER_SIZE];
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, storage, MIDI_OUT_BUFFER_SIZE));
+
+  const uint8_t pc = STATUS_BIT | (MIDI_MSG_TYPE_PROGRAM_CHANGE << 4) | TEST_CHANNEL_BITS;
+
+  const MIDI_Message expect_msgs[] = {
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .data.program_change = {.program = 5}},
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .data.program_change = {.program = 6}},
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .data.program_change = {.program = 7}},
+  };
+
+  // 10 ticks over 3 intervals, byte i is at floor(10 * i / 3)
+  const uint8_t        bytes[]           = {pc, 5, 6, 7};
+  const MIDI_Timestamp expect_timestamps[] = {3, 6, 10};
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_chunk_timed(parser, bytes, sizeof(bytes), 0, 10, &consumed));
+  EXPECT_EQ(&r, sizeof(bytes), consumed);
+  EXPECT_EQ(&r, PASS, expect_timed_output(parser, expect_msgs, expect_timestamps, 3));
+
+  // a chunk of one byte is at first, which is also last
+  EXPECT_EQ(&r, OK, MIDI_parse_chunk_timed(parser, &bytes[1], 1, 1000, 1000, &consumed));
+  EXPECT_EQ(&r, 1000, MIDI_parser_pop_timed_msg(parser).timestamp);
+
+  // SysEx payload is skipped over in runs, the times after it still line up
+  // clang-format off
+  const uint8_t with_sysex[] = {0xf0, 1, 2, MIDI_RT_CLOCK, 3, 4, 0xf7, pc, 5};
+  // clang-format on
+  const MIDI_Message expect_sysex_msgs[] = {
+      {.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = MIDI_RT_CLOCK}},
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .data.program_change = {.program = 5}},
+  };
+  const MIDI_Timestamp expect_sysex_timestamps[] = {130, 180};
+
+  EXPECT_EQ(&r, OK, MIDI_parse_chunk_timed(parser, with_sysex, sizeof(with_sysex), 100, 180, &consumed));
+  EXPECT_EQ(&r, PASS, expect_timed_output(parser, expect_sysex_msgs, expect_sysex_timestamps, 2));
+
+  // big numbers don't overflow, and the last byte is exactly at last
+  const MIDI_Timestamp big = UINT64_MAX - 7;
+  EXPECT_EQ(&r, OK, MIDI_parse_chunk_timed(parser, bytes, sizeof(bytes), 0, big, &consumed));
+  for(size_t i = 0; i < 2; i++) MIDI_parser_pop_msg(parser);
+  EXPECT_EQ(&r, big, MIDI_parser_pop_timed_msg(parser).timestamp);
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parse_chunk_timed(parser, bytes, sizeof(bytes), 10, 9, &consumed));
+
+  return r;
+}
+
+static Result tst_timestamps_stop_early(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Message   storage[4];
+  MIDI_Timestamp timestamps[4];
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 4));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, timestamps, 4));
+
+  uint8_t      bytes[1 + (2 * 10)];
+  const size_t n = make_cc_flood(bytes, 10, MIDI_CTRL_VOLUME);
+
+  // byte i is at 10 * i, message i ends at byte 2 * (i + 1)
+  size_t consumed = 0;
+  size_t done     = 0;
+  size_t num_msgs = 0;
+  while(done < n) {
+    const MIDI_Timestamp first = 10 * done;
+    const MIDI_Timestamp last  = 10 * (n - 1);
+    EXPECT_EQ(&r, OK, MIDI_parse_chunk_timed(parser, &bytes[done], n - done, first, last, &consumed));
+    done += consumed;
+
+    while(MIDI_parser_has_output(parser)) {
+      const MIDI_TimedMessage timed = MIDI_parser_pop_timed_msg(parser);
+      EXPECT_EQ(&r, num_msgs, timed.msg.data.control_change.value);
+      EXPECT_EQ(&r, 20 * (num_msgs + 1), timed.timestamp);
+      num_msgs++;
+    }
+    if(HAS_FAILED(&r)) return r;
+  }
+  EXPECT_EQ(&r, 10, num_msgs);
+
+  return r;
+}
+
+static Result tst_timestamps_overflow(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Message   storage[4];
+  MIDI_Timestamp timestamps[4];
+
+  // time i for message i
+  uint8_t        bytes[1 + (2 * 10)];
+  MIDI_Timestamp times[1 + (2 * 10)];
+  const size_t   n = make_cc_flood(bytes, 10, MIDI_CTRL_VOLUME);
+  for(size_t i = 0; i < n; i++) times[i] = (i + 1) / 2;
+
+  // the newest message takes the place of the one it supersedes, with its own time
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 4));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, timestamps, 4));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_COALESCE));
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes_timed(parser, bytes, times, n, &consumed));
+  for(size_t i = 0; i < 3; i++) EXPECT_EQ(&r, i + 1, MIDI_parser_pop_timed_msg(parser).timestamp);
+  const MIDI_TimedMessage last = MIDI_parser_pop_timed_msg(parser);
+  EXPECT_EQ(&r, 9, last.msg.data.control_change.value);
+  EXPECT_EQ(&r, 10, last.timestamp);
+
+  // timestamps move along with the messages that are kept
+  EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_DROP_OLDEST));
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes_timed(parser, bytes, times, n, &consumed));
+  for(size_t i = 6; i < 10; i++) {
+    const MIDI_TimedMessage timed = MIDI_parser_pop_timed_msg(parser);
+    EXPECT_EQ(&r, i, timed.msg.data.control_change.value);
+    EXPECT_EQ(&r, i + 1, timed.timestamp);
+  }
+
+  return r;
+}
+
+static Result tst_timestamps_overflow_order(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  const MIDI_Channel other = TEST_CHANNEL + 1;
+
+  MIDI_Message   storage[4];
+  MIDI_Timestamp timestamps[4];
+  EXPECT_EQ(&r, OK, MIDI_parser_init_omni(parser, MIDI_channel_to_mask(TEST_CHANNEL) | MIDI_channel_to_mask(other)));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 4));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, timestamps, 4));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_overflow_policy(parser, MIDI_OVERFLOW_COALESCE));
+
+  const uint8_t cc_status = STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | TEST_CHANNEL_BITS;
+  const uint8_t other_cc  = STATUS_BIT | (MIDI_MSG_TYPE_CONTROL_CHANGE << 4) | (TEST_CHANNEL_BITS + 1);
+
+  // time i for message i
+  // clang-format off
+  const uint8_t bytes[] = {
+    cc_status, MIDI_CTRL_VOLUME, 0,  // dropped for volume 5
+    other_cc,  MIDI_CTRL_VOLUME, 1,
+    cc_status, MIDI_CTRL_VOLUME, 2,  // last on its channel, but not the newest: kept with time 3
+    other_cc,  MIDI_CTRL_VOLUME, 3,  // buffer is full now
+    other_cc,  MIDI_CTRL_VOLUME, 4,  // newest, coalesces into volume 3 and takes time 5
+    cc_status, MIDI_CTRL_VOLUME, 5,  // would go back to time 6 ahead of time 5, drops volume 0
+  };
+  // clang-format on
+  MIDI_Timestamp times[sizeof(bytes)];
+  for(size_t i = 0; i < sizeof(bytes); i++) times[i] = (i / 3) + 1;
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_parse_bytes_timed(parser, bytes, times, sizeof(bytes), &consumed));
+  EXPECT_EQ(&r, 2, MIDI_parser_get_dropped_count(parser));
+  if(HAS_FAILED(&r)) return r;
+
+  const uint8_t        expect_values[] = {1, 2, 4, 5};
+  const MIDI_Timestamp expect_times[]  = {2, 3, 5, 6};
+  for(size_t i = 0; i < 4; i++) {
+    const MIDI_TimedMessage timed = MIDI_parser_pop_timed_msg(parser);
+    EXPECT_EQ(&r, expect_values[i], timed.msg.data.control_change.value);
+    EXPECT_EQ(&r, expect_times[i], timed.timestamp);
+  }
+  EXPECT_FALSE(&r, MIDI_parser_has_output(parser));
+
+  return r;
+}
+
+static Result tst_timestamp_buffer(void * env) {
+  Result        r      = PASS;
+  MIDI_Parser * parser = (MIDI_Parser *)env;
+
+  MIDI_Timestamp timestamps[MIDI_OUT_BUFFER_SIZE];
+  MIDI_Message   storage[8];
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_timestamp_buffer(NULL, timestamps, MIDI_OUT_BUFFER_SIZE));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_timestamp_buffer(parser, timestamps, MIDI_OUT_BUFFER_SIZE / 2));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, timestamps, MIDI_OUT_BUFFER_SIZE));
+
+  // a new message buffer lets go of the timestamps
+  EXPECT_EQ(&r, OK, MIDI_parser_set_buffer(parser, storage, 8));
+  EXPECT_EQ(&r, NULL, parser->msg_buffer.timestamps);
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_parser_set_timestamp_buffer(parser, timestamps, MIDI_OUT_BUFFER_SIZE));
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, timestamps, 8));
+
+  const uint8_t pc = STATUS_BIT | (MIDI_MSG_TYPE_PROGRAM_CHANGE << 4) | TEST_CHANNEL_BITS;
+  EXPECT_EQ(&r, OK, MIDI_parse_byte_timed(parser, pc, 1));
+  EXPECT_EQ(&r, OK, MIDI_parse_byte_timed(parser, 5, 2));
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_parser_set_timestamp_buffer(parser, NULL, 0));
+  EXPECT_EQ(&r, 2, MIDI_parser_pop_timed_msg(parser).timestamp);
+
+  // turned off, the timed calls still parse
+  EXPECT_EQ(&r, OK, MIDI_parser_set_timestamp_buffer(parser, NULL, 0));
+  EXPECT_EQ(&r, OK, MIDI_parse_byte_timed(parser, 6, 3));
+  EXPECT_EQ(&r, 0, MIDI_parser_peek_timestamp(parser));
+  const MIDI_TimedMessage timed = MIDI_parser_pop_timed_msg(parser);
+  EXPECT_EQ(&r, 0, timed.timestamp);
+  EXPECT_EQ(&r, 6, timed.msg.data.program_change.program);
+
+  return r;
+}
+
 int main(void) {
   TestWithFixture tests_with_fixture[] = {
       tst_fixture,
       tst_note_on,
       tst_note_on_zero_velocity,
       tst_multiple_msgs,
+      tst_note_on_bulk,
+      tst_multiple_msgs_bulk,
+      tst_multiple_msgs_bulk_split,
+      tst_bulk_stops_when_full,
+      tst_bulk_args,
+      tst_multiple_msgs_engines,
+      tst_engines_agree_on_random_input,
+      tst_omni,
+      tst_omni_channel_mask,
+      tst_omni_running_status_channel_change,
+      tst_external_buffer,
+      tst_overflow_drop_oldest,
+      tst_overflow_drop_newest,
+      tst_overflow_coalesce_order,
+      tst_overflow_coalesce_aftertouch,
+      tst_stats,
+      tst_pop_msgs,
+      tst_peek_commit_msgs,
+      tst_pop_packed_msgs,
+      tst_real_time,
+      tst_sysex,
+      tst_sysex_abort,
+      tst_sysex_long_dump,
+      tst_aftertouch_program_change,
+      tst_timestamps,
+      tst_timestamps_chunk,
+      tst_timestamps_stop_early,
+      tst_timestamps_overflow,
+      tst_timestamps_overflow_order,
+      tst_timestamp_buffer,
   };
 
   return (run_tests_with_fixture(tests_with_fixture,
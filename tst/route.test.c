@@ -0,0 +1,279 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OK STAT_OK
+
+#include "route.h"
+#include "test_msgs.h"
+
+static MIDI_Router router; // too big for the stack
+
+static bool msg_eq(MIDI_Message a, MIDI_Message b) {
+  return a.type == b.type && a.channel == b.channel && a.data.pitch_bend.value == b.data.pitch_bend.value;
+}
+
+// routes a single message, returns the number of messages it turned into
+static size_t route_one(MIDI_Message msg, MIDI_Message * out) {
+  size_t consumed = 0;
+  return MIDI_route_apply(&router, &msg, 1, out, MIDI_ROUTE_MAX_OUTPUTS, &consumed);
+}
+
+static Result tst_no_rules(void) {
+  Result r = PASS;
+
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, NULL, 0));
+
+  const MIDI_Message in[] = {
+      note_on(1, 60, 100),
+      note_off(16, 0, 0),
+      cc(5, MIDI_CTRL_VOLUME, 127),
+      {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = 2, .data.program_change = {12}},
+      {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = 3, .data.aftertouch_mono = {99}},
+      {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 4, .data.pitch_bend = {-8192}},
+      {.type = MIDI_MSG_TYPE_MISC, .data.misc = {MIDI_RT_CLOCK}},
+  };
+  const size_t n = sizeof(in) / sizeof(in[0]);
+
+  MIDI_Message out[8];
+  size_t       consumed = 0;
+  EXPECT_EQ(&r, n, MIDI_route_apply(&router, in, n, out, 8, &consumed));
+  EXPECT_EQ(&r, n, consumed);
+  for(size_t i = 0; i < n; i++) EXPECT_TRUE(&r, msg_eq(in[i], out[i]));
+
+  // stops before what doesn't fit
+  EXPECT_EQ(&r, 3, MIDI_route_apply(&router, in, n, out, 3, &consumed));
+  EXPECT_EQ(&r, 3, consumed);
+
+  return r;
+}
+
+static Result tst_split_and_transpose(void) {
+  Result r = PASS;
+
+  // a keyboard split, the left hand an octave up on channel 2 and the right hand on channel 3, channel 10 muted
+  MIDI_RouteRule rules[3] = {MIDI_ROUTE_RULE_ALL, MIDI_ROUTE_RULE_ALL, MIDI_ROUTE_RULE_ALL};
+  rules[0].channel_mask   = 1u << 9;
+  rules[0].action         = MIDI_ROUTE_DROP;
+  rules[1].types          = MIDI_ROUTE_NOTE_TYPES;
+  rules[1].key_max        = 59;
+  rules[1].channel        = 2;
+  rules[1].transpose      = 12;
+  rules[2].types          = MIDI_ROUTE_NOTE_TYPES;
+  rules[2].channel_mask   = 1;
+  rules[2].key_min        = 60;
+  rules[2].channel        = 3;
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, rules, 3));
+
+  MIDI_Message out[MIDI_ROUTE_MAX_OUTPUTS];
+  // later rules see what earlier ones made of a message, 59 is 71 on channel 2 by the time the right hand rule sees it
+  EXPECT_EQ(&r, 1, route_one(note_on(1, 59, 100), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(2, 71, 100), out[0]));
+  EXPECT_EQ(&r, 1, route_one(note_off(1, 59, 10), out));
+  EXPECT_TRUE(&r, msg_eq(note_off(2, 71, 10), out[0]));
+  EXPECT_EQ(&r, 1, route_one(note_on(1, 60, 100), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(3, 60, 100), out[0]));
+
+  // the left hand rule takes all channels, the right hand one only channel 1
+  EXPECT_EQ(&r, 1, route_one(note_on(4, 0, 1), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(2, 12, 1), out[0]));
+  EXPECT_EQ(&r, 1, route_one(note_on(4, 60, 1), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(4, 60, 1), out[0]));
+
+  // controllers aren't notes
+  EXPECT_EQ(&r, 1, route_one(cc(1, 20, 5), out));
+  EXPECT_TRUE(&r, msg_eq(cc(1, 20, 5), out[0]));
+
+  EXPECT_EQ(&r, 0, route_one(note_on(10, 60, 100), out));
+  EXPECT_EQ(&r, 0, route_one(cc(10, 7, 100), out));
+
+  // in a batch, what's dropped leaves no gap, but still needs room in out
+  const MIDI_Message in[]     = {note_on(10, 60, 100), note_on(1, 60, 100), note_on(10, 62, 100)};
+  size_t             consumed = 0;
+  EXPECT_EQ(&r, 1, MIDI_route_apply(&router, in, 3, out, 2, &consumed));
+  EXPECT_EQ(&r, 3, consumed);
+  EXPECT_TRUE(&r, msg_eq(note_on(3, 60, 100), out[0]));
+  EXPECT_EQ(&r, 1, MIDI_route_apply(&router, in, 3, out, 1, &consumed));
+  EXPECT_EQ(&r, 2, consumed);
+
+  // out of range after transposing
+  rules[1].key_max   = 127;
+  rules[1].transpose = -12;
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, rules, 2));
+  EXPECT_EQ(&r, 0, route_one(note_on(1, 11, 100), out));
+  EXPECT_EQ(&r, 1, route_one(note_on(1, 12, 100), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(2, 0, 100), out[0]));
+
+  return r;
+}
+
+static Result tst_values(void) {
+  Result r = PASS;
+
+  uint8_t half[128];
+  uint8_t plus_ten[128];
+  MIDI_route_linear_values(half, 64, 0, 0, 127);
+  MIDI_route_linear_values(plus_ten, 128, 10, 0, 127);
+  EXPECT_EQ(&r, 50, half[100]);
+  EXPECT_EQ(&r, 127, plus_ten[120]);
+
+  // mod wheel to cutoff at half the range, then everything raised by 10
+  MIDI_RouteRule rules[2] = {MIDI_ROUTE_RULE_ALL, MIDI_ROUTE_RULE_ALL};
+  rules[0].types          = MIDI_ROUTE_TYPE(MIDI_MSG_TYPE_CONTROL_CHANGE);
+  rules[0].key_min        = MIDI_CTRL_MOD_WHEEL;
+  rules[0].key_max        = MIDI_CTRL_MOD_WHEEL;
+  rules[0].key            = MIDI_CTRL_CUTOFF_FREQUENCY;
+  rules[0].values         = half;
+  rules[1].values         = plus_ten;
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, rules, 2));
+  EXPECT_EQ(&r, 3, router.num_tables); // identity, plus_ten, and both
+
+  MIDI_Message out[MIDI_ROUTE_MAX_OUTPUTS];
+  EXPECT_EQ(&r, 1, route_one(cc(1, MIDI_CTRL_MOD_WHEEL, 100), out));
+  EXPECT_TRUE(&r, msg_eq(cc(1, MIDI_CTRL_CUTOFF_FREQUENCY, 60), out[0]));
+  EXPECT_EQ(&r, 1, route_one(cc(1, MIDI_CTRL_VOLUME, 100), out));
+  EXPECT_TRUE(&r, msg_eq(cc(1, MIDI_CTRL_VOLUME, 110), out[0]));
+
+  const MIDI_Message pressure = {.type = MIDI_MSG_TYPE_AFTERTOUCH_MONO, .channel = 7, .data.aftertouch_mono = {1}};
+  EXPECT_EQ(&r, 1, route_one(pressure, out));
+  EXPECT_EQ(&r, 11, out[0].data.aftertouch_mono.value);
+
+  // no values to map
+  const MIDI_Message bend = {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 7, .data.pitch_bend = {-100}};
+  EXPECT_EQ(&r, 1, route_one(bend, out));
+  EXPECT_TRUE(&r, msg_eq(bend, out[0]));
+
+  // a velocity curve never turns a note on into a note off
+  uint8_t zero[128];
+  MIDI_route_linear_values(zero, 0, 0, 0, 127);
+  rules[0]        = MIDI_ROUTE_RULE_ALL;
+  rules[0].values = zero;
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, rules, 1));
+  EXPECT_EQ(&r, 1, route_one(note_on(1, 60, 100), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(1, 60, 1), out[0]));
+  EXPECT_EQ(&r, 1, route_one(note_off(1, 60, 100), out));
+  EXPECT_TRUE(&r, msg_eq(note_off(1, 60, 0), out[0]));
+
+  return r;
+}
+
+static Result tst_duplicate(void) {
+  Result r = PASS;
+
+  // notes layered an octave down on channel 5, and the original dropped above C6
+  MIDI_RouteRule rules[2] = {MIDI_ROUTE_RULE_ALL, MIDI_ROUTE_RULE_ALL};
+  rules[0].types          = MIDI_ROUTE_NOTE_TYPES;
+  rules[0].action         = MIDI_ROUTE_DUPLICATE;
+  rules[0].channel        = 5;
+  rules[0].transpose      = -12;
+  rules[1].types          = MIDI_ROUTE_NOTE_TYPES;
+  rules[1].channel_mask   = 1;
+  rules[1].key_min        = 84;
+  rules[1].action         = MIDI_ROUTE_DROP;
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, rules, 2));
+
+  MIDI_Message out[MIDI_ROUTE_MAX_OUTPUTS];
+  EXPECT_EQ(&r, 2, route_one(note_on(1, 60, 100), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(1, 60, 100), out[0]));
+  EXPECT_TRUE(&r, msg_eq(note_on(5, 48, 100), out[1]));
+
+  EXPECT_EQ(&r, 1, route_one(note_off(1, 90, 0), out));
+  EXPECT_TRUE(&r, msg_eq(note_off(5, 78, 0), out[0]));
+
+  // the copy goes on to the later rules too
+  EXPECT_EQ(&r, 2, route_one(note_on(2, 100, 1), out));
+  EXPECT_TRUE(&r, msg_eq(note_on(2, 100, 1), out[0]));
+  EXPECT_TRUE(&r, msg_eq(note_on(5, 88, 1), out[1]));
+  EXPECT_EQ(&r, 1, route_one(note_on(2, 5, 1), out)); // the copy falls off the keyboard
+
+  // a batch that doesn't fit is cut between messages
+  const MIDI_Message in[] = {note_on(1, 60, 100), note_on(1, 62, 100), note_on(1, 64, 100)};
+  size_t             consumed = 0;
+  EXPECT_EQ(&r, 4, MIDI_route_apply(&router, in, 3, out, 5, &consumed));
+  EXPECT_EQ(&r, 2, consumed);
+  EXPECT_TRUE(&r, msg_eq(note_on(5, 50, 100), out[3]));
+
+  return r;
+}
+
+static Result tst_errors(void) {
+  Result r = PASS;
+
+  MIDI_RouteRule rules[8];
+  for(size_t i = 0; i < 8; i++) {
+    rules[i]              = MIDI_ROUTE_RULE_ALL;
+    rules[i].types        = MIDI_ROUTE_TYPE(MIDI_MSG_TYPE_NOTE_ON);
+    rules[i].channel_mask = 1;
+    rules[i].action       = MIDI_ROUTE_DUPLICATE;
+  }
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, rules, 3)); // 8 outputs
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_route_compile(&router, rules, 5));
+
+  // a copy of everything doesn't fit
+  rules[0]        = MIDI_ROUTE_RULE_ALL;
+  rules[0].action = MIDI_ROUTE_DUPLICATE;
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_route_compile(&router, rules, 1));
+
+  // nor do a hundred different value tables
+  static uint8_t        tables[100][128];
+  static MIDI_RouteRule many[100];
+  for(size_t i = 0; i < 100; i++) {
+    MIDI_route_linear_values(tables[i], 128, (int16_t)i, 0, 127);
+    many[i]              = MIDI_ROUTE_RULE_ALL;
+    many[i].types        = MIDI_ROUTE_TYPE(MIDI_MSG_TYPE_CONTROL_CHANGE);
+    many[i].channel_mask = 1;
+    many[i].key_min      = (uint8_t)i;
+    many[i].key_max      = (uint8_t)i;
+    many[i].values       = tables[i];
+  }
+  EXPECT_EQ(&r, OK, MIDI_route_compile(&router, many, MIDI_ROUTER_MAX_TABLES - 1));
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_route_compile(&router, many, 100));
+
+  rules[0] = MIDI_ROUTE_RULE_ALL;
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_route_compile(NULL, rules, 1));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_route_compile(&router, NULL, 1));
+  rules[0].action = 3;
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_route_compile(&router, rules, 1));
+  rules[0]         = MIDI_ROUTE_RULE_ALL;
+  rules[0].channel = 17;
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_route_compile(&router, rules, 1));
+  rules[0]     = MIDI_ROUTE_RULE_ALL;
+  rules[0].key = 128;
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_route_compile(&router, rules, 1));
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_no_rules,
+      tst_split_and_transpose,
+      tst_values,
+      tst_duplicate,
+      tst_errors,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
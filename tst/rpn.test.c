@@ -0,0 +1,310 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OK STAT_OK
+
+#include "cc14.h"
+#include "rpn.h"
+#include "test_msgs.h"
+
+static MIDI_RpnResult select_rpn(MIDI_RpnDecoder * decoder, MIDI_Channel channel, uint16_t param) {
+  MIDI_ParamChange out;
+  MIDI_rpn_process(decoder, cc(channel, MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB, param >> 7), 0, &out);
+  return MIDI_rpn_process(decoder, cc(channel, MIDI_CTRL_REGISTERED_PARAM_NUMBER_LSB, param & 0x7f), 0, &out);
+}
+
+static Result expect_change(MIDI_ParamChange change, MIDI_Channel channel, MIDI_ParamKind kind, MIDI_ParamOp op,
+                            uint16_t param, uint16_t value) {
+  Result r = PASS;
+
+  EXPECT_EQ(&r, channel, change.channel);
+  EXPECT_EQ(&r, kind, change.kind);
+  EXPECT_EQ(&r, op, change.op);
+  EXPECT_EQ(&r, param, change.param);
+  EXPECT_EQ(&r, value, change.value);
+
+  return r;
+}
+
+static Result tst_rpn(void) {
+  Result r = PASS;
+
+  MIDI_RpnDecoder decoder;
+  EXPECT_EQ(&r, OK, MIDI_rpn_init(&decoder, MIDI_RPN_WAIT_FOR_LSB, 0));
+
+  MIDI_ParamChange out = {0};
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED,
+            MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB, 0x00), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED,
+            MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_REGISTERED_PARAM_NUMBER_LSB, 0x02), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY, 0x40), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY_LSB, 0x01), 0, &out));
+  EXPECT_EQ(&r, PASS,
+            expect_change(out, 1, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_COARSE_TUNING, (0x40 << 7) | 0x01));
+
+  // the parameter stays selected
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY_LSB, 0x02), 0, &out));
+  EXPECT_EQ(&r, PASS,
+            expect_change(out, 1, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_COARSE_TUNING, (0x40 << 7) | 0x02));
+
+  // a data entry MSB on its own is let go by the next one
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY, 0x10), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY, 0x11), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 1, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_COARSE_TUNING, 0x10 << 7));
+
+  // or by selecting another parameter, it still belongs to the old one
+  EXPECT_EQ(&r, MIDI_RPN_EMIT,
+            MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_MSB, 0x05), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 1, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_COARSE_TUNING, 0x11 << 7));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED,
+            MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_LSB, 0x06), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY, 0x7f), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY_LSB, 0x7f), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 1, MIDI_PARAM_NRPN, MIDI_PARAM_SET, (0x05 << 7) | 0x06, 0x3fff));
+
+  MIDI_ParamChange flushed[4];
+  EXPECT_EQ(&r, 0, MIDI_rpn_flush(&decoder, flushed, 4));
+
+  return r;
+}
+
+static Result tst_null_and_pass(void) {
+  Result r = PASS;
+
+  MIDI_RpnDecoder decoder;
+  EXPECT_EQ(&r, OK, MIDI_rpn_init(&decoder, MIDI_RPN_WAIT_FOR_LSB, 0));
+
+  MIDI_ParamChange out = {0};
+
+  // nothing selected yet
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(2, MIDI_CTRL_DATA_ENTRY, 0x40), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(2, MIDI_CTRL_DATA_ENTRY_LSB, 0x40), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(2, MIDI_CTRL_DATA_INCREMENT, 0), 0, &out));
+
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, select_rpn(&decoder, 2, MIDI_RPN_PITCH_BEND_SENSITIVITY));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, select_rpn(&decoder, 2, MIDI_RPN_NULL));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(2, MIDI_CTRL_DATA_ENTRY, 0x40), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(2, MIDI_CTRL_DATA_ENTRY_LSB, 0x40), 0, &out));
+
+  const MIDI_Message passed[] = {
+      cc(2, MIDI_CTRL_VOLUME, 1),
+      cc(0, MIDI_CTRL_DATA_ENTRY, 1), // no channel
+      {.type = MIDI_MSG_TYPE_NOTE_ON, .channel = 2, .data.note_on = {.note = MIDI_CTRL_DATA_ENTRY, .velocity = 1}},
+  };
+  for(size_t i = 0; i < sizeof(passed) / sizeof(passed[0]); i++) {
+    EXPECT_EQ(&r, MIDI_RPN_PASS, MIDI_rpn_process(&decoder, passed[i], 0, &out));
+  }
+
+  MIDI_ParamChange flushed[4];
+  EXPECT_EQ(&r, 0, MIDI_rpn_flush(&decoder, flushed, 4));
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_rpn_init(NULL, MIDI_RPN_WAIT_FOR_LSB, 0));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_rpn_init(&decoder, (MIDI_RpnMode)7, 0));
+
+  return r;
+}
+
+static Result tst_increment_decrement(void) {
+  Result r = PASS;
+
+  MIDI_RpnDecoder decoder;
+  EXPECT_EQ(&r, OK, MIDI_rpn_init(&decoder, MIDI_RPN_WAIT_FOR_LSB, 0));
+
+  MIDI_ParamChange out = {0};
+
+  // without a value to go from, they're passed on as they are
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, select_rpn(&decoder, 3, MIDI_RPN_FINE_TUNING));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_INCREMENT, 0), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 3, MIDI_PARAM_RPN, MIDI_PARAM_INCREMENT, MIDI_RPN_FINE_TUNING, 0));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_DECREMENT, 0), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 3, MIDI_PARAM_RPN, MIDI_PARAM_DECREMENT, MIDI_RPN_FINE_TUNING, 0));
+
+  // a held MSB is folded in
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_ENTRY, 0x7f), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_DECREMENT, 0), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 3, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_FINE_TUNING, (0x7f << 7) - 1));
+
+  MIDI_ParamChange flushed[4];
+  EXPECT_EQ(&r, 0, MIDI_rpn_flush(&decoder, flushed, 4));
+
+  // clamped at both ends
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_ENTRY_LSB, 0x7f), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 3, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_FINE_TUNING, 0x3f7f));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_ENTRY, 0x7f), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_ENTRY_LSB, 0x7f), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_INCREMENT, 0), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 3, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_FINE_TUNING, 0x3fff));
+
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, select_rpn(&decoder, 3, MIDI_RPN_COARSE_TUNING));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_ENTRY, 0), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_ENTRY_LSB, 1), 0, &out));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_DECREMENT, 0), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 3, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_COARSE_TUNING, 0));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(3, MIDI_CTRL_DATA_DECREMENT, 0), 0, &out));
+  EXPECT_EQ(&r, PASS, expect_change(out, 3, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_COARSE_TUNING, 0));
+
+  return r;
+}
+
+static Result tst_timeout_and_modes(void) {
+  Result r = PASS;
+
+  MIDI_RpnDecoder decoder;
+  EXPECT_EQ(&r, OK, MIDI_rpn_init(&decoder, MIDI_RPN_WAIT_FOR_LSB, 100));
+
+  MIDI_ParamChange out[4];
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, select_rpn(&decoder, 1, MIDI_RPN_PITCH_BEND_SENSITIVITY));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, select_rpn(&decoder, 16, MIDI_RPN_COARSE_TUNING));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(16, MIDI_CTRL_DATA_ENTRY, 2), 1000, &out[0]));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY, 12), 1050, &out[0]));
+
+  EXPECT_EQ(&r, 0, MIDI_rpn_poll(&decoder, 1099, out, 4));
+  EXPECT_EQ(&r, 1, MIDI_rpn_poll(&decoder, 1100, out, 4));
+  EXPECT_EQ(&r, PASS, expect_change(out[0], 16, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_COARSE_TUNING, 2 << 7));
+  EXPECT_EQ(&r, 1, MIDI_rpn_flush(&decoder, out, 4));
+  EXPECT_EQ(&r, PASS,
+            expect_change(out[0], 1, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_PITCH_BEND_SENSITIVITY, 12 << 7));
+  EXPECT_EQ(&r, 0, MIDI_rpn_flush(&decoder, out, 4));
+
+  EXPECT_EQ(&r, OK, MIDI_rpn_init(&decoder, MIDI_RPN_MSB_IMMEDIATE, 0));
+  EXPECT_EQ(&r, MIDI_RPN_CONSUMED, select_rpn(&decoder, 1, MIDI_RPN_PITCH_BEND_SENSITIVITY));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY, 12), 0, &out[0]));
+  EXPECT_EQ(&r, PASS,
+            expect_change(out[0], 1, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_PITCH_BEND_SENSITIVITY, 12 << 7));
+  EXPECT_EQ(&r, MIDI_RPN_EMIT, MIDI_rpn_process(&decoder, cc(1, MIDI_CTRL_DATA_ENTRY_LSB, 50), 0, &out[0]));
+  EXPECT_EQ(&r, PASS,
+            expect_change(out[0], 1, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_PITCH_BEND_SENSITIVITY, (12 << 7) | 50));
+  EXPECT_EQ(&r, 0, MIDI_rpn_flush(&decoder, out, 4));
+
+  return r;
+}
+
+// behind a parser, every four-CC write comes out as one change
+static Result tst_behind_parser(void) {
+  Result r = PASS;
+
+  MIDI_RpnDecoder decoder;
+  EXPECT_EQ(&r, OK, MIDI_rpn_init(&decoder, MIDI_RPN_WAIT_FOR_LSB, 0));
+
+  uint8_t bytes[1 + 8 * 6];
+  size_t  n  = 0;
+  bytes[n++] = 0xb9; // channel 10, running status from here on
+  for(uint8_t i = 0; i < 6; i++) {
+    bytes[n++] = MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_MSB;
+    bytes[n++] = 0x01;
+    bytes[n++] = MIDI_CTRL_NON_REGISTERED_PARAM_NUMBER_LSB;
+    bytes[n++] = i;
+    bytes[n++] = MIDI_CTRL_DATA_ENTRY;
+    bytes[n++] = i;
+    bytes[n++] = MIDI_CTRL_DATA_ENTRY_LSB;
+    bytes[n++] = 0x7f - i;
+  }
+
+  MIDI_Message msgs[4 * 6];
+  const size_t num_msgs = parse_msgs(bytes, n, msgs, 4 * 6);
+  EXPECT_EQ(&r, 4 * 6, num_msgs);
+
+  size_t num_changes = 0;
+  for(size_t m = 0; m < num_msgs; m++) {
+    MIDI_ParamChange out;
+    if(MIDI_rpn_process(&decoder, msgs[m], 0, &out) == MIDI_RPN_EMIT) {
+      const uint8_t  i     = (uint8_t)num_changes;
+      const uint16_t value = (uint16_t)((i << 7) | (0x7f - i));
+      EXPECT_EQ(&r, PASS, expect_change(out, 10, MIDI_PARAM_NRPN, MIDI_PARAM_SET, (0x01 << 7) | i, value));
+      num_changes++;
+    }
+  }
+  EXPECT_EQ(&r, 6, num_changes);
+
+  return r;
+}
+
+// behind a parser and a pairer, the pairer passes data entry on and only pairs the other controllers
+static Result tst_behind_cc14(void) {
+  Result r = PASS;
+
+  MIDI_Cc14Pairer pairer;
+  MIDI_RpnDecoder decoder;
+  EXPECT_EQ(&r, OK, MIDI_cc14_init(&pairer, MIDI_CC14_DEFINED_CONTROLS, MIDI_CC14_WAIT_FOR_LSB, 0));
+  EXPECT_EQ(&r, OK, MIDI_rpn_init(&decoder, MIDI_RPN_WAIT_FOR_LSB, 0));
+
+  // clang-format off
+  const uint8_t bytes[] = {
+    0xb1, // channel 2, running status from here on
+    MIDI_CTRL_REGISTERED_PARAM_NUMBER_MSB, 0x00,
+    MIDI_CTRL_REGISTERED_PARAM_NUMBER_LSB, 0x00,
+    MIDI_CTRL_MOD_WHEEL,                   0x12,
+    MIDI_CTRL_DATA_ENTRY,                  0x0c,
+    MIDI_CTRL_MOD_WHEEL_LSB,               0x34,
+    MIDI_CTRL_DATA_ENTRY_LSB,              0x32,
+  };
+  // clang-format on
+
+  MIDI_Message msgs[6];
+  const size_t num_msgs = parse_msgs(bytes, sizeof(bytes), msgs, 6);
+  EXPECT_EQ(&r, 6, num_msgs);
+
+  size_t num_cc14    = 0;
+  size_t num_changes = 0;
+  for(size_t i = 0; i < num_msgs; i++) {
+    MIDI_ControlChange14 cc14;
+    switch(MIDI_cc14_process(&pairer, msgs[i], 0, &cc14)) {
+    case MIDI_CC14_EMIT:
+      EXPECT_EQ(&r, MIDI_CTRL_MOD_WHEEL, cc14.control);
+      EXPECT_EQ(&r, (0x12 << 7) | 0x34, cc14.value);
+      num_cc14++;
+      break;
+    case MIDI_CC14_HELD: break;
+    case MIDI_CC14_PASS: {
+      MIDI_ParamChange out;
+      if(MIDI_rpn_process(&decoder, msgs[i], 0, &out) == MIDI_RPN_EMIT) {
+        EXPECT_EQ(&r, PASS,
+                  expect_change(out, 2, MIDI_PARAM_RPN, MIDI_PARAM_SET, MIDI_RPN_PITCH_BEND_SENSITIVITY,
+                                (0x0c << 7) | 0x32));
+        num_changes++;
+      }
+      break;
+    }
+    }
+  }
+  EXPECT_EQ(&r, 1, num_cc14);
+  EXPECT_EQ(&r, 1, num_changes);
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_rpn,
+      tst_null_and_pass,
+      tst_increment_decrement,
+      tst_timeout_and_modes,
+      tst_behind_parser,
+      tst_behind_cc14,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
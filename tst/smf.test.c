@@ -0,0 +1,320 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OK STAT_OK
+
+#include "smf.h"
+
+// clang-format off
+static const uint8_t test_file[] = {
+  'M', 'T', 'h', 'd', 0x00, 0x00, 0x00, 0x06,
+  0x00, 0x01,                   // format 1
+  0x00, 0x02,                   // 2 tracks
+  0x01, 0xe0,                   // 480 ticks per quarter note
+
+  'M', 'T', 'r', 'k', 0x00, 0x00, 0x00, 0x22,
+  0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20, // tempo, skipped
+  0x00, 0x90, 0x3c, 0x64,                   // note on C4
+  0x83, 0x60, 0x3c, 0x00,                   // 480 later, running status note on with velocity 0
+  0x00, 0xf0, 0x03, 0x7e, 0x01, 0xf7,       // SysEx, skipped
+  0x81, 0x00, 0x40, 0x64,                   // 128 later, running status survived the SysEx
+  0x00, 0xc1, 0x05,                         // program change on channel 2
+  0x0a, 0x06,                               // with running status
+  0x00, 0xff, 0x2f, 0x00,                   // end of track
+
+  'X', 'F', 'I', 'H', 0x00, 0x00, 0x00, 0x02, // some other chunk, skipped
+  0xab, 0xcd,
+
+  'M', 'T', 'r', 'k', 0x00, 0x00, 0x00, 0x0b,
+  0x00, 0xb0, 0x07, 0x64,                   // volume
+  0xff, 0xff, 0xff, 0x7f, 0xe0, 0x00, 0x40, // longest delta time there is, pitch bend center, no end of track
+};
+// clang-format on
+
+static const MIDI_SmfEvent track0_events[] = {
+    {0, {.type = MIDI_MSG_TYPE_NOTE_ON, .channel = 1, .data.note_on = {.note = MIDI_NOTE_C_4, .velocity = 100}}},
+    {480, {.type = MIDI_MSG_TYPE_NOTE_OFF, .channel = 1, .data.note_off = {.note = MIDI_NOTE_C_4, .velocity = 63}}},
+    {608, {.type = MIDI_MSG_TYPE_NOTE_ON, .channel = 1, .data.note_on = {.note = 0x40, .velocity = 100}}},
+    {608, {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = 2, .data.program_change = {.program = 5}}},
+    {618, {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = 2, .data.program_change = {.program = 6}}},
+};
+
+static const MIDI_SmfEvent track1_events[] = {
+    {0,
+     {.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+      .channel             = 1,
+      .data.control_change = {.control = MIDI_CTRL_VOLUME, .value = 100}}},
+    {MIDI_SMF_VLQ_MAX, {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 1, .data.pitch_bend = {.value = 0}}},
+};
+
+static Result expect_events(MIDI_SmfTrack track, const MIDI_SmfEvent * expect, size_t n) {
+  Result r = PASS;
+
+  MIDI_SmfTrackIter iter;
+  EXPECT_EQ(&r, OK, MIDI_smf_track_iter_init(&iter, track));
+
+  for(size_t i = 0; i < n; i++) {
+    MIDI_SmfEvent event = {0};
+    EXPECT_EQ(&r, OK, MIDI_smf_track_iter_next(&iter, &event));
+    EXPECT_EQ(&r, expect[i].tick, event.tick);
+    EXPECT_EQ(&r, expect[i].msg.type, event.msg.type);
+    EXPECT_EQ(&r, expect[i].msg.channel, event.msg.channel);
+    EXPECT_EQ(&r, expect[i].msg.data.pitch_bend.value, event.msg.data.pitch_bend.value); // compares all data bytes
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  MIDI_SmfEvent event = {0};
+  EXPECT_EQ(&r, STAT_OK_FINISHED, MIDI_smf_track_iter_next(&iter, &event));
+  EXPECT_EQ(&r, STAT_OK_FINISHED, MIDI_smf_track_iter_next(&iter, &event)); // and stays finished
+
+  return r;
+}
+
+static Result expect_test_file(const MIDI_Smf * smf) {
+  Result r = PASS;
+
+  EXPECT_EQ(&r, 1, smf->format);
+  EXPECT_EQ(&r, 2, smf->num_tracks);
+  EXPECT_EQ(&r, 480, smf->division);
+
+  MIDI_SmfTrack tracks[4];
+  size_t        num_tracks = 0;
+  EXPECT_EQ(&r, OK, MIDI_smf_get_tracks(smf, tracks, 4, &num_tracks));
+  EXPECT_EQ(&r, 2, num_tracks);
+  if(HAS_FAILED(&r)) return r;
+
+  EXPECT_EQ(&r, PASS, expect_events(tracks[0], track0_events, sizeof(track0_events) / sizeof(track0_events[0])));
+  EXPECT_EQ(&r, PASS, expect_events(tracks[1], track1_events, sizeof(track1_events) / sizeof(track1_events[0])));
+
+  return r;
+}
+
+static Result tst_vlq(void) {
+  Result r = PASS;
+
+  const struct {
+    uint8_t  bytes[MIDI_SMF_VLQ_MAX_SIZE];
+    size_t   len;
+    uint32_t value;
+  } cases[] = {
+      {{0x00}, 1, 0},
+      {{0x40}, 1, 0x40},
+      {{0x7f}, 1, 0x7f},
+      {{0x81, 0x00}, 2, 0x80},
+      {{0xc0, 0x00}, 2, 0x2000},
+      {{0xff, 0x7f}, 2, 0x3fff},
+      {{0x81, 0x80, 0x00}, 3, 0x4000},
+      {{0xff, 0xff, 0x7f}, 3, 0x1fffff},
+      {{0x81, 0x80, 0x80, 0x00}, 4, 0x200000},
+      {{0xff, 0xff, 0xff, 0x7f}, 4, MIDI_SMF_VLQ_MAX},
+  };
+
+  for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const uint8_t * pos   = cases[i].bytes;
+    uint32_t        value = 0;
+    EXPECT_TRUE(&r, MIDI_smf_decode_vlq(&pos, cases[i].bytes + cases[i].len, &value));
+    EXPECT_EQ(&r, cases[i].value, value);
+    EXPECT_EQ(&r, cases[i].bytes + cases[i].len, pos);
+
+    uint8_t encoded[MIDI_SMF_VLQ_MAX_SIZE] = {0};
+    EXPECT_EQ(&r, cases[i].len, MIDI_smf_encode_vlq(cases[i].value, encoded));
+    EXPECT_EQ(&r, 0, memcmp(cases[i].bytes, encoded, cases[i].len));
+
+    // cut short, it should fail and leave pos alone
+    pos = cases[i].bytes;
+    EXPECT_FALSE(&r, MIDI_smf_decode_vlq(&pos, cases[i].bytes + cases[i].len - 1, &value));
+    EXPECT_EQ(&r, cases[i].bytes, pos);
+  }
+
+  const uint8_t   too_long[] = {0x81, 0x80, 0x80, 0x80, 0x00};
+  const uint8_t * pos        = too_long;
+  uint32_t        value      = 0;
+  EXPECT_FALSE(&r, MIDI_smf_decode_vlq(&pos, too_long + sizeof(too_long), &value));
+
+  return r;
+}
+
+static Result tst_open_buffer(void) {
+  Result r = PASS;
+
+  MIDI_Smf smf;
+  EXPECT_EQ(&r, OK, MIDI_smf_open_buffer(&smf, test_file, sizeof(test_file)));
+  EXPECT_FALSE(&r, smf.is_mapped);
+  EXPECT_EQ(&r, PASS, expect_test_file(&smf));
+  EXPECT_EQ(&r, OK, MIDI_smf_close(&smf));
+
+  return r;
+}
+
+static Result tst_open_file(void) {
+  Result r = PASS;
+
+  char path[] = "/tmp/c_midi_smf_test_XXXXXX";
+  int  fd     = mkstemp(path);
+  EXPECT_TRUE(&r, fd >= 0);
+  if(HAS_FAILED(&r)) return r;
+  EXPECT_EQ(&r, (ssize_t)sizeof(test_file), write(fd, test_file, sizeof(test_file)));
+  close(fd);
+
+  MIDI_Smf smf;
+  EXPECT_EQ(&r, OK, MIDI_smf_open(&smf, path));
+  EXPECT_TRUE(&r, smf.is_mapped);
+  EXPECT_EQ(&r, PASS, expect_test_file(&smf));
+  EXPECT_EQ(&r, OK, MIDI_smf_close(&smf));
+
+  unlink(path);
+
+  EXPECT_EQ(&r, STAT_ERR_IO, MIDI_smf_open(&smf, path));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_open(&smf, NULL));
+
+  return r;
+}
+
+static Result tst_invalid_header(void) {
+  Result r = PASS;
+
+  MIDI_Smf smf;
+  uint8_t  data[sizeof(test_file)];
+
+  memcpy(data, test_file, sizeof(data));
+  data[0] = 'R'; // RIFF MIDI isn't supported
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_open_buffer(&smf, data, sizeof(data)));
+
+  memcpy(data, test_file, sizeof(data));
+  data[9] = 3; // format 3 doesn't exist
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_open_buffer(&smf, data, sizeof(data)));
+
+  memcpy(data, test_file, sizeof(data));
+  data[7] = 5; // header too short
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_open_buffer(&smf, data, sizeof(data)));
+
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_open_buffer(&smf, test_file, 13));
+
+  // a longer header is fine, the rest of it is skipped
+  // clang-format off
+  const uint8_t long_header[] = {
+    'M', 'T', 'h', 'd', 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x01, 0x00, 0x60, 0xaa, 0xbb,
+    'M', 'T', 'r', 'k', 0x00, 0x00, 0x00, 0x04, 0x00, 0xff, 0x2f, 0x00,
+  };
+  // clang-format on
+  MIDI_SmfTrack track;
+  size_t        num_tracks = 0;
+  EXPECT_EQ(&r, OK, MIDI_smf_open_buffer(&smf, long_header, sizeof(long_header)));
+  EXPECT_EQ(&r, OK, MIDI_smf_get_tracks(&smf, &track, 1, &num_tracks));
+  EXPECT_EQ(&r, 1, num_tracks);
+  EXPECT_EQ(&r, 4, track.len);
+
+  return r;
+}
+
+static Result tst_get_tracks(void) {
+  Result r = PASS;
+
+  MIDI_Smf smf;
+  EXPECT_EQ(&r, OK, MIDI_smf_open_buffer(&smf, test_file, sizeof(test_file)));
+
+  MIDI_SmfTrack tracks[2];
+  size_t        num_tracks = 0;
+  EXPECT_EQ(&r, OK, MIDI_smf_get_tracks(&smf, tracks, 1, &num_tracks));
+  EXPECT_EQ(&r, 1, num_tracks);
+  EXPECT_EQ(&r, &test_file[22], tracks[0].data); // points into the file, nothing is copied
+  EXPECT_EQ(&r, 0x22, tracks[0].len);
+
+  // a truncated file gives a truncated last track
+  EXPECT_EQ(&r, OK, MIDI_smf_open_buffer(&smf, test_file, sizeof(test_file) - 3));
+  EXPECT_EQ(&r, OK, MIDI_smf_get_tracks(&smf, tracks, 2, &num_tracks));
+  EXPECT_EQ(&r, 2, num_tracks);
+  if(HAS_FAILED(&r)) return r;
+  EXPECT_EQ(&r, 0x0b - 3, tracks[1].len);
+
+  // the first event is complete, the second one is cut off
+  MIDI_SmfTrackIter iter;
+  MIDI_SmfEvent     event;
+  EXPECT_EQ(&r, OK, MIDI_smf_track_iter_init(&iter, tracks[1]));
+  EXPECT_EQ(&r, OK, MIDI_smf_track_iter_next(&iter, &event));
+  EXPECT_EQ(&r, MIDI_MSG_TYPE_CONTROL_CHANGE, event.msg.type);
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_track_iter_next(&iter, &event));
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_get_tracks(&smf, NULL, 2, &num_tracks));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_get_tracks(&smf, tracks, 2, NULL));
+
+  return r;
+}
+
+static Result tst_malformed_tracks(void) {
+  Result r = PASS;
+
+  // clang-format off
+  const uint8_t no_running_status[] = {0x00, 0x3c, 0x64};
+  const uint8_t truncated_msg[]     = {0x00, 0x90, 0x3c};
+  const uint8_t status_in_data[]    = {0x00, 0x90, 0x3c, 0x80, 0x3c, 0x00};
+  const uint8_t truncated_meta[]    = {0x00, 0xff, 0x01, 0x05, 'a', 'b'};
+  const uint8_t truncated_delta[]   = {0x00, 0x90, 0x3c, 0x64, 0x81};
+  const uint8_t system_common[]     = {0x00, 0xf2, 0x00, 0x00};
+  // clang-format on
+
+  const MIDI_SmfTrack tracks[] = {
+      {no_running_status, sizeof(no_running_status)},
+      {truncated_msg, sizeof(truncated_msg)},
+      {status_in_data, sizeof(status_in_data)},
+      {truncated_meta, sizeof(truncated_meta)},
+      {truncated_delta + 4, 1},
+      {system_common, sizeof(system_common)},
+  };
+
+  for(size_t i = 0; i < sizeof(tracks) / sizeof(tracks[0]); i++) {
+    MIDI_SmfTrackIter iter;
+    MIDI_SmfEvent     event;
+    EXPECT_EQ(&r, OK, MIDI_smf_track_iter_init(&iter, tracks[i]));
+    EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_track_iter_next(&iter, &event));
+    if(HAS_FAILED(&r)) printf("track %zu\n", i);
+  }
+
+  // events before the problem still come through
+  MIDI_SmfTrackIter iter;
+  MIDI_SmfEvent     event;
+  EXPECT_EQ(&r, OK, MIDI_smf_track_iter_init(&iter, (MIDI_SmfTrack){truncated_delta, sizeof(truncated_delta)}));
+  EXPECT_EQ(&r, OK, MIDI_smf_track_iter_next(&iter, &event));
+  EXPECT_EQ(&r, MIDI_MSG_TYPE_NOTE_ON, event.msg.type);
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_track_iter_next(&iter, &event));
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_vlq,
+      tst_open_buffer,
+      tst_open_file,
+      tst_invalid_header,
+      tst_get_tracks,
+      tst_malformed_tracks,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
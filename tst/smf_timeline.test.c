@@ -0,0 +1,263 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define OK STAT_OK
+
+#include "smf_timeline.h"
+#include "test_smf.h"
+
+#define NUM_RANDOM_TRACKS   24
+#define RANDOM_TRACK_EVENTS 500
+#define RANDOM_TRACK_SIZE   (RANDOM_TRACK_EVENTS * (MIDI_SMF_VLQ_MAX_SIZE + 3))
+
+// clang-format off
+static const uint8_t track_a[] = {0x00, 0x90, 0x3c, 0x64, 0x0a, 0x3e, 0x64, 0x00, 0x3c, 0x00, 0x00, 0xff, 0x2f, 0x00};
+static const uint8_t track_b[] = {0x0a, 0xb0, 0x07, 0x64, 0x00, 0xc0, 0x05};
+static const uint8_t track_c[] = {0x00, 0xe0, 0x00, 0x40, 0x14, 0x80, 0x3c, 0x00};
+// clang-format on
+
+static const MIDI_SmfTrack tracks[] = {
+    {track_a, sizeof(track_a)},
+    {track_b, sizeof(track_b)},
+    {track_c, sizeof(track_c)},
+};
+#define NUM_TRACKS (sizeof(tracks) / sizeof(tracks[0]))
+
+// running status notes and controllers with small, often zero, delta times so there are plenty of equal ticks
+static size_t fill_random_track(uint8_t * data, uint32_t * seed) {
+  uint8_t * p              = data;
+  uint8_t   running_status = 0;
+
+  for(size_t i = 0; i < RANDOM_TRACK_EVENTS; i++) {
+    const uint32_t r = rand_u32(seed);
+    *(p++)           = (r % 3 == 0) ? (r >> 4) % 3 : 0;
+
+    const uint8_t status = ((r >> 8) % 4 == 0) ? 0xb2 : 0x92;
+    if(status != running_status) *(p++) = status;
+    running_status = status;
+    *(p++)         = (r >> 12) & 0x7f;
+    *(p++)         = (r >> 19) & 0x7f;
+  }
+
+  return (size_t)(p - data);
+}
+
+static Result tst_decode_track(void) {
+  Result r = PASS;
+
+  MIDI_SmfEvent       events[8];
+  MIDI_SmfTrackEvents out = {.events = events, .capacity = 8};
+
+  EXPECT_EQ(&r, OK, MIDI_smf_decode_track(tracks[0], &out));
+  EXPECT_EQ(&r, OK, out.stat);
+  EXPECT_EQ(&r, 3, out.num_events);
+  EXPECT_EQ(&r, 10, events[2].tick);
+  EXPECT_EQ(&r, MIDI_MSG_TYPE_NOTE_OFF, events[2].msg.type);
+
+  EXPECT_EQ(&r, 7, MIDI_smf_track_max_events(tracks[0]));
+  EXPECT_EQ(&r, 3, MIDI_smf_track_max_events(tracks[1]));
+
+  // not enough room
+  out.capacity = 2;
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_decode_track(tracks[0], &out));
+  EXPECT_EQ(&r, STAT_ERR_RANGE, out.stat);
+  EXPECT_EQ(&r, 2, out.num_events);
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_decode_track(tracks[0], NULL));
+
+  return r;
+}
+
+static Result tst_decode_tracks(void) {
+  Result r = PASS;
+
+  for(size_t num_threads = 1; num_threads <= 8; num_threads++) {
+    MIDI_SmfEvent       events[NUM_TRACKS][8];
+    MIDI_SmfTrackEvents out[NUM_TRACKS];
+    for(size_t i = 0; i < NUM_TRACKS; i++) out[i] = (MIDI_SmfTrackEvents){.events = events[i], .capacity = 8};
+
+    EXPECT_EQ(&r, OK, MIDI_smf_decode_tracks(tracks, out, NUM_TRACKS, num_threads));
+    EXPECT_EQ(&r, 3, out[0].num_events);
+    EXPECT_EQ(&r, 2, out[1].num_events);
+    EXPECT_EQ(&r, 2, out[2].num_events);
+    EXPECT_EQ(&r, MIDI_MSG_TYPE_PROGRAM_CHANGE, events[1][1].msg.type);
+    EXPECT_EQ(&r, 20, events[2][1].tick);
+    if(HAS_FAILED(&r)) {
+      printf("num_threads %zu\n", num_threads);
+      return r;
+    }
+  }
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_decode_tracks(tracks, NULL, NUM_TRACKS, 1));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_decode_tracks(tracks, NULL, 0, 0));
+  EXPECT_EQ(&r, OK, MIDI_smf_decode_tracks(NULL, NULL, 0, 4));
+
+  return r;
+}
+
+static Result tst_decode_tracks_error(void) {
+  Result r = PASS;
+
+  const uint8_t       bad[]      = {0x00, 0x3c, 0x64}; // no running status
+  const MIDI_SmfTrack with_bad[] = {tracks[0], {bad, sizeof(bad)}, tracks[2]};
+
+  MIDI_SmfEvent       events[3][8];
+  MIDI_SmfTrackEvents out[3];
+  for(size_t i = 0; i < 3; i++) out[i] = (MIDI_SmfTrackEvents){.events = events[i], .capacity = 8};
+
+  // the other tracks are still decoded
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_smf_decode_tracks(with_bad, out, 3, 3));
+  EXPECT_EQ(&r, OK, out[0].stat);
+  EXPECT_EQ(&r, STAT_ERR_RANGE, out[1].stat);
+  EXPECT_EQ(&r, OK, out[2].stat);
+  EXPECT_EQ(&r, 2, out[2].num_events);
+
+  return r;
+}
+
+static Result tst_merge(void) {
+  Result r = PASS;
+
+  MIDI_SmfEvent       events[NUM_TRACKS][8];
+  MIDI_SmfTrackEvents out[NUM_TRACKS];
+  for(size_t i = 0; i < NUM_TRACKS; i++) out[i] = (MIDI_SmfTrackEvents){.events = events[i], .capacity = 8};
+  EXPECT_EQ(&r, OK, MIDI_smf_decode_tracks(tracks, out, NUM_TRACKS, 2));
+
+  const struct {
+    uint64_t         tick;
+    size_t           track;
+    MIDI_MessageType type;
+  } expect[] = {
+      {0, 0, MIDI_MSG_TYPE_NOTE_ON},
+      {0, 2, MIDI_MSG_TYPE_PITCH_BEND},
+      {10, 0, MIDI_MSG_TYPE_NOTE_ON},
+      {10, 0, MIDI_MSG_TYPE_NOTE_OFF},
+      {10, 1, MIDI_MSG_TYPE_CONTROL_CHANGE},
+      {10, 1, MIDI_MSG_TYPE_PROGRAM_CHANGE},
+      {20, 2, MIDI_MSG_TYPE_NOTE_OFF},
+  };
+
+  MIDI_SmfMergeCursor heap[NUM_TRACKS];
+  MIDI_SmfMerge       merge;
+  EXPECT_EQ(&r, OK, MIDI_smf_merge_init(&merge, out, NUM_TRACKS, heap));
+
+  for(size_t i = 0; i < sizeof(expect) / sizeof(expect[0]); i++) {
+    MIDI_SmfEvent event;
+    size_t        track = 99;
+    EXPECT_EQ(&r, OK, MIDI_smf_merge_next(&merge, &event, &track));
+    EXPECT_EQ(&r, expect[i].tick, event.tick);
+    EXPECT_EQ(&r, expect[i].track, track);
+    EXPECT_EQ(&r, expect[i].type, event.msg.type);
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  MIDI_SmfEvent event;
+  EXPECT_EQ(&r, STAT_OK_FINISHED, MIDI_smf_merge_next(&merge, &event, NULL));
+
+  // nothing to merge
+  EXPECT_EQ(&r, OK, MIDI_smf_merge_init(&merge, NULL, 0, NULL));
+  EXPECT_EQ(&r, STAT_OK_FINISHED, MIDI_smf_merge_next(&merge, &event, NULL));
+
+  return r;
+}
+
+static Result tst_merge_random(void) {
+  Result r = PASS;
+
+  static uint8_t             data[NUM_RANDOM_TRACKS][RANDOM_TRACK_SIZE];
+  static MIDI_SmfEvent       events[NUM_RANDOM_TRACKS][RANDOM_TRACK_EVENTS];
+  static MIDI_SmfEvent       merged[2][NUM_RANDOM_TRACKS * RANDOM_TRACK_EVENTS];
+  static size_t              merged_tracks[2][NUM_RANDOM_TRACKS * RANDOM_TRACK_EVENTS];
+  static MIDI_SmfTrack       random_tracks[NUM_RANDOM_TRACKS];
+  static MIDI_SmfTrackEvents out[NUM_RANDOM_TRACKS];
+
+  uint32_t seed = 42;
+  for(size_t i = 0; i < NUM_RANDOM_TRACKS; i++) {
+    // leave some tracks empty
+    const size_t len = (i % 7 == 3) ? 0 : fill_random_track(data[i], &seed);
+    random_tracks[i] = (MIDI_SmfTrack){data[i], len};
+  }
+
+  // once on a single thread and once on many, the merged result has to be identical
+  const size_t num_threads[] = {1, 8};
+  for(size_t run = 0; run < 2; run++) {
+    for(size_t i = 0; i < NUM_RANDOM_TRACKS; i++) {
+      out[i] = (MIDI_SmfTrackEvents){.events = events[i], .capacity = RANDOM_TRACK_EVENTS};
+    }
+    EXPECT_EQ(&r, OK, MIDI_smf_decode_tracks(random_tracks, out, NUM_RANDOM_TRACKS, num_threads[run]));
+
+    MIDI_SmfMergeCursor heap[NUM_RANDOM_TRACKS];
+    MIDI_SmfMerge       merge;
+    EXPECT_EQ(&r, OK, MIDI_smf_merge_init(&merge, out, NUM_RANDOM_TRACKS, heap));
+
+    size_t next_pos[NUM_RANDOM_TRACKS] = {0};
+    size_t n                           = 0;
+    while(MIDI_smf_merge_next(&merge, &merged[run][n], &merged_tracks[run][n]) == OK) {
+      const size_t track = merged_tracks[run][n];
+
+      // every event exactly once, in its track's order
+      EXPECT_TRUE(&r, events_equal(&merged[run][n], &events[track][next_pos[track]++]));
+
+      // ordered by tick, then by track
+      if(n > 0) {
+        const MIDI_SmfEvent * prev = &merged[run][n - 1];
+        EXPECT_TRUE(&r, prev->tick <= merged[run][n].tick);
+        if(prev->tick == merged[run][n].tick) EXPECT_TRUE(&r, merged_tracks[run][n - 1] <= track);
+      }
+      if(HAS_FAILED(&r)) return r;
+      n++;
+    }
+
+    size_t total = 0;
+    for(size_t i = 0; i < NUM_RANDOM_TRACKS; i++) {
+      EXPECT_EQ(&r, out[i].num_events, next_pos[i]);
+      total += out[i].num_events;
+    }
+    EXPECT_EQ(&r, total, n);
+    EXPECT_EQ(&r, (NUM_RANDOM_TRACKS - 3) * RANDOM_TRACK_EVENTS, total);
+  }
+
+  for(size_t i = 0; i < (NUM_RANDOM_TRACKS - 3) * RANDOM_TRACK_EVENTS; i++) {
+    EXPECT_TRUE(&r, events_equal(&merged[0][i], &merged[1][i]));
+    EXPECT_EQ(&r, merged_tracks[0][i], merged_tracks[1][i]);
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_decode_track,
+      tst_decode_tracks,
+      tst_decode_tracks_error,
+      tst_merge,
+      tst_merge_random,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OK STAT_OK
+
+#include "smf.h"
+#include "smf_writer.h"
+#include "test_msgs.h"
+#include "test_smf.h"
+
+#define NUM_RANDOM_EVENTS 5000
+
+static MIDI_SmfEvent random_event(uint64_t * tick, uint32_t * seed) {
+  const uint32_t     r       = rand_u32(seed);
+  const MIDI_Channel channel = 1 + (r & 0x1);
+  const uint8_t      data1   = (r >> 1) & 0x7f;
+  const uint8_t      data2   = 1 + ((r >> 8) % 127);
+
+  *tick += (r >> 16) % 4;
+
+  MIDI_SmfEvent event = {.tick = *tick};
+  switch((r >> 20) % 4) {
+  case 0: event.msg = note_on(channel, data1, data2); break;
+  case 1: event.msg = note_off(channel, data1, ((r >> 22) & 1) ? MIDI_NOTE_OFF_DEFAULT_VELOCITY : data2); break;
+  case 2: event.msg = cc(channel, data1, data2); break;
+  default:
+    event.msg = (MIDI_Message){
+        .type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = channel, .data.program_change = {.program = data1}};
+    break;
+  }
+
+  return event;
+}
+
+static bool make_path(char * path) {
+  const int fd = mkstemp(path);
+  if(fd < 0) return false;
+  close(fd);
+  return true;
+}
+
+static Result read_file(const char * path, uint8_t * data, size_t max_len, size_t * len) {
+  Result r = PASS;
+
+  FILE * file = fopen(path, "rb");
+  EXPECT_TRUE(&r, file != NULL);
+  if(HAS_FAILED(&r)) return r;
+  *len = fread(data, 1, max_len, file);
+  fclose(file);
+
+  return r;
+}
+
+static Result tst_write(void) {
+  Result r = PASS;
+
+  char path[] = "/tmp/c_midi_smf_writer_test_XXXXXX";
+  EXPECT_TRUE(&r, make_path(path));
+  if(HAS_FAILED(&r)) return r;
+
+  uint8_t        buffer[256];
+  MIDI_SmfWriter writer;
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_open(&writer, path, 480, buffer, sizeof(buffer)));
+
+  const MIDI_SmfEvent events[] = {
+      {0, note_on(1, MIDI_NOTE_C_4, 100)},
+      {480, note_on(1, MIDI_NOTE_E_4, 90)},
+      {960, note_off(1, MIDI_NOTE_C_4, MIDI_NOTE_OFF_DEFAULT_VELOCITY)},
+      {960, note_off(1, MIDI_NOTE_E_4, 10)},
+      {960, {.type = MIDI_MSG_TYPE_PROGRAM_CHANGE, .channel = 0, .data.program_change = {.program = 5}}},
+      {1000, {.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = 2, .data.pitch_bend = {.value = -8192}}},
+  };
+  const size_t num_events = sizeof(events) / sizeof(events[0]);
+
+  size_t consumed = 0;
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_write_events(&writer, events, num_events, &consumed));
+  EXPECT_EQ(&r, num_events, consumed);
+  EXPECT_EQ(&r, 0, writer.num_writes); // all of it still fits in the buffer
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_close(&writer));
+  EXPECT_EQ(&r, 1, writer.num_writes);
+
+  // clang-format off
+  const uint8_t expect[] = {
+    'M', 'T', 'h', 'd', 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x01, 0x01, 0xe0,
+    'M', 'T', 'r', 'k', 0x00, 0x00, 0x00, 0x1b,
+    0x00, 0x90, MIDI_NOTE_C_4, 100,
+    0x83, 0x60, MIDI_NOTE_E_4, 90,      // running status
+    0x83, 0x60, MIDI_NOTE_C_4, 0x00,    // note off as note on with velocity 0, keeps the running status
+    0x00, 0x80, MIDI_NOTE_E_4, 10,
+    0x00, 0xc0, 5,                      // without a channel it goes to channel 1
+    0x28, 0xe1, 0x00, 0x00,
+    0x00, MIDI_SMF_META, MIDI_SMF_META_END_OF_TRACK, 0x00,
+  };
+  // clang-format on
+
+  uint8_t data[256];
+  size_t  len = 0;
+  EXPECT_EQ(&r, PASS, read_file(path, data, sizeof(data), &len));
+  EXPECT_EQ(&r, sizeof(expect), len);
+  EXPECT_EQ(&r, 0, memcmp(expect, data, sizeof(expect)));
+
+  unlink(path);
+
+  return r;
+}
+
+// whatever goes in comes back out of the reader, also when the buffer is as small as it gets
+static Result tst_write_read_back(void) {
+  Result r = PASS;
+
+  static MIDI_SmfEvent events[NUM_RANDOM_EVENTS];
+  uint32_t             seed = 7;
+  uint64_t             tick = 0;
+  for(size_t i = 0; i < NUM_RANDOM_EVENTS; i++) events[i] = random_event(&tick, &seed);
+
+  const size_t capacities[] = {MIDI_SMF_WRITER_MIN_BUFFER_SIZE, 100, 1 << 16};
+
+  for(size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+    char path[] = "/tmp/c_midi_smf_writer_test_XXXXXX";
+    EXPECT_TRUE(&r, make_path(path));
+    if(HAS_FAILED(&r)) return r;
+
+    static uint8_t buffer[1 << 16];
+    MIDI_SmfWriter writer;
+    EXPECT_EQ(&r, OK, MIDI_smf_writer_open(&writer, path, 96, buffer, capacities[c]));
+    for(size_t i = 0; i < NUM_RANDOM_EVENTS; i++) EXPECT_EQ(&r, OK, MIDI_smf_writer_write(&writer, events[i]));
+    EXPECT_EQ(&r, OK, MIDI_smf_writer_close(&writer));
+
+    if(capacities[c] > NUM_RANDOM_EVENTS * 4) EXPECT_EQ(&r, 1, writer.num_writes);
+    if(capacities[c] == MIDI_SMF_WRITER_MIN_BUFFER_SIZE) EXPECT_TRUE(&r, writer.num_writes > 100);
+
+    MIDI_Smf smf;
+    EXPECT_EQ(&r, OK, MIDI_smf_open(&smf, path));
+    EXPECT_EQ(&r, 0, smf.format);
+    EXPECT_EQ(&r, 1, smf.num_tracks);
+    EXPECT_EQ(&r, 96, smf.division);
+
+    MIDI_SmfTrack track;
+    size_t        num_tracks = 0;
+    EXPECT_EQ(&r, OK, MIDI_smf_get_tracks(&smf, &track, 1, &num_tracks));
+    EXPECT_EQ(&r, 1, num_tracks);
+    EXPECT_EQ(&r, smf.size - 22, track.len);
+
+    MIDI_SmfTrackIter iter;
+    MIDI_SmfEvent     event;
+    EXPECT_EQ(&r, OK, MIDI_smf_track_iter_init(&iter, track));
+    for(size_t i = 0; i < NUM_RANDOM_EVENTS; i++) {
+      EXPECT_EQ(&r, OK, MIDI_smf_track_iter_next(&iter, &event));
+      EXPECT_TRUE(&r, events_equal(&events[i], &event));
+      if(HAS_FAILED(&r)) {
+        printf("capacity %zu, event %zu\n", capacities[c], i);
+        break;
+      }
+    }
+    EXPECT_EQ(&r, STAT_OK_FINISHED, MIDI_smf_track_iter_next(&iter, &event));
+    EXPECT_EQ(&r, iter.end, iter.pos);
+
+    EXPECT_EQ(&r, OK, MIDI_smf_close(&smf));
+    unlink(path);
+    if(HAS_FAILED(&r)) return r;
+  }
+
+  return r;
+}
+
+static Result tst_refused_events(void) {
+  Result r = PASS;
+
+  char path[] = "/tmp/c_midi_smf_writer_test_XXXXXX";
+  EXPECT_TRUE(&r, make_path(path));
+  if(HAS_FAILED(&r)) return r;
+
+  uint8_t        buffer[64];
+  MIDI_SmfWriter writer;
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_open(&writer, path, 480, buffer, sizeof(buffer)));
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_write(&writer, (MIDI_SmfEvent){100, note_on(1, MIDI_NOTE_C_4, 1)}));
+
+  const size_t len = writer.len;
+
+  const MIDI_SmfEvent clock = {100, {.type = MIDI_MSG_TYPE_MISC, .data.misc = {.status = 0xf8}}};
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_write(&writer, clock));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_write(&writer, (MIDI_SmfEvent){99, note_on(1, MIDI_NOTE_C_4, 1)}));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_write(&writer, (MIDI_SmfEvent){100, note_on(1, MIDI_NOTE_C_4, 0)}));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_write(&writer, (MIDI_SmfEvent){100, note_on(17, MIDI_NOTE_C_4, 1)}));
+  EXPECT_EQ(&r,
+            STAT_ERR_RANGE,
+            MIDI_smf_writer_write(&writer, (MIDI_SmfEvent){100 + MIDI_SMF_VLQ_MAX + 1, note_on(1, MIDI_NOTE_C_4, 1)}));
+  EXPECT_EQ(&r, len, writer.len);
+  EXPECT_EQ(&r, 100, writer.last_tick);
+
+  // the events before the refused one are written
+  const MIDI_SmfEvent events[] = {
+      {100, note_off(1, MIDI_NOTE_C_4, 1)},
+      {100 + MIDI_SMF_VLQ_MAX, note_on(1, MIDI_NOTE_C_4, 1)},
+      {100, note_off(1, MIDI_NOTE_C_4, 1)},
+  };
+  size_t consumed = 0;
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_write_events(&writer, events, 3, &consumed));
+  EXPECT_EQ(&r, 2, consumed);
+  EXPECT_EQ(&r, 100 + MIDI_SMF_VLQ_MAX, writer.last_tick);
+
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_flush(&writer));
+  EXPECT_EQ(&r, 0, writer.len);
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_close(&writer));
+
+  // and the file can be read
+  MIDI_Smf      smf;
+  MIDI_SmfTrack track;
+  size_t        num_tracks = 0;
+  EXPECT_EQ(&r, OK, MIDI_smf_open(&smf, path));
+  EXPECT_EQ(&r, OK, MIDI_smf_get_tracks(&smf, &track, 1, &num_tracks));
+
+  MIDI_SmfTrackIter iter;
+  MIDI_SmfEvent     event;
+  EXPECT_EQ(&r, OK, MIDI_smf_track_iter_init(&iter, track));
+  for(int i = 0; i < 3; i++) EXPECT_EQ(&r, OK, MIDI_smf_track_iter_next(&iter, &event));
+  EXPECT_EQ(&r, 100 + MIDI_SMF_VLQ_MAX, event.tick);
+  EXPECT_EQ(&r, STAT_OK_FINISHED, MIDI_smf_track_iter_next(&iter, &event));
+  EXPECT_EQ(&r, OK, MIDI_smf_close(&smf));
+
+  unlink(path);
+
+  return r;
+}
+
+static Result tst_open_close(void) {
+  Result r = PASS;
+
+  char path[] = "/tmp/c_midi_smf_writer_test_XXXXXX";
+  EXPECT_TRUE(&r, make_path(path));
+  if(HAS_FAILED(&r)) return r;
+
+  uint8_t        buffer[MIDI_SMF_WRITER_MIN_BUFFER_SIZE];
+  MIDI_SmfWriter writer;
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_open(&writer, path, 480, buffer, sizeof(buffer) - 1));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_open(&writer, path, 0, buffer, sizeof(buffer)));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_smf_writer_open(&writer, NULL, 480, buffer, sizeof(buffer)));
+  EXPECT_EQ(&r, STAT_ERR_IO, MIDI_smf_writer_open(&writer, "/nonexistent/dir/file.mid", 480, buffer, sizeof(buffer)));
+
+  // an empty recording is still a valid file
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_open(&writer, path, 480, buffer, sizeof(buffer)));
+  EXPECT_EQ(&r, OK, MIDI_smf_writer_close(&writer));
+
+  uint8_t data[64];
+  size_t  len = 0;
+  EXPECT_EQ(&r, PASS, read_file(path, data, sizeof(data), &len));
+  EXPECT_EQ(&r, 26, len);
+  EXPECT_EQ(&r, 4, data[21]);
+
+  // closed
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_smf_writer_write(&writer, (MIDI_SmfEvent){0, note_on(1, 60, 1)}));
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_smf_writer_flush(&writer));
+  EXPECT_EQ(&r, STAT_ERR_PRECONDITION, MIDI_smf_writer_close(&writer));
+
+  unlink(path);
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_write,
+      tst_write_read_back,
+      tst_refused_events,
+      tst_open_close,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_TEST_MSGS_H
+#define C_MIDI_TEST_MSGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "message.h"
+#include "parser.h"
+
+// Messages for the tests of what is put after a parser, and the parser to get them from bytes.
+
+static inline MIDI_Message note_on(MIDI_Channel channel, uint8_t note, uint8_t velocity) {
+  return (MIDI_Message){
+      .type = MIDI_MSG_TYPE_NOTE_ON, .channel = channel, .data.note_on = {.note = note, .velocity = velocity}};
+}
+
+static inline MIDI_Message note_off(MIDI_Channel channel, uint8_t note, uint8_t velocity) {
+  return (MIDI_Message){
+      .type = MIDI_MSG_TYPE_NOTE_OFF, .channel = channel, .data.note_off = {.note = note, .velocity = velocity}};
+}
+
+static inline MIDI_Message cc(MIDI_Channel channel, uint8_t control, uint8_t value) {
+  return (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+                        .channel             = channel,
+                        .data.control_change = {.control = control, .value = value}};
+}
+
+static inline MIDI_Message pitch_bend(MIDI_Channel channel, int16_t value) {
+  return (MIDI_Message){.type = MIDI_MSG_TYPE_PITCH_BEND, .channel = channel, .data.pitch_bend = {.value = value}};
+}
+
+// Runs bytes through an omni parser on all channels and writes up to max of the messages to msgs. Returns how many, or
+// 0 if the parser failed.
+static inline size_t parse_msgs(const uint8_t * bytes, size_t n, MIDI_Message * msgs, size_t max) {
+  MIDI_Parser parser;
+  if(MIDI_parser_init_omni(&parser, MIDI_CHANNEL_MASK_ALL) != STAT_OK) return 0;
+
+  size_t num_msgs = 0;
+  for(size_t i = 0; i < n; i++) {
+    if(MIDI_parse_byte(&parser, bytes[i]) != STAT_OK) return 0;
+    while(MIDI_parser_has_output(&parser) && num_msgs < max) msgs[num_msgs++] = MIDI_parser_pop_msg(&parser);
+  }
+
+  return num_msgs;
+}
+
+#endif
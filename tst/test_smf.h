@@ -0,0 +1,41 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef C_MIDI_TEST_SMF_H
+#define C_MIDI_TEST_SMF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "smf.h"
+
+// For the tests that read and write Standard MIDI Files, with the message builders in test_msgs.h.
+
+static inline bool events_equal(const MIDI_SmfEvent * a, const MIDI_SmfEvent * b) {
+  return a->tick == b->tick && a->msg.type == b->msg.type && a->msg.channel == b->msg.channel &&
+         a->msg.data.pitch_bend.value == b->msg.data.pitch_bend.value; // compares all data bytes
+}
+
+// the same sequence for the same seed, to make random tracks that can be reproduced
+static inline uint32_t rand_u32(uint32_t * state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+#endif
@@ -0,0 +1,253 @@
+// MIT License
+//
+// Copyright (c) 2023 Arjen P. van Zanten
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+// NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <cfac/test_utils.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OK STAT_OK
+
+#include "voice.h"
+
+#define NUM_VOICES 4
+#define MAX_EVENTS (NUM_VOICES + 1)
+
+typedef struct Fixture {
+  MIDI_VoiceAllocator allocator;
+  MIDI_VoiceEvent     events[MAX_EVENTS];
+  size_t              num_events;
+} Fixture;
+
+static MIDI_Message note_on(uint8_t note, uint8_t velocity) {
+  return (MIDI_Message){
+      .type = MIDI_MSG_TYPE_NOTE_ON, .channel = 1, .data.note_on = {.note = note, .velocity = velocity}};
+}
+
+static MIDI_Message note_off(uint8_t note) {
+  return (MIDI_Message){.type = MIDI_MSG_TYPE_NOTE_OFF, .channel = 1, .data.note_off = {.note = note}};
+}
+
+static MIDI_Message cc(uint8_t control, uint8_t value) {
+  return (MIDI_Message){.type                = MIDI_MSG_TYPE_CONTROL_CHANGE,
+                        .channel             = 1,
+                        .data.control_change = {.control = control, .value = value}};
+}
+
+static size_t feed(Fixture * f, MIDI_Message msg) {
+  if(MIDI_voice_process(&(f->allocator), msg, f->events, MAX_EVENTS, &(f->num_events)) != OK) return SIZE_MAX;
+  return f->num_events;
+}
+
+static Result expect_event(MIDI_VoiceEvent event, MIDI_VoiceEventType type, uint8_t voice, uint8_t note) {
+  Result r = PASS;
+
+  EXPECT_EQ(&r, type, event.type);
+  EXPECT_EQ(&r, voice, event.voice);
+  EXPECT_EQ(&r, note, event.note);
+
+  return r;
+}
+
+// notes 60, 40, 80 and 50 on voices 0-3
+static Result fill(Fixture * f, MIDI_StealPolicy policy) {
+  Result r = PASS;
+
+  EXPECT_EQ(&r, OK, MIDI_voice_init(&(f->allocator), 1, NUM_VOICES, policy));
+
+  const uint8_t notes[]      = {60, 40, 80, 50};
+  const uint8_t velocities[] = {100, 50, 70, 50};
+  for(uint8_t i = 0; i < NUM_VOICES; i++) {
+    EXPECT_EQ(&r, 1, feed(f, note_on(notes[i], velocities[i])));
+    EXPECT_EQ(&r, PASS, expect_event(f->events[0], MIDI_VOICE_START, i, notes[i]));
+    EXPECT_EQ(&r, velocities[i], f->events[0].velocity);
+  }
+  EXPECT_EQ(&r, NUM_VOICES, MIDI_voice_num_active(&(f->allocator)));
+
+  return r;
+}
+
+static Result tst_allocate_release(void) {
+  Result  r = PASS;
+  Fixture f;
+
+  EXPECT_EQ(&r, PASS, fill(&f, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, 2, MIDI_voice_of_note(&(f.allocator), 80));
+  EXPECT_EQ(&r, MIDI_VOICE_NONE, MIDI_voice_of_note(&(f.allocator), 81));
+
+  // voices are reused in the order they were released in
+  EXPECT_EQ(&r, 1, feed(&f, note_off(80)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_RELEASE, 2, 80));
+  EXPECT_EQ(&r, 1, feed(&f, note_on(60, 0))); // a note off too
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_RELEASE, 0, 60));
+  EXPECT_EQ(&r, MIDI_VOICE_NONE, MIDI_voice_of_note(&(f.allocator), 80));
+  EXPECT_EQ(&r, 2, MIDI_voice_num_active(&(f.allocator)));
+
+  EXPECT_EQ(&r, 1, feed(&f, note_on(70, 1)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_START, 2, 70));
+  EXPECT_EQ(&r, 1, feed(&f, note_on(71, 1)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_START, 0, 71));
+
+  // playing a note again retriggers its voice
+  EXPECT_EQ(&r, 1, feed(&f, note_on(40, 127)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_START, 1, 40));
+
+  // notes without a voice and other channels are ignored
+  EXPECT_EQ(&r, 0, feed(&f, note_off(41)));
+  MIDI_Message other = note_on(90, 100);
+  other.channel      = 2;
+  EXPECT_EQ(&r, 0, feed(&f, other));
+
+  return r;
+}
+
+static Result tst_steal(void) {
+  Result  r = PASS;
+  Fixture f;
+
+  const struct {
+    MIDI_StealPolicy policy;
+    uint8_t          voice;
+    uint8_t          note;
+  } cases[] = {
+      {MIDI_STEAL_OLDEST, 0, 60},
+      {MIDI_STEAL_QUIETEST, 1, 40}, // 40 and 50 are both at 50, 40 is older
+      {MIDI_STEAL_LOWEST, 1, 40},
+      {MIDI_STEAL_HIGHEST, 2, 80},
+  };
+
+  for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    EXPECT_EQ(&r, PASS, fill(&f, cases[i].policy));
+    EXPECT_EQ(&r, 2, feed(&f, note_on(90, 100)));
+    EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_KILL, cases[i].voice, cases[i].note));
+    EXPECT_EQ(&r, PASS, expect_event(f.events[1], MIDI_VOICE_START, cases[i].voice, 90));
+    EXPECT_EQ(&r, MIDI_VOICE_NONE, MIDI_voice_of_note(&(f.allocator), cases[i].note));
+    EXPECT_EQ(&r, cases[i].voice, MIDI_voice_of_note(&(f.allocator), 90));
+    EXPECT_EQ(&r, NUM_VOICES, MIDI_voice_num_active(&(f.allocator)));
+  }
+
+  // the stolen voices keep coming from the right end
+  EXPECT_EQ(&r, PASS, fill(&f, MIDI_STEAL_OLDEST));
+  for(uint8_t i = 0; i < 2 * NUM_VOICES; i++) {
+    EXPECT_EQ(&r, 2, feed(&f, note_on(100 + i, 100)));
+    EXPECT_EQ(&r, i % NUM_VOICES, f.events[0].voice);
+  }
+
+  EXPECT_EQ(&r, PASS, fill(&f, MIDI_STEAL_QUIETEST));
+  EXPECT_EQ(&r, 2, feed(&f, note_on(91, 1)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_KILL, 1, 40));
+  EXPECT_EQ(&r, 2, feed(&f, note_on(92, 100)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_KILL, 1, 91));
+  EXPECT_EQ(&r, 2, feed(&f, note_on(93, 100)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_KILL, 3, 50));
+
+  return r;
+}
+
+static Result tst_sustain(void) {
+  Result  r = PASS;
+  Fixture f;
+
+  EXPECT_EQ(&r, PASS, fill(&f, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, 0, feed(&f, cc(MIDI_CTRL_DAMPER_PEDAL_ON_OFF, 127)));
+
+  EXPECT_EQ(&r, 0, feed(&f, note_off(60)));
+  EXPECT_EQ(&r, 0, feed(&f, note_off(40)));
+  EXPECT_EQ(&r, MIDI_VOICE_SUSTAINED, f.allocator.voices[0].state);
+  EXPECT_EQ(&r, MIDI_VOICE_ON, f.allocator.voices[2].state);
+
+  // played again while held, it's down again
+  EXPECT_EQ(&r, 1, feed(&f, note_on(40, 10)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_START, 1, 40));
+  EXPECT_EQ(&r, MIDI_VOICE_ON, f.allocator.voices[1].state);
+
+  EXPECT_EQ(&r, 0, feed(&f, cc(MIDI_CTRL_DAMPER_PEDAL_ON_OFF, 127))); // still down
+  EXPECT_EQ(&r, 1, feed(&f, cc(MIDI_CTRL_DAMPER_PEDAL_ON_OFF, 0)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_RELEASE, 0, 60));
+  EXPECT_EQ(&r, 3, MIDI_voice_num_active(&(f.allocator)));
+
+  // all notes off holds on to the notes while the pedal is down
+  EXPECT_EQ(&r, 0, feed(&f, cc(MIDI_CTRL_DAMPER_PEDAL_ON_OFF, 64)));
+  EXPECT_EQ(&r, 0, feed(&f, cc(MIDI_CTRL_ALL_NOTES_OFF, 0)));
+  EXPECT_EQ(&r, 3, MIDI_voice_num_active(&(f.allocator)));
+  EXPECT_EQ(&r, 3, feed(&f, cc(MIDI_CTRL_RESET_ALL_CONTROLLERS, 0)));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[0], MIDI_VOICE_RELEASE, 2, 80));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[1], MIDI_VOICE_RELEASE, 3, 50));
+  EXPECT_EQ(&r, PASS, expect_event(f.events[2], MIDI_VOICE_RELEASE, 1, 40));
+  EXPECT_EQ(&r, 0, MIDI_voice_num_active(&(f.allocator)));
+
+  return r;
+}
+
+static Result tst_all_off(void) {
+  Result  r = PASS;
+  Fixture f;
+
+  EXPECT_EQ(&r, PASS, fill(&f, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, NUM_VOICES, feed(&f, cc(MIDI_CTRL_ALL_NOTES_OFF, 0)));
+  for(uint8_t i = 0; i < NUM_VOICES; i++) EXPECT_EQ(&r, MIDI_VOICE_RELEASE, f.events[i].type);
+  EXPECT_EQ(&r, 0, MIDI_voice_num_active(&(f.allocator)));
+
+  // even with the pedal down, all sound off kills every voice
+  EXPECT_EQ(&r, PASS, fill(&f, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, 0, feed(&f, cc(MIDI_CTRL_DAMPER_PEDAL_ON_OFF, 127)));
+  EXPECT_EQ(&r, 0, feed(&f, note_off(50)));
+  EXPECT_EQ(&r, NUM_VOICES, feed(&f, cc(MIDI_CTRL_ALL_SOUND_OFF, 0)));
+  for(uint8_t i = 0; i < NUM_VOICES; i++) EXPECT_EQ(&r, MIDI_VOICE_KILL, f.events[i].type);
+  EXPECT_EQ(&r, 0, MIDI_voice_num_active(&(f.allocator)));
+  EXPECT_EQ(&r, 0, feed(&f, cc(MIDI_CTRL_DAMPER_PEDAL_ON_OFF, 0)));
+
+  // and everything still works afterwards
+  EXPECT_EQ(&r, PASS, fill(&f, MIDI_STEAL_QUIETEST));
+
+  return r;
+}
+
+static Result tst_errors(void) {
+  Result  r = PASS;
+  Fixture f;
+
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_voice_init(NULL, 1, NUM_VOICES, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_voice_init(&(f.allocator), 17, NUM_VOICES, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_voice_init(&(f.allocator), 1, 0, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, STAT_ERR_RANGE, MIDI_voice_init(&(f.allocator), 1, MIDI_VOICES_MAX + 1, MIDI_STEAL_OLDEST));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_voice_init(&(f.allocator), 1, NUM_VOICES, (MIDI_StealPolicy)9));
+
+  EXPECT_EQ(&r, OK, MIDI_voice_init(&(f.allocator), 0, MIDI_VOICES_MAX, MIDI_STEAL_OLDEST));
+  // not enough room for the events of a full pool
+  EXPECT_EQ(&r, STAT_ERR_ARGS,
+            MIDI_voice_process(&(f.allocator), note_on(60, 1), f.events, MAX_EVENTS, &(f.num_events)));
+  EXPECT_EQ(&r, STAT_ERR_ARGS, MIDI_voice_process(NULL, note_on(60, 1), f.events, MAX_EVENTS, &(f.num_events)));
+
+  return r;
+}
+
+int main(void) {
+  Test tests[] = {
+      tst_allocate_release,
+      tst_steal,
+      tst_sustain,
+      tst_all_off,
+      tst_errors,
+  };
+
+  return (run_tests(tests, sizeof(tests) / sizeof(Test)) == PASS) ? 0 : 1;
+}